@@ -1,13 +1,18 @@
 // Audio Feature Extractor Worklet
 // Processes audio in real-time to extract features for analysis
 
+// C++ feature rows: 13 MFCCs, energy, ZCR, spectral centroid, pitch
+const ROW_COLUMNS = 17;
+// Rows per 'feature-rows' message; about 85 ms at the default hop and 48 kHz
+const ROWS_PER_BATCH = 4;
+
 class FeatureExtractorProcessor extends AudioWorkletProcessor {
   constructor(options) {
     super();
     
     // Configuration from options
     this.bufferSize = options.processorOptions?.bufferSize || 2048;
-    this.hopSize = options.processorOptions?.hopSize || 512;
+    this.hopSize = options.processorOptions?.hopSize || 1024; // offline analysis hop, frame / 2
     this.mfccCoefficients = options.processorOptions?.mfccCoefficients || 13;
     
     // Internal buffers
@@ -23,6 +28,172 @@ class FeatureExtractorProcessor extends AudioWorkletProcessor {
     for (let i = 0; i < this.bufferSize; i++) {
       this.window[i] = 0.54 - 0.46 * Math.cos(2 * Math.PI * i / (this.bufferSize - 1));
     }
+    
+    // C++ extractor (src/wasm/worklet_extractor.cpp), when the page could
+    // compile it. Features then come from the same code as offline analysis;
+    // the JS implementation below is the fallback.
+    this.wasm = null;
+    this.wasmInput = null;
+    this.wasmFeatures = null;
+    this.wasmStride = 0;
+    // C++ rows go out in batches, in blocks the main thread transfers back
+    // with 'return-rows', so steady-state posting allocates nothing per row
+    this.rowPool = [];
+    this.rowBatch = null;
+    this.batchRows = 0;
+    this.batchTime = 0;
+    const wasmModule = options.processorOptions?.wasmModule;
+    if (wasmModule) {
+      this.initWasm(wasmModule);
+    }
+    
+    // Shared sample ring (src/wasm/ring_buffer.h). While one is attached the
+    // worklet only writes raw samples into it; the analysis side extracts
+    // features from the ring with the C++ streaming extractor.
+    this.ringControl = null;
+    this.ringSamples = null;
+    this.ringCapacity = 0;
+    const ring = options.processorOptions?.ring;
+    if (ring) {
+      this.attachRing(ring.buffer, ring.byteOffset);
+    }
+    this.port.onmessage = (event) => {
+      const message = event.data;
+      if (message?.type === 'attach-ring') {
+        this.attachRing(message.buffer, message.byteOffset);
+      } else if (message?.type === 'return-rows') {
+        this.rowPool.push(new Float32Array(message.buffer));
+      } else if (message?.type === 'flush') {
+        this.postRowBatch();
+      } else if (message?.type === 'detach-ring') {
+        this.ringControl = null;
+        this.ringSamples = null;
+        this.ringCapacity = 0;
+      }
+    };
+  }
+  
+  // Instantiated synchronously: the worklet scope has no fetch. All of the
+  // extractor's allocation happens in worklet_configure(), and its memory
+  // never grows, so the views taken here stay valid.
+  initWasm(wasmModule) {
+    try {
+      // A standalone build only imports WASI calls on its abort paths
+      const imports = {};
+      for (const entry of WebAssembly.Module.imports(wasmModule)) {
+        if (entry.kind !== 'function') continue;
+        imports[entry.module] = imports[entry.module] || {};
+        imports[entry.module][entry.name] = () => {
+          throw new Error(`feature extractor called ${entry.module}.${entry.name}`);
+        };
+      }
+      const exports = new WebAssembly.Instance(wasmModule, imports).exports;
+      if (exports._initialize) {
+        exports._initialize();
+      }
+      
+      const maxFrames = 8;
+      if (!exports.worklet_configure(this.sampleRate, this.bufferSize, this.hopSize, maxFrames)) {
+        throw new Error('unsupported frame configuration');
+      }
+      const memory = exports.memory.buffer;
+      this.wasmStride = exports.worklet_feature_stride();
+      this.wasmInput = new Float32Array(memory, exports.worklet_input(), exports.worklet_quantum());
+      this.wasmFeatures = new Float32Array(memory, exports.worklet_features(), maxFrames * this.wasmStride);
+      this.wasm = exports;
+    } catch (error) {
+      this.wasm = null;
+      this.port.postMessage({ type: 'error', data: `C++ feature extractor unavailable: ${error.message}`, timestamp: Date.now() });
+    }
+  }
+  
+  // Feeds the quantum to the C++ extractor, which does a bounded slice of
+  // frame work per call, and batches any rows it completed
+  processWasm(inputChannel) {
+    const wasm = this.wasm;
+    const input = this.wasmInput;
+    for (let offset = 0; offset < inputChannel.length; offset += input.length) {
+      const count = Math.min(input.length, inputChannel.length - offset);
+      for (let i = 0; i < count; i++) {
+        input[i] = inputChannel[offset + i];
+      }
+      const rows = wasm.worklet_process(count);
+      for (let r = 0; r < rows; r++) {
+        this.appendWasmRow(r * this.wasmStride);
+      }
+      if (rows > 0) {
+        wasm.worklet_clear();
+      }
+    }
+  }
+  
+  // Copies one row into the open batch, posting the batch when it is full
+  appendWasmRow(base) {
+    if (!this.rowBatch) {
+      this.rowBatch = this.rowPool.pop() || new Float32Array(ROWS_PER_BATCH * ROW_COLUMNS);
+      this.batchTime = currentTime;
+    }
+    const row = this.wasmFeatures;
+    const batch = this.rowBatch;
+    const offset = this.batchRows * ROW_COLUMNS;
+    for (let c = 0; c < ROW_COLUMNS; c++) {
+      batch[offset + c] = row[base + c];
+    }
+    if (++this.batchRows === ROWS_PER_BATCH) {
+      this.postRowBatch();
+    }
+  }
+  
+  // Posts the open batch, full or not ('flush' sends the tail when recording
+  // stops). The message carries the block as a transferable:
+  // {rows, columns, time, interval} with `time` the context time of the first
+  // row and `interval` the seconds between rows.
+  postRowBatch() {
+    if (!this.rowBatch || this.batchRows === 0) return;
+    const batch = this.rowBatch;
+    this.port.postMessage({
+      type: 'feature-rows',
+      buffer: batch.buffer,
+      rows: this.batchRows,
+      columns: ROW_COLUMNS,
+      time: this.batchTime,
+      interval: this.hopSize / this.sampleRate,
+      timestamp: Date.now()
+    }, [batch.buffer]);
+    this.rowBatch = null;
+    this.batchRows = 0;
+  }
+  
+  // Header words: writeIndex [0], overruns [1], readIndex [16], capacity [17];
+  // samples start 128 bytes in
+  attachRing(buffer, byteOffset) {
+    const control = new Uint32Array(buffer, byteOffset, 32);
+    const capacity = Atomics.load(control, 17);
+    if (capacity === 0 || (capacity & (capacity - 1)) !== 0) {
+      this.port.postMessage({ type: 'error', data: 'invalid sample ring', timestamp: Date.now() });
+      return;
+    }
+    this.ringControl = control;
+    this.ringSamples = new Float32Array(buffer, byteOffset + 128, capacity);
+    this.ringCapacity = capacity;
+  }
+  
+  // Single producer: copy what fits, count the rest as overruns, then
+  // publish with the write index. Never blocks and never allocates.
+  writeRing(samples) {
+    const control = this.ringControl;
+    const write = Atomics.load(control, 0);
+    const read = Atomics.load(control, 16);
+    const free = this.ringCapacity - ((write - read) >>> 0);
+    const count = Math.min(samples.length, free);
+    const mask = this.ringCapacity - 1;
+    for (let i = 0; i < count; i++) {
+      this.ringSamples[(write + i) & mask] = samples[i];
+    }
+    Atomics.store(control, 0, (write + count) >>> 0);
+    if (count < samples.length) {
+      Atomics.add(control, 1, samples.length - count);
+    }
   }
   
   // Main processing function
@@ -35,6 +206,24 @@ class FeatureExtractorProcessor extends AudioWorkletProcessor {
     
     const inputChannel = input[0];
     
+    if (this.ringControl) {
+      this.writeRing(inputChannel);
+      const output = outputs[0];
+      if (output && output[0]) {
+        output[0].set(inputChannel);
+      }
+      return true;
+    }
+    
+    if (this.wasm) {
+      this.processWasm(inputChannel);
+      const output = outputs[0];
+      if (output && output[0]) {
+        output[0].set(inputChannel);
+      }
+      return true;
+    }
+    
     // Copy input to circular buffer
     for (let i = 0; i < inputChannel.length; i++) {
       this.inputBuffer[this.bufferIndex] = inputChannel[i];
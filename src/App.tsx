@@ -1,4 +1,4 @@
-import React, { useState } from 'react';
+import React, { useCallback, useEffect, useState } from 'react';
 import { ThemeProvider } from '@mui/material/styles';
 import CssBaseline from '@mui/material/CssBaseline';
 import {
@@ -102,6 +102,16 @@ function App() {
     wasmPath: '/wasm'
   }));
 
+  // Loaded up front so the first recording can already stream live features
+  useEffect(() => {
+    analysisService.initialize();
+  }, [analysisService]);
+
+  const waveformPeaks = useCallback(
+    (buffer: AudioBuffer, peaksPerSecond: number) => analysisService.waveformPeaks(buffer, peaksPerSecond),
+    [analysisService]
+  );
+
   const handleRecordingComplete = (recording: RecordingData) => {
     setCurrentRecording(recording);
     setError(null);
@@ -254,6 +264,7 @@ function App() {
                 onAnalyze={handleAnalyze}
                 isAnalyzing={isAnalyzing}
                 maxDuration={300}
+                liveFeatureSource={analysisService}
               />
             </Grid>
 
@@ -265,6 +276,7 @@ function App() {
                   showControls={true}
                   showTimeline={true}
                   enableRegions={false}
+                  peakSource={waveformPeaks}
                 />
               ) : (
                 <Paper sx={{ p: 3, height: '100%', display: 'flex', alignItems: 'center', justifyContent: 'center' }}>
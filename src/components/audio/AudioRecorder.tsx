@@ -23,7 +23,7 @@ import {
   VolumeUp as VolumeUpIcon,
 } from '@mui/icons-material';
 import { AudioService } from '../../services/AudioService';
-import { AudioServiceConfig, RecordingData, AudioWorkletMessage } from '../../types/audio';
+import { AudioServiceConfig, RecordingData, AudioWorkletMessage, LiveFeatureSource } from '../../types/audio';
 import { formatTime } from '../../utils/formatters';
 
 interface AudioRecorderProps {
@@ -34,8 +34,16 @@ interface AudioRecorderProps {
   onAnalyze?: () => void;
   isAnalyzing?: boolean;
   maxDuration?: number;
+  // C++ features from the worklet's shared sample ring while recording; the
+  // rows end up in RecordingData.liveFeatures
+  liveFeatureSource?: LiveFeatureSource;
 }
 
+// How often the live ring is drained; it holds 2 s of audio
+const LIVE_DRAIN_MS = 100;
+// Energy column of a live feature row
+const LIVE_ENERGY_COLUMN = 13;
+
 export const AudioRecorder: React.FC<AudioRecorderProps> = ({
   onRecordingComplete,
   onRecordingStart,
@@ -44,6 +52,7 @@ export const AudioRecorder: React.FC<AudioRecorderProps> = ({
   onAnalyze,
   isAnalyzing = false,
   maxDuration = 300, // 5 minutes default
+  liveFeatureSource,
 }) => {
   const [isRecording, setIsRecording] = useState(false);
   const [isPaused, setIsPaused] = useState(false);
@@ -57,23 +66,80 @@ export const AudioRecorder: React.FC<AudioRecorderProps> = ({
   const audioServiceRef = useRef<AudioService | null>(null);
   const animationFrameRef = useRef<number | null>(null);
   const startTimeRef = useRef<number | null>(null);
+  const liveSourceRef = useRef<LiveFeatureSource | null>(null);
+  const liveTimerRef = useRef<number | null>(null);
+  const liveRowsRef = useRef<number[][]>([]);
 
   // Handle real-time audio processing
   const handleAudioProcessing = useCallback((message: AudioWorkletMessage) => {
     if (message.type === 'features' && message.data) {
       const features = message.data as any;
       if (features.energy && features.energy.length > 0) {
-        const level = Math.min(100, features.energy[0] * 500);
+        const level = Math.min(100, features.energy[features.energy.length - 1] * 500);
         setAudioLevel(level);
       }
     }
   }, []);
 
+  const takeLiveRows = useCallback((rows: number[][]) => {
+    if (rows.length === 0) return;
+    liveRowsRef.current.push(...rows);
+    setAudioLevel(Math.min(100, rows[rows.length - 1][LIVE_ENERGY_COLUMN] * 500));
+  }, []);
+
+  // With the shared-memory analysis build the worklet writes raw samples to
+  // a ring and features come from the C++ streaming extractor; otherwise
+  // createLiveStream returns null and the worklet keeps posting features
+  const startLiveFeatures = useCallback(() => {
+    const service = audioServiceRef.current;
+    const sampleRate = service ? service.getSampleRate() : null;
+    if (!liveFeatureSource || !service || !sampleRate) return;
+
+    const ring = liveFeatureSource.createLiveStream(sampleRate);
+    if (!ring) return;
+    if (!service.attachSampleRing(ring)) {
+      liveFeatureSource.closeLiveStream();
+      return;
+    }
+    liveSourceRef.current = liveFeatureSource;
+    liveRowsRef.current = [];
+    liveTimerRef.current = window.setInterval(
+      () => takeLiveRows(liveFeatureSource.drainLiveFeatures()), LIVE_DRAIN_MS
+    );
+  }, [liveFeatureSource, takeLiveRows]);
+
+  // Stops the worklet writing to the ring. Sent before the recording stops,
+  // so the worklet has seen it by the time stopRecording() resolves.
+  const detachLiveFeatures = useCallback(() => {
+    if (liveTimerRef.current !== null) {
+      window.clearInterval(liveTimerRef.current);
+      liveTimerRef.current = null;
+    }
+    if (liveSourceRef.current) {
+      audioServiceRef.current?.attachSampleRing(null);
+    }
+  }, []);
+
+  // After detachLiveFeatures: every row of the capture, or null when there
+  // was no live stream. The ring itself is released by the next
+  // createLiveStream or on unmount, never while a worklet may still write.
+  const finishLiveFeatures = useCallback((): number[][] | null => {
+    const source = liveSourceRef.current;
+    if (!source) return null;
+    takeLiveRows(source.finishLiveFeatures());
+    liveSourceRef.current = null;
+    const rows = liveRowsRef.current;
+    liveRowsRef.current = [];
+    return rows;
+  }, [takeLiveRows]);
+
   const handleStopRecording = useCallback(async () => {
     if (!audioServiceRef.current || !isRecording) return;
 
     try {
+      detachLiveFeatures();
       const recordingData = await audioServiceRef.current.stopRecording();
+      const liveRows = finishLiveFeatures();
       setIsRecording(false);
       setIsPaused(false);
       setRecordingTime(0);
@@ -82,13 +148,13 @@ export const AudioRecorder: React.FC<AudioRecorderProps> = ({
       startTimeRef.current = null;
       
       onRecordingStop?.();
-      onRecordingComplete(recordingData);
+      onRecordingComplete(liveRows ? { ...recordingData, liveFeatures: liveRows } : recordingData);
     } catch (err) {
       const errorMessage = err instanceof Error ? err.message : 'Failed to stop recording';
       setError(errorMessage);
       onError?.(new Error(errorMessage));
     }
-  }, [isRecording, onRecordingStop, onRecordingComplete, onError]);
+  }, [isRecording, onRecordingStop, onRecordingComplete, onError, detachLiveFeatures, finishLiveFeatures]);
 
   // Initialize audio service
   useEffect(() => {
@@ -123,7 +189,7 @@ export const AudioRecorder: React.FC<AudioRecorderProps> = ({
           processingOptions: {
             // Don't specify sampleRate - will be set based on AudioContext
             bufferSize: 2048,
-            hopSize: 512,
+            hopSize: 1024, // frame / 2, as in offline analysis
             mfccCoefficients: 13,
           },
           enableRealTimeProcessing: true,
@@ -159,6 +225,13 @@ export const AudioRecorder: React.FC<AudioRecorderProps> = ({
     };
   }, [onError, handleAudioProcessing]);
 
+  // The last live stream is released with the recorder, after the service
+  // above has shut the worklet down
+  useEffect(() => () => {
+    detachLiveFeatures();
+    liveFeatureSource?.closeLiveStream();
+  }, [liveFeatureSource, detachLiveFeatures]);
+
   // Update recording time
   useEffect(() => {
     if (isRecording && !isPaused && startTimeRef.current) {
@@ -211,6 +284,7 @@ export const AudioRecorder: React.FC<AudioRecorderProps> = ({
       // Request microphone permission explicitly
       console.log('Requesting microphone access...');
       await audioServiceRef.current.startRecording();
+      startLiveFeatures();
       
       setIsRecording(true);
       setRecordingTime(0);
@@ -247,8 +321,9 @@ export const AudioRecorder: React.FC<AudioRecorderProps> = ({
   };
 
   const handleReset = () => {
+    detachLiveFeatures();
     if (audioServiceRef.current && isRecording) {
-      audioServiceRef.current.stopRecording().catch(console.error);
+      audioServiceRef.current.stopRecording().catch(console.error).then(() => finishLiveFeatures());
     }
     setIsRecording(false);
     setIsPaused(false);
@@ -23,6 +23,11 @@ import {
 import WaveSurfer from 'wavesurfer.js';
 import { RecordingData } from '../../types/audio';
 import { formatTime, audioBufferToWav, downloadBlob } from '../../utils/formatters';
+import { WaveformPeaks } from '../../services/WasmAnalysisService';
+
+// Peak resolution handed to WaveSurfer: the zoom slider's maximum, so every
+// zoom level draws from peaks instead of the raw samples
+const PEAKS_PER_SECOND = 200;
 
 interface WaveformVisualizerProps {
   recording?: RecordingData;
@@ -35,6 +40,9 @@ interface WaveformVisualizerProps {
   showControls?: boolean;
   showTimeline?: boolean;
   enableRegions?: boolean;
+  // Precomputed peaks (WasmAnalysisService.waveformPeaks); null falls back
+  // to WaveSurfer decoding and scanning the audio
+  peakSource?: (audioBuffer: AudioBuffer, peaksPerSecond: number) => WaveformPeaks | null;
 }
 
 export const WaveformVisualizer: React.FC<WaveformVisualizerProps> = ({
@@ -48,6 +56,7 @@ export const WaveformVisualizer: React.FC<WaveformVisualizerProps> = ({
   showControls = true,
   showTimeline = true,
   enableRegions = false,
+  peakSource,
 }) => {
   const containerRef = useRef<HTMLDivElement>(null);
   const wavesurferRef = useRef<WaveSurfer | null>(null);
@@ -114,7 +123,13 @@ export const WaveformVisualizer: React.FC<WaveformVisualizerProps> = ({
       // Convert AudioBuffer to WAV blob without creating new AudioContext
       const wav = audioBufferToWav(buffer);
       const url = URL.createObjectURL(wav);
-      wavesurfer.load(url);
+      const peaks = peakSource?.(buffer, PEAKS_PER_SECOND);
+      if (peaks) {
+        // Upper half from the first channel, lower half from the second
+        wavesurfer.load(url, [peaks.max, peaks.min], buffer.duration);
+      } else {
+        wavesurfer.load(url);
+      }
       
       // Cleanup URL when component unmounts
       return () => {
@@ -126,7 +141,7 @@ export const WaveformVisualizer: React.FC<WaveformVisualizerProps> = ({
     return () => {
       wavesurfer.destroy();
     };
-  }, [audioUrl, audioBuffer, recording, height, showTimeline, enableRegions, theme, onReady, onProgress, onFinish]);
+  }, [audioUrl, audioBuffer, recording, height, showTimeline, enableRegions, theme, onReady, onProgress, onFinish, peakSource]);
 
   // Control handlers
   const handlePlayPause = () => {
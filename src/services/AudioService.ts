@@ -17,6 +17,8 @@ export class AudioService implements AudioServiceInterface {
   private recordedChunks: Blob[] = [];
   private isRecording = false;
   private processingCallback: AudioProcessingCallback | null = null;
+  private sampleRing: { buffer: SharedArrayBuffer; byteOffset: number } | null = null;
+  private workletExtractor: WebAssembly.Module | null = null;
   private config: AudioServiceConfig;
 
   constructor(config: AudioServiceConfig) {
@@ -42,11 +44,31 @@ export class AudioService implements AudioServiceInterface {
     try {
       await this.audioContext.audioWorklet.addModule('/worklets/feature-extractor.js');
       console.log('AudioWorklet loaded successfully');
+      this.workletExtractor = await this.compileWorkletExtractor();
     } catch (error) {
       console.warn('AudioWorklet not available, falling back to ScriptProcessorNode');
     }
   }
 
+  /**
+   * Compile the C++ feature extractor for the worklet, which cannot fetch
+   * it itself. Without it the worklet uses its JavaScript extractor.
+   */
+  private async compileWorkletExtractor(): Promise<WebAssembly.Module | null> {
+    if (this.workletExtractor) return this.workletExtractor;
+
+    try {
+      const response = await fetch('/wasm/feature_worklet.wasm');
+      if (!response.ok) {
+        throw new Error(`HTTP ${response.status}`);
+      }
+      return await WebAssembly.compile(await response.arrayBuffer());
+    } catch (error) {
+      console.warn('C++ worklet extractor not available, using JavaScript features:', error);
+      return null;
+    }
+  }
+
   async startRecording(): Promise<void> {
     if (this.isRecording) {
       throw new Error('Recording already in progress');
@@ -185,6 +207,10 @@ export class AudioService implements AudioServiceInterface {
         this.mediaRecorder.onstop = handleStop;
       }
 
+      // Rows the worklet has not batched up yet; the reply still reaches
+      // forwardFeatureRows after cleanup() drops the node
+      this.workletNode?.port.postMessage({ type: 'flush' });
+
       // Stop the recording
       try {
         if (this.mediaRecorder && this.mediaRecorder.state === 'recording') {
@@ -213,13 +239,17 @@ export class AudioService implements AudioServiceInterface {
       this.workletNode = new AudioWorkletNode(this.audioContext, 'feature-extractor', {
         processorOptions: {
           bufferSize: this.config.processingOptions.bufferSize || 2048,
-          hopSize: this.config.processingOptions.hopSize || 512,
-          mfccCoefficients: this.config.processingOptions.mfccCoefficients || 13
+          hopSize: this.config.processingOptions.hopSize || 1024,
+          mfccCoefficients: this.config.processingOptions.mfccCoefficients || 13,
+          ring: this.sampleRing,
+          wasmModule: this.workletExtractor
         }
       });
 
       this.workletNode.port.onmessage = (event) => {
-        if (this.processingCallback) {
+        if (event.data?.type === 'feature-rows') {
+          this.forwardFeatureRows(event.data);
+        } else if (this.processingCallback) {
           this.processingCallback(event.data as AudioWorkletMessage);
         }
       };
@@ -234,6 +264,54 @@ export class AudioService implements AudioServiceInterface {
     }
   }
 
+  /**
+   * Hand a batch of C++ worklet rows to the processing callback as one
+   * AudioFeatures message, then give the block back for reuse.
+   */
+  private forwardFeatureRows(batch: {
+    buffer: ArrayBuffer; rows: number; columns: number; time: number; interval: number; timestamp: number;
+  }): void {
+    if (this.processingCallback) {
+      const rows = new Float32Array(batch.buffer, 0, batch.rows * batch.columns);
+      const features: AudioFeatures = {
+        mfcc: [], energy: [], pitch: [], spectralCentroid: [], spectralRolloff: [],
+        zeroCrossingRate: [], durations: [], timestamps: []
+      };
+      for (let r = 0; r < batch.rows; r++) {
+        const base = r * batch.columns;
+        features.mfcc.push(Array.from(rows.subarray(base, base + 13)));
+        features.energy.push(rows[base + 13]);
+        features.zeroCrossingRate.push(rows[base + 14]);
+        features.spectralCentroid.push(rows[base + 15]);
+        features.pitch.push(rows[base + 16]);
+        features.timestamps.push(batch.time + r * batch.interval);
+      }
+      this.processingCallback({ type: 'features', data: features, timestamp: batch.timestamp });
+    }
+    this.workletNode?.port.postMessage({ type: 'return-rows', buffer: batch.buffer }, [batch.buffer]);
+  }
+
+  /**
+   * Route captured samples into a shared ring (WasmAnalysisService.createLiveStream)
+   * instead of extracting features in the worklet. Applies to the running
+   * worklet, if any, and to every one created afterwards. Returns whether a
+   * worklet is running to write into it.
+   */
+  attachSampleRing(ring: { buffer: SharedArrayBuffer; byteOffset: number } | null): boolean {
+    this.sampleRing = ring;
+    if (this.workletNode) {
+      this.workletNode.port.postMessage(
+        ring ? { type: 'attach-ring', buffer: ring.buffer, byteOffset: ring.byteOffset } : { type: 'detach-ring' }
+      );
+    }
+    return this.workletNode !== null;
+  }
+
+  // Capture sample rate; null until the AudioContext exists
+  getSampleRate(): number | null {
+    return this.audioContext ? this.audioContext.sampleRate : null;
+  }
+
   private setupFallbackProcessing(source: MediaStreamAudioSourceNode): void {
     if (!this.audioContext) return;
 
@@ -12,6 +12,182 @@ export interface WasmAnalysisConfig {
   enableLogging: boolean;
   timeoutMs: number;
   wasmPath: string;
+  memoryBudgetBytes?: number; // per-module workspace ceiling, 0 = unlimited
+  referenceStoreUrl?: string; // reference feature store built offline
+  reciter?: number; // reciter index within the reference store
+  sliceBudgetMs?: number; // run extraction and DTW in main-thread slices of this length
+  latencyTargetMs?: number; // let the engine pick the DTW variant for this target
+  accuracyTolerance?: number; // 0 = exact DTW only; > 0 admits banded and FastDTW
+  featureCacheBytes?: number; // features kept for recordings seen before, 0 = no cache
+  noiseSuppression?: boolean; // mask learned room noise out of the spectrum before the MFCCs
+  loudnessNormalization?: boolean; // bring input to a common loudness (AGC) before feature extraction
+}
+
+const DEFAULT_MEMORY_BUDGET = 64 * 1024 * 1024;
+
+// Status words of a module's cancel_control() block (src/wasm/cancellation.h)
+const RUN_CANCELLED = 1;
+const RUN_PARTIAL = 2;
+
+type CancellableModule = Pick<DTWModule, 'cancel_control' | 'HEAP8'>;
+
+// DTWAlgorithm values reported in alignment_plan() (src/wasm/workspace.h)
+const DTW_ALGORITHMS = ['full', 'banded', 'distance-only', 'fastdtw', 'hirschberg'];
+
+// Stages published by progressive_advance() (src/wasm/progressive.h)
+const PROGRESSIVE_COARSE = 1;
+const PROGRESSIVE_PHONEME = 3;
+
+// Segment flags and the query feature layout used by segment_recitation()
+// (src/wasm/segmenter.h): 13 MFCC, then RMS energy; one frame per 1024
+// samples (2048-sample frames, half-frame hop)
+const SEGMENT_ALIGNED = 1;
+const SEGMENT_SCORED = 2;
+const SEGMENT_ENERGY_COLUMN = 13;
+const FEATURE_HOP = 1024;
+// Offline feature rows: DTW aligns the MFCC columns, the whole row (with
+// energy, ZCR, centroid and pitch) feeds pause and pitch checks
+const MFCC_COLUMNS = 13;
+const FEATURE_COLUMNS = 17;
+
+export interface AyahSegmentResult {
+  verseId: string | null; // null when the segment was cut at pauses only
+  ayah: number;
+  startTime: number; // seconds into the recording
+  endTime: number;
+  timingAccuracy: number | null; // null without a reference alignment
+  phonemeAccuracy: number | null; // null when the run stopped before scoring it
+  overallScore: number | null;
+}
+
+// WaqfMark and WaqfVerdict values (src/wasm/waqf.h), and the mushaf signs
+// the marks are read from; a word's sign follows its letters
+const WAQF_SIGNS: { [sign: string]: number } = {
+  '\u06DA': 1, // jeem: stopping permitted
+  '\u06D7': 2, // qala: stopping preferred
+  '\u06D6': 3, // sala: continuing preferred
+  '\u06D8': 4, // meem: stop required
+  '\u06D9': 5, // la: do not stop
+  '\u06DB': 6  // mu'anaqah: stop at one of the pair
+};
+const WAQF_VERSE_END = 7;
+const WAQF_VERDICTS: WaqfFinding['verdict'][] = [
+  'correct', 'discouraged', 'unmarked', 'forbidden', 'inside-word', 'missed-required', 'paired-twice'
+];
+const PITCH_COLUMN = 16;
+
+export interface WaqfFinding {
+  wordId: string; // the word the pause follows (or interrupts)
+  startTime: number; // seconds into the recording
+  durationMs: number; // 0 for a missed required stop
+  verdict: 'correct' | 'discouraged' | 'unmarked' | 'forbidden' | 'inside-word' | 'missed-required' | 'paired-twice';
+}
+
+// Nasal murmur (ghunnah) scoring; layouts in src/wasm/nasal.h
+const NASAL_SEGMENT_BYTES = 24;
+
+export interface NasalSegmentResult {
+  startTime: number; // seconds into the recording
+  endTime: number;
+  meanScore: number; // frame nasality in [0, 1]
+  peakScore: number;
+  durationMs: number;
+}
+
+export interface NasalityProfile {
+  frameRate: number; // scores per second
+  scores: Float32Array;
+  segments: NasalSegmentResult[];
+}
+
+// Qalqalah release bursts; layout in src/wasm/qalqalah.h
+const QALQALAH_BURST_BYTES = 16;
+
+export interface QalqalahBurstResult {
+  time: number; // seconds into the recording
+  strength: number; // 0..1
+  riseDb: number; // level over the stop closure
+  closureMs: number; // quiet stretch before the release
+}
+
+// Onsets and syllable nuclei; layout in src/wasm/onset.h
+const LANDMARK_BYTES = 16;
+const LANDMARK_NUCLEUS = 1;
+
+export interface SpeechLandmarks {
+  onsets: { time: number; strength: number }[]; // seconds, flux over threshold
+  nuclei: { time: number; prominenceDb: number }[]; // one per syllable vowel
+}
+
+// process_audio_features_ex options: F1-F3 after the 17 base columns, noise
+// suppression before the mel stage and loudness normalisation of the input
+// (no extra columns)
+const FEATURE_FORMANTS = 1;
+const FEATURE_DENOISE = 2;
+const FEATURE_LOUDNESS = 4;
+const FORMANT_COLUMN = 17;
+const FORMANT_FEATURES_PER_FRAME = 17 + 3;
+
+export interface FormantTrack {
+  frameRate: number; // frames per second
+  f1: number[]; // Hz per frame, 0 where there is no formant
+  f2: number[];
+  f3: number[];
+}
+
+export interface LongRecitationReport {
+  segments: AyahSegmentResult[];
+  ayahsExpected: number;
+  ayahsAligned: number;
+  overallScore: number;
+  timingAccuracy: number | null;
+  phonemeAccuracy: number;
+}
+
+export interface ProgressiveUpdate {
+  stage: 'coarse' | 'aligned' | 'complete';
+  timingAccuracy: number;
+  analysis: RecitationAnalysis | null; // the 'complete' stage only
+}
+
+/**
+ * Raised when the engine stopped an analysis early: 'cancelled' after
+ * cancelAnalysis(), 'partial' when the timeoutMs deadline passed mid-call.
+ */
+export class AnalysisInterruptedError extends Error {
+  constructor(
+    public readonly status: 'cancelled' | 'partial',
+    public readonly stage: string,
+    public readonly progress: number
+  ) {
+    super(`WebAssembly analysis ${status} during ${stage} (${Math.round(progress * 100)}% done)`);
+    this.name = 'AnalysisInterruptedError';
+  }
+}
+
+// Live capture matches offline extraction: 2048-sample frames, half-frame hop
+const LIVE_FRAME_SIZE = 2048;
+const LIVE_HOP_SIZE = LIVE_FRAME_SIZE / 2;
+const LIVE_FEATURES_PER_FRAME = 13 + 4;
+
+// Waveform peaks: the live pyramid is reserved for the recorder's longest
+// take so reads never see it move; a bin is int16 min, max, rms
+const LIVE_PEAK_SECONDS = 300;
+const PEAK_BIN_VALUES = 3;
+const PEAK_SCALE = 1 / 32767;
+
+// Per-pixel waveform summary read from a peak pyramid, values in [-1, 1]
+export interface WaveformPeaks {
+  min: Float32Array;
+  max: Float32Array;
+  rms: Float32Array;
+  samplesPerPeak: number;
+}
+
+// Sample ring shared with the AudioWorklet: a SharedArrayBuffer region
+export interface LiveSampleRing {
+  buffer: SharedArrayBuffer;
+  byteOffset: number;
 }
 
 export class WasmAnalysisService {
@@ -19,6 +195,11 @@ export class WasmAnalysisService {
   private dtwModule: DTWModule | null = null;
   private hmmModule: HMMModule | null = null;
   private audioModule: AudioProcessorModule | null = null;
+  private referenceStoreLoaded = false;
+  private liveStream: {
+    basePtr: number; ringPtr: number; stream: number; peaks: number; sampleRate: number;
+  } | null = null;
+  private sliceCancelled = false;
   private initialized = false;
 
   constructor(config: WasmAnalysisConfig = {
@@ -65,6 +246,258 @@ export class WasmAnalysisService {
     this.dtwModule = dtwModule;
     this.hmmModule = hmmModule;
     this.audioModule = audioModule;
+
+    if (this.config.featureCacheBytes !== undefined) {
+      audioModule.feature_cache_configure(this.config.featureCacheBytes);
+    }
+
+    if (this.config.referenceStoreUrl) {
+      await this.loadReferenceStore(this.config.referenceStoreUrl);
+    }
+  }
+
+  /**
+   * Copy the reference store into the DTW heap once; the engine reads it in
+   * place for the lifetime of the module, so the region is never freed.
+   */
+  private async loadReferenceStore(url: string): Promise<void> {
+    if (!this.dtwModule) return;
+
+    try {
+      const response = await fetch(url);
+      if (!response.ok) {
+        throw new Error(`HTTP ${response.status}`);
+      }
+      const bytes = new Uint8Array(await response.arrayBuffer());
+
+      // The store needs 16-byte alignment; malloc only guarantees 8
+      const basePtr = this.dtwModule.malloc(bytes.length + 16);
+      const dataPtr = (basePtr + 15) & ~15;
+      this.dtwModule.HEAPU8.set(bytes, dataPtr);
+
+      const entries = this.dtwModule.reference_store_open(dataPtr, bytes.length);
+      if (entries < 0) {
+        this.dtwModule.free(basePtr);
+        throw new Error('malformed reference store');
+      }
+      this.referenceStoreLoaded = true;
+      this.log(`Reference store loaded (${entries} entries)`);
+      const storeFrontEnd = this.dtwModule.reference_front_end();
+      if (storeFrontEnd !== this.frontEndOptions()) {
+        this.log(`Reference store front end (${storeFrontEnd}) differs from the configured one ` +
+          `(${this.frontEndOptions()}); distances will be biased`);
+      }
+    } catch (error) {
+      this.log('Reference store not available, using synthetic references', error);
+    }
+  }
+
+  /**
+   * Set up a capture ring in the audio module's memory and a streaming
+   * extractor that reads it in place. The returned region is handed to the
+   * AudioWorklet (AudioService.attachSampleRing), which writes samples into
+   * it directly. Needs the shared-memory build (WASM_THREADS=1); returns
+   * null otherwise.
+   */
+  createLiveStream(sampleRate: number, seconds = 2): LiveSampleRing | null {
+    const module = this.audioModule;
+    if (!module || typeof SharedArrayBuffer === 'undefined' ||
+        !(module.HEAPU8.buffer instanceof SharedArrayBuffer)) {
+      return null;
+    }
+    this.closeLiveStream();
+
+    const capacity = Math.ceil(sampleRate * seconds);
+    const basePtr = module.malloc(module.ring_buffer_bytes(capacity) + 16);
+    const ringPtr = (basePtr + 15) & ~15; // ring header needs 16-byte alignment
+    if (module.ring_buffer_init(ringPtr, capacity) <= 0) {
+      module.free(basePtr);
+      return null;
+    }
+
+    // Room for everything the ring can hold between two drains
+    const maxFrames = Math.ceil(capacity / LIVE_HOP_SIZE) + 1;
+    const stream = module.stream_create(sampleRate, LIVE_FRAME_SIZE, LIVE_HOP_SIZE, maxFrames);
+    if (!stream) {
+      module.free(basePtr);
+      return null;
+    }
+
+    // Waveform summary built from the same samples as the features
+    const peaks = module.peak_pyramid_create(sampleRate * LIVE_PEAK_SECONDS);
+    module.stream_attach_peaks(stream, peaks);
+    module.stream_enable_nasality(stream);
+    module.stream_enable_qalqalah(stream);
+    module.stream_enable_landmarks(stream);
+    if (this.config.noiseSuppression) {
+      module.stream_enable_noise_suppression(stream);
+    }
+    if (this.config.loudnessNormalization) {
+      module.stream_enable_loudness(stream);
+    }
+
+    this.liveStream = { basePtr, ringPtr, stream, peaks, sampleRate };
+    return { buffer: module.HEAPU8.buffer as SharedArrayBuffer, byteOffset: ringPtr };
+  }
+
+  /**
+   * Extract features for every sample the worklet has written since the
+   * last call. Rows are 13 MFCCs + energy + ZCR + spectral centroid + pitch.
+   */
+  drainLiveFeatures(): number[][] {
+    const module = this.audioModule;
+    const live = this.liveStream;
+    if (!module || !live) return [];
+
+    module.stream_drain(live.stream, live.ringPtr);
+    return this.takeLiveFeatures();
+  }
+
+  /**
+   * End the live capture: features for what is left in the ring and for the
+   * tail loudness normalisation holds back, so the capture ends on the same
+   * frames as offline analysis. Call when recording stops, before
+   * closeLiveStream().
+   */
+  finishLiveFeatures(): number[][] {
+    const module = this.audioModule;
+    const live = this.liveStream;
+    if (!module || !live) return [];
+
+    module.stream_drain(live.stream, live.ringPtr);
+    module.stream_finish(live.stream);
+    return this.takeLiveFeatures();
+  }
+
+  // Rows the live stream has produced since the last call
+  private takeLiveFeatures(): number[][] {
+    const module = this.audioModule!;
+    const live = this.liveStream!;
+    const count = module.stream_frame_count(live.stream);
+    const stride = module.stream_feature_stride(live.stream);
+    const featuresPtr = module.stream_features(live.stream);
+    const heap = new Float32Array(module.HEAPF32.buffer, featuresPtr, count * stride);
+
+    const frames: number[][] = [];
+    for (let i = 0; i < count; i++) {
+      frames.push(Array.from(heap.subarray(i * stride, i * stride + LIVE_FEATURES_PER_FRAME)));
+    }
+    module.stream_clear(live.stream);
+    return frames;
+  }
+
+  closeLiveStream(): void {
+    if (!this.audioModule || !this.liveStream) return;
+    this.audioModule.stream_destroy(this.liveStream.stream);
+    this.audioModule.peak_pyramid_destroy(this.liveStream.peaks);
+    this.audioModule.free(this.liveStream.basePtr);
+    this.liveStream = null;
+  }
+
+  /**
+   * Nasal murmur segments of the live capture so far, for ghunnah timing
+   * while the reciter is still going.
+   */
+  liveNasalSegments(): NasalSegmentResult[] {
+    const module = this.audioModule;
+    const live = this.liveStream;
+    if (!module || !live) return [];
+    return this.readNasalSegments(
+      module.stream_nasal_segments(live.stream), module.stream_nasal_segment_count(live.stream),
+      LIVE_HOP_SIZE / live.sampleRate
+    );
+  }
+
+  /**
+   * Qalqalah release bursts of the live capture so far.
+   */
+  liveQalqalahBursts(): QalqalahBurstResult[] {
+    const module = this.audioModule;
+    const live = this.liveStream;
+    if (!module || !live) return [];
+    return this.readQalqalahBursts(
+      module.stream_qalqalah_bursts(live.stream), module.stream_qalqalah_count(live.stream), live.sampleRate
+    );
+  }
+
+  /**
+   * Onsets and syllable nuclei of the live capture confirmed so far.
+   */
+  liveLandmarks(): SpeechLandmarks {
+    const module = this.audioModule;
+    const live = this.liveStream;
+    if (!module || !live) return { onsets: [], nuclei: [] };
+    return this.readLandmarks(
+      module.stream_landmarks(live.stream), module.stream_landmark_count(live.stream),
+      LIVE_HOP_SIZE / live.sampleRate
+    );
+  }
+
+  /**
+   * Waveform of the live capture so far, `pixels` columns of
+   * `samplesPerPixel` samples from `startSample`. Reads the peak pyramid
+   * in place, so the cost follows the pixel count, not the take length.
+   */
+  liveWaveformPeaks(samplesPerPixel: number, pixels: number, startSample = 0): WaveformPeaks | null {
+    if (!this.audioModule || !this.liveStream) return null;
+    return this.readPeaks(this.liveStream.peaks, startSample, samplesPerPixel, pixels);
+  }
+
+  /**
+   * Waveform of a whole recording at `peaksPerSecond`, for renderers that
+   * take precomputed peaks instead of scanning the samples themselves.
+   */
+  waveformPeaks(audioBuffer: AudioBuffer, peaksPerSecond: number): WaveformPeaks | null {
+    const module = this.audioModule;
+    if (!module) return null;
+
+    const samples = audioBuffer.getChannelData(0);
+    const pyramid = module.peak_pyramid_create(samples.length);
+    const samplesPtr = module.malloc(samples.length * 4);
+    try {
+      module.HEAPF32.set(samples, samplesPtr / 4);
+      module.peak_pyramid_append(pyramid, samplesPtr, samples.length);
+      const samplesPerPixel = audioBuffer.sampleRate / peaksPerSecond;
+      const pixels = Math.ceil(samples.length / samplesPerPixel);
+      return this.readPeaks(pyramid, 0, samplesPerPixel, pixels);
+    } finally {
+      module.free(samplesPtr);
+      module.peak_pyramid_destroy(pyramid);
+    }
+  }
+
+  // Each pixel folds the few pyramid bins it overlaps
+  private readPeaks(pyramid: number, startSample: number, samplesPerPixel: number,
+                    pixels: number): WaveformPeaks {
+    const module = this.audioModule!;
+    const level = module.peak_pyramid_level_for(pyramid, samplesPerPixel);
+    const binSamples = module.peak_pyramid_bin_samples(level);
+    const bins = module.peak_pyramid_bins(pyramid, level);
+    const view = new Int16Array(module.HEAPU8.buffer, module.peak_pyramid_data(pyramid, level),
+                                bins * PEAK_BIN_VALUES);
+
+    const min = new Float32Array(pixels);
+    const max = new Float32Array(pixels);
+    const rms = new Float32Array(pixels);
+    for (let x = 0; x < pixels; x++) {
+      const first = Math.floor((startSample + x * samplesPerPixel) / binSamples);
+      const last = Math.min(bins, Math.ceil((startSample + (x + 1) * samplesPerPixel) / binSamples));
+      let lo = 0;
+      let hi = 0;
+      let squares = 0;
+      for (let b = first; b < last; b++) {
+        const offset = b * PEAK_BIN_VALUES;
+        lo = b === first ? view[offset] : Math.min(lo, view[offset]);
+        hi = b === first ? view[offset + 1] : Math.max(hi, view[offset + 1]);
+        squares += view[offset + 2] * view[offset + 2];
+      }
+      if (last > first) {
+        min[x] = lo * PEAK_SCALE;
+        max[x] = hi * PEAK_SCALE;
+        rms[x] = Math.sqrt(squares / (last - first)) * PEAK_SCALE;
+      }
+    }
+    return { min, max, rms, samplesPerPeak: samplesPerPixel };
   }
 
   private async loadDTWModule(): Promise<DTWModule> {
@@ -134,20 +567,24 @@ export class WasmAnalysisService {
 
     this.log('Starting WebAssembly-powered analysis...');
 
-    return new Promise((resolve, reject) => {
-      const timeoutId = setTimeout(() => {
-        reject(new Error(`WebAssembly analysis timeout after ${this.config.timeoutMs}ms`));
-      }, this.config.timeoutMs);
+    if (this.config.sliceBudgetMs) {
+      return this.analyzeRecitationSliced(audioBuffer, audioFeatures, referenceVerse, startTime);
+    }
+
+    // The engine loops poll this deadline themselves, so a slow analysis
+    // stops instead of running on after the caller has given up
+    this.armCancellation(Date.now() + this.config.timeoutMs);
 
+    return new Promise((resolve, reject) => {
       try {
         // Extract enhanced MFCC features using WebAssembly
         const enhancedMFCC = this.extractWasmMFCC(audioBuffer);
         
-        // Generate reference MFCC (in production, this would come from a database)
-        const referenceMFCC = this.generateReferenceMFCC(referenceVerse);
-        
-        // Perform DTW alignment using WebAssembly
-        const dtwResult = this.performWasmDTW(enhancedMFCC, referenceMFCC);
+        // Align against the stored reference recitation when there is one
+        const referenceEntry = this.findReferenceEntry(referenceVerse);
+        const dtwResult = referenceEntry >= 0
+          ? this.performWasmReferenceDTW(enhancedMFCC, referenceEntry)
+          : this.performWasmDTW(enhancedMFCC, this.generateReferenceMFCC(referenceVerse));
         
         // Perform HMM analysis for phoneme recognition
         const hmmResult = this.performWasmHMM(enhancedMFCC);
@@ -160,30 +597,771 @@ export class WasmAnalysisService {
           referenceVerse
         );
 
-        clearTimeout(timeoutId);
         const duration = Date.now() - startTime;
         this.log(`WebAssembly analysis completed in ${duration}ms`);
         
         resolve(analysis);
       } catch (error) {
-        clearTimeout(timeoutId);
         this.log('WebAssembly analysis failed:', error);
         reject(error);
       }
     });
   }
 
-  private extractWasmMFCC(audioBuffer: AudioBuffer): number[][] {
+  /**
+   * analyzeRecitation() in stages. onUpdate gets a coarse timing score a few
+   * milliseconds after feature extraction, then the full-resolution score,
+   * then the complete analysis, which the promise also resolves to. Each
+   * stage searches only around the previous stage's alignment path, so the
+   * refinements add little to the total time.
+   */
+  async analyzeProgressively(
+    audioBuffer: AudioBuffer,
+    audioFeatures: AudioFeatures,
+    referenceVerse: QuranVerse,
+    onUpdate: (update: ProgressiveUpdate) => void
+  ): Promise<RecitationAnalysis> {
+    const startTime = Date.now();
+
+    if (!this.initialized) {
+      await this.initialize();
+    }
+
+    const module = this.dtwModule;
+    if (!module) {
+      const analysis = await this.analyzeRecitation(audioBuffer, audioFeatures, referenceVerse);
+      onUpdate({ stage: 'complete', timingAccuracy: analysis.timingAccuracy, analysis });
+      return analysis;
+    }
+
+    this.log('Starting progressive WebAssembly analysis...');
+
+    const deadlineMs = Date.now() + this.config.timeoutMs;
+    this.sliceCancelled = false;
+    this.armCancellation(deadlineMs);
+
+    const enhancedMFCC = this.config.sliceBudgetMs
+      ? await this.extractSlicedMFCC(audioBuffer, deadlineMs)
+      : this.extractWasmMFCC(audioBuffer);
+
+    const entry = this.findReferenceEntry(referenceVerse);
+    const referenceMFCC = entry >= 0 ? null : this.generateReferenceMFCC(referenceVerse);
+    const queryLen = enhancedMFCC.length;
+    const refLen = referenceMFCC ? referenceMFCC.length : module.reference_frames(entry);
+    const featureDim = enhancedMFCC[0]?.length || 13;
+
+    // The engine copies both inputs, so they are released straight away
+    const queryPtr = module.malloc(queryLen * featureDim * 8);
+    const refPtr = referenceMFCC ? module.malloc(refLen * featureDim * 8) : 0;
+    let analysis = 0;
+    try {
+      const queryHeap = new Float64Array(module.HEAPF64.buffer, queryPtr, queryLen * featureDim);
+      for (let i = 0; i < queryLen; i++) {
+        queryHeap.set(enhancedMFCC[i].slice(0, featureDim), i * featureDim);
+      }
+      if (referenceMFCC) {
+        const refHeap = new Float64Array(module.HEAPF64.buffer, refPtr, refLen * featureDim);
+        for (let i = 0; i < refLen; i++) {
+          refHeap.set(referenceMFCC[i].slice(0, featureDim), i * featureDim);
+        }
+      }
+      analysis = referenceMFCC
+        ? module.progressive_create(queryPtr, queryLen, featureDim, refPtr, refLen, featureDim)
+        : module.progressive_create_reference(queryPtr, queryLen, featureDim, entry);
+    } finally {
+      if (refPtr) module.free(refPtr);
+      module.free(queryPtr);
+    }
+    if (!analysis) {
+      throw new Error('Progressive analysis could not be created');
+    }
+
+    try {
+      for (;;) {
+        const stage = module.progressive_advance(analysis);
+        if (stage === 0) {
+          this.checkRunStatus(module, 'progressive analysis');
+          throw new Error('Progressive analysis failed');
+        }
+
+        // Layout in src/wasm/progressive.h; views are taken after the call
+        // in case it grew the heap
+        const resultPtr = module.progressive_result(analysis);
+        const fields = new Float64Array(module.HEAP8.buffer, resultPtr + 8, 3);
+        const stageDistance = stage === PROGRESSIVE_COARSE ? fields[0] : fields[1];
+        const dtwResult = {
+          distance: stageDistance,
+          alignmentScore: Math.max(0, 100 - stageDistance * 20),
+          queryLength: queryLen,
+          referenceLength: refLen
+        };
+
+        if (stage < PROGRESSIVE_PHONEME) {
+          onUpdate({
+            stage: stage === PROGRESSIVE_COARSE ? 'coarse' : 'aligned',
+            timingAccuracy: Math.round(dtwResult.alignmentScore),
+            analysis: null
+          });
+
+          // Let the update render before the next stage
+          await new Promise(resolve => setTimeout(resolve, 0));
+          if (this.sliceCancelled) {
+            throw new AnalysisInterruptedError('cancelled', 'progressive analysis', stage / PROGRESSIVE_PHONEME);
+          }
+          if (Date.now() >= deadlineMs) {
+            throw new AnalysisInterruptedError('partial', 'progressive analysis', stage / PROGRESSIVE_PHONEME);
+          }
+          continue;
+        }
+
+        const complete = this.generateComprehensiveAnalysis(
+          dtwResult,
+          { likelihood: fields[2], numStates: 4 },
+          audioFeatures,
+          referenceVerse
+        );
+        this.log(`Progressive analysis completed in ${Date.now() - startTime}ms`);
+        onUpdate({ stage: 'complete', timingAccuracy: complete.timingAccuracy, analysis: complete });
+        return complete;
+      }
+    } finally {
+      module.progressive_destroy(analysis);
+    }
+  }
+
+  /**
+   * Analysis of a recording of consecutive ayahs, up to a whole surah. The
+   * engine cuts it into ayah segments, at boundaries found by matching each
+   * ayah's stored reference (or at pauses when the store has none), scores
+   * the segments in parallel and combines the scores, so the recording is
+   * never aligned as one quadratic-cost sequence.
+   */
+  async analyzeLongRecitation(
+    audioBuffer: AudioBuffer,
+    verses: QuranVerse[]
+  ): Promise<LongRecitationReport> {
+    const startTime = Date.now();
+
+    if (!this.initialized) {
+      await this.initialize();
+    }
+
+    const module = this.dtwModule;
+    if (!module) {
+      throw new Error('DTW module not loaded');
+    }
+
+    this.log(`Starting segmented analysis of ${verses.length} ayahs...`);
+
+    const deadlineMs = Date.now() + this.config.timeoutMs;
+    this.sliceCancelled = false;
+    this.armCancellation(deadlineMs);
+
+    // Whole rows: pauses are found from the energy column
+    const enhancedMFCC = this.config.sliceBudgetMs
+      ? await this.extractSlicedMFCC(audioBuffer, deadlineMs, FEATURE_COLUMNS)
+      : this.extractWasmMFCC(audioBuffer, FEATURE_COLUMNS);
+    const queryLen = enhancedMFCC.length;
+    const featureDim = enhancedMFCC[0]?.length || MFCC_COLUMNS;
+    if (featureDim <= SEGMENT_ENERGY_COLUMN) {
+      throw new Error('Segmented analysis needs the WebAssembly feature extractor');
+    }
+    const secondsPerFrame = FEATURE_HOP / audioBuffer.sampleRate;
+
+    // Without the store there is nothing to match ayahs against
+    const labelled = this.referenceStoreLoaded && verses.length > 0;
+    const surah = labelled ? verses[0].surahNumber : 0;
+    const firstAyah = labelled ? verses[0].verseNumber : 0;
+    const lastAyah = labelled ? verses[verses.length - 1].verseNumber : 0;
+
+    // The engine does not keep the query
+    const queryPtr = module.malloc(queryLen * featureDim * 8);
+    let segmentation = 0;
+    try {
+      const queryHeap = new Float64Array(module.HEAPF64.buffer, queryPtr, queryLen * featureDim);
+      for (let i = 0; i < queryLen; i++) {
+        queryHeap.set(enhancedMFCC[i].slice(0, featureDim), i * featureDim);
+      }
+      segmentation = module.segment_recitation(
+        queryPtr, queryLen, featureDim, MFCC_COLUMNS, SEGMENT_ENERGY_COLUMN,
+        1 / secondsPerFrame, surah, firstAyah, lastAyah, this.config.reciter ?? 0
+      );
+    } finally {
+      module.free(queryPtr);
+    }
+    if (!segmentation) {
+      throw new Error('Segmented analysis could not be started');
+    }
+
+    try {
+      this.checkRunStatus(module, 'segmented analysis');
+
+      // Layouts in src/wasm/segmenter.h
+      const reportPtr = module.segmentation_report(segmentation);
+      const counts = new Int32Array(module.HEAP8.buffer, reportPtr, 8);
+      const segmentsPtr = module.segmentation_segments(segmentation);
+      const segments: AyahSegmentResult[] = [];
+      for (let i = 0; i < counts[0]; i++) {
+        const fields = new Int32Array(module.HEAP8.buffer, segmentsPtr + i * 48, 12);
+        const ayah = fields[2];
+        const flags = fields[11];
+        const verse = ayah > 0 ? verses.find(v => v.verseNumber === ayah) : undefined;
+        const scored = (flags & SEGMENT_SCORED) !== 0;
+        segments.push({
+          verseId: verse ? verse.id : null,
+          ayah,
+          startTime: fields[0] * secondsPerFrame,
+          endTime: fields[1] * secondsPerFrame,
+          timingAccuracy: scored && (flags & SEGMENT_ALIGNED) !== 0 ? fields[8] : null,
+          phonemeAccuracy: scored ? fields[9] : null,
+          overallScore: scored ? fields[10] : null
+        });
+      }
+
+      this.log(`Segmented analysis completed in ${Date.now() - startTime}ms`, {
+        segments: counts[0],
+        ayahsAligned: counts[2]
+      });
+      return {
+        segments,
+        ayahsExpected: counts[1],
+        ayahsAligned: counts[2],
+        timingAccuracy: counts[4] >= 0 ? counts[4] : null,
+        phonemeAccuracy: counts[5],
+        overallScore: counts[6]
+      };
+    } finally {
+      module.segmentation_destroy(segmentation);
+    }
+  }
+
+  /**
+   * Pauses in a recitation of one verse, each placed on the word boundary
+   * it falls on and checked against the verse's stop marks; required stops
+   * that were recited through are reported too. Needs the reference store
+   * entry of the verse with its word boundaries.
+   */
+  async verifyWaqf(audioBuffer: AudioBuffer, verse: QuranVerse): Promise<WaqfFinding[]> {
+    if (!this.initialized) {
+      await this.initialize();
+    }
+
+    const module = this.dtwModule;
+    const entry = this.findReferenceEntry(verse);
+    if (!module || entry < 0 || module.reference_word_count(entry) !== verse.words.length) {
+      throw new Error('Waqf verification needs the reference word boundaries of this verse');
+    }
+
+    this.armCancellation(Date.now() + this.config.timeoutMs);
+    // Whole rows: pauses come from the energy column, pitch from column 16
+    const enhancedMFCC = this.extractWasmMFCC(audioBuffer, FEATURE_COLUMNS);
+    const queryLen = enhancedMFCC.length;
+    const featureDim = enhancedMFCC[0]?.length || MFCC_COLUMNS;
+    if (featureDim <= PITCH_COLUMN) {
+      throw new Error('Waqf verification needs the WebAssembly feature extractor');
+    }
+    const secondsPerFrame = FEATURE_HOP / audioBuffer.sampleRate;
+
+    const words = verse.words.length;
+    const queryPtr = module.malloc(queryLen * featureDim * 8);
+    const marksPtr = module.malloc(words * 4);
+    let check = 0;
+    try {
+      const queryHeap = new Float64Array(module.HEAPF64.buffer, queryPtr, queryLen * featureDim);
+      for (let i = 0; i < queryLen; i++) {
+        queryHeap.set(enhancedMFCC[i].slice(0, featureDim), i * featureDim);
+      }
+      const marks = new Int32Array(module.HEAP8.buffer, marksPtr, words);
+      verse.words.forEach((word, index) => {
+        let mark = index === words - 1 ? WAQF_VERSE_END : 0;
+        for (const ch of Array.from(word.arabicText)) {
+          if (WAQF_SIGNS[ch]) mark = WAQF_SIGNS[ch];
+        }
+        marks[index] = mark;
+      });
+      check = module.detect_waqf(
+        queryPtr, queryLen, featureDim, MFCC_COLUMNS, SEGMENT_ENERGY_COLUMN, PITCH_COLUMN,
+        1 / secondsPerFrame, entry, marksPtr, words
+      );
+    } finally {
+      module.free(marksPtr);
+      module.free(queryPtr);
+    }
+    if (!check) {
+      this.checkRunStatus(module, 'waqf verification');
+      throw new Error('Waqf verification failed');
+    }
+
+    try {
+      // Layout in src/wasm/waqf.h
+      const findings: WaqfFinding[] = [];
+      const pausesPtr = module.waqf_pauses(check);
+      for (let i = 0; i < module.waqf_count(check); i++) {
+        const fields = new Int32Array(module.HEAP8.buffer, pausesPtr + i * 32, 6);
+        const durationMs = new Float64Array(module.HEAP8.buffer, pausesPtr + i * 32 + 24, 1)[0];
+        findings.push({
+          wordId: verse.words[fields[2]].id,
+          startTime: fields[0] * secondsPerFrame,
+          durationMs,
+          verdict: WAQF_VERDICTS[fields[4]]
+        });
+      }
+      this.log(`Waqf verification found ${findings.length} pauses`);
+      return findings;
+    } finally {
+      module.waqf_destroy(check);
+    }
+  }
+
+  /**
+   * Frame-level nasality of a recording and the nasal murmur segments in
+   * it, on the same frames as the extracted features, for ghunnah, idgham
+   * and ikhfa checks.
+   */
+  async detectNasality(audioBuffer: AudioBuffer): Promise<NasalityProfile> {
+    if (!this.initialized) {
+      await this.initialize();
+    }
+    const module = this.audioModule;
+    if (!module) {
+      throw new Error('Nasality detection needs the WebAssembly audio module');
+    }
+
+    const audioData = audioBuffer.getChannelData(0);
+    const secondsPerFrame = FEATURE_HOP / audioBuffer.sampleRate;
+    const dataPtr = module.malloc(audioData.length * 8);
+    let detector = 0;
+    try {
+      new Float64Array(module.HEAPF64.buffer, dataPtr, audioData.length).set(audioData);
+      detector = module.nasal_analyze(dataPtr, audioData.length, audioBuffer.sampleRate,
+                                      FEATURE_HOP * 2, FEATURE_HOP);
+    } finally {
+      module.free(dataPtr);
+    }
+    if (!detector) {
+      throw new Error('Nasality detection failed');
+    }
+
+    try {
+      const frames = module.nasal_frame_count(detector);
+      const scores = new Float32Array(module.HEAPF32.buffer, module.nasal_scores(detector), frames).slice();
+      const segments = this.readNasalSegments(
+        module.nasal_segments(detector), module.nasal_segment_count(detector), secondsPerFrame
+      );
+      this.log(`Nasality: ${segments.length} nasal segments in ${frames} frames`);
+      return { frameRate: 1 / secondsPerFrame, scores, segments };
+    } finally {
+      module.nasal_destroy(detector);
+    }
+  }
+
+  /**
+   * Release bursts (stop closure, then a sudden broadband rise) in a
+   * recording, at a few milliseconds' resolution, for matching against the
+   * expected qalqalah letters.
+   */
+  async detectQalqalah(audioBuffer: AudioBuffer): Promise<QalqalahBurstResult[]> {
+    if (!this.initialized) {
+      await this.initialize();
+    }
+    const module = this.audioModule;
+    if (!module) {
+      throw new Error('Qalqalah detection needs the WebAssembly audio module');
+    }
+
+    const audioData = audioBuffer.getChannelData(0);
+    const dataPtr = module.malloc(audioData.length * 8);
+    let detector = 0;
+    try {
+      new Float64Array(module.HEAPF64.buffer, dataPtr, audioData.length).set(audioData);
+      detector = module.qalqalah_analyze(dataPtr, audioData.length, audioBuffer.sampleRate);
+    } finally {
+      module.free(dataPtr);
+    }
+    if (!detector) {
+      throw new Error('Qalqalah detection failed');
+    }
+
+    try {
+      const bursts = this.readQalqalahBursts(
+        module.qalqalah_bursts(detector), module.qalqalah_count(detector), audioBuffer.sampleRate
+      );
+      this.log(`Qalqalah: ${bursts.length} release bursts`);
+      return bursts;
+    } finally {
+      module.qalqalah_destroy(detector);
+    }
+  }
+
+  /**
+   * Spectral-flux onsets and syllable nuclei of a recording, on the feature
+   * frames: cheap anchors for word segmentation and for bounding alignment
+   * searches.
+   */
+  async detectLandmarks(audioBuffer: AudioBuffer): Promise<SpeechLandmarks> {
+    if (!this.initialized) {
+      await this.initialize();
+    }
+    const module = this.audioModule;
+    if (!module) {
+      throw new Error('Landmark detection needs the WebAssembly audio module');
+    }
+
+    const audioData = audioBuffer.getChannelData(0);
+    const dataPtr = module.malloc(audioData.length * 8);
+    let detector = 0;
+    try {
+      new Float64Array(module.HEAPF64.buffer, dataPtr, audioData.length).set(audioData);
+      detector = module.landmarks_analyze(dataPtr, audioData.length, audioBuffer.sampleRate, FEATURE_HOP * 2);
+    } finally {
+      module.free(dataPtr);
+    }
+    if (!detector) {
+      throw new Error('Landmark detection failed');
+    }
+
+    try {
+      const landmarks = this.readLandmarks(
+        module.landmarks(detector), module.landmark_count(detector), FEATURE_HOP / audioBuffer.sampleRate
+      );
+      this.log(`Landmarks: ${landmarks.onsets.length} onsets, ${landmarks.nuclei.length} syllable nuclei`);
+      return landmarks;
+    } finally {
+      module.landmarks_destroy(detector);
+    }
+  }
+
+  /**
+   * F1-F3 per feature frame from the LPC formant columns: vowel quality and
+   * the lowered F2 of heavy (tafkhim) letters, which the MFCCs blur.
+   */
+  async extractFormants(audioBuffer: AudioBuffer): Promise<FormantTrack> {
+    if (!this.initialized) {
+      await this.initialize();
+    }
+    const module = this.audioModule;
+    if (!module) {
+      throw new Error('Formant tracking needs the WebAssembly audio module');
+    }
+
+    const audioData = audioBuffer.getChannelData(0);
+    const frameSize = FEATURE_HOP * 2;
+    const numFrames = audioData.length >= frameSize
+      ? Math.floor((audioData.length - frameSize) / FEATURE_HOP) + 1
+      : 0;
+    const track: FormantTrack = {
+      frameRate: audioBuffer.sampleRate / FEATURE_HOP, f1: [], f2: [], f3: []
+    };
+
+    // One grow for input, the wider rows and the formant candidates
+    const options = FEATURE_FORMANTS | this.frontEndOptions();
+    const reserved = module.reserve_audio_workspace(
+      audioData.length, audioBuffer.sampleRate, frameSize, options, this.memoryBudget()
+    );
+    if (reserved < 0) {
+      throw new Error('Recording exceeds the WebAssembly memory budget');
+    }
+
+    // Inputs and results share the module's scratch arena; one reset frees both
+    const dataPtr = module.scratch_alloc(audioData.length * 8);
+    try {
+      new Float64Array(module.HEAPF64.buffer, dataPtr, audioData.length).set(audioData);
+      const featuresPtr = module.process_audio_features_ex(
+        dataPtr, audioData.length, audioBuffer.sampleRate, frameSize, options
+      );
+      this.checkRunStatus(module, 'formant tracking');
+      const features = new Float64Array(
+        module.HEAPF64.buffer, featuresPtr, numFrames * FORMANT_FEATURES_PER_FRAME
+      );
+      for (let i = 0; i < numFrames; i++) {
+        const row = i * FORMANT_FEATURES_PER_FRAME + FORMANT_COLUMN;
+        track.f1.push(features[row]);
+        track.f2.push(features[row + 1]);
+        track.f3.push(features[row + 2]);
+      }
+    } finally {
+      module.scratch_reset();
+    }
+    this.log(`Formants: ${numFrames} frames`);
+    return track;
+  }
+
+  private readLandmarks(ptr: number, count: number, secondsPerFrame: number): SpeechLandmarks {
+    const module = this.audioModule!;
+    const landmarks: SpeechLandmarks = { onsets: [], nuclei: [] };
+    for (let i = 0; i < count; i++) {
+      const offset = ptr + i * LANDMARK_BYTES;
+      const fields = new Int32Array(module.HEAP8.buffer, offset, 2);
+      const strength = new Float32Array(module.HEAP8.buffer, offset + 8, 1)[0];
+      const time = fields[0] * secondsPerFrame;
+      if (fields[1] === LANDMARK_NUCLEUS) {
+        landmarks.nuclei.push({ time, prominenceDb: strength });
+      } else {
+        landmarks.onsets.push({ time, strength });
+      }
+    }
+    // Live landmarks come in the order they were confirmed
+    landmarks.onsets.sort((a, b) => a.time - b.time);
+    landmarks.nuclei.sort((a, b) => a.time - b.time);
+    return landmarks;
+  }
+
+  private readQalqalahBursts(ptr: number, count: number, sampleRate: number): QalqalahBurstResult[] {
+    const module = this.audioModule!;
+    const bursts: QalqalahBurstResult[] = [];
+    for (let i = 0; i < count; i++) {
+      const offset = ptr + i * QALQALAH_BURST_BYTES;
+      const fields = new Float32Array(module.HEAP8.buffer, offset + 4, 3);
+      bursts.push({
+        time: new Int32Array(module.HEAP8.buffer, offset, 1)[0] / sampleRate,
+        strength: fields[0],
+        riseDb: fields[1],
+        closureMs: fields[2]
+      });
+    }
+    return bursts;
+  }
+
+  private readNasalSegments(ptr: number, count: number, secondsPerFrame: number): NasalSegmentResult[] {
+    const module = this.audioModule!;
+    const segments: NasalSegmentResult[] = [];
+    for (let i = 0; i < count; i++) {
+      const offset = ptr + i * NASAL_SEGMENT_BYTES;
+      const bounds = new Int32Array(module.HEAP8.buffer, offset, 2);
+      const scores = new Float32Array(module.HEAP8.buffer, offset + 8, 2);
+      segments.push({
+        startTime: bounds[0] * secondsPerFrame,
+        endTime: bounds[1] * secondsPerFrame,
+        meanScore: scores[0],
+        peakScore: scores[1],
+        durationMs: new Float64Array(module.HEAP8.buffer, offset + 16, 1)[0]
+      });
+    }
+    return segments;
+  }
+
+  /**
+   * Ask a running analysis to stop. The engine notices at its next poll
+   * when the analysis runs on another thread (shared-memory build); calls
+   * made after this one fail straight away until the next analysis starts.
+   */
+  cancelAnalysis(): void {
+    this.sliceCancelled = true;
+    for (const module of this.cancellableModules()) {
+      Atomics.store(new Int32Array(module.HEAP8.buffer, module.cancel_control(), 1), 0, 1);
+    }
+  }
+
+  /**
+   * analyzeRecitation() for callers on the main thread: feature extraction
+   * and DTW run as resumable engine tasks, sliceBudgetMs at a time, with the
+   * event loop free between slices. Results match the blocking path.
+   */
+  private async analyzeRecitationSliced(
+    audioBuffer: AudioBuffer,
+    audioFeatures: AudioFeatures,
+    referenceVerse: QuranVerse,
+    startTime: number
+  ): Promise<RecitationAnalysis> {
+    const deadlineMs = Date.now() + this.config.timeoutMs;
+    this.sliceCancelled = false;
+    this.armCancellation(deadlineMs);
+
+    try {
+      const enhancedMFCC = await this.extractSlicedMFCC(audioBuffer, deadlineMs);
+      const dtwResult = await this.performSlicedDTW(
+        enhancedMFCC, this.findReferenceEntry(referenceVerse), referenceVerse, deadlineMs
+      );
+
+      // The four-state forward pass is short enough to run in one go
+      const hmmResult = this.performWasmHMM(enhancedMFCC);
+
+      const analysis = this.generateComprehensiveAnalysis(
+        dtwResult,
+        hmmResult,
+        audioFeatures,
+        referenceVerse
+      );
+      this.log(`WebAssembly analysis completed in ${Date.now() - startTime}ms (sliced)`);
+      return analysis;
+    } catch (error) {
+      this.log('WebAssembly analysis failed:', error);
+      throw error;
+    }
+  }
+
+  // Steps an engine task until it reports completion, yielding to the event
+  // loop between steps. Stops with AnalysisInterruptedError on
+  // cancelAnalysis() or once the deadline has passed.
+  private async runSliced(
+    step: (budgetUs: number) => number,
+    progress: () => number,
+    stage: string,
+    deadlineMs: number
+  ): Promise<void> {
+    const budgetUs = (this.config.sliceBudgetMs ?? 0) * 1000;
+    while (!step(budgetUs)) {
+      await new Promise(resolve => setTimeout(resolve, 0));
+      if (this.sliceCancelled) {
+        throw new AnalysisInterruptedError('cancelled', stage, progress());
+      }
+      if (Date.now() >= deadlineMs) {
+        throw new AnalysisInterruptedError('partial', stage, progress());
+      }
+    }
+  }
+
+  // The first `columns` of each row: the MFCCs by default, FEATURE_COLUMNS
+  // for whole rows. Task inputs live in malloc() memory rather than the
+  // scratch arena, which other calls may reset while a task is suspended.
+  private async extractSlicedMFCC(
+    audioBuffer: AudioBuffer,
+    deadlineMs: number,
+    columns = MFCC_COLUMNS
+  ): Promise<number[][]> {
+    const module = this.audioModule;
+    if (!module) {
+      return this.extractFallbackMFCC(audioBuffer);
+    }
+
+    const audioData = audioBuffer.getChannelData(0);
+    const frameSize = 2048;
+    const dataPtr = module.malloc(audioData.length * 8);
+    let task = 0;
+
+    try {
+      new Float64Array(module.HEAPF64.buffer, dataPtr, audioData.length).set(audioData);
+      task = module.feature_task_create(
+        dataPtr, audioData.length, audioBuffer.sampleRate, frameSize, this.frontEndOptions()
+      );
+      await this.runSliced(
+        budgetUs => module.feature_task_step(task, budgetUs),
+        () => module.feature_task_progress(task),
+        'feature extraction',
+        deadlineMs
+      );
+
+      // Views are taken only now: the heap may have grown between steps
+      const numFrames = module.feature_task_frames(task);
+      const stride = module.feature_task_stride(task);
+      const rows = new Float64Array(module.HEAPF64.buffer, module.feature_task_features(task), numFrames * stride);
+      const mfccFeatures: number[][] = [];
+      for (let i = 0; i < numFrames; i++) {
+        mfccFeatures.push(Array.from(rows.subarray(i * stride, i * stride + columns)));
+      }
+      return mfccFeatures;
+    } finally {
+      if (task) module.feature_task_destroy(task);
+      module.free(dataPtr);
+    }
+  }
+
+  private async performSlicedDTW(
+    queryMFCC: number[][],
+    entry: number,
+    verse: QuranVerse,
+    deadlineMs: number
+  ): Promise<any> {
+    const module = this.dtwModule;
+    if (!module) {
+      throw new Error('DTW module not loaded');
+    }
+
+    const referenceMFCC = entry >= 0 ? null : this.generateReferenceMFCC(verse);
+    const queryLen = queryMFCC.length;
+    const refLen = referenceMFCC ? referenceMFCC.length : module.reference_frames(entry);
+    const featureDim = queryMFCC[0]?.length || 13;
+
+    const queryPtr = module.malloc(queryLen * featureDim * 8);
+    const refPtr = referenceMFCC ? module.malloc(refLen * featureDim * 8) : 0;
+    let task = 0;
+
+    try {
+      const queryHeap = new Float64Array(module.HEAPF64.buffer, queryPtr, queryLen * featureDim);
+      for (let i = 0; i < queryLen; i++) {
+        queryHeap.set(queryMFCC[i].slice(0, featureDim), i * featureDim);
+      }
+      if (referenceMFCC) {
+        const refHeap = new Float64Array(module.HEAPF64.buffer, refPtr, refLen * featureDim);
+        for (let i = 0; i < refLen; i++) {
+          refHeap.set(referenceMFCC[i].slice(0, featureDim), i * featureDim);
+        }
+      }
+
+      task = referenceMFCC
+        ? module.dtw_task_create(queryPtr, queryLen, featureDim, refPtr, refLen, featureDim, -1)
+        : module.dtw_task_create_reference(queryPtr, queryLen, featureDim, entry);
+      if (!task) {
+        throw new Error('DTW task could not be created');
+      }
+      await this.runSliced(
+        budgetUs => module.dtw_task_step(task, budgetUs),
+        () => module.dtw_task_progress(task),
+        'DTW alignment',
+        deadlineMs
+      );
+
+      const distance = module.dtw_task_normalized_distance(task);
+      return {
+        distance,
+        alignmentScore: Math.max(0, 100 - distance * 20),
+        queryLength: queryLen,
+        referenceLength: refLen
+      };
+    } finally {
+      if (task) module.dtw_task_destroy(task);
+      if (refPtr) module.free(refPtr);
+      module.free(queryPtr);
+    }
+  }
+
+  private cancellableModules(): CancellableModule[] {
+    return [this.audioModule, this.dtwModule, this.hmmModule]
+      .filter((module): module is NonNullable<typeof module> => module !== null);
+  }
+
+  // Clears the cancel flag and sets the deadline (epoch ms) in every module
+  private armCancellation(deadlineMs: number): void {
+    for (const module of this.cancellableModules()) {
+      const ptr = module.cancel_control();
+      Atomics.store(new Int32Array(module.HEAP8.buffer, ptr, 1), 0, 0);
+      new Float64Array(module.HEAP8.buffer, ptr + 8, 1)[0] = deadlineMs;
+    }
+  }
+
+  // Throws AnalysisInterruptedError when the module's last call stopped early
+  private checkRunStatus(module: CancellableModule, stage: string): void {
+    const ptr = module.cancel_control();
+    const status = new Int32Array(module.HEAP8.buffer, ptr, 2)[1];
+    if (status === RUN_CANCELLED || status === RUN_PARTIAL) {
+      const progress = new Float64Array(module.HEAP8.buffer, ptr + 8, 2)[1];
+      throw new AnalysisInterruptedError(status === RUN_CANCELLED ? 'cancelled' : 'partial', stage, progress);
+    }
+  }
+
+  // The first `columns` of each row: the MFCCs by default, FEATURE_COLUMNS
+  // for whole rows
+  private extractWasmMFCC(audioBuffer: AudioBuffer, columns = MFCC_COLUMNS): number[][] {
     if (this.audioModule) {
       this.log('Extracting MFCC features with WebAssembly...');
       
       const audioData = audioBuffer.getChannelData(0);
       const sampleRate = audioBuffer.sampleRate;
       const frameSize = 2048;
-      const hopSize = 512;
+      const hopSize = frameSize / 2; // process_audio_features uses a half-frame hop
+      
+      // Size the arena for input + features in one grow, so HEAPF64 views
+      // taken below cannot be detached by memory growth mid-analysis
+      const options = this.frontEndOptions();
+      const reserved = this.audioModule.reserve_audio_workspace(
+        audioData.length, sampleRate, frameSize, options, this.memoryBudget()
+      );
+      if (reserved < 0) {
+        throw new Error('Recording exceeds the WebAssembly memory budget');
+      }
       
-      // Allocate memory in WASM
-      const dataPtr = this.audioModule.malloc(audioData.length * 8); // 8 bytes per double
+      // Inputs and results share the module's scratch arena; one reset frees both
+      const dataPtr = this.audioModule.scratch_alloc(audioData.length * 8); // 8 bytes per double
       
       try {
         // Copy audio data to WASM memory
@@ -193,13 +1371,18 @@ export class WasmAnalysisService {
         }
         
         // Process audio and extract features
-        const featuresPtr = this.audioModule.process_audio_features(
-          dataPtr, audioData.length, sampleRate, frameSize
+        const hitsBefore = this.audioModule.feature_cache_hits();
+        const featuresPtr = this.audioModule.process_audio_features_ex(
+          dataPtr, audioData.length, sampleRate, frameSize, options
         );
+        this.checkRunStatus(this.audioModule, 'feature extraction');
+        if (this.audioModule.feature_cache_hits() > hitsBefore) {
+          this.log('Reused cached features for this recording');
+        }
         
         // Calculate number of frames and features per frame
         const numFrames = Math.floor((audioData.length - frameSize) / hopSize) + 1;
-        const featuresPerFrame = 13 + 4; // 13 MFCC + energy + ZCR + spectral centroid + pitch
+        const featuresPerFrame = FEATURE_COLUMNS; // 13 MFCC + energy + ZCR + spectral centroid + pitch
         
         // Read features from WASM memory
         const featuresHeap = new Float64Array(
@@ -212,17 +1395,15 @@ export class WasmAnalysisService {
         const mfccFeatures: number[][] = [];
         for (let i = 0; i < numFrames; i++) {
           const frame: number[] = [];
-          for (let j = 0; j < 13; j++) { // Only MFCC coefficients
+          for (let j = 0; j < columns; j++) {
             frame.push(featuresHeap[i * featuresPerFrame + j]);
           }
           mfccFeatures.push(frame);
         }
         
-        this.audioModule.free(featuresPtr);
-        
         return mfccFeatures;
       } finally {
-        this.audioModule.free(dataPtr);
+        this.audioModule.scratch_reset();
       }
     } else {
       // Fallback: Fast JavaScript-based MFCC extraction
@@ -272,9 +1453,16 @@ export class WasmAnalysisService {
     return mfccFeatures;
   }
 
+  private findReferenceEntry(verse: QuranVerse): number {
+    if (!this.dtwModule || !this.referenceStoreLoaded) return -1;
+    return this.dtwModule.reference_find(
+      verse.surahNumber, verse.verseNumber, this.config.reciter ?? 0
+    );
+  }
+
   private generateReferenceMFCC(verse: QuranVerse): number[][] {
-    // In production, this would load from a reference audio database
-    // For now, generate synthetic reference based on verse characteristics
+    // Fallback when the reference store has no recording of this verse:
+    // a synthetic reference based on verse characteristics
     const expectedDuration = 4.0; // seconds for Bismillah
     const frameRate = 100; // frames per second
     const numFrames = Math.round(expectedDuration * frameRate);
@@ -322,9 +1510,22 @@ export class WasmAnalysisService {
     const refLen = referenceMFCC.length;
     const featureDim = queryMFCC[0]?.length || 13;
     
-    // Allocate memory for sequences
-    const queryPtr = this.dtwModule.malloc(queryLen * featureDim * 8);
-    const refPtr = this.dtwModule.malloc(refLen * featureDim * 8);
+    // The adaptive planner sizes its own workspace within the budget
+    const adaptive = this.config.latencyTargetMs !== undefined;
+    if (!adaptive) {
+      const reserved = this.dtwModule.reserve_dtw_workspace(
+        queryLen, refLen, featureDim, this.memoryBudget()
+      );
+      if (reserved < 0) {
+        throw new Error('DTW inputs exceed the WebAssembly memory budget');
+      }
+    }
+    
+    // Allocate memory for sequences from the scratch arena. Both allocations
+    // happen before any view is taken: a grow between them would detach the
+    // first view.
+    const queryPtr = this.dtwModule.scratch_alloc(queryLen * featureDim * 8);
+    const refPtr = this.dtwModule.scratch_alloc(refLen * featureDim * 8);
     
     try {
       // Copy query MFCC to WASM memory
@@ -344,10 +1545,13 @@ export class WasmAnalysisService {
       }
       
       // Compute DTW distance
-      const distance = this.dtwModule.compute_normalized_dtw(
-        queryPtr, queryLen, featureDim,
-        refPtr, refLen, featureDim
-      );
+      const distance = adaptive
+        ? this.computeAdaptiveDTW(this.dtwModule, queryPtr, queryLen, refPtr, refLen, featureDim)
+        : this.dtwModule.compute_normalized_dtw(
+            queryPtr, queryLen, featureDim,
+            refPtr, refLen, featureDim
+          );
+      this.checkRunStatus(this.dtwModule, 'DTW alignment');
       
       // Convert distance to alignment score (0-100)
       const alignmentScore = Math.max(0, 100 - distance * 20);
@@ -360,8 +1564,87 @@ export class WasmAnalysisService {
       };
       
     } finally {
-      this.dtwModule.free(queryPtr);
-      this.dtwModule.free(refPtr);
+      this.dtwModule.scratch_reset();
+    }
+  }
+
+  // Normalised DTW through the engine's planner (src/wasm/planner.h); the
+  // plan it chose is logged so slow or approximate runs can be explained
+  private computeAdaptiveDTW(
+    module: DTWModule,
+    queryPtr: number, queryLen: number,
+    refPtr: number, refLen: number,
+    featureDim: number
+  ): number {
+    const distance = module.compute_adaptive_dtw(
+      queryPtr, queryLen, featureDim,
+      refPtr, refLen, featureDim,
+      this.memoryBudget(), this.config.latencyTargetMs ?? 0, this.config.accuracyTolerance ?? 0
+    );
+
+    const planPtr = module.alignment_plan();
+    const words = new Int32Array(module.HEAP8.buffer, planPtr, 4);
+    const flags = new Uint8Array(module.HEAP8.buffer, planPtr + 16, 4);
+    const estimates = new Float64Array(module.HEAP8.buffer, planPtr + 24, 2);
+    if (!flags[2]) {
+      throw new Error('DTW inputs exceed the WebAssembly memory budget');
+    }
+    this.log('Adaptive DTW plan', {
+      algorithm: DTW_ALGORITHMS[words[0]],
+      bandWidth: words[1],
+      radius: words[2],
+      threads: words[3],
+      singlePrecision: flags[0] === 1,
+      exact: flags[1] === 1,
+      withinLatency: flags[3] === 1,
+      estimatedMs: estimates[0],
+      workspaceBytes: estimates[1]
+    });
+    return distance;
+  }
+
+  private performWasmReferenceDTW(queryMFCC: number[][], entry: number): any {
+    if (!this.dtwModule) {
+      throw new Error('DTW module not loaded');
+    }
+
+    this.log('Performing DTW against the reference store...');
+
+    const queryLen = queryMFCC.length;
+    const refLen = this.dtwModule.reference_frames(entry);
+    const featureDim = queryMFCC[0]?.length || 13;
+
+    const reserved = this.dtwModule.reserve_dtw_workspace(
+      queryLen, refLen, featureDim, this.memoryBudget()
+    );
+    if (reserved < 0) {
+      throw new Error('DTW inputs exceed the WebAssembly memory budget');
+    }
+
+    const queryPtr = this.dtwModule.scratch_alloc(queryLen * featureDim * 8);
+
+    try {
+      const queryHeap = new Float64Array(this.dtwModule.HEAPF64.buffer, queryPtr, queryLen * featureDim);
+      for (let i = 0; i < queryLen; i++) {
+        for (let j = 0; j < featureDim; j++) {
+          queryHeap[i * featureDim + j] = queryMFCC[i][j];
+        }
+      }
+
+      // The reference is read from the store in place; only the first
+      // featureDim columns are compared
+      const distance = this.dtwModule.compute_reference_dtw(queryPtr, queryLen, featureDim, entry);
+      this.checkRunStatus(this.dtwModule, 'DTW alignment');
+      const alignmentScore = Math.max(0, 100 - distance * 20);
+
+      return {
+        distance,
+        alignmentScore,
+        queryLength: queryLen,
+        referenceLength: refLen
+      };
+    } finally {
+      this.dtwModule.scratch_reset();
     }
   }
 
@@ -381,11 +1664,18 @@ export class WasmAnalysisService {
     const obsLen = observations.length;
     const numStates = 4; // Representing different phoneme states
     
-    // Allocate memory
-    const obsPtr = this.hmmModule.malloc(obsLen * 4); // 4 bytes per int
-    const transPtr = this.hmmModule.malloc(numStates * numStates * 8);
-    const emissPtr = this.hmmModule.malloc(numStates * 256 * 8);
-    const initialPtr = this.hmmModule.malloc(numStates * 8);
+    const reserved = this.hmmModule.reserve_hmm_workspace(
+      obsLen, numStates, 256, 0, this.memoryBudget()
+    );
+    if (reserved < 0) {
+      throw new Error('HMM inputs exceed the WebAssembly memory budget');
+    }
+    
+    // Allocate memory from the scratch arena
+    const obsPtr = this.hmmModule.scratch_alloc(obsLen * 4); // 4 bytes per int
+    const transPtr = this.hmmModule.scratch_alloc(numStates * numStates * 8);
+    const emissPtr = this.hmmModule.scratch_alloc(numStates * 256 * 8);
+    const initialPtr = this.hmmModule.scratch_alloc(numStates * 8);
     
     try {
       // Copy observations
@@ -420,6 +1710,7 @@ export class WasmAnalysisService {
       const likelihood = this.hmmModule.forward_algorithm(
         obsPtr, obsLen, transPtr, emissPtr, initialPtr, numStates
       );
+      this.checkRunStatus(this.hmmModule, 'HMM analysis');
       
       return {
         likelihood,
@@ -428,10 +1719,7 @@ export class WasmAnalysisService {
       };
       
     } finally {
-      this.hmmModule.free(obsPtr);
-      this.hmmModule.free(transPtr);
-      this.hmmModule.free(emissPtr);
-      this.hmmModule.free(initialPtr);
+      this.hmmModule.scratch_reset();
     }
   }
 
@@ -618,6 +1906,16 @@ export class WasmAnalysisService {
     };
   }
 
+  // process_audio_features_ex switches for the configured front end
+  private frontEndOptions(): number {
+    return (this.config.noiseSuppression ? FEATURE_DENOISE : 0) |
+      (this.config.loudnessNormalization ? FEATURE_LOUDNESS : 0);
+  }
+
+  private memoryBudget(): number {
+    return this.config.memoryBudgetBytes ?? DEFAULT_MEMORY_BUDGET;
+  }
+
   private log(message: string, data?: any): void {
     if (this.config.enableLogging) {
       if (data) {
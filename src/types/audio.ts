@@ -23,6 +23,9 @@ export interface RecordingData {
   audioBuffer: AudioBuffer;
   features: AudioFeatures;
   segments: AudioSegment[];
+  // Rows of the C++ streaming extractor captured live (13 MFCCs, energy,
+  // ZCR, spectral centroid, pitch), when a LiveFeatureSource was available
+  liveFeatures?: number[][];
   metadata: {
     duration: number;
     sampleRate: number;
@@ -57,6 +60,16 @@ export interface AudioWorkletMessage {
 
 export type AudioProcessingCallback = (message: AudioWorkletMessage) => void;
 
+// Live feature extraction from a shared sample ring the worklet writes to
+// (WasmAnalysisService). createLiveStream returns null unless the analysis
+// module is the shared-memory (pthreads) build.
+export interface LiveFeatureSource {
+  createLiveStream(sampleRate: number, seconds?: number): { buffer: SharedArrayBuffer; byteOffset: number } | null;
+  drainLiveFeatures(): number[][];
+  finishLiveFeatures(): number[][];
+  closeLiveStream(): void;
+}
+
 export interface AudioServiceInterface {
   initialize(): Promise<void>;
   startRecording(): Promise<void>;
@@ -1,3 +1,52 @@
+// Embind class APIs return typed_memory_view results: typed arrays that
+// alias engine-owned buffers in the module heap. A view is invalidated by the
+// next call that refills the same buffer, by delete(), and by memory growth;
+// slice() anything that has to outlive that.
+export interface FeatureBuffer {
+  data: Float32Array; // rows x stride, element (i, j) at i * stride + j
+  rows: number;
+  cols: number;
+  stride: number;
+}
+
+export interface AlignmentView {
+  distance: number;
+  pathLength: number;
+  path: Int32Array; // interleaved (query, reference) index pairs
+}
+
+export interface ForwardView {
+  probability: number;
+  alpha: Float64Array; // rows x stride log probabilities
+  rows: number;
+  stride: number;
+}
+
+export interface ViterbiView {
+  probability: number;
+  path: Int32Array;
+  probabilities: Float64Array;
+}
+
+export interface AudioProcessorInstance {
+  audioInput(samples: number): Float64Array;
+  processInput(sampleRate: number, frameSize: number, hopSize: number): FeatureBuffer;
+  delete(): void;
+}
+
+export interface DynamicTimeWarpingInstance {
+  sequenceInput(which: 0 | 1, rows: number, cols: number): FeatureBuffer;
+  alignInputs(bandWidth: number): AlignmentView;
+  delete(): void;
+}
+
+export interface HiddenMarkovModelInstance {
+  observationInput(length: number): Int32Array;
+  forwardInput(): ForwardView;
+  viterbiInput(): ViterbiView;
+  delete(): void;
+}
+
 export interface DTWModule {
   compute_dtw_distance(
     seq1: number, seq1_len: number, feature_dim1: number,
@@ -7,10 +56,85 @@ export interface DTWModule {
     seq1: number, seq1_len: number, feature_dim1: number,
     seq2: number, seq2_len: number, feature_dim2: number
   ): number;
+  compute_normalized_dtw_f32(
+    seq1: number, seq1_len: number, feature_dim1: number,
+    seq2: number, seq2_len: number, feature_dim2: number
+  ): number;
+  reserve_dtw_workspace(
+    seq1_len: number, seq2_len: number, feature_dim: number,
+    budget_bytes: number
+  ): number;
+  plan_alignment(
+    seq1_len: number, seq2_len: number, feature_dim: number, need_path: number,
+    memory_budget: number, latency_ms: number, tolerance: number
+  ): number;
+  alignment_plan(): number;
+  compute_adaptive_dtw(
+    seq1: number, seq1_len: number, feature_dim1: number,
+    seq2: number, seq2_len: number, feature_dim2: number,
+    memory_budget: number, latency_ms: number, tolerance: number
+  ): number;
+  reference_store_open(data: number, size_bytes: number): number;
+  reference_find(surah: number, ayah: number, reciter: number): number;
+  reference_frames(entry: number): number;
+  reference_feature_dim(): number;
+  reference_front_end(): number;
+  reference_feature_stride(): number;
+  reference_features(entry: number): number;
+  reference_word_count(entry: number): number;
+  reference_word_boundaries(entry: number): number;
+  compute_reference_dtw(
+    query: number, query_len: number, feature_dim: number, entry: number
+  ): number;
+  reference_lower_bound(
+    query: number, query_len: number, feature_dim: number, entry: number
+  ): number;
+  dtw_task_create(
+    seq1: number, seq1_len: number, feature_dim1: number,
+    seq2: number, seq2_len: number, feature_dim2: number,
+    window_size: number
+  ): number;
+  dtw_task_create_reference(
+    query: number, query_len: number, feature_dim: number, entry: number
+  ): number;
+  dtw_task_step(task: number, budget_us: number): number;
+  dtw_task_progress(task: number): number;
+  dtw_task_normalized_distance(task: number): number;
+  dtw_task_destroy(task: number): void;
+  progressive_create(
+    query: number, query_len: number, feature_dim1: number,
+    reference: number, reference_len: number, feature_dim2: number
+  ): number;
+  progressive_create_reference(
+    query: number, query_len: number, feature_dim: number, entry: number
+  ): number;
+  progressive_advance(analysis: number): number;
+  progressive_result(analysis: number): number;
+  progressive_destroy(analysis: number): void;
+  segment_recitation(
+    query: number, query_len: number, feature_dim: number, dtw_dim: number, energy_column: number,
+    frame_rate: number, surah: number, first_ayah: number, last_ayah: number, reciter: number
+  ): number;
+  segmentation_report(segmentation: number): number;
+  segmentation_segments(segmentation: number): number;
+  segmentation_destroy(segmentation: number): void;
+  detect_waqf(
+    query: number, query_len: number, feature_dim: number, dtw_dim: number, energy_column: number,
+    pitch_column: number, frame_rate: number, entry: number, marks: number, mark_count: number
+  ): number;
+  waqf_count(check: number): number;
+  waqf_pauses(check: number): number;
+  waqf_destroy(check: number): void;
+  cancel_control(): number;
+  scratch_alloc(size: number): number;
+  scratch_reset(): void;
   malloc(size: number): number;
   free(ptr: number): void;
   HEAPF64: Float64Array;
+  HEAPF32: Float32Array;
+  HEAPU8: Uint8Array;
   HEAP8: Int8Array;
+  DynamicTimeWarping: new () => DynamicTimeWarpingInstance;
 }
 
 export interface HMMModule {
@@ -24,10 +148,28 @@ export interface HMMModule {
     transitions: number, emissions: number,
     initial_probs: number, num_states: number
   ): number;
+  reserve_hmm_workspace(
+    obs_len: number, num_states: number, num_symbols: number,
+    want_path: number, budget_bytes: number
+  ): number;
+  viterbi_task_create(
+    observations: number, obs_len: number,
+    transitions: number, emissions: number,
+    initial_probs: number, num_states: number
+  ): number;
+  viterbi_task_step(task: number, budget_us: number): number;
+  viterbi_task_progress(task: number): number;
+  viterbi_task_probability(task: number): number;
+  viterbi_task_path(task: number): number;
+  viterbi_task_destroy(task: number): void;
+  cancel_control(): number;
+  scratch_alloc(size: number): number;
+  scratch_reset(): void;
   malloc(size: number): number;
   free(ptr: number): void;
   HEAPF64: Float64Array;
   HEAP8: Int8Array;
+  HiddenMarkovModel: new (states: number, observations: number) => HiddenMarkovModelInstance;
 }
 
 export interface AudioProcessorModule {
@@ -35,14 +177,108 @@ export interface AudioProcessorModule {
     audio_data: number, data_len: number,
     sample_rate: number, frame_size: number
   ): number;
+  process_audio_features_ex(
+    audio_data: number, data_len: number,
+    sample_rate: number, frame_size: number, options: number
+  ): number;
   extract_mfcc(
     spectrum: number, spectrum_len: number,
     sample_rate: number, num_coeffs: number
   ): number;
+  reserve_audio_workspace(
+    data_len: number, sample_rate: number, frame_size: number,
+    options: number, budget_bytes: number
+  ): number;
+  ring_buffer_bytes(capacity: number): number;
+  ring_buffer_init(memory: number, capacity: number): number;
+  ring_buffer_write(ring: number, samples: number, count: number): number;
+  ring_buffer_read(ring: number, out: number, count: number): number;
+  ring_buffer_readable(ring: number): number;
+  ring_buffer_writable(ring: number): number;
+  ring_buffer_overruns(ring: number): number;
+  stream_create(
+    sample_rate: number, frame_size: number, hop_size: number,
+    max_frames: number
+  ): number;
+  stream_destroy(stream: number): void;
+  stream_push(stream: number, samples: number, count: number): number;
+  stream_drain(stream: number, ring: number): number;
+  stream_finish(stream: number): number;
+  stream_frame_count(stream: number): number;
+  stream_features(stream: number): number;
+  stream_feature_stride(stream: number): number;
+  stream_clear(stream: number): void;
+  stream_reset(stream: number): void;
+  stream_dropped(stream: number): number;
+  stream_attach_peaks(stream: number, pyramid: number): void;
+  peak_pyramid_create(expected_samples: number): number;
+  peak_pyramid_destroy(pyramid: number): void;
+  peak_pyramid_append(pyramid: number, samples: number, count: number): void;
+  peak_pyramid_clear(pyramid: number): void;
+  peak_pyramid_levels(pyramid: number): number;
+  peak_pyramid_level_for(pyramid: number, samples_per_pixel: number): number;
+  peak_pyramid_bin_samples(level: number): number;
+  peak_pyramid_bins(pyramid: number, level: number): number;
+  peak_pyramid_data(pyramid: number, level: number): number;
+  peak_pyramid_samples(pyramid: number): number;
+  stream_enable_nasality(stream: number): number;
+  stream_nasal_scores(stream: number): number;
+  stream_nasal_segment_count(stream: number): number;
+  stream_nasal_segments(stream: number): number;
+  stream_enable_qalqalah(stream: number): number;
+  stream_qalqalah_count(stream: number): number;
+  stream_qalqalah_bursts(stream: number): number;
+  stream_enable_landmarks(stream: number): number;
+  stream_landmark_count(stream: number): number;
+  stream_landmarks(stream: number): number;
+  stream_enable_noise_suppression(stream: number): number;
+  stream_enable_loudness(stream: number): number;
+  stream_loudness_lufs(stream: number): number;
+  stream_loudness_gain_db(stream: number): number;
+  nasal_analyze(
+    audio_data: number, data_len: number, sample_rate: number, frame_size: number,
+    hop_size: number
+  ): number;
+  nasal_frame_count(detector: number): number;
+  nasal_scores(detector: number): number;
+  nasal_segment_count(detector: number): number;
+  nasal_segments(detector: number): number;
+  nasal_destroy(detector: number): void;
+  qalqalah_analyze(audio_data: number, data_len: number, sample_rate: number): number;
+  qalqalah_count(detector: number): number;
+  qalqalah_bursts(detector: number): number;
+  qalqalah_destroy(detector: number): void;
+  landmarks_analyze(
+    audio_data: number, data_len: number, sample_rate: number, frame_size: number
+  ): number;
+  landmark_count(detector: number): number;
+  landmarks(detector: number): number;
+  landmarks_destroy(detector: number): void;
+  feature_task_create(
+    audio_data: number, data_len: number, sample_rate: number, frame_size: number,
+    options: number
+  ): number;
+  feature_task_step(task: number, budget_us: number): number;
+  feature_task_progress(task: number): number;
+  feature_task_frames(task: number): number;
+  feature_task_features(task: number): number;
+  feature_task_stride(task: number): number;
+  feature_task_destroy(task: number): void;
+  feature_cache_configure(budget_bytes: number): void;
+  feature_cache_clear(): void;
+  feature_cache_hits(): number;
+  feature_cache_misses(): number;
+  feature_cache_bytes(): number;
+  cancel_control(): number;
+  scratch_alloc(size: number): number;
+  scratch_reset(): void;
   malloc(size: number): number;
   free(ptr: number): void;
   HEAPF64: Float64Array;
+  HEAPF32: Float32Array;
+  HEAPU8: Uint8Array;
   HEAP8: Int8Array;
+  AudioProcessor: new () => AudioProcessorInstance;
 }
 
 declare global {
@@ -0,0 +1,339 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <vector>
+
+// Memory management shared by the engine modules.
+//
+// ScratchArena is a bump allocator for everything that only lives for the
+// duration of one analysis call (frame buffers, spectra, cost matrices,
+// delta/psi tables). Blocks are kept between analyses, so once the arena has
+// warmed up the hot path does not touch the general-purpose heap at all.
+//
+// ObjectPool is a size-class free-list allocator for long-lived engine state
+// (model matrices, cached windows and filter banks) so that objects created
+// and destroyed over a long session reuse the same slabs instead of
+// fragmenting the heap.
+
+constexpr size_t kArenaAlignment = 16;
+
+inline size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+class ScratchArena {
+public:
+    struct Marker {
+        size_t block;
+        size_t offset;
+    };
+
+    explicit ScratchArena(size_t blockSize = 1 << 20)
+        : blockSize(blockSize), current(0), offset(0), used(0), highWater(0) {}
+
+    ~ScratchArena() {
+        for (Block& block : blocks) {
+            std::free(block.data);
+        }
+    }
+
+    ScratchArena(const ScratchArena&) = delete;
+    ScratchArena& operator=(const ScratchArena&) = delete;
+
+    void* allocate(size_t bytes, size_t alignment = kArenaAlignment) {
+        if (bytes == 0) bytes = 1;
+
+        while (current < blocks.size()) {
+            Block& block = blocks[current];
+            uintptr_t base = reinterpret_cast<uintptr_t>(block.data);
+            size_t start = alignUp(base + offset, alignment) - base;
+            if (start + bytes <= block.size) {
+                used += start + bytes - offset;
+                offset = start + bytes;
+                if (used > highWater) highWater = used;
+                return block.data + start;
+            }
+            // Skip the tail of this block; it is reclaimed on rewind/reset
+            used += block.size - offset;
+            current++;
+            offset = 0;
+        }
+
+        size_t size = alignUp(bytes + alignment, blockSize);
+        addBlock(size);
+        return allocate(bytes, alignment);
+    }
+
+    template <typename T>
+    T* allocateArray(size_t count) {
+        return static_cast<T*>(allocate(count * sizeof(T), alignof(T) > kArenaAlignment ? alignof(T) : kArenaAlignment));
+    }
+
+    Marker mark() const {
+        return {current, offset};
+    }
+
+    void rewind(Marker marker) {
+        current = marker.block;
+        offset = marker.offset;
+        used = 0;
+        for (size_t i = 0; i < current; i++) {
+            used += blocks[i].size;
+        }
+        used += offset;
+    }
+
+    // Drop all allocations. If the last analysis spilled into several blocks,
+    // they are merged into a single block sized to the high-water mark so the
+    // steady state is one contiguous region.
+    void reset() {
+        if (blocks.size() > 1) {
+            size_t total = alignUp(highWater, blockSize);
+            for (Block& block : blocks) {
+                std::free(block.data);
+            }
+            blocks.clear();
+            addBlock(total);
+        }
+        current = 0;
+        offset = 0;
+        used = 0;
+    }
+
+    // Make sure the next `bytes` of allocations fit in the current block, so
+    // a planned workspace is obtained with at most one heap allocation.
+    void reserve(size_t bytes) {
+        if (current < blocks.size() && blocks[current].size - offset >= bytes) {
+            return;
+        }
+
+        size_t size = alignUp(bytes + kArenaAlignment, blockSize);
+        if (used == 0) {
+            for (Block& block : blocks) {
+                std::free(block.data);
+            }
+            blocks.clear();
+            addBlock(size);
+            current = 0;
+            offset = 0;
+            return;
+        }
+
+        uint8_t* data = static_cast<uint8_t*>(std::malloc(size));
+        if (!data) {
+            throw std::bad_alloc();
+        }
+        if (current < blocks.size()) {
+            used += blocks[current].size - offset;
+            current++;
+        }
+        blocks.insert(blocks.begin() + current, Block{data, size});
+        offset = 0;
+    }
+
+    size_t bytesUsed() const { return used; }
+    size_t peakBytes() const { return highWater; }
+
+    size_t capacity() const {
+        size_t total = 0;
+        for (const Block& block : blocks) {
+            total += block.size;
+        }
+        return total;
+    }
+
+private:
+    struct Block {
+        uint8_t* data;
+        size_t size;
+    };
+
+    void addBlock(size_t size) {
+        uint8_t* data = static_cast<uint8_t*>(std::malloc(size));
+        if (!data) {
+            throw std::bad_alloc();
+        }
+        blocks.push_back({data, size});
+    }
+
+    std::vector<Block> blocks;
+    size_t blockSize;
+    size_t current;
+    size_t offset;
+    size_t used;
+    size_t highWater;
+};
+
+// Rewinds the arena to where it was when the scope was opened.
+class ArenaScope {
+public:
+    explicit ArenaScope(ScratchArena& arena) : arena(arena), marker(arena.mark()) {}
+    ~ArenaScope() { arena.rewind(marker); }
+
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+
+private:
+    ScratchArena& arena;
+    ScratchArena::Marker marker;
+};
+
+// Per-thread arena used for one analysis at a time.
+inline ScratchArena& analysisArena() {
+    thread_local ScratchArena arena;
+    return arena;
+}
+
+// STL adapter; deallocation is a no-op, memory comes back on rewind/reset.
+template <typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    ArenaAllocator() : arena(&analysisArena()) {}
+    explicit ArenaAllocator(ScratchArena& arena) : arena(&arena) {}
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(size_t count) {
+        return arena->allocateArray<T>(count);
+    }
+
+    void deallocate(T*, size_t) {}
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+
+private:
+    template <typename U>
+    friend class ArenaAllocator;
+
+    ScratchArena* arena;
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+class ObjectPool {
+public:
+    static constexpr size_t kMinClassSize = 16;
+    static constexpr size_t kNumClasses = 9; // 16 B .. 4 KiB
+    static constexpr size_t kSlabSize = 64 * 1024;
+
+    ObjectPool() {
+        for (size_t i = 0; i < kNumClasses; i++) {
+            freeLists[i] = nullptr;
+        }
+    }
+
+    ~ObjectPool() {
+        for (void* slab : slabs) {
+            std::free(slab);
+        }
+    }
+
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    void* allocate(size_t bytes) {
+        int sizeClass = classFor(bytes);
+        if (sizeClass < 0) {
+            void* large = std::malloc(bytes);
+            if (!large) throw std::bad_alloc();
+            return large;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!freeLists[sizeClass]) {
+            refill(sizeClass);
+        }
+        FreeNode* node = freeLists[sizeClass];
+        freeLists[sizeClass] = node->next;
+        return node;
+    }
+
+    void deallocate(void* ptr, size_t bytes) {
+        if (!ptr) return;
+        int sizeClass = classFor(bytes);
+        if (sizeClass < 0) {
+            std::free(ptr);
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        FreeNode* node = static_cast<FreeNode*>(ptr);
+        node->next = freeLists[sizeClass];
+        freeLists[sizeClass] = node;
+    }
+
+private:
+    struct FreeNode {
+        FreeNode* next;
+    };
+
+    static int classFor(size_t bytes) {
+        size_t size = kMinClassSize;
+        for (size_t i = 0; i < kNumClasses; i++, size <<= 1) {
+            if (bytes <= size) return static_cast<int>(i);
+        }
+        return -1;
+    }
+
+    void refill(int sizeClass) {
+        size_t size = kMinClassSize << sizeClass;
+        uint8_t* slab = static_cast<uint8_t*>(std::malloc(kSlabSize));
+        if (!slab) throw std::bad_alloc();
+        slabs.push_back(slab);
+
+        for (size_t offset = 0; offset + size <= kSlabSize; offset += size) {
+            FreeNode* node = reinterpret_cast<FreeNode*>(slab + offset);
+            node->next = freeLists[sizeClass];
+            freeLists[sizeClass] = node;
+        }
+    }
+
+    FreeNode* freeLists[kNumClasses];
+    std::vector<void*> slabs;
+    std::mutex mutex;
+};
+
+inline ObjectPool& enginePool() {
+    static ObjectPool pool;
+    return pool;
+}
+
+template <typename T>
+class PoolAllocator {
+public:
+    using value_type = T;
+
+    PoolAllocator() = default;
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>&) {}
+
+    T* allocate(size_t count) {
+        return static_cast<T*>(enginePool().allocate(count * sizeof(T)));
+    }
+
+    void deallocate(T* ptr, size_t count) {
+        enginePool().deallocate(ptr, count * sizeof(T));
+    }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U>&) const { return true; }
+
+    template <typename U>
+    bool operator!=(const PoolAllocator<U>&) const { return false; }
+};
+
+template <typename T>
+using PoolVector = std::vector<T, PoolAllocator<T>>;
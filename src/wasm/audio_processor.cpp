@@ -1,313 +1,631 @@
 #include <vector>
-#include <cmath>
 #include <algorithm>
-#include <complex>
 #include <emscripten/emscripten.h>
 #include <emscripten/bind.h>
+#include "audio_processor.h"
+#include "cancellation.h"
+#include "feature_cache.h"
+#include "nasal.h"
+#include "onset.h"
+#include "peak_pyramid.h"
+#include "qalqalah.h"
+#include "ring_buffer.h"
+#include "streaming_extractor.h"
 
 using namespace emscripten;
 
-const double PI = 3.14159265358979323846;
+// One processor per module so runtime-planned tables survive between calls
+static AudioProcessor& sharedProcessor() {
+    static AudioProcessor processor;
+    return processor;
+}
 
-class AudioProcessor {
-private:
-    std::vector<double> hammingWindow(int size) {
-        std::vector<double> window(size);
-        for (int i = 0; i < size; i++) {
-            window[i] = 0.54 - 0.46 * std::cos(2.0 * PI * i / (size - 1));
-        }
-        return window;
+// Features of recent recordings, so re-analysing one skips the front end
+static FeatureCache& featureCache() {
+    static FeatureCache cache;
+    return cache;
+}
+
+// A feature task and the cache entry it fills when it finishes
+struct ExtractionTask {
+    FeatureKey key;
+    FeatureTask features;
+    bool cached;
+};
+
+// Emscripten bindings
+EMSCRIPTEN_BINDINGS(audio_processor_module) {
+    register_vector<double>("VectorDouble");
+    register_vector<std::vector<double>>("VectorVectorDouble");
+    
+    value_object<FeatureBuffer>("FeatureBuffer")
+        .field("data", &FeatureBuffer::data)
+        .field("rows", &FeatureBuffer::rows)
+        .field("cols", &FeatureBuffer::cols)
+        .field("stride", &FeatureBuffer::stride);
+    
+    class_<AudioProcessor>("AudioProcessor")
+        .constructor<>()
+        .function("extractMFCC", &AudioProcessor::extractMFCC)
+        .function("calculateEnergy", &AudioProcessor::calculateEnergy)
+        .function("calculateZeroCrossingRate", &AudioProcessor::calculateZeroCrossingRate)
+        .function("calculateSpectralCentroid", &AudioProcessor::calculateSpectralCentroid)
+        .function("estimatePitch", &AudioProcessor::estimatePitch)
+        .function("processAudioFrames", &AudioProcessor::processAudioFrames)
+        .function("audioInput", &AudioProcessor::audioInput)
+        .function("processInput", &AudioProcessor::processInput);
+}
+
+// C-style API
+//
+// Results are allocated from the analysis arena and stay valid until
+// scratch_reset(); callers must not free() them. Inputs can be placed in
+// the same arena with scratch_alloc() so one analysis never touches malloc;
+// reserve_audio_workspace() sizes the arena for both in a single grow.
+extern "C" {
+    EMSCRIPTEN_KEEPALIVE
+    void* scratch_alloc(int bytes) {
+        return analysisArena().allocate(bytes);
     }
     
-    std::vector<double> hannWindow(int size) {
-        std::vector<double> window(size);
-        for (int i = 0; i < size; i++) {
-            window[i] = 0.5 * (1.0 - std::cos(2.0 * PI * i / (size - 1)));
+    EMSCRIPTEN_KEEPALIVE
+    void scratch_reset() {
+        analysisArena().reset();
+    }
+    
+    // Control block polled by the long-running calls below (cancellation.h).
+    // Set the deadline (and clear the cancel flag) before a call, then read
+    // the status: anything but Complete means the result is incomplete.
+    EMSCRIPTEN_KEEPALIVE
+    CancelControl* cancel_control() {
+        return &moduleCancelControl();
+    }
+    
+    // Reserves room for data_len input samples plus one
+    // process_audio_features_ex call with `options` (and one frame's scratch
+    // on each scheduler worker) and plans the DSP tables. Returns the bytes
+    // reserved on the calling thread, or -1 when they exceed budget_bytes
+    // (0 = unlimited).
+    EMSCRIPTEN_KEEPALIVE
+    double reserve_audio_workspace(int data_len, double sample_rate, int frame_size,
+                                   int options, double budget_bytes) {
+        int numFrames = AudioProcessor::frameCount(data_len, frame_size, frame_size / 2);
+        uint32_t flags = static_cast<uint32_t>(options) & kFeatureOptions;
+        WorkspacePlan plan = planFeatureWorkspace(data_len, numFrames, frame_size, flags,
+                                                  static_cast<size_t>(std::max(0.0, budget_bytes)));
+        if (!reserveWorkspace(plan)) {
+            return -1.0;
         }
-        return window;
+        sharedProcessor().prepare(frame_size, sample_rate);
+        return static_cast<double>(plan.totalBytes());
     }
     
-    std::vector<std::complex<double>> fft(const std::vector<double>& input) {
-        int n = input.size();
-        std::vector<std::complex<double>> output(n);
-        
-        // Simple DFT implementation (not optimized)
-        for (int k = 0; k < n; k++) {
-            std::complex<double> sum = 0.0;
-            for (int j = 0; j < n; j++) {
-                double angle = -2.0 * PI * k * j / n;
-                sum += input[j] * std::complex<double>(std::cos(angle), std::sin(angle));
+    // Features of every frame_size / 2 hop, as dense rows so JS can index
+    // frame * columns + feature: the 17 base columns, then the optional ones
+    // selected by `options` (kFeatureFormants = 1 appends F1-F3 in Hz).
+    // kFeatureDenoise = 2 suppresses the noise learned from the recording's
+    // quietest frames before the mel stage, and kFeatureLoudness = 4
+    // normalises the recording's loudness first; neither adds a column.
+    EMSCRIPTEN_KEEPALIVE
+    double* process_audio_features_ex(double* audio_data, int data_len, 
+                                      double sample_rate, int frame_size, int options) {
+        int hopSize = frame_size / 2;
+        int numFrames = AudioProcessor::frameCount(data_len, frame_size, hopSize);
+        uint32_t flags = static_cast<uint32_t>(options) & kFeatureOptions;
+        int columns = featureColumns(flags);
+        
+        // Result first, so the scratch scope below can be rewound past it
+        // Zeroed, so frames skipped by a cancelled run read as silence
+        double* result = analysisArena().allocateArray<double>(static_cast<size_t>(numFrames) * columns);
+        std::fill(result, result + static_cast<size_t>(numFrames) * columns, 0.0);
+        
+        CancelScope cancel(moduleCancelControl());
+        MutableFeatureView features(result, numFrames, columns);
+        FeatureKey key = featureKey(audio_data, data_len, sample_rate, frame_size, hopSize, flags);
+        if (const FeatureMatrix* cached = featureCache().find(key)) {
+            for (int i = 0; i < numFrames; i++) {
+                std::copy(cached->row(i), cached->row(i) + columns, features.row(i));
             }
-            output[k] = sum;
+            return result;
         }
         
-        return output;
+        {
+            ArenaScope scope(analysisArena());
+            sharedProcessor().processAudioFramesInto(audio_data, data_len, sample_rate,
+                                                     frame_size, hopSize, features, flags);
+        }
+        // A stopped run holds silence for the frames it skipped
+        if (cancel.status() == RunStatus::Complete) {
+            featureCache().insert(key, features);
+        }
+        return result;
     }
     
-    std::vector<double> getMagnitudeSpectrum(const std::vector<std::complex<double>>& fft_result) {
-        std::vector<double> magnitude(fft_result.size() / 2);
-        for (size_t i = 0; i < magnitude.size(); i++) {
-            magnitude[i] = std::abs(fft_result[i]);
-        }
-        return magnitude;
+    EMSCRIPTEN_KEEPALIVE
+    double* process_audio_features(double* audio_data, int data_len, 
+                                  double sample_rate, int frame_size) {
+        return process_audio_features_ex(audio_data, data_len, sample_rate, frame_size, 0);
     }
     
-    double hzToMel(double hz) {
-        return 2595.0 * std::log10(1.0 + hz / 700.0);
+    // Feature cache (feature_cache.h). process_audio_features and feature
+    // tasks look recordings up by content; budget_bytes 0 turns caching off.
+    EMSCRIPTEN_KEEPALIVE
+    void feature_cache_configure(double budget_bytes) {
+        featureCache().setCapacity(static_cast<size_t>(std::max(0.0, budget_bytes)));
     }
     
-    double melToHz(double mel) {
-        return 700.0 * (std::pow(10.0, mel / 2595.0) - 1.0);
+    EMSCRIPTEN_KEEPALIVE
+    void feature_cache_clear() {
+        featureCache().clear();
     }
     
-    std::vector<std::vector<double>> createMelFilterBank(int nFilters, int nFFT, double sampleRate) {
-        double nyquist = sampleRate / 2.0;
-        double melMin = hzToMel(0);
-        double melMax = hzToMel(nyquist);
-        
-        std::vector<double> melPoints(nFilters + 2);
-        for (int i = 0; i < nFilters + 2; i++) {
-            melPoints[i] = melMin + (melMax - melMin) * i / (nFilters + 1);
-        }
-        
-        std::vector<double> hzPoints(nFilters + 2);
-        for (int i = 0; i < nFilters + 2; i++) {
-            hzPoints[i] = melToHz(melPoints[i]);
-        }
-        
-        std::vector<int> binPoints(nFilters + 2);
-        for (int i = 0; i < nFilters + 2; i++) {
-            binPoints[i] = static_cast<int>(hzPoints[i] * nFFT / sampleRate);
-        }
-        
-        std::vector<std::vector<double>> filterBank(nFilters, std::vector<double>(nFFT / 2, 0.0));
-        
-        for (int i = 1; i <= nFilters; i++) {
-            for (int j = binPoints[i - 1]; j < binPoints[i]; j++) {
-                if (j < nFFT / 2) {
-                    filterBank[i - 1][j] = static_cast<double>(j - binPoints[i - 1]) / 
-                                          (binPoints[i] - binPoints[i - 1]);
-                }
-            }
-            
-            for (int j = binPoints[i]; j < binPoints[i + 1]; j++) {
-                if (j < nFFT / 2) {
-                    filterBank[i - 1][j] = static_cast<double>(binPoints[i + 1] - j) / 
-                                          (binPoints[i + 1] - binPoints[i]);
-                }
-            }
-        }
-        
-        return filterBank;
+    EMSCRIPTEN_KEEPALIVE
+    double feature_cache_hits() {
+        return static_cast<double>(featureCache().hitCount());
     }
     
-    std::vector<double> dct(const std::vector<double>& input) {
-        int n = input.size();
-        std::vector<double> output(n);
-        
-        for (int k = 0; k < n; k++) {
-            double sum = 0.0;
-            for (int j = 0; j < n; j++) {
-                sum += input[j] * std::cos(PI * k * (j + 0.5) / n);
-            }
-            output[k] = sum;
-        }
-        
-        return output;
+    EMSCRIPTEN_KEEPALIVE
+    double feature_cache_misses() {
+        return static_cast<double>(featureCache().missCount());
     }
     
-public:
-    std::vector<double> extractMFCC(const std::vector<double>& audioFrame, 
-                                   double sampleRate, int nCoeffs = 13) {
-        int frameSize = audioFrame.size();
-        
-        // Apply window
-        std::vector<double> window = hammingWindow(frameSize);
-        std::vector<double> windowedFrame(frameSize);
-        for (int i = 0; i < frameSize; i++) {
-            windowedFrame[i] = audioFrame[i] * window[i];
-        }
-        
-        // FFT
-        std::vector<std::complex<double>> fftResult = fft(windowedFrame);
-        std::vector<double> spectrum = getMagnitudeSpectrum(fftResult);
-        
-        // Mel filter bank
-        int nFilters = 26;
-        std::vector<std::vector<double>> filterBank = createMelFilterBank(nFilters, frameSize, sampleRate);
-        
-        // Apply filters
-        std::vector<double> filterEnergies(nFilters);
-        for (int i = 0; i < nFilters; i++) {
-            double energy = 0.0;
-            for (size_t j = 0; j < spectrum.size(); j++) {
-                energy += spectrum[j] * filterBank[i][j];
-            }
-            filterEnergies[i] = std::log(std::max(energy, 1e-10));
-        }
-        
-        // DCT
-        std::vector<double> mfcc = dct(filterEnergies);
+    EMSCRIPTEN_KEEPALIVE
+    double feature_cache_bytes() {
+        return static_cast<double>(featureCache().bytes());
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    double* extract_mfcc(double* spectrum, int spectrum_len, 
+                        double sample_rate, int num_coeffs) {
+        double* result = analysisArena().allocateArray<double>(num_coeffs);
         
-        // Return first n coefficients
-        std::vector<double> result(nCoeffs);
-        for (int i = 0; i < nCoeffs && i < static_cast<int>(mfcc.size()); i++) {
-            result[i] = mfcc[i];
-        }
+        ArenaScope scope(analysisArena());
+        sharedProcessor().extractMFCCInto(spectrum, spectrum_len, sample_rate, num_coeffs, result);
         
         return result;
     }
     
-    double calculateEnergy(const std::vector<double>& audioFrame) {
-        double sum = 0.0;
-        for (double sample : audioFrame) {
-            sum += sample * sample;
+    // Live capture. A sample ring (ring_buffer.h) is formatted in 16-byte
+    // aligned memory the caller provides. With the pthreads build that is a
+    // malloc()ed block of the shared heap: the AudioWorklet writes samples
+    // into it with Atomics, and a stream drains them in place, with no
+    // messages and no copies through JS.
+    EMSCRIPTEN_KEEPALIVE
+    int ring_buffer_bytes(int capacity) {
+        return static_cast<int>(SampleRing::bytesFor(capacity));
+    }
+    
+    // Returns the capacity in samples (rounded up to a power of two), or 0
+    EMSCRIPTEN_KEEPALIVE
+    int ring_buffer_init(void* memory, int capacity) {
+        return SampleRing::create(memory, capacity).capacity();
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    int ring_buffer_write(void* ring, const float* samples, int count) {
+        return SampleRing::attach(ring).write(samples, count);
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    int ring_buffer_read(void* ring, float* out, int count) {
+        return SampleRing::attach(ring).read(out, count);
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    int ring_buffer_readable(void* ring) {
+        return SampleRing::attach(ring).readable();
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    int ring_buffer_writable(void* ring) {
+        return SampleRing::attach(ring).writable();
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    double ring_buffer_overruns(void* ring) {
+        return SampleRing::attach(ring).overruns();
+    }
+    
+    // Streaming feature extraction with the offline frame layout. Rows are
+    // float32, stream_feature_stride() apart, and stay valid until
+    // stream_clear(). Returns nullptr for unusable configurations.
+    EMSCRIPTEN_KEEPALIVE
+    StreamingFeatureExtractor* stream_create(double sample_rate, int frame_size, int hop_size,
+                                             int max_frames) {
+        StreamingFeatureExtractor* stream = new StreamingFeatureExtractor();
+        if (!stream->configure(sample_rate, frame_size, hop_size, max_frames)) {
+            delete stream;
+            return nullptr;
         }
-        return std::sqrt(sum / audioFrame.size());
+        return stream;
     }
     
-    double calculateZeroCrossingRate(const std::vector<double>& audioFrame) {
-        int crossings = 0;
-        for (size_t i = 1; i < audioFrame.size(); i++) {
-            if ((audioFrame[i] >= 0) != (audioFrame[i - 1] >= 0)) {
-                crossings++;
-            }
+    EMSCRIPTEN_KEEPALIVE
+    void stream_destroy(StreamingFeatureExtractor* stream) {
+        delete stream;
+    }
+    
+    // Both return the number of frames completed by the call
+    EMSCRIPTEN_KEEPALIVE
+    int stream_push(StreamingFeatureExtractor* stream, const float* samples, int count) {
+        return stream ? stream->push(samples, count) : 0;
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    int stream_drain(StreamingFeatureExtractor* stream, void* ring) {
+        SampleRing samples = SampleRing::attach(ring);
+        return stream ? stream->drain(samples) : 0;
+    }
+    
+    // Call when capture stops, after the last push/drain: completes the
+    // frames held back by loudness normalisation. stream_reset() before the
+    // stream takes samples again.
+    EMSCRIPTEN_KEEPALIVE
+    int stream_finish(StreamingFeatureExtractor* stream) {
+        return stream ? stream->finish() : 0;
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    int stream_frame_count(StreamingFeatureExtractor* stream) {
+        return stream ? stream->frameCount() : 0;
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    const float* stream_features(StreamingFeatureExtractor* stream) {
+        return stream ? stream->data() : nullptr;
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    int stream_feature_stride(StreamingFeatureExtractor* stream) {
+        return stream ? stream->stride() : 0;
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    void stream_clear(StreamingFeatureExtractor* stream) {
+        if (stream) stream->clearFrames();
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    void stream_reset(StreamingFeatureExtractor* stream) {
+        if (stream) stream->reset();
+    }
+    
+    // Frames lost because stream_clear() was not called in time
+    EMSCRIPTEN_KEEPALIVE
+    double stream_dropped(StreamingFeatureExtractor* stream) {
+        return stream ? static_cast<double>(stream->framesDropped()) : 0.0;
+    }
+    
+    // Waveform peak pyramid (PeakPyramid). Bins are three int16 values
+    // (min, max, rms), peak_pyramid_bins() of them at peak_pyramid_data();
+    // the pointer stays valid while the pyramid is within expected_samples.
+    // A pyramid attached to a stream is fed by stream_push/stream_drain and
+    // must outlive the attachment.
+    EMSCRIPTEN_KEEPALIVE
+    PeakPyramid* peak_pyramid_create(double expected_samples) {
+        return new PeakPyramid(static_cast<int64_t>(expected_samples));
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    void peak_pyramid_destroy(PeakPyramid* pyramid) {
+        delete pyramid;
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    void peak_pyramid_append(PeakPyramid* pyramid, const float* samples, int count) {
+        if (pyramid) pyramid->append(samples, count);
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    void peak_pyramid_clear(PeakPyramid* pyramid) {
+        if (pyramid) pyramid->clear();
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    int peak_pyramid_levels(PeakPyramid* pyramid) {
+        return pyramid ? pyramid->levels() : 0;
+    }
+    
+    // The level to draw at `samples_per_pixel`
+    EMSCRIPTEN_KEEPALIVE
+    int peak_pyramid_level_for(PeakPyramid* pyramid, double samples_per_pixel) {
+        return pyramid ? pyramid->levelFor(samples_per_pixel) : 0;
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    int peak_pyramid_bin_samples(int level) {
+        return level >= 0 && level < kMaxPeakLevels ? static_cast<int>(PeakPyramid::binSamples(level)) : 0;
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    int peak_pyramid_bins(PeakPyramid* pyramid, int level) {
+        return pyramid ? pyramid->bins(level) : 0;
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    const PeakBin* peak_pyramid_data(PeakPyramid* pyramid, int level) {
+        return pyramid ? pyramid->data(level) : nullptr;
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    double peak_pyramid_samples(PeakPyramid* pyramid) {
+        return pyramid ? static_cast<double>(pyramid->samples()) : 0.0;
+    }
+    
+    // Null detaches
+    EMSCRIPTEN_KEEPALIVE
+    void stream_attach_peaks(StreamingFeatureExtractor* stream, PeakPyramid* pyramid) {
+        if (stream) stream->attachPeaks(pyramid);
+    }
+    
+    // Nasal murmur (ghunnah) scoring of the stream's frames (NasalDetector).
+    // Enable right after stream_create; scores are one float32 per feature
+    // row and share the rows' lifetime. Segments (NasalSegment, 24 bytes)
+    // accumulate until stream_reset().
+    EMSCRIPTEN_KEEPALIVE
+    int stream_enable_nasality(StreamingFeatureExtractor* stream) {
+        return stream && stream->enableNasality() ? 1 : 0;
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    const float* stream_nasal_scores(StreamingFeatureExtractor* stream) {
+        return stream ? stream->nasality().scores() : nullptr;
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    int stream_nasal_segment_count(StreamingFeatureExtractor* stream) {
+        return stream ? stream->nasality().segmentCount() : 0;
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    const NasalSegment* stream_nasal_segments(StreamingFeatureExtractor* stream) {
+        return stream ? stream->nasality().segments() : nullptr;
+    }
+    
+    // Qalqalah release bursts in the stream (QalqalahDetector), 16 bytes
+    // each, sample positions from the start of the stream. They accumulate
+    // until stream_reset().
+    EMSCRIPTEN_KEEPALIVE
+    int stream_enable_qalqalah(StreamingFeatureExtractor* stream) {
+        return stream && stream->enableQalqalah() ? 1 : 0;
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    int stream_qalqalah_count(StreamingFeatureExtractor* stream) {
+        return stream ? stream->qalqalah().burstCount() : 0;
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    const QalqalahBurst* stream_qalqalah_bursts(StreamingFeatureExtractor* stream) {
+        return stream ? stream->qalqalah().bursts() : nullptr;
+    }
+    
+    // Onsets and syllable nuclei of the stream (OnsetDetector), 16 bytes
+    // each, in the order they are confirmed; they accumulate until
+    // stream_reset().
+    EMSCRIPTEN_KEEPALIVE
+    int stream_enable_landmarks(StreamingFeatureExtractor* stream) {
+        return stream && stream->enableLandmarks() ? 1 : 0;
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    int stream_landmark_count(StreamingFeatureExtractor* stream) {
+        return stream ? stream->landmarks().landmarkCount() : 0;
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    const SpeechLandmark* stream_landmarks(StreamingFeatureExtractor* stream) {
+        return stream ? stream->landmarks().landmarks() : nullptr;
+    }
+    
+    // Noise suppression for the stream's MFCCs and landmarks from now on;
+    // the profile is relearned after stream_reset()
+    EMSCRIPTEN_KEEPALIVE
+    int stream_enable_noise_suppression(StreamingFeatureExtractor* stream) {
+        return stream && stream->enableNoiseSuppression() ? 1 : 0;
+    }
+    
+    // Loudness normalisation (LoudnessNormalizer) ahead of the stream's
+    // framing; enable right after stream_create. Frames complete up to two
+    // loudness blocks (0.2 s) later than without it.
+    EMSCRIPTEN_KEEPALIVE
+    int stream_enable_loudness(StreamingFeatureExtractor* stream) {
+        return stream && stream->enableLoudness() ? 1 : 0;
+    }
+    
+    // Short-term loudness (LUFS) and the gain applied, dB
+    EMSCRIPTEN_KEEPALIVE
+    double stream_loudness_lufs(StreamingFeatureExtractor* stream) {
+        return stream ? stream->loudness().shortTermLufs() : 0.0;
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    double stream_loudness_gain_db(StreamingFeatureExtractor* stream) {
+        return stream ? stream->loudness().gainDb() : 0.0;
+    }
+    
+    // Nasal scores and segments of a whole recording, frames as in
+    // process_audio_features with the given hop. Returns nullptr for
+    // unusable configurations.
+    EMSCRIPTEN_KEEPALIVE
+    NasalDetector* nasal_analyze(double* audio_data, int data_len, double sample_rate, int frame_size,
+                                 int hop_size) {
+        int frames = AudioProcessor::frameCount(data_len, frame_size, hop_size);
+        NasalDetector* detector = new NasalDetector();
+        if (!detector->configure({sample_rate, frame_size, hop_size}, std::max(1, frames))) {
+            delete detector;
+            return nullptr;
+        }
+        for (int f = 0; f < frames; f++) {
+            detector->push(audio_data + static_cast<size_t>(f) * hop_size);
         }
-        return static_cast<double>(crossings) / audioFrame.size();
+        detector->finish();
+        return detector;
     }
     
-    double calculateSpectralCentroid(const std::vector<double>& audioFrame, double sampleRate) {
-        std::vector<std::complex<double>> fftResult = fft(audioFrame);
-        std::vector<double> spectrum = getMagnitudeSpectrum(fftResult);
-        
-        double numerator = 0.0;
-        double denominator = 0.0;
-        
-        for (size_t i = 0; i < spectrum.size(); i++) {
-            double frequency = i * sampleRate / (2.0 * spectrum.size());
-            numerator += frequency * spectrum[i];
-            denominator += spectrum[i];
+    EMSCRIPTEN_KEEPALIVE
+    int nasal_frame_count(NasalDetector* detector) {
+        return detector ? detector->scoreCount() : 0;
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    const float* nasal_scores(NasalDetector* detector) {
+        return detector ? detector->scores() : nullptr;
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    int nasal_segment_count(NasalDetector* detector) {
+        return detector ? detector->segmentCount() : 0;
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    const NasalSegment* nasal_segments(NasalDetector* detector) {
+        return detector ? detector->segments() : nullptr;
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    void nasal_destroy(NasalDetector* detector) {
+        delete detector;
+    }
+    
+    // Qalqalah bursts of a whole recording, in one pass over the samples.
+    // Returns nullptr for unusable sample rates.
+    EMSCRIPTEN_KEEPALIVE
+    QalqalahDetector* qalqalah_analyze(double* audio_data, int data_len, double sample_rate) {
+        QalqalahDetector* detector = new QalqalahDetector();
+        if (!detector->configure(sample_rate)) {
+            delete detector;
+            return nullptr;
         }
-        
-        return denominator > 0 ? numerator / denominator : 0.0;
+        detector->push(audio_data, data_len);
+        detector->finish();
+        return detector;
     }
     
-    double estimatePitch(const std::vector<double>& audioFrame, double sampleRate) {
-        // Autocorrelation-based pitch estimation
-        int frameSize = audioFrame.size();
-        std::vector<double> autocorr(frameSize);
-        
-        for (int lag = 0; lag < frameSize; lag++) {
-            double sum = 0.0;
-            for (int i = 0; i < frameSize - lag; i++) {
-                sum += audioFrame[i] * audioFrame[i + lag];
-            }
-            autocorr[lag] = sum;
+    EMSCRIPTEN_KEEPALIVE
+    int qalqalah_count(QalqalahDetector* detector) {
+        return detector ? detector->burstCount() : 0;
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    const QalqalahBurst* qalqalah_bursts(QalqalahDetector* detector) {
+        return detector ? detector->bursts() : nullptr;
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    void qalqalah_destroy(QalqalahDetector* detector) {
+        delete detector;
+    }
+    
+    // Onsets and syllable nuclei of a whole recording, sorted by frame, on
+    // the frames of process_audio_features. Only the spectrum and mel stage
+    // run, spread over the scheduler; the detector then reads the frames in
+    // order. Returns nullptr for unusable configurations.
+    EMSCRIPTEN_KEEPALIVE
+    OnsetDetector* landmarks_analyze(double* audio_data, int data_len, double sample_rate, int frame_size) {
+        int hopSize = frame_size / 2;
+        OnsetDetector* detector = new OnsetDetector();
+        if (hopSize <= 0 || !detector->configure(sample_rate / hopSize, kMelFilters)) {
+            delete detector;
+            return nullptr;
         }
         
-        // Find peak in autocorrelation (excluding lag 0)
-        int minPeriod = static_cast<int>(sampleRate / 800.0); // 800 Hz max
-        int maxPeriod = static_cast<int>(sampleRate / 80.0);  // 80 Hz min
-        
-        double maxCorr = 0.0;
-        int bestPeriod = 0;
-        
-        for (int period = minPeriod; period <= maxPeriod && period < frameSize; period++) {
-            if (autocorr[period] > maxCorr) {
-                maxCorr = autocorr[period];
-                bestPeriod = period;
+        ScratchArena& arena = analysisArena();
+        ArenaScope scope(arena);
+        int numFrames = AudioProcessor::frameCount(data_len, frame_size, hopSize);
+        // The rows here, then one frame's spectrum on this thread and on
+        // every worker, so the loop below does not grow any arena
+        arena.reserve(arenaBytes(static_cast<size_t>(numFrames) * kMelFilters, sizeof(double)) +
+                      arenaBytes(numFrames, sizeof(double)) + frameScratchBytes(frame_size));
+        reserveWorkerArenas(frameScratchBytes(frame_size));
+        double* logMel = arena.allocateArray<double>(static_cast<size_t>(numFrames) * kMelFilters);
+        double* energy = arena.allocateArray<double>(numFrames);
+        AudioProcessor& processor = sharedProcessor();
+        processor.prepare(frame_size, sample_rate);
+        parallelFor(0, numFrames, kFramesPerTask, [&](int f) {
+            const double* frame = audio_data + static_cast<size_t>(f) * hopSize;
+            processor.logMelInto(frame, frame_size, sample_rate, logMel + static_cast<size_t>(f) * kMelFilters);
+            double sum = 0.0;
+            for (int i = 0; i < frame_size; i++) {
+                sum += frame[i] * frame[i];
             }
+            energy[f] = std::sqrt(sum / frame_size);
+        });
+        for (int f = 0; f < numFrames; f++) {
+            detector->push(logMel + static_cast<size_t>(f) * kMelFilters, energy[f]);
         }
-        
-        return bestPeriod > 0 ? sampleRate / bestPeriod : 0.0;
+        detector->finish();
+        return detector;
     }
     
-    std::vector<std::vector<double>> processAudioFrames(const std::vector<double>& audioData,
-                                                       double sampleRate, int frameSize, int hopSize) {
-        std::vector<std::vector<double>> features;
-        
-        for (int i = 0; i <= static_cast<int>(audioData.size()) - frameSize; i += hopSize) {
-            std::vector<double> frame(frameSize);
-            for (int j = 0; j < frameSize; j++) {
-                frame[j] = audioData[i + j];
-            }
-            
-            // Extract features for this frame
-            std::vector<double> mfcc = extractMFCC(frame, sampleRate);
-            double energy = calculateEnergy(frame);
-            double zcr = calculateZeroCrossingRate(frame);
-            double spectralCentroid = calculateSpectralCentroid(frame, sampleRate);
-            double pitch = estimatePitch(frame, sampleRate);
-            
-            // Combine features
-            std::vector<double> frameFeatures;
-            frameFeatures.insert(frameFeatures.end(), mfcc.begin(), mfcc.end());
-            frameFeatures.push_back(energy);
-            frameFeatures.push_back(zcr);
-            frameFeatures.push_back(spectralCentroid);
-            frameFeatures.push_back(pitch);
-            
-            features.push_back(frameFeatures);
-        }
-        
-        return features;
+    EMSCRIPTEN_KEEPALIVE
+    int landmark_count(OnsetDetector* detector) {
+        return detector ? detector->landmarkCount() : 0;
     }
-};
-
-// Emscripten bindings
-EMSCRIPTEN_BINDINGS(audio_processor_module) {
-    register_vector<double>("VectorDouble");
-    register_vector<std::vector<double>>("VectorVectorDouble");
     
-    class_<AudioProcessor>("AudioProcessor")
-        .constructor<>()
-        .function("extractMFCC", &AudioProcessor::extractMFCC)
-        .function("calculateEnergy", &AudioProcessor::calculateEnergy)
-        .function("calculateZeroCrossingRate", &AudioProcessor::calculateZeroCrossingRate)
-        .function("calculateSpectralCentroid", &AudioProcessor::calculateSpectralCentroid)
-        .function("estimatePitch", &AudioProcessor::estimatePitch)
-        .function("processAudioFrames", &AudioProcessor::processAudioFrames);
-}
-
-// C-style API
-extern "C" {
     EMSCRIPTEN_KEEPALIVE
-    double* process_audio_features(double* audio_data, int data_len, 
-                                  double sample_rate, int frame_size) {
-        AudioProcessor processor;
-        
-        std::vector<double> audioVec(audio_data, audio_data + data_len);
+    const SpeechLandmark* landmarks(OnsetDetector* detector) {
+        return detector ? detector->landmarks() : nullptr;
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    void landmarks_destroy(OnsetDetector* detector) {
+        delete detector;
+    }
+    
+    // Time-sliced extraction for the main thread (FeatureTask), with the
+    // same frames as process_audio_features_ex and the same `options`. Step
+    // with a budget in microseconds until feature_task_step() returns 1; rows
+    // are featureColumns(options) doubles, feature_task_stride() apart, valid
+    // until the task is destroyed. The audio must stay allocated until then.
+    // Audio the feature cache has seen gives a task that is already done.
+    EMSCRIPTEN_KEEPALIVE
+    ExtractionTask* feature_task_create(double* audio_data, int data_len, double sample_rate, int frame_size,
+                                        int options) {
         int hopSize = frame_size / 2;
-        
-        auto features = processor.processAudioFrames(audioVec, sample_rate, frame_size, hopSize);
-        
-        // Flatten features array
-        int totalFeatures = features.size() * (features.empty() ? 0 : features[0].size());
-        double* result = (double*)malloc(totalFeatures * sizeof(double));
-        
-        int idx = 0;
-        for (const auto& frame : features) {
-            for (double feature : frame) {
-                result[idx++] = feature;
-            }
+        uint32_t flags = static_cast<uint32_t>(options) & kFeatureOptions;
+        FeatureKey key = featureKey(audio_data, data_len, sample_rate, frame_size, hopSize, flags);
+        ExtractionTask* task = new ExtractionTask{key, FeatureTask(audio_data, data_len, sample_rate,
+                                                                   frame_size, hopSize, flags), false};
+        if (const FeatureMatrix* cached = featureCache().find(key)) {
+            task->features.complete(*cached);
+            task->cached = true;
         }
-        
-        return result;
+        return task;
     }
     
     EMSCRIPTEN_KEEPALIVE
-    double* extract_mfcc(double* spectrum, int spectrum_len, 
-                        double sample_rate, int num_coeffs) {
-        AudioProcessor processor;
-        
-        std::vector<double> audioFrame(spectrum, spectrum + spectrum_len);
-        auto mfcc = processor.extractMFCC(audioFrame, sample_rate, num_coeffs);
-        
-        double* result = (double*)malloc(mfcc.size() * sizeof(double));
-        for (size_t i = 0; i < mfcc.size(); i++) {
-            result[i] = mfcc[i];
+    int feature_task_step(ExtractionTask* task, double budget_us) {
+        if (!task || !task->features.step(budget_us)) return 0;
+        if (!task->cached) {
+            featureCache().insert(task->key, task->features.features());
+            task->cached = true;
         }
-        
-        return result;
+        return 1;
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    double feature_task_progress(ExtractionTask* task) {
+        return task ? task->features.progress() : 0.0;
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    int feature_task_frames(ExtractionTask* task) {
+        return task ? task->features.frameCount() : 0;
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    const double* feature_task_features(ExtractionTask* task) {
+        return task ? task->features.features().data() : nullptr;
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    int feature_task_stride(ExtractionTask* task) {
+        return task ? static_cast<int>(task->features.features().stride()) : 0;
     }
-}
\ No newline at end of file
+    
+    EMSCRIPTEN_KEEPALIVE
+    void feature_task_destroy(ExtractionTask* task) {
+        delete task;
+    }
+}
@@ -0,0 +1,597 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <complex>
+#include "arena.h"
+#include "cancellation.h"
+#include "dsp_tables.h"
+#include "feature_matrix.h"
+#include "loudness.h"
+#include "lpc.h"
+#include "noise_suppression.h"
+#include "scheduler.h"
+#include "time_slice.h"
+#include "workspace.h"
+
+const double PI = 3.14159265358979323846;
+
+const int kMelFilters = 26;
+const int kMFCCCoefficients = 13;
+const int kFeaturesPerFrame = kMFCCCoefficients + 4; // MFCC + energy + ZCR + centroid + pitch
+const int kFramesPerTask = 16; // frame-loop grain for the scheduler
+
+// Optional columns after the kFeaturesPerFrame base ones, selected by the
+// `options` bits of processAudioFramesInto
+const uint32_t kFeatureFormants = 1u; // F1-F3 in Hz (lpc.h), 0 when unvoiced or silent
+// Not a column: noise suppression before the mel stage (noise_suppression.h)
+const uint32_t kFeatureDenoise = 2u;
+// Not a column: loudness normalisation of the input (loudness.h)
+const uint32_t kFeatureLoudness = 4u;
+const uint32_t kFeatureOptions = kFeatureFormants | kFeatureDenoise | kFeatureLoudness;
+
+inline int featureColumns(uint32_t options) {
+    return kFeaturesPerFrame + ((options & kFeatureFormants) ? kFormantColumns : 0);
+}
+
+// planAudioWorkspace for processAudioFramesInto with `options`: rows of
+// featureColumns(options), plus for kFeatureFormants the per-frame
+// candidates held until the tracking pass. kFeatureDenoise learns its
+// profile with the frame scratch and one level per frame (learnNoiseProfile);
+// kFeatureLoudness frames a normalised copy of the whole input.
+inline WorkspacePlan planFeatureWorkspace(int dataLen, int numFrames, int frameSize, uint32_t options,
+                                          size_t budget) {
+    WorkspacePlan plan = planAudioWorkspace(dataLen, numFrames, featureColumns(options), frameSize, 0);
+    if (options & kFeatureFormants) {
+        plan.scratchBytes += arenaBytes(std::max(1, numFrames), sizeof(FormantCandidates));
+    }
+    if (options & kFeatureDenoise) {
+        plan.scratchBytes += arenaBytes(std::max(1, numFrames), sizeof(double));
+    }
+    if (options & kFeatureLoudness) {
+        plan.scratchBytes += arenaBytes(dataLen, sizeof(double));
+    }
+    plan.feasible = withinBudget(plan.totalBytes(), budget);
+    return plan;
+}
+
+class AudioProcessor {
+private:
+    // Buffers behind the typed_memory_view APIs
+    PoolVector<double> inputSamples;
+    FeatureMatrixF featureOutput;
+    
+    // Gain mask for the spectrum of logMelInto; not owned
+    NoiseSuppressor* noise = nullptr;
+    
+    // Runtime-planned tables for configurations without compile-time ones
+    // (see dsp_tables.h), rebuilt only when the frame configuration changes
+    PoolVector<double> planWindow;
+    PoolVector<double> planTwiddleCos;
+    PoolVector<double> planTwiddleSin;
+    PoolVector<int32_t> planBitReverse;
+    PoolVector<int32_t> planMelStart;
+    PoolVector<int32_t> planMelLength;
+    PoolVector<int32_t> planMelOffset;
+    PoolVector<double> planMelWeights;
+    PoolVector<double> planDCT;
+    dsp::SpectralTables runtimeTables = {};
+    
+    const dsp::SpectralTables& tablesFor(int frameSize, double sampleRate) {
+        if (const dsp::SpectralTables* tables = dsp::standardTables(frameSize, sampleRate, kMelFilters)) {
+            return *tables;
+        }
+        if (runtimeTables.fftSize == frameSize && runtimeTables.sampleRate == sampleRate) {
+            return runtimeTables;
+        }
+        
+        planWindow.resize(frameSize);
+        dsp::fillHamming(planWindow.data(), frameSize);
+        
+        // Non-power-of-two sizes use the direct DFT and need no twiddles
+        bool radix2 = dsp::isPowerOfTwo(frameSize);
+        planTwiddleCos.resize(radix2 ? frameSize / 2 : 0);
+        planTwiddleSin.resize(radix2 ? frameSize / 2 : 0);
+        planBitReverse.resize(radix2 ? frameSize : 0);
+        if (radix2) {
+            dsp::fillTwiddles(planTwiddleCos.data(), planTwiddleSin.data(), frameSize);
+            dsp::fillBitReverse(planBitReverse.data(), frameSize);
+        }
+        
+        planMelStart.resize(kMelFilters);
+        planMelLength.resize(kMelFilters);
+        planMelOffset.resize(kMelFilters);
+        planMelWeights.resize(std::max(frameSize, 1));
+        dsp::fillMelBank(planMelStart.data(), planMelLength.data(), planMelOffset.data(),
+                         planMelWeights.data(), kMelFilters, frameSize, sampleRate);
+        
+        planDCT.resize(kMelFilters * kMelFilters);
+        dsp::fillDCT(planDCT.data(), kMelFilters);
+        
+        runtimeTables = {frameSize, sampleRate, kMelFilters,
+                         planWindow.data(), planTwiddleCos.data(), planTwiddleSin.data(),
+                         radix2 ? planBitReverse.data() : nullptr,
+                         planMelStart.data(), planMelLength.data(), planMelOffset.data(),
+                         planMelWeights.data(), planDCT.data()};
+        return runtimeTables;
+    }
+    
+    std::vector<double> hannWindow(int size) {
+        std::vector<double> window(size);
+        for (int i = 0; i < size; i++) {
+            window[i] = 0.5 * (1.0 - std::cos(2.0 * PI * i / (size - 1)));
+        }
+        return window;
+    }
+    
+    // Magnitude of the first n/2 DFT bins, written to `magnitude`. Radix-2
+    // FFT with the table twiddles; other sizes fall back to a direct DFT.
+    void magnitudeSpectrum(const double* input, int n, double* magnitude,
+                           const dsp::SpectralTables& tables) {
+        if (tables.bitReverse) {
+            ScratchArena& arena = analysisArena();
+            ArenaScope scope(arena);
+            double* re = arena.allocateArray<double>(n);
+            double* im = arena.allocateArray<double>(n);
+            std::copy(input, input + n, re);
+            std::fill(im, im + n, 0.0);
+            dsp::fft(re, im, tables);
+            for (int k = 0; k < n / 2; k++) {
+                magnitude[k] = std::sqrt(re[k] * re[k] + im[k] * im[k]);
+            }
+            return;
+        }
+        
+        for (int k = 0; k < n / 2; k++) {
+            std::complex<double> sum = 0.0;
+            for (int j = 0; j < n; j++) {
+                double angle = -2.0 * PI * k * j / n;
+                sum += input[j] * std::complex<double>(std::cos(angle), std::sin(angle));
+            }
+            magnitude[k] = std::abs(sum);
+        }
+    }
+    
+    // DCT-II of the log filter energies against the precomputed basis
+    void dct(const double* input, int n, double* output, const dsp::SpectralTables& tables) {
+        for (int k = 0; k < n; k++) {
+            const double* basis = tables.dctBasis + static_cast<size_t>(k) * n;
+            double sum = 0.0;
+            for (int j = 0; j < n; j++) {
+                sum += input[j] * basis[j];
+            }
+            output[k] = sum;
+        }
+    }
+    
+    double energyOf(const double* audioFrame, int frameSize) {
+        double sum = 0.0;
+        for (int i = 0; i < frameSize; i++) {
+            sum += audioFrame[i] * audioFrame[i];
+        }
+        return std::sqrt(sum / frameSize);
+    }
+    
+    double zeroCrossingRateOf(const double* audioFrame, int frameSize) {
+        int crossings = 0;
+        for (int i = 1; i < frameSize; i++) {
+            if ((audioFrame[i] >= 0) != (audioFrame[i - 1] >= 0)) {
+                crossings++;
+            }
+        }
+        return static_cast<double>(crossings) / frameSize;
+    }
+    
+    double spectralCentroidOf(const double* audioFrame, int frameSize, double sampleRate) {
+        ArenaScope scope(analysisArena());
+        int nBins = frameSize / 2;
+        double* spectrum = analysisArena().allocateArray<double>(nBins);
+        magnitudeSpectrum(audioFrame, frameSize, spectrum, tablesFor(frameSize, sampleRate));
+        
+        double numerator = 0.0;
+        double denominator = 0.0;
+        
+        for (int i = 0; i < nBins; i++) {
+            double frequency = i * sampleRate / (2.0 * nBins);
+            numerator += frequency * spectrum[i];
+            denominator += spectrum[i];
+        }
+        
+        return denominator > 0 ? numerator / denominator : 0.0;
+    }
+    
+    double pitchOf(const double* audioFrame, int frameSize, double sampleRate) {
+        PitchSearch search = beginPitchSearch(frameSize, sampleRate);
+        continuePitchSearch(audioFrame, frameSize, search, search.lastLag - search.nextLag + 1);
+        return pitchFrom(search, sampleRate);
+    }
+    
+public:
+    // The kMelFilters log mel energies of one frame, the spectrum the MFCCs
+    // are taken from
+    void logMelInto(const double* audioFrame, int frameSize, double sampleRate, double* filterEnergies) {
+        ScratchArena& arena = analysisArena();
+        ArenaScope scope(arena);
+        int nBins = frameSize / 2;
+        
+        const dsp::SpectralTables& tables = tablesFor(frameSize, sampleRate);
+        
+        // Apply window
+        double* windowedFrame = arena.allocateArray<double>(frameSize);
+        for (int i = 0; i < frameSize; i++) {
+            windowedFrame[i] = audioFrame[i] * tables.window[i];
+        }
+        
+        // FFT
+        double* spectrum = arena.allocateArray<double>(nBins);
+        magnitudeSpectrum(windowedFrame, frameSize, spectrum, tables);
+        if (noise) noise->process(spectrum, nBins);
+        
+        // Apply the (sparse) mel filters
+        for (int i = 0; i < kMelFilters; i++) {
+            const double* bins = spectrum + tables.melStart[i];
+            const double* weights = tables.melWeights + tables.melOffset[i];
+            double energy = 0.0;
+            for (int j = 0; j < tables.melLength[i]; j++) {
+                energy += bins[j] * weights[j];
+            }
+            filterEnergies[i] = std::log(std::max(energy, 1e-10));
+        }
+    }
+    
+    // `logMel`, when given, receives the kMelFilters log mel energies too
+    void extractMFCCInto(const double* audioFrame, int frameSize, double sampleRate,
+                         int nCoeffs, double* result, double* logMel = nullptr) {
+        double energies[kMelFilters];
+        double* filterEnergies = logMel ? logMel : energies;
+        logMelInto(audioFrame, frameSize, sampleRate, filterEnergies);
+        
+        // DCT
+        double mfcc[kMelFilters];
+        dct(filterEnergies, kMelFilters, mfcc, tablesFor(frameSize, sampleRate));
+        
+        // Return first n coefficients
+        for (int i = 0; i < nCoeffs; i++) {
+            result[i] = i < kMelFilters ? mfcc[i] : 0.0;
+        }
+    }
+    
+    // Noise suppression for every frame from now on (null turns it off).
+    // A suppressor that is not frozen learns from the frames, which must then
+    // come in stream order from one thread.
+    void setNoiseSuppressor(NoiseSuppressor* suppressor) { noise = suppressor; }
+    
+    // Batch VAD: learns `suppressor`'s profile from the quietest of the
+    // numFrames frames (level within kNoiseVadDb of the quietest, at most
+    // kMaxNoiseFrames of them spread over the recording) and freezes it
+    void learnNoiseProfile(const double* audioData, int numFrames, int frameSize, int hopSize,
+                           double sampleRate, NoiseSuppressor& suppressor) {
+        ScratchArena& arena = analysisArena();
+        ArenaScope scope(arena);
+        double* levels = arena.allocateArray<double>(std::max(1, numFrames));
+        double quietest = 0.0;
+        for (int f = 0; f < numFrames; f++) {
+            double rms = energyOf(audioData + static_cast<size_t>(f) * hopSize, frameSize);
+            levels[f] = 20.0 * std::log10(std::max(rms, 1e-10));
+            quietest = f == 0 ? levels[f] : std::min(quietest, levels[f]);
+        }
+        int candidates = 0;
+        for (int f = 0; f < numFrames; f++) {
+            if (levels[f] < quietest + kNoiseVadDb) candidates++;
+        }
+        
+        const dsp::SpectralTables& tables = tablesFor(frameSize, sampleRate);
+        int nBins = frameSize / 2;
+        double* windowed = arena.allocateArray<double>(frameSize);
+        double* spectrum = arena.allocateArray<double>(nBins);
+        int every = std::max(1, candidates / kMaxNoiseFrames);
+        int seen = 0;
+        for (int f = 0; f < numFrames && suppressor.framesLearned() < kMaxNoiseFrames; f++) {
+            if (levels[f] >= quietest + kNoiseVadDb || seen++ % every != 0) continue;
+            const double* frame = audioData + static_cast<size_t>(f) * hopSize;
+            for (int i = 0; i < frameSize; i++) {
+                windowed[i] = frame[i] * tables.window[i];
+            }
+            magnitudeSpectrum(windowed, frameSize, spectrum, tables);
+            suppressor.learn(spectrum);
+        }
+        suppressor.freeze();
+    }
+    
+    // The dataLen samples kFeatureLoudness frames are read from, in one
+    // sequential pass; false (and `out` untouched) for unusable sample rates
+    static bool normalizeLoudness(const double* audioData, int dataLen, double sampleRate, double* out) {
+        LoudnessNormalizer normalizer;
+        if (!normalizer.configure(sampleRate)) return false;
+        auto store = [&](const double* span, int count) {
+            out = std::copy(span, span + count, out);
+        };
+        normalizer.process(audioData, dataLen, store);
+        normalizer.finish(store);
+        return true;
+    }
+    
+    // Plans the tables ahead of an analysis so the pool is not touched
+    // mid-run (a no-op for the compile-time configurations)
+    void prepare(int frameSize, double sampleRate) {
+        tablesFor(frameSize, sampleRate);
+    }
+    
+    static int frameCount(int dataLen, int frameSize, int hopSize) {
+        if (frameSize <= 0 || hopSize <= 0 || dataLen < frameSize) return 0;
+        return (dataLen - frameSize) / hopSize + 1;
+    }
+    
+    std::vector<double> extractMFCC(const std::vector<double>& audioFrame, 
+                                   double sampleRate, int nCoeffs = 13) {
+        std::vector<double> result(nCoeffs);
+        extractMFCCInto(audioFrame.data(), audioFrame.size(), sampleRate, nCoeffs, result.data());
+        return result;
+    }
+    
+    double calculateEnergy(const std::vector<double>& audioFrame) {
+        return energyOf(audioFrame.data(), audioFrame.size());
+    }
+    
+    double calculateZeroCrossingRate(const std::vector<double>& audioFrame) {
+        return zeroCrossingRateOf(audioFrame.data(), audioFrame.size());
+    }
+    
+    double calculateSpectralCentroid(const std::vector<double>& audioFrame, double sampleRate) {
+        return spectralCentroidOf(audioFrame.data(), audioFrame.size(), sampleRate);
+    }
+    
+    double estimatePitch(const std::vector<double>& audioFrame, double sampleRate) {
+        return pitchOf(audioFrame.data(), audioFrame.size(), sampleRate);
+    }
+    
+    // The kFeaturesPerFrame features of one frameSize-sample frame, and
+    // optionally its log mel energies. Call prepare() first when several
+    // threads share this processor.
+    void extractFrameInto(const double* frame, int frameSize, double sampleRate, double* out,
+                          double* logMel = nullptr) {
+        extractSpectralInto(frame, frameSize, sampleRate, out, logMel);
+        out[kMFCCCoefficients + 3] = pitchOf(frame, frameSize, sampleRate);
+    }
+    
+    // Autocorrelation pitch estimate, evaluated only at the lags the peak
+    // search looks at. The search can be advanced a few lags at a time so a
+    // caller with a per-call deadline can spread one frame over several
+    // calls (worklet_extractor.h); the result is the same either way.
+    struct PitchSearch {
+        int nextLag;
+        int lastLag;
+        int bestPeriod;
+        double maxCorr;
+    };
+    
+    static PitchSearch beginPitchSearch(int frameSize, double sampleRate) {
+        int minPeriod = static_cast<int>(sampleRate / 800.0); // 800 Hz max
+        int maxPeriod = static_cast<int>(sampleRate / 80.0);  // 80 Hz min
+        return {minPeriod, std::min(maxPeriod, frameSize - 1), 0, 0.0};
+    }
+    
+    // Evaluates up to `lags` more lags; true once every lag has been seen
+    static bool continuePitchSearch(const double* audioFrame, int frameSize, PitchSearch& search, int lags) {
+        int stop = std::min(search.lastLag, search.nextLag + lags - 1);
+        for (int period = search.nextLag; period <= stop; period++) {
+            double sum = 0.0;
+            for (int i = 0; i < frameSize - period; i++) {
+                sum += audioFrame[i] * audioFrame[i + period];
+            }
+            if (sum > search.maxCorr) {
+                search.maxCorr = sum;
+                search.bestPeriod = period;
+            }
+        }
+        search.nextLag = std::max(search.nextLag, stop + 1);
+        return search.nextLag > search.lastLag;
+    }
+    
+    static double pitchFrom(const PitchSearch& search, double sampleRate) {
+        return search.bestPeriod > 0 ? sampleRate / search.bestPeriod : 0.0;
+    }
+    
+    // Every column of extractFrameInto except pitch
+    void extractSpectralInto(const double* frame, int frameSize, double sampleRate, double* out,
+                             double* logMel = nullptr) {
+        extractMFCCInto(frame, frameSize, sampleRate, kMFCCCoefficients, out, logMel);
+        out[kMFCCCoefficients] = energyOf(frame, frameSize);
+        out[kMFCCCoefficients + 1] = zeroCrossingRateOf(frame, frameSize);
+        out[kMFCCCoefficients + 2] = spectralCentroidOf(frame, frameSize, sampleRate);
+    }
+    
+    // Fills one row of `features` per frame (frameCount() rows,
+    // featureColumns(options) columns, any stride, float or double). Frames
+    // are read in place from `audioData`; all scratch lives in the arena.
+    // When a CancelScope stops the run, the base columns of skipped frames
+    // are left as they were and their formants read 0. kFeatureLoudness
+    // normalises a copy of the audio first, in one sequential pass;
+    // kFeatureDenoise then learns a noise profile before the frame loop.
+    template <typename T>
+    int processAudioFramesInto(const double* audioData, int dataLen, double sampleRate,
+                               int frameSize, int hopSize, BasicMutableFeatureView<T> features,
+                               uint32_t options = 0) {
+        int numFrames = std::min(frameCount(dataLen, frameSize, hopSize), features.rows());
+        ScratchArena& arena = analysisArena();
+        ArenaScope scope(arena);
+        if ((options & kFeatureLoudness) && numFrames > 0) {
+            // Rates the normaliser refuses keep the raw samples
+            double* normalized = arena.allocateArray<double>(dataLen);
+            if (normalizeLoudness(audioData, dataLen, sampleRate, normalized)) audioData = normalized;
+        }
+        // Formant candidates are found per frame in parallel; labelling them
+        // F1-F3 follows the previous frame, so that pass runs in order after
+        FormantCandidates* candidates = nullptr;
+        if ((options & kFeatureFormants) && features.cols() >= featureColumns(kFeatureFormants)) {
+            candidates = arena.allocateArray<FormantCandidates>(std::max(1, numFrames));
+            std::fill(candidates, candidates + numFrames, FormantCandidates());
+        }
+        
+        // Frames are independent, so they are spread over the engine
+        // scheduler. Planning the tables up front leaves the workers with
+        // read-only access to this object; each uses its own arena.
+        tablesFor(frameSize, sampleRate);
+        NoiseSuppressor* attached = noise;
+        NoiseSuppressor suppressor;
+        if ((options & kFeatureDenoise) && numFrames > 0 &&
+            suppressor.configure(frameSize / 2, sampleRate / hopSize)) {
+            learnNoiseProfile(audioData, numFrames, frameSize, hopSize, sampleRate, suppressor);
+            noise = &suppressor;
+        }
+        // Workers do not inherit the caller's CancelScope, so the control is
+        // captured here and polled once per frame
+        CancelControl* cancel = currentCancelControl();
+        std::atomic<int> completed(0);
+        parallelFor(0, numFrames, kFramesPerTask, [&](int f) {
+            if (stopRequested(cancel)) return;
+            const double* frame = audioData + static_cast<size_t>(f) * hopSize;
+            double frameFeatures[kFeaturesPerFrame];
+            extractFrameInto(frame, frameSize, sampleRate, frameFeatures);
+            std::copy(frameFeatures, frameFeatures + kFeaturesPerFrame, features.row(f));
+            if (candidates) candidates[f] = formantCandidates(frame, frameSize, sampleRate);
+            completed.fetch_add(1, std::memory_order_relaxed);
+        });
+        if (numFrames > 0 && completed.load() < numFrames) {
+            reportProgress(cancel, static_cast<double>(completed.load()) / numFrames);
+        }
+        
+        if (candidates) {
+            FormantTracker tracker;
+            for (int f = 0; f < numFrames; f++) {
+                double formants[kFormantColumns];
+                tracker.track(candidates[f], formants);
+                std::copy(formants, formants + kFormantColumns, features.row(f) + kFeaturesPerFrame);
+            }
+        }
+        noise = attached;
+        return numFrames;
+    }
+    
+    template <typename T>
+    BasicFeatureMatrix<T> extractFeatures(const double* audioData, int dataLen, double sampleRate,
+                                          int frameSize, int hopSize, uint32_t options = 0) {
+        BasicFeatureMatrix<T> features(frameCount(dataLen, frameSize, hopSize), featureColumns(options));
+        processAudioFramesInto(audioData, dataLen, sampleRate, frameSize, hopSize, features.mutableView(),
+                               options);
+        return features;
+    }
+    
+#ifdef __EMSCRIPTEN__
+    // Zero-copy embind surface. JS fills the view from audioInput() with
+    // Float64Array.set(), calls processInput() and reads the returned
+    // Float32Array in one go. Both views point into this object: they are
+    // invalidated by the next audioInput()/processInput() call, by delete(),
+    // and by WASM memory growth, so slice() anything that must outlive them.
+    emscripten::val audioInput(int samples) {
+        inputSamples.resize(std::max(0, samples));
+        return emscripten::val(emscripten::typed_memory_view(inputSamples.size(), inputSamples.data()));
+    }
+    
+    FeatureBuffer processInput(double sampleRate, int frameSize, int hopSize) {
+        ArenaScope scope(analysisArena());
+        int dataLen = inputSamples.size();
+        featureOutput.resize(frameCount(dataLen, frameSize, hopSize), kFeaturesPerFrame);
+        processAudioFramesInto(inputSamples.data(), dataLen, sampleRate, frameSize, hopSize,
+                               featureOutput.mutableView());
+        
+        size_t elements = static_cast<size_t>(featureOutput.rows()) * featureOutput.stride();
+        return {emscripten::val(emscripten::typed_memory_view(elements, featureOutput.data())),
+                featureOutput.rows(), featureOutput.cols(), static_cast<int>(featureOutput.stride())};
+    }
+#endif
+    
+    std::vector<std::vector<double>> processAudioFrames(const std::vector<double>& audioData,
+                                                       double sampleRate, int frameSize, int hopSize) {
+        ScratchArena& arena = analysisArena();
+        ArenaScope scope(arena);
+        int numFrames = frameCount(audioData.size(), frameSize, hopSize);
+        MutableFeatureView features = arenaFeatures<double>(arena, numFrames, kFeaturesPerFrame);
+        processAudioFramesInto(audioData.data(), audioData.size(), sampleRate, frameSize, hopSize, features);
+        
+        return toNested<double>(features);
+    }
+};
+
+// Resumable processAudioFramesInto: step() extracts frames in order until
+// its time budget is spent. Rows go to a matrix owned by the task; the
+// audio must stay where it is until the task is done. Rows are identical to
+// the blocking call's with the same options. The loudness pass and the noise
+// profile are whole-recording steps, so they run once in the constructor.
+class FeatureTask {
+public:
+    FeatureTask(const double* audioData, int dataLen, double sampleRate, int frameSize, int hopSize,
+                uint32_t options = 0)
+        : audioData(audioData), sampleRate(sampleRate), frameSize(frameSize), hopSize(hopSize),
+          total(AudioProcessor::frameCount(dataLen, frameSize, hopSize)), options(options) {
+        output.resize(total, featureColumns(options));
+        if (total == 0) return;
+        processor.prepare(frameSize, sampleRate);
+        if (options & kFeatureLoudness) {
+            normalized.resize(dataLen);
+            if (!AudioProcessor::normalizeLoudness(audioData, dataLen, sampleRate, normalized.data())) {
+                normalized.clear(); // source() falls back to the raw samples
+            }
+        }
+        if ((options & kFeatureDenoise) && suppressor.configure(frameSize / 2, sampleRate / hopSize)) {
+            processor.learnNoiseProfile(source(), total, frameSize, hopSize, sampleRate, suppressor);
+        }
+    }
+    
+    // Runs frames until budgetUs has been spent; true once every frame is done
+    bool step(double budgetUs) {
+        TimeSlice slice(budgetUs);
+        processor.setNoiseSuppressor(suppressor.ready() ? &suppressor : nullptr);
+        while (next < total) {
+            {
+                ArenaScope scope(analysisArena());
+                const double* frame = source() + static_cast<size_t>(next) * hopSize;
+                double features[kFeaturesPerFrame];
+                processor.extractFrameInto(frame, frameSize, sampleRate, features);
+                std::copy(features, features + kFeaturesPerFrame, output.row(next));
+                if (options & kFeatureFormants) {
+                    tracker.track(formantCandidates(frame, frameSize, sampleRate),
+                                  output.row(next) + kFeaturesPerFrame);
+                }
+            }
+            next++;
+            if (slice.exhausted(kSliceCheckInterval) && next < total) {
+                return false;
+            }
+        }
+        return true;
+    }
+    
+    // Completes the task with features computed earlier for the same audio
+    void complete(FeatureView ready) {
+        output.assign(ready);
+        next = total;
+    }
+    
+    bool done() const { return next >= total; }
+    double progress() const { return total > 0 ? static_cast<double>(next) / total : 1.0; }
+    
+    // frameCount() rows; the first framesDone() are filled
+    int frameCount() const { return total; }
+    int framesDone() const { return next; }
+    const FeatureMatrix& features() const { return output; }
+    
+private:
+    // The audio frames are read from: the caller's, or its normalised copy
+    const double* source() const { return normalized.empty() ? audioData : normalized.data(); }
+    
+    AudioProcessor processor;
+    const double* audioData;
+    double sampleRate;
+    int frameSize;
+    int hopSize;
+    int total;
+    uint32_t options;
+    int next = 0;
+    PoolVector<double> normalized;
+    NoiseSuppressor suppressor;
+    FormantTracker tracker;
+    FeatureMatrix output;
+};
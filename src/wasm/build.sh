@@ -15,13 +15,24 @@ fi
 # Create output directory
 mkdir -p ../../public/wasm
 
+# Optional pthreads build of the audio processor, whose frame loop runs on
+# the engine scheduler (scheduler.h). The page must be cross-origin isolated
+# for SharedArrayBuffer. Usage: WASM_THREADS=1 ./build.sh
+THREAD_FLAGS=""
+AUDIO_ENVIRONMENT="web"
+if [ "${WASM_THREADS:-0}" = "1" ]; then
+    THREAD_FLAGS="-pthread -s PTHREAD_POOL_SIZE=navigator.hardwareConcurrency"
+    AUDIO_ENVIRONMENT="web,worker"
+fi
+
 # Build DTW module
 echo "Building DTW module..."
 emcc dtw.cpp \
     -O3 \
+    -std=c++17 \
     -s WASM=1 \
     -s EXPORTED_RUNTIME_METHODS='["cwrap", "ccall", "getValue", "setValue"]' \
-    -s EXPORTED_FUNCTIONS='["_compute_dtw_distance", "_compute_normalized_dtw", "_malloc", "_free"]' \
+    -s EXPORTED_FUNCTIONS='["_compute_dtw_distance", "_compute_normalized_dtw", "_compute_normalized_dtw_f32", "_reserve_dtw_workspace", "_plan_alignment", "_alignment_plan", "_compute_adaptive_dtw", "_reference_store_open", "_reference_find", "_reference_frames", "_reference_feature_dim", "_reference_front_end", "_reference_feature_stride", "_reference_features", "_reference_word_count", "_reference_word_boundaries", "_compute_reference_dtw", "_reference_lower_bound", "_dtw_task_create", "_dtw_task_create_reference", "_dtw_task_step", "_dtw_task_progress", "_dtw_task_normalized_distance", "_dtw_task_destroy", "_progressive_create", "_progressive_create_reference", "_progressive_advance", "_progressive_result", "_progressive_destroy", "_segment_recitation", "_segmentation_report", "_segmentation_segments", "_segmentation_destroy", "_detect_waqf", "_waqf_count", "_waqf_pauses", "_waqf_destroy", "_cancel_control", "_scratch_alloc", "_scratch_reset", "_malloc", "_free"]' \
     -s MODULARIZE=1 \
     -s EXPORT_NAME="DTWModule" \
     -s ENVIRONMENT=web \
@@ -39,9 +50,10 @@ emcc dtw.cpp \
 echo "Building HMM module..."
 emcc hmm.cpp \
     -O3 \
+    -std=c++17 \
     -s WASM=1 \
     -s EXPORTED_RUNTIME_METHODS='["cwrap", "ccall", "getValue", "setValue"]' \
-    -s EXPORTED_FUNCTIONS='["_viterbi_decode", "_forward_algorithm", "_malloc", "_free"]' \
+    -s EXPORTED_FUNCTIONS='["_viterbi_decode", "_forward_algorithm", "_reserve_hmm_workspace", "_viterbi_task_create", "_viterbi_task_step", "_viterbi_task_progress", "_viterbi_task_probability", "_viterbi_task_path", "_viterbi_task_destroy", "_cancel_control", "_scratch_alloc", "_scratch_reset", "_malloc", "_free"]' \
     -s MODULARIZE=1 \
     -s EXPORT_NAME="HMMModule" \
     -s ENVIRONMENT=web \
@@ -59,12 +71,14 @@ emcc hmm.cpp \
 echo "Building audio processor module..."
 emcc audio_processor.cpp \
     -O3 \
+    -std=c++17 \
+    $THREAD_FLAGS \
     -s WASM=1 \
     -s EXPORTED_RUNTIME_METHODS='["cwrap", "ccall", "getValue", "setValue"]' \
-    -s EXPORTED_FUNCTIONS='["_process_audio_features", "_extract_mfcc", "_malloc", "_free"]' \
+    -s EXPORTED_FUNCTIONS='["_process_audio_features", "_process_audio_features_ex", "_extract_mfcc", "_reserve_audio_workspace", "_ring_buffer_bytes", "_ring_buffer_init", "_ring_buffer_write", "_ring_buffer_read", "_ring_buffer_readable", "_ring_buffer_writable", "_ring_buffer_overruns", "_stream_create", "_stream_destroy", "_stream_push", "_stream_drain", "_stream_finish", "_stream_frame_count", "_stream_features", "_stream_feature_stride", "_stream_clear", "_stream_reset", "_stream_dropped", "_stream_attach_peaks", "_peak_pyramid_create", "_peak_pyramid_destroy", "_peak_pyramid_append", "_peak_pyramid_clear", "_peak_pyramid_levels", "_peak_pyramid_level_for", "_peak_pyramid_bin_samples", "_peak_pyramid_bins", "_peak_pyramid_data", "_peak_pyramid_samples", "_stream_enable_nasality", "_stream_nasal_scores", "_stream_nasal_segment_count", "_stream_nasal_segments", "_stream_enable_qalqalah", "_stream_qalqalah_count", "_stream_qalqalah_bursts", "_stream_enable_landmarks", "_stream_landmark_count", "_stream_landmarks", "_stream_enable_noise_suppression", "_stream_enable_loudness", "_stream_loudness_lufs", "_stream_loudness_gain_db", "_nasal_analyze", "_nasal_frame_count", "_nasal_scores", "_nasal_segment_count", "_nasal_segments", "_nasal_destroy", "_qalqalah_analyze", "_qalqalah_count", "_qalqalah_bursts", "_qalqalah_destroy", "_landmarks_analyze", "_landmark_count", "_landmarks", "_landmarks_destroy", "_feature_task_create", "_feature_task_step", "_feature_task_progress", "_feature_task_frames", "_feature_task_features", "_feature_task_stride", "_feature_task_destroy", "_feature_cache_configure", "_feature_cache_clear", "_feature_cache_hits", "_feature_cache_misses", "_feature_cache_bytes", "_cancel_control", "_scratch_alloc", "_scratch_reset", "_malloc", "_free"]' \
     -s MODULARIZE=1 \
     -s EXPORT_NAME="AudioProcessorModule" \
-    -s ENVIRONMENT=web \
+    -s ENVIRONMENT=$AUDIO_ENVIRONMENT \
     -s ALLOW_MEMORY_GROWTH=1 \
     -s INITIAL_MEMORY=33554432 \
     -s MAXIMUM_MEMORY=268435456 \
@@ -75,9 +89,75 @@ emcc audio_processor.cpp \
     --bind \
     -o ../../public/wasm/audio_processor.js
 
+# Build the AudioWorklet feature extractor as a standalone .wasm with no JS
+# runtime and no embind. The page compiles it and passes the module to the
+# worklet (feature-extractor.js), which instantiates it synchronously. Memory
+# is fixed so the worklet's views over it are never detached.
+echo "Building worklet feature extractor..."
+emcc worklet_extractor.cpp \
+    -O3 \
+    -std=c++17 \
+    -s STANDALONE_WASM=1 \
+    --no-entry \
+    -s EXPORTED_FUNCTIONS='["_worklet_configure", "_worklet_input", "_worklet_quantum", "_worklet_process", "_worklet_features", "_worklet_feature_stride", "_worklet_clear", "_worklet_reset", "_worklet_dropped", "_worklet_late"]' \
+    -s ALLOW_MEMORY_GROWTH=0 \
+    -s INITIAL_MEMORY=8388608 \
+    -s STACK_SIZE=262144 \
+    -s FILESYSTEM=0 \
+    -o ../../public/wasm/feature_worklet.wasm
+
 # Create TypeScript type definitions
 echo "Generating TypeScript definitions..."
 cat > ../../src/types/wasm.ts << 'EOF'
+// Embind class APIs return typed_memory_view results: typed arrays that
+// alias engine-owned buffers in the module heap. A view is invalidated by the
+// next call that refills the same buffer, by delete(), and by memory growth;
+// slice() anything that has to outlive that.
+export interface FeatureBuffer {
+  data: Float32Array; // rows x stride, element (i, j) at i * stride + j
+  rows: number;
+  cols: number;
+  stride: number;
+}
+
+export interface AlignmentView {
+  distance: number;
+  pathLength: number;
+  path: Int32Array; // interleaved (query, reference) index pairs
+}
+
+export interface ForwardView {
+  probability: number;
+  alpha: Float64Array; // rows x stride log probabilities
+  rows: number;
+  stride: number;
+}
+
+export interface ViterbiView {
+  probability: number;
+  path: Int32Array;
+  probabilities: Float64Array;
+}
+
+export interface AudioProcessorInstance {
+  audioInput(samples: number): Float64Array;
+  processInput(sampleRate: number, frameSize: number, hopSize: number): FeatureBuffer;
+  delete(): void;
+}
+
+export interface DynamicTimeWarpingInstance {
+  sequenceInput(which: 0 | 1, rows: number, cols: number): FeatureBuffer;
+  alignInputs(bandWidth: number): AlignmentView;
+  delete(): void;
+}
+
+export interface HiddenMarkovModelInstance {
+  observationInput(length: number): Int32Array;
+  forwardInput(): ForwardView;
+  viterbiInput(): ViterbiView;
+  delete(): void;
+}
+
 export interface DTWModule {
   compute_dtw_distance(
     seq1: number, seq1_len: number, feature_dim1: number,
@@ -87,10 +167,85 @@ export interface DTWModule {
     seq1: number, seq1_len: number, feature_dim1: number,
     seq2: number, seq2_len: number, feature_dim2: number
   ): number;
+  compute_normalized_dtw_f32(
+    seq1: number, seq1_len: number, feature_dim1: number,
+    seq2: number, seq2_len: number, feature_dim2: number
+  ): number;
+  reserve_dtw_workspace(
+    seq1_len: number, seq2_len: number, feature_dim: number,
+    budget_bytes: number
+  ): number;
+  plan_alignment(
+    seq1_len: number, seq2_len: number, feature_dim: number, need_path: number,
+    memory_budget: number, latency_ms: number, tolerance: number
+  ): number;
+  alignment_plan(): number;
+  compute_adaptive_dtw(
+    seq1: number, seq1_len: number, feature_dim1: number,
+    seq2: number, seq2_len: number, feature_dim2: number,
+    memory_budget: number, latency_ms: number, tolerance: number
+  ): number;
+  reference_store_open(data: number, size_bytes: number): number;
+  reference_find(surah: number, ayah: number, reciter: number): number;
+  reference_frames(entry: number): number;
+  reference_feature_dim(): number;
+  reference_front_end(): number;
+  reference_feature_stride(): number;
+  reference_features(entry: number): number;
+  reference_word_count(entry: number): number;
+  reference_word_boundaries(entry: number): number;
+  compute_reference_dtw(
+    query: number, query_len: number, feature_dim: number, entry: number
+  ): number;
+  reference_lower_bound(
+    query: number, query_len: number, feature_dim: number, entry: number
+  ): number;
+  dtw_task_create(
+    seq1: number, seq1_len: number, feature_dim1: number,
+    seq2: number, seq2_len: number, feature_dim2: number,
+    window_size: number
+  ): number;
+  dtw_task_create_reference(
+    query: number, query_len: number, feature_dim: number, entry: number
+  ): number;
+  dtw_task_step(task: number, budget_us: number): number;
+  dtw_task_progress(task: number): number;
+  dtw_task_normalized_distance(task: number): number;
+  dtw_task_destroy(task: number): void;
+  progressive_create(
+    query: number, query_len: number, feature_dim1: number,
+    reference: number, reference_len: number, feature_dim2: number
+  ): number;
+  progressive_create_reference(
+    query: number, query_len: number, feature_dim: number, entry: number
+  ): number;
+  progressive_advance(analysis: number): number;
+  progressive_result(analysis: number): number;
+  progressive_destroy(analysis: number): void;
+  segment_recitation(
+    query: number, query_len: number, feature_dim: number, dtw_dim: number, energy_column: number,
+    frame_rate: number, surah: number, first_ayah: number, last_ayah: number, reciter: number
+  ): number;
+  segmentation_report(segmentation: number): number;
+  segmentation_segments(segmentation: number): number;
+  segmentation_destroy(segmentation: number): void;
+  detect_waqf(
+    query: number, query_len: number, feature_dim: number, dtw_dim: number, energy_column: number,
+    pitch_column: number, frame_rate: number, entry: number, marks: number, mark_count: number
+  ): number;
+  waqf_count(check: number): number;
+  waqf_pauses(check: number): number;
+  waqf_destroy(check: number): void;
+  cancel_control(): number;
+  scratch_alloc(size: number): number;
+  scratch_reset(): void;
   malloc(size: number): number;
   free(ptr: number): void;
   HEAPF64: Float64Array;
+  HEAPF32: Float32Array;
+  HEAPU8: Uint8Array;
   HEAP8: Int8Array;
+  DynamicTimeWarping: new () => DynamicTimeWarpingInstance;
 }
 
 export interface HMMModule {
@@ -104,10 +259,28 @@ export interface HMMModule {
     transitions: number, emissions: number,
     initial_probs: number, num_states: number
   ): number;
+  reserve_hmm_workspace(
+    obs_len: number, num_states: number, num_symbols: number,
+    want_path: number, budget_bytes: number
+  ): number;
+  viterbi_task_create(
+    observations: number, obs_len: number,
+    transitions: number, emissions: number,
+    initial_probs: number, num_states: number
+  ): number;
+  viterbi_task_step(task: number, budget_us: number): number;
+  viterbi_task_progress(task: number): number;
+  viterbi_task_probability(task: number): number;
+  viterbi_task_path(task: number): number;
+  viterbi_task_destroy(task: number): void;
+  cancel_control(): number;
+  scratch_alloc(size: number): number;
+  scratch_reset(): void;
   malloc(size: number): number;
   free(ptr: number): void;
   HEAPF64: Float64Array;
   HEAP8: Int8Array;
+  HiddenMarkovModel: new (states: number, observations: number) => HiddenMarkovModelInstance;
 }
 
 export interface AudioProcessorModule {
@@ -115,14 +288,108 @@ export interface AudioProcessorModule {
     audio_data: number, data_len: number,
     sample_rate: number, frame_size: number
   ): number;
+  process_audio_features_ex(
+    audio_data: number, data_len: number,
+    sample_rate: number, frame_size: number, options: number
+  ): number;
   extract_mfcc(
     spectrum: number, spectrum_len: number,
     sample_rate: number, num_coeffs: number
   ): number;
+  reserve_audio_workspace(
+    data_len: number, sample_rate: number, frame_size: number,
+    options: number, budget_bytes: number
+  ): number;
+  ring_buffer_bytes(capacity: number): number;
+  ring_buffer_init(memory: number, capacity: number): number;
+  ring_buffer_write(ring: number, samples: number, count: number): number;
+  ring_buffer_read(ring: number, out: number, count: number): number;
+  ring_buffer_readable(ring: number): number;
+  ring_buffer_writable(ring: number): number;
+  ring_buffer_overruns(ring: number): number;
+  stream_create(
+    sample_rate: number, frame_size: number, hop_size: number,
+    max_frames: number
+  ): number;
+  stream_destroy(stream: number): void;
+  stream_push(stream: number, samples: number, count: number): number;
+  stream_drain(stream: number, ring: number): number;
+  stream_finish(stream: number): number;
+  stream_frame_count(stream: number): number;
+  stream_features(stream: number): number;
+  stream_feature_stride(stream: number): number;
+  stream_clear(stream: number): void;
+  stream_reset(stream: number): void;
+  stream_dropped(stream: number): number;
+  stream_attach_peaks(stream: number, pyramid: number): void;
+  peak_pyramid_create(expected_samples: number): number;
+  peak_pyramid_destroy(pyramid: number): void;
+  peak_pyramid_append(pyramid: number, samples: number, count: number): void;
+  peak_pyramid_clear(pyramid: number): void;
+  peak_pyramid_levels(pyramid: number): number;
+  peak_pyramid_level_for(pyramid: number, samples_per_pixel: number): number;
+  peak_pyramid_bin_samples(level: number): number;
+  peak_pyramid_bins(pyramid: number, level: number): number;
+  peak_pyramid_data(pyramid: number, level: number): number;
+  peak_pyramid_samples(pyramid: number): number;
+  stream_enable_nasality(stream: number): number;
+  stream_nasal_scores(stream: number): number;
+  stream_nasal_segment_count(stream: number): number;
+  stream_nasal_segments(stream: number): number;
+  stream_enable_qalqalah(stream: number): number;
+  stream_qalqalah_count(stream: number): number;
+  stream_qalqalah_bursts(stream: number): number;
+  stream_enable_landmarks(stream: number): number;
+  stream_landmark_count(stream: number): number;
+  stream_landmarks(stream: number): number;
+  stream_enable_noise_suppression(stream: number): number;
+  stream_enable_loudness(stream: number): number;
+  stream_loudness_lufs(stream: number): number;
+  stream_loudness_gain_db(stream: number): number;
+  nasal_analyze(
+    audio_data: number, data_len: number, sample_rate: number, frame_size: number,
+    hop_size: number
+  ): number;
+  nasal_frame_count(detector: number): number;
+  nasal_scores(detector: number): number;
+  nasal_segment_count(detector: number): number;
+  nasal_segments(detector: number): number;
+  nasal_destroy(detector: number): void;
+  qalqalah_analyze(audio_data: number, data_len: number, sample_rate: number): number;
+  qalqalah_count(detector: number): number;
+  qalqalah_bursts(detector: number): number;
+  qalqalah_destroy(detector: number): void;
+  landmarks_analyze(
+    audio_data: number, data_len: number, sample_rate: number, frame_size: number
+  ): number;
+  landmark_count(detector: number): number;
+  landmarks(detector: number): number;
+  landmarks_destroy(detector: number): void;
+  feature_task_create(
+    audio_data: number, data_len: number, sample_rate: number, frame_size: number,
+    options: number
+  ): number;
+  feature_task_step(task: number, budget_us: number): number;
+  feature_task_progress(task: number): number;
+  feature_task_frames(task: number): number;
+  feature_task_features(task: number): number;
+  feature_task_stride(task: number): number;
+  feature_task_destroy(task: number): void;
+  feature_cache_configure(budget_bytes: number): void;
+  feature_cache_clear(): void;
+  feature_cache_hits(): number;
+  feature_cache_misses(): number;
+  feature_cache_bytes(): number;
+  cancel_control(): number;
+  scratch_alloc(size: number): number;
+  scratch_reset(): void;
   malloc(size: number): number;
   free(ptr: number): void;
   HEAPF64: Float64Array;
+  HEAPF32: Float32Array;
+  HEAPU8: Uint8Array;
   HEAP8: Int8Array;
+  AudioProcessor: new () => AudioProcessorInstance;
 }
 
 declare global {
@@ -145,4 +412,5 @@ echo "  - ../../public/wasm/hmm.js"
 echo "  - ../../public/wasm/hmm.wasm"
 echo "  - ../../public/wasm/audio_processor.js"
 echo "  - ../../public/wasm/audio_processor.wasm"
+echo "  - ../../public/wasm/feature_worklet.wasm"
 echo "  - ../../src/types/wasm.ts"
\ No newline at end of file
@@ -0,0 +1,31 @@
+#!/bin/bash
+
+# Native build of the offline tools. They compile the same engine headers as
+# the WebAssembly modules, so features match the browser pipeline.
+set -e
+
+CXX=${CXX:-c++}
+CXXFLAGS=${CXXFLAGS:-"-O3 -march=native"}
+
+mkdir -p ../../build-native
+
+echo "Building corpus builder..."
+$CXX tools/corpus_builder.cpp \
+    -std=c++17 \
+    $CXXFLAGS \
+    -pthread \
+    -Wall \
+    -o ../../build-native/corpus_builder
+
+echo "Building analysis daemon..."
+$CXX tools/analysis_daemon.cpp \
+    -std=c++17 \
+    $CXXFLAGS \
+    -pthread \
+    -Wall \
+    -o ../../build-native/analysis_daemon
+
+echo "Native tools built successfully!"
+echo "Files generated:"
+echo "  - ../../build-native/corpus_builder"
+echo "  - ../../build-native/analysis_daemon"
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#ifdef __EMSCRIPTEN__
+#include <emscripten/emscripten.h>
+#endif
+
+// Cooperative cancellation for the engine's long loops (frame extraction,
+// DTW rows, HMM steps). A synchronous WASM call cannot be interrupted from
+// outside, so the loops themselves poll a small control block at bounded
+// intervals and stop early when asked to.
+//
+// Layout (little-endian, 24 bytes):
+//     0  uint32  cancel      non-zero requests a stop; set by the caller
+//     4  int32   status      RunStatus of the last run; set by the engine
+//     8  float64 deadline    epoch milliseconds (Date.now() clock), 0 = none
+//    16  float64 progress    fraction of the last run's work completed
+// JS reads and writes it through Int32Array/Float64Array views; `cancel`
+// is only observed mid-call when another thread can write it (shared memory
+// or the native tools), whereas the deadline works on any thread.
+
+enum class RunStatus : int32_t {
+    Complete = 0,
+    Cancelled = 1, // the cancel flag was raised
+    Partial = 2    // the deadline passed; outputs hold only the work done so far
+};
+
+struct CancelControl {
+    std::atomic<uint32_t> cancel;
+    std::atomic<int32_t> status;
+    double deadlineMs;
+    double progress;
+};
+
+static_assert(sizeof(CancelControl) == 24, "cancel control layout");
+
+// Work between polls in the cell- and step-based loops
+constexpr size_t kCancelPollInterval = 1 << 16;
+
+inline double engineClockMs() {
+#ifdef __EMSCRIPTEN__
+    return emscripten_date_now();
+#else
+    return std::chrono::duration<double, std::milli>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// One control block per module for the C API
+inline CancelControl& moduleCancelControl() {
+    static CancelControl control = {};
+    return control;
+}
+
+// Control in effect on this thread, installed by CancelScope
+inline CancelControl*& currentCancelControl() {
+    thread_local CancelControl* control = nullptr;
+    return control;
+}
+
+// True once `control` has been cancelled or its deadline has passed. The
+// first reason seen is latched into `status`, so every loop sharing the
+// control (including scheduler workers) stops for the same reason.
+inline bool stopRequested(CancelControl* control) {
+    if (!control) return false;
+    if (control->status.load(std::memory_order_relaxed) != static_cast<int32_t>(RunStatus::Complete)) {
+        return true;
+    }
+
+    RunStatus reason = RunStatus::Complete;
+    if (control->cancel.load(std::memory_order_relaxed) != 0) {
+        reason = RunStatus::Cancelled;
+    } else if (control->deadlineMs > 0 && engineClockMs() >= control->deadlineMs) {
+        reason = RunStatus::Partial;
+    }
+    if (reason == RunStatus::Complete) return false;
+
+    int32_t expected = static_cast<int32_t>(RunStatus::Complete);
+    control->status.compare_exchange_strong(expected, static_cast<int32_t>(reason));
+    return true;
+}
+
+inline bool stopRequested() {
+    return stopRequested(currentCancelControl());
+}
+
+// Records how far a loop got when it stopped (serial loops only)
+inline void reportProgress(CancelControl* control, double fraction) {
+    if (control) control->progress = fraction;
+}
+
+// Polls the calling thread's control once roughly every `interval` units of
+// work (DTW cells, HMM transitions), so cheap iterations do not pay for a
+// clock read each
+class CancelPoll {
+public:
+    explicit CancelPoll(size_t interval) : control(currentCancelControl()), interval(interval) {}
+
+    // Adds `work` units; true when the run must stop
+    bool stop(size_t work) {
+        if (!control) return false;
+        pending += work;
+        if (pending < interval) return false;
+        pending = 0;
+        return stopRequested(control);
+    }
+
+    void progress(double fraction) { reportProgress(control, fraction); }
+
+private:
+    CancelControl* control;
+    size_t interval;
+    size_t pending = 0;
+};
+
+// Installs `control` for the calling thread for one run: clears the status,
+// and marks the run fully done on exit unless a loop stopped it. The
+// previously installed control is restored on exit.
+class CancelScope {
+public:
+    explicit CancelScope(CancelControl& control) : control(control), previous(currentCancelControl()) {
+        control.status.store(static_cast<int32_t>(RunStatus::Complete), std::memory_order_relaxed);
+        control.progress = 0.0;
+        currentCancelControl() = &control;
+    }
+
+    ~CancelScope() {
+        if (status() == RunStatus::Complete) {
+            control.progress = 1.0;
+        }
+        currentCancelControl() = previous;
+    }
+
+    CancelScope(const CancelScope&) = delete;
+    CancelScope& operator=(const CancelScope&) = delete;
+
+    RunStatus status() const {
+        return static_cast<RunStatus>(control.status.load(std::memory_order_relaxed));
+    }
+
+private:
+    CancelControl& control;
+    CancelControl* previous;
+};
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include "dtw.h"
+#include "feature_matrix.h"
+#include "scheduler.h"
+#include "workspace.h"
+
+// DTW Barycenter Averaging (Petitjean et al., 2011).
+//
+// Builds one template from several recordings of the same verse: start from
+// the medoid recording, then repeatedly align every recording to the current
+// template and replace each template frame with the mean of the frames
+// aligned to it. Alignment uses the first `alignDims` columns (the MFCCs);
+// all columns are averaged.
+
+struct DBAOptions {
+    int alignDims;       // columns used for alignment, <= 0 for all
+    int maxIterations;
+    double tolerance;    // stop when no template value moves more than this
+    size_t memoryBudget; // per-alignment workspace ceiling, 0 = unlimited
+};
+
+inline FeatureView narrowed(FeatureView view, int cols) {
+    if (cols <= 0 || cols >= view.cols()) {
+        return view;
+    }
+    return FeatureView(view.data(), view.rows(), cols, view.stride());
+}
+
+// Index of the sequence with the smallest summed normalised DTW distance to
+// all others. Pairs are aligned in parallel; the sums are taken in pair
+// order so the choice does not depend on scheduling.
+inline int dbaMedoid(const std::vector<FeatureView>& sequences, int alignDims) {
+    int k = sequences.size();
+    std::vector<std::pair<int, int>> pairs;
+    for (int a = 0; a < k; a++) {
+        for (int b = a + 1; b < k; b++) {
+            pairs.push_back({a, b});
+        }
+    }
+
+    std::vector<double> distances(pairs.size());
+    parallelFor(0, pairs.size(), 1, [&](int p) {
+        DynamicTimeWarping dtw;
+        ArenaScope scope(analysisArena());
+        DTWOutcome outcome = dtw.align(narrowed(sequences[pairs[p].first], alignDims),
+                                       narrowed(sequences[pairs[p].second], alignDims),
+                                       DistanceMetric::Euclidean, -1, nullptr);
+        distances[p] = outcome.pathLength > 0 ? outcome.distance / outcome.pathLength
+                                              : outcome.distance;
+    });
+
+    std::vector<double> totals(k, 0.0);
+    for (size_t p = 0; p < pairs.size(); p++) {
+        totals[pairs[p].first] += distances[p];
+        totals[pairs[p].second] += distances[p];
+    }
+    return static_cast<int>(std::min_element(totals.begin(), totals.end()) - totals.begin());
+}
+
+// Returns an empty matrix when there are no sequences or their widths differ
+inline FeatureMatrix dbaAverage(const std::vector<FeatureView>& sequences, const DBAOptions& options) {
+    if (sequences.empty()) {
+        return FeatureMatrix();
+    }
+    int dim = sequences[0].cols();
+    for (const FeatureView& sequence : sequences) {
+        if (sequence.cols() != dim || sequence.empty()) {
+            return FeatureMatrix();
+        }
+    }
+
+    FeatureMatrix average;
+    average.assign(sequences[dbaMedoid(sequences, options.alignDims)]);
+    if (sequences.size() == 1) {
+        return average;
+    }
+
+    int m = average.rows();
+    int alignDims = narrowed(average.view(), options.alignDims).cols();
+    FeatureMatrix sums(m, dim);
+    std::vector<int> counts(m);
+    std::vector<std::vector<std::pair<int, int>>> paths(sequences.size());
+    std::vector<char> aligned(sequences.size());
+
+    for (int iteration = 0; iteration < options.maxIterations; iteration++) {
+        sums.resize(m, dim);
+        std::fill(counts.begin(), counts.end(), 0);
+
+        // Align in parallel, then accumulate in sequence order so the
+        // template is identical for any worker count
+        parallelFor(0, sequences.size(), 1, [&](int s) {
+            const FeatureView& sequence = sequences[s];
+            WorkspacePlan plan = planDTWWorkspace(m, sequence.rows(), alignDims, DTWAlgorithm::Full,
+                                                  -1, true, options.memoryBudget);
+            aligned[s] = reserveWorkspace(plan);
+            if (!aligned[s]) {
+                return;
+            }
+            DynamicTimeWarping dtw;
+            ArenaScope scope(analysisArena());
+            dtw.alignPlanned(narrowed(average.view(), alignDims), narrowed(sequence, alignDims),
+                             plan, &paths[s]);
+        });
+
+        for (size_t s = 0; s < sequences.size(); s++) {
+            if (!aligned[s]) continue;
+            for (const std::pair<int, int>& step : paths[s]) {
+                double* sum = sums.row(step.first);
+                const double* frame = sequences[s].row(step.second);
+                for (int c = 0; c < dim; c++) {
+                    sum[c] += frame[c];
+                }
+                counts[step.first]++;
+            }
+        }
+
+        double moved = 0.0;
+        for (int i = 0; i < m; i++) {
+            if (counts[i] == 0) continue;
+            double* row = average.row(i);
+            const double* sum = sums.row(i);
+            for (int c = 0; c < dim; c++) {
+                double value = sum[c] / counts[i];
+                moved = std::max(moved, std::fabs(value - row[c]));
+                row[c] = value;
+            }
+        }
+        if (moved <= options.tolerance) {
+            break;
+        }
+    }
+    return average;
+}
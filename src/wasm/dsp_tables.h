@@ -0,0 +1,323 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Precomputed DSP tables for the frame pipeline.
+//
+// The table builders are constexpr and use the constexpr math below, so the
+// same code fills tables in the data segment at compile time (for the
+// configurations we ship) and in pooled memory at runtime (for any other
+// frame size or sample rate). Both paths therefore produce identical values.
+//
+// Shipped configurations:
+//   16 kHz,  512-point frames (32 ms)
+//   48 kHz, 2048-point frames (43 ms, what the Web Audio path records at)
+// each with 26 mel filters and a 26 x 26 DCT-II basis (MFCCs use the first
+// 13 rows).
+
+namespace dsp {
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr double kLn2 = 0.69314718055994530942;
+constexpr double kLn10 = 2.30258509299404568402;
+constexpr int kMaxMelFilters = 64;
+
+// ---- constexpr math ---------------------------------------------------------
+
+constexpr double sinSeries(double x) { // |x| <= pi/4
+    double x2 = x * x;
+    double term = x;
+    double sum = x;
+    for (int n = 1; n < 11; n++) {
+        term *= -x2 / ((2.0 * n) * (2.0 * n + 1.0));
+        sum += term;
+    }
+    return sum;
+}
+
+constexpr double cosSeries(double x) { // |x| <= pi/4
+    double x2 = x * x;
+    double term = 1.0;
+    double sum = 1.0;
+    for (int n = 1; n < 11; n++) {
+        term *= -x2 / ((2.0 * n - 1.0) * (2.0 * n));
+        sum += term;
+    }
+    return sum;
+}
+
+// Nearest multiple of pi/2
+constexpr long quadrant(double x) {
+    double q = x / (kPi / 2.0);
+    return static_cast<long>(q >= 0 ? q + 0.5 : q - 0.5);
+}
+
+constexpr double cos(double x) {
+    long q = quadrant(x);
+    double r = x - q * (kPi / 2.0);
+    switch (((q % 4) + 4) % 4) {
+        case 0: return cosSeries(r);
+        case 1: return -sinSeries(r);
+        case 2: return -cosSeries(r);
+        default: return sinSeries(r);
+    }
+}
+
+constexpr double sin(double x) {
+    long q = quadrant(x);
+    double r = x - q * (kPi / 2.0);
+    switch (((q % 4) + 4) % 4) {
+        case 0: return sinSeries(r);
+        case 1: return cosSeries(r);
+        case 2: return -sinSeries(r);
+        default: return -cosSeries(r);
+    }
+}
+
+constexpr double log(double x) { // x > 0
+    int exponent = 0;
+    while (x > 1.41421356237309504880) { x *= 0.5; exponent++; }
+    while (x < 0.70710678118654752440) { x *= 2.0; exponent--; }
+
+    // log(x) = 2 atanh((x - 1) / (x + 1))
+    double s = (x - 1.0) / (x + 1.0);
+    double s2 = s * s;
+    double term = s;
+    double sum = 0.0;
+    for (int k = 0; k < 16; k++) {
+        sum += term / (2 * k + 1);
+        term *= s2;
+    }
+    return 2.0 * sum + exponent * kLn2;
+}
+
+constexpr double exp(double x) {
+    long k = static_cast<long>(x / kLn2 + (x >= 0 ? 0.5 : -0.5));
+    double r = x - k * kLn2;
+    double term = 1.0;
+    double sum = 1.0;
+    for (int n = 1; n < 20; n++) {
+        term *= r / n;
+        sum += term;
+    }
+    for (; k > 0; k--) sum *= 2.0;
+    for (; k < 0; k++) sum *= 0.5;
+    return sum;
+}
+
+constexpr double log10(double x) { return log(x) / kLn10; }
+constexpr double pow10(double x) { return exp(x * kLn10); }
+
+constexpr double hzToMel(double hz) { return 2595.0 * log10(1.0 + hz / 700.0); }
+constexpr double melToHz(double mel) { return 700.0 * (pow10(mel / 2595.0) - 1.0); }
+
+constexpr bool isPowerOfTwo(int n) { return n > 0 && (n & (n - 1)) == 0; }
+
+// ---- builders ---------------------------------------------------------------
+
+constexpr void fillHamming(double* window, int n) {
+    for (int i = 0; i < n; i++) {
+        window[i] = 0.54 - 0.46 * cos(2.0 * kPi * i / (n - 1));
+    }
+}
+
+// e^{-2 pi i k / n} for k < n / 2
+constexpr void fillTwiddles(double* twiddleCos, double* twiddleSin, int n) {
+    for (int k = 0; k < n / 2; k++) {
+        double angle = -2.0 * kPi * k / n;
+        twiddleCos[k] = cos(angle);
+        twiddleSin[k] = sin(angle);
+    }
+}
+
+constexpr void fillBitReverse(int32_t* reversed, int n) {
+    int bits = 0;
+    while ((1 << bits) < n) bits++;
+    for (int i = 0; i < n; i++) {
+        int r = 0;
+        for (int b = 0; b < bits; b++) {
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        reversed[i] = r;
+    }
+}
+
+// DCT-II basis, row k: cos(pi k (j + 0.5) / n)
+constexpr void fillDCT(double* basis, int n) {
+    for (int k = 0; k < n; k++) {
+        for (int j = 0; j < n; j++) {
+            basis[k * n + j] = cos(kPi * k * (j + 0.5) / n);
+        }
+    }
+}
+
+// Triangular mel filters stored sparsely: filter i covers bins
+// [start[i], start[i] + length[i]) with weights at weights[offset[i]...].
+// Weights need at most nFFT entries. Returns the number used.
+constexpr int fillMelBank(int32_t* start, int32_t* length, int32_t* offset, double* weights,
+                          int nFilters, int nFFT, double sampleRate) {
+    int nBins = nFFT / 2;
+    double melMin = hzToMel(0);
+    double melMax = hzToMel(sampleRate / 2.0);
+
+    // The edges are exact (DC and Nyquist) so the outer filters do not
+    // depend on how log/pow round near an integer bin
+    int32_t binPoints[kMaxMelFilters + 2] = {};
+    for (int i = 1; i <= nFilters; i++) {
+        double mel = melMin + (melMax - melMin) * i / (nFilters + 1);
+        binPoints[i] = static_cast<int32_t>(melToHz(mel) * nFFT / sampleRate);
+    }
+    binPoints[nFilters + 1] = nBins;
+
+    int used = 0;
+    for (int i = 1; i <= nFilters; i++) {
+        int lo = binPoints[i - 1];
+        int center = binPoints[i];
+        int hi = binPoints[i + 1] < nBins ? binPoints[i + 1] : nBins;
+
+        start[i - 1] = lo;
+        length[i - 1] = hi > lo ? hi - lo : 0;
+        offset[i - 1] = used;
+
+        for (int j = lo; j < hi; j++) {
+            if (j < center) {
+                weights[used++] = static_cast<double>(j - lo) / (center - lo);
+            } else {
+                weights[used++] = static_cast<double>(binPoints[i + 1] - j) /
+                                  (binPoints[i + 1] - center);
+            }
+        }
+    }
+    return used;
+}
+
+// ---- table sets -------------------------------------------------------------
+
+// Non-owning view of one configuration's tables
+struct SpectralTables {
+    int fftSize;
+    double sampleRate;
+    int melFilters;
+    const double* window;       // fftSize
+    const double* twiddleCos;   // fftSize / 2
+    const double* twiddleSin;   // fftSize / 2
+    const int32_t* bitReverse;  // fftSize
+    const int32_t* melStart;    // melFilters
+    const int32_t* melLength;   // melFilters
+    const int32_t* melOffset;   // melFilters
+    const double* melWeights;
+    const double* dctBasis;     // melFilters x melFilters
+};
+
+// Each table is its own constant expression so the evaluation stays well
+// inside compiler step limits.
+template <int N>
+constexpr std::array<double, N> makeWindow() {
+    std::array<double, N> table{};
+    fillHamming(table.data(), N);
+    return table;
+}
+
+template <int N>
+constexpr std::array<double, N / 2> makeTwiddles(bool imaginary) {
+    std::array<double, N / 2> re{};
+    std::array<double, N / 2> im{};
+    fillTwiddles(re.data(), im.data(), N);
+    return imaginary ? im : re;
+}
+
+template <int N>
+constexpr std::array<int32_t, N> makeBitReverse() {
+    std::array<int32_t, N> table{};
+    fillBitReverse(table.data(), N);
+    return table;
+}
+
+template <int Filters>
+constexpr std::array<double, Filters * Filters> makeDCT() {
+    std::array<double, Filters * Filters> table{};
+    fillDCT(table.data(), Filters);
+    return table;
+}
+
+template <int SampleRate, int N, int Filters>
+struct MelTables {
+    std::array<int32_t, Filters> start{};
+    std::array<int32_t, Filters> length{};
+    std::array<int32_t, Filters> offset{};
+    std::array<double, N> weights{};
+};
+
+template <int SampleRate, int N, int Filters>
+constexpr MelTables<SampleRate, N, Filters> makeMel() {
+    MelTables<SampleRate, N, Filters> mel{};
+    fillMelBank(mel.start.data(), mel.length.data(), mel.offset.data(), mel.weights.data(),
+                Filters, N, static_cast<double>(SampleRate));
+    return mel;
+}
+
+template <int SampleRate, int N, int Filters>
+struct GeneratedTables {
+    static constexpr std::array<double, N> window = makeWindow<N>();
+    static constexpr std::array<double, N / 2> twiddleCos = makeTwiddles<N>(false);
+    static constexpr std::array<double, N / 2> twiddleSin = makeTwiddles<N>(true);
+    static constexpr std::array<int32_t, N> bitReverse = makeBitReverse<N>();
+    static constexpr MelTables<SampleRate, N, Filters> mel = makeMel<SampleRate, N, Filters>();
+    static constexpr std::array<double, Filters * Filters> dct = makeDCT<Filters>();
+
+    static SpectralTables view() {
+        return {N, static_cast<double>(SampleRate), Filters,
+                window.data(), twiddleCos.data(), twiddleSin.data(), bitReverse.data(),
+                mel.start.data(), mel.length.data(), mel.offset.data(), mel.weights.data(),
+                dct.data()};
+    }
+};
+
+using Tables16k512 = GeneratedTables<16000, 512, 26>;
+using Tables48k2048 = GeneratedTables<48000, 2048, 26>;
+
+// Compile-time tables for a shipped configuration, or nullptr
+inline const SpectralTables* standardTables(int fftSize, double sampleRate, int melFilters) {
+    static const SpectralTables tables16k = Tables16k512::view();
+    static const SpectralTables tables48k = Tables48k2048::view();
+
+    if (melFilters != 26) return nullptr;
+    if (fftSize == 512 && sampleRate == 16000.0) return &tables16k;
+    if (fftSize == 2048 && sampleRate == 48000.0) return &tables48k;
+    return nullptr;
+}
+
+// In-place iterative radix-2 FFT over (re, im) using the tables' twiddles
+inline void fft(double* re, double* im, const SpectralTables& tables) {
+    int n = tables.fftSize;
+    for (int i = 0; i < n; i++) {
+        int j = tables.bitReverse[i];
+        if (i < j) {
+            double tr = re[i]; re[i] = re[j]; re[j] = tr;
+            double ti = im[i]; im[i] = im[j]; im[j] = ti;
+        }
+    }
+
+    for (int size = 2; size <= n; size <<= 1) {
+        int half = size >> 1;
+        int step = n / size;
+        for (int base = 0; base < n; base += size) {
+            for (int k = 0; k < half; k++) {
+                double wr = tables.twiddleCos[k * step];
+                double wi = tables.twiddleSin[k * step];
+                int a = base + k;
+                int b = a + half;
+                double tr = re[b] * wr - im[b] * wi;
+                double ti = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+}
+
+} // namespace dsp
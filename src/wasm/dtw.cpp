@@ -1,190 +1,21 @@
 #include <vector>
-#include <cmath>
 #include <algorithm>
 #include <limits>
+#include <cstdint>
+#include <memory>
 #include <emscripten/emscripten.h>
 #include <emscripten/bind.h>
+#include "cancellation.h"
+#include "dtw.h"
+#include "planner.h"
+#include "progressive.h"
+#include "reference_store.h"
+#include "scoring.h"
+#include "segmenter.h"
+#include "waqf.h"
 
 using namespace emscripten;
 
-struct DTWResult {
-    double distance;
-    std::vector<std::pair<int, int>> path;
-};
-
-class DynamicTimeWarping {
-private:
-    std::vector<std::vector<double>> costMatrix;
-    std::vector<std::vector<int>> pathMatrix;
-    
-    double euclideanDistance(const std::vector<double>& a, const std::vector<double>& b) {
-        if (a.size() != b.size()) {
-            return std::numeric_limits<double>::infinity();
-        }
-        
-        double sum = 0.0;
-        for (size_t i = 0; i < a.size(); i++) {
-            double diff = a[i] - b[i];
-            sum += diff * diff;
-        }
-        return std::sqrt(sum);
-    }
-    
-    double manhattanDistance(const std::vector<double>& a, const std::vector<double>& b) {
-        if (a.size() != b.size()) {
-            return std::numeric_limits<double>::infinity();
-        }
-        
-        double sum = 0.0;
-        for (size_t i = 0; i < a.size(); i++) {
-            sum += std::abs(a[i] - b[i]);
-        }
-        return sum;
-    }
-    
-public:
-    DTWResult compute(const std::vector<std::vector<double>>& seq1, 
-                     const std::vector<std::vector<double>>& seq2,
-                     const std::string& distanceMetric = "euclidean") {
-        int n = seq1.size();
-        int m = seq2.size();
-        
-        if (n == 0 || m == 0) {
-            return {std::numeric_limits<double>::infinity(), {}};
-        }
-        
-        // Initialize cost matrix
-        costMatrix.assign(n + 1, std::vector<double>(m + 1, std::numeric_limits<double>::infinity()));
-        pathMatrix.assign(n + 1, std::vector<int>(m + 1, -1));
-        
-        costMatrix[0][0] = 0.0;
-        
-        // Fill cost matrix
-        for (int i = 1; i <= n; i++) {
-            for (int j = 1; j <= m; j++) {
-                double cost;
-                if (distanceMetric == "manhattan") {
-                    cost = manhattanDistance(seq1[i-1], seq2[j-1]);
-                } else {
-                    cost = euclideanDistance(seq1[i-1], seq2[j-1]);
-                }
-                
-                double match = costMatrix[i-1][j-1];
-                double insertion = costMatrix[i][j-1];
-                double deletion = costMatrix[i-1][j];
-                
-                double minCost = std::min({match, insertion, deletion});
-                costMatrix[i][j] = cost + minCost;
-                
-                // Track path
-                if (minCost == match) {
-                    pathMatrix[i][j] = 0; // diagonal
-                } else if (minCost == insertion) {
-                    pathMatrix[i][j] = 1; // horizontal
-                } else {
-                    pathMatrix[i][j] = 2; // vertical
-                }
-            }
-        }
-        
-        // Backtrack to find optimal path
-        std::vector<std::pair<int, int>> path;
-        int i = n, j = m;
-        
-        while (i > 0 && j > 0) {
-            path.push_back({i-1, j-1});
-            
-            switch (pathMatrix[i][j]) {
-                case 0: // diagonal
-                    i--; j--;
-                    break;
-                case 1: // horizontal
-                    j--;
-                    break;
-                case 2: // vertical
-                    i--;
-                    break;
-            }
-        }
-        
-        std::reverse(path.begin(), path.end());
-        
-        return {costMatrix[n][m], path};
-    }
-    
-    DTWResult computeConstrained(const std::vector<std::vector<double>>& seq1,
-                                const std::vector<std::vector<double>>& seq2,
-                                int windowSize) {
-        int n = seq1.size();
-        int m = seq2.size();
-        
-        if (n == 0 || m == 0) {
-            return {std::numeric_limits<double>::infinity(), {}};
-        }
-        
-        // Sakoe-Chiba band constraint
-        costMatrix.assign(n + 1, std::vector<double>(m + 1, std::numeric_limits<double>::infinity()));
-        pathMatrix.assign(n + 1, std::vector<int>(m + 1, -1));
-        
-        costMatrix[0][0] = 0.0;
-        
-        for (int i = 1; i <= n; i++) {
-            int jStart = std::max(1, i - windowSize);
-            int jEnd = std::min(m, i + windowSize);
-            
-            for (int j = jStart; j <= jEnd; j++) {
-                double cost = euclideanDistance(seq1[i-1], seq2[j-1]);
-                
-                double match = costMatrix[i-1][j-1];
-                double insertion = costMatrix[i][j-1];
-                double deletion = costMatrix[i-1][j];
-                
-                double minCost = std::min({match, insertion, deletion});
-                costMatrix[i][j] = cost + minCost;
-                
-                if (minCost == match) {
-                    pathMatrix[i][j] = 0;
-                } else if (minCost == insertion) {
-                    pathMatrix[i][j] = 1;
-                } else {
-                    pathMatrix[i][j] = 2;
-                }
-            }
-        }
-        
-        // Backtrack
-        std::vector<std::pair<int, int>> path;
-        int i = n, j = m;
-        
-        while (i > 0 && j > 0) {
-            path.push_back({i-1, j-1});
-            
-            switch (pathMatrix[i][j]) {
-                case 0:
-                    i--; j--;
-                    break;
-                case 1:
-                    j--;
-                    break;
-                case 2:
-                    i--;
-                    break;
-            }
-        }
-        
-        std::reverse(path.begin(), path.end());
-        
-        return {costMatrix[n][m], path};
-    }
-    
-    double computeNormalizedDistance(const std::vector<std::vector<double>>& seq1,
-                                   const std::vector<std::vector<double>>& seq2) {
-        DTWResult result = compute(seq1, seq2);
-        int pathLength = result.path.size();
-        return pathLength > 0 ? result.distance / pathLength : result.distance;
-    }
-};
-
 // Emscripten bindings
 EMSCRIPTEN_BINDINGS(dtw_module) {
     value_object<std::pair<int, int>>("PathPoint")
@@ -195,6 +26,44 @@ EMSCRIPTEN_BINDINGS(dtw_module) {
         .field("distance", &DTWResult::distance)
         .field("path", &DTWResult::path);
     
+    enum_<DTWAlgorithm>("DTWAlgorithm")
+        .value("Full", DTWAlgorithm::Full)
+        .value("Banded", DTWAlgorithm::Banded)
+        .value("DistanceOnly", DTWAlgorithm::DistanceOnly)
+        .value("FastDTW", DTWAlgorithm::FastDTW)
+        .value("Hirschberg", DTWAlgorithm::Hirschberg);
+    
+    value_object<WorkspacePlan>("WorkspacePlan")
+        .field("feasible", &WorkspacePlan::feasible)
+        .field("downgraded", &WorkspacePlan::downgraded)
+        .field("dtwAlgorithm", &WorkspacePlan::dtwAlgorithm)
+        .field("bandWidth", &WorkspacePlan::bandWidth)
+        .field("inputBytes", &WorkspacePlan::inputBytes)
+        .field("scratchBytes", &WorkspacePlan::scratchBytes);
+    
+    value_object<AlignmentPlan>("AlignmentPlan")
+        .field("algorithm", &AlignmentPlan::algorithm)
+        .field("bandWidth", &AlignmentPlan::bandWidth)
+        .field("radius", &AlignmentPlan::radius)
+        .field("threads", &AlignmentPlan::threads)
+        .field("singlePrecision", &AlignmentPlan::singlePrecision)
+        .field("exact", &AlignmentPlan::exact)
+        .field("feasible", &AlignmentPlan::feasible)
+        .field("withinLatency", &AlignmentPlan::withinLatency)
+        .field("estimatedMs", &AlignmentPlan::estimatedMs)
+        .field("workspaceBytes", &AlignmentPlan::workspaceBytes);
+    
+    value_object<FeatureBuffer>("FeatureBuffer")
+        .field("data", &FeatureBuffer::data)
+        .field("rows", &FeatureBuffer::rows)
+        .field("cols", &FeatureBuffer::cols)
+        .field("stride", &FeatureBuffer::stride);
+    
+    value_object<AlignmentView>("AlignmentView")
+        .field("distance", &AlignmentView::distance)
+        .field("pathLength", &AlignmentView::pathLength)
+        .field("path", &AlignmentView::path);
+    
     register_vector<double>("VectorDouble");
     register_vector<std::vector<double>>("VectorVectorDouble");
     register_vector<std::pair<int, int>>("VectorPathPoint");
@@ -203,61 +72,475 @@ EMSCRIPTEN_BINDINGS(dtw_module) {
         .constructor<>()
         .function("compute", &DynamicTimeWarping::compute)
         .function("computeConstrained", &DynamicTimeWarping::computeConstrained)
-        .function("computeNormalizedDistance", &DynamicTimeWarping::computeNormalizedDistance);
+        .function("computeNormalizedDistance", &DynamicTimeWarping::computeNormalizedDistance)
+        .function("computePlanned", &DynamicTimeWarping::computePlanned)
+        .function("sequenceInput", &DynamicTimeWarping::sequenceInput)
+        .function("alignInputs", &DynamicTimeWarping::alignInputs)
+        .class_function("planWorkspace", &DynamicTimeWarping::planWorkspace)
+        .class_function("planAlignment", &planAlignment);
+}
+
+// Reference store opened over a heap region owned by the caller
+static ReferenceStore& referenceStore() {
+    static ReferenceStore store;
+    return store;
+}
+
+static bool validReference(int entry) {
+    return entry >= 0 && entry < referenceStore().entryCount();
+}
+
+// Last plan made by plan_alignment() or compute_adaptive_dtw()
+static AlignmentPlan& lastAlignmentPlan() {
+    static AlignmentPlan plan = {};
+    return plan;
 }
 
+// Handle behind the segmentation_* API
+struct Segmentation {
+    std::vector<RecitationSegment> segments;
+    RecitationReport report;
+};
+
+// Handle behind the waqf_* API
+struct WaqfCheck {
+    std::vector<WaqfPause> pauses;
+};
+
+// Handle behind the dtw_task_* API. Caller sequences are read in place.
+// Reference alignments copy the query to float32 like compute_reference_dtw,
+// and decode non-float32 entries into the task since the arena may rewind
+// between steps.
+struct AlignmentTask {
+    FeatureMatrixF query;
+    FeatureMatrixF decoded;
+    std::unique_ptr<DTWTask<double>> exact;
+    std::unique_ptr<DTWTask<float>> reference;
+    
+    bool step(double budgetUs) { return exact ? exact->step(budgetUs) : reference->step(budgetUs); }
+    double progress() const { return exact ? exact->progress() : reference->progress(); }
+    DTWOutcome outcome() const { return exact ? exact->outcome() : reference->outcome(); }
+};
+
 // C-style API for direct calling
+//
+// Sequences are wrapped in FeatureViews over caller memory, no copies. scratch_alloc() hands out
+// input buffers from the analysis arena; scratch_reset() releases them and
+// all per-call scratch at once. Call reserve_dtw_workspace() first so the
+// inputs and the whole computation fit in a single up-front grow.
 extern "C" {
+    EMSCRIPTEN_KEEPALIVE
+    void* scratch_alloc(int bytes) {
+        return analysisArena().allocate(bytes);
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    void scratch_reset() {
+        analysisArena().reset();
+    }
+    
+    // Control block polled by the long-running calls below (cancellation.h).
+    // Set the deadline (and clear the cancel flag) before a call, then read
+    // the status: anything but Complete means the result is incomplete.
+    EMSCRIPTEN_KEEPALIVE
+    CancelControl* cancel_control() {
+        return &moduleCancelControl();
+    }
+    
+    // Returns the number of bytes reserved for one compute_* call over these
+    // inputs, or -1 when they exceed budget_bytes (0 = unlimited).
+    EMSCRIPTEN_KEEPALIVE
+    double reserve_dtw_workspace(int seq1_len, int seq2_len, int feature_dim,
+                                 double budget_bytes) {
+        WorkspacePlan plan = DynamicTimeWarping::planWorkspace(seq1_len, seq2_len, feature_dim,
+                                                               DTWAlgorithm::Full, -1, false,
+                                                               budget_bytes);
+        return reserveWorkspace(plan) ? static_cast<double>(plan.totalBytes()) : -1.0;
+    }
+    
     EMSCRIPTEN_KEEPALIVE
     double compute_dtw_distance(double* seq1, int seq1_len, int feature_dim1,
                                double* seq2, int seq2_len, int feature_dim2) {
-        if (feature_dim1 != feature_dim2) {
+        CancelScope cancel(moduleCancelControl());
+        DynamicTimeWarping dtw;
+        return dtw.align(FeatureView(seq1, seq1_len, feature_dim1),
+                         FeatureView(seq2, seq2_len, feature_dim2),
+                         DistanceMetric::Euclidean, -1, nullptr).distance;
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    double compute_normalized_dtw(double* seq1, int seq1_len, int feature_dim1,
+                                 double* seq2, int seq2_len, int feature_dim2) {
+        CancelScope cancel(moduleCancelControl());
+        DynamicTimeWarping dtw;
+        DTWOutcome outcome = dtw.align(FeatureView(seq1, seq1_len, feature_dim1),
+                                       FeatureView(seq2, seq2_len, feature_dim2),
+                                       DistanceMetric::Euclidean, -1, nullptr);
+        return outcome.pathLength > 0 ? outcome.distance / outcome.pathLength : outcome.distance;
+    }
+    
+    // Single-precision variant for Float32Array features (half the memory)
+    EMSCRIPTEN_KEEPALIVE
+    double compute_normalized_dtw_f32(float* seq1, int seq1_len, int feature_dim1,
+                                      float* seq2, int seq2_len, int feature_dim2) {
+        CancelScope cancel(moduleCancelControl());
+        DynamicTimeWarping dtw;
+        DTWOutcome outcome = dtw.align(FeatureViewF(seq1, seq1_len, feature_dim1),
+                                       FeatureViewF(seq2, seq2_len, feature_dim2),
+                                       DistanceMetric::Euclidean, -1, nullptr);
+        return outcome.pathLength > 0 ? outcome.distance / outcome.pathLength : outcome.distance;
+    }
+    
+    // Adaptive alignment (planner.h). plan_alignment() only plans;
+    // compute_adaptive_dtw() plans and runs, returning the normalised
+    // distance (infinity when no plan fits in memory). Both return or leave
+    // the chosen plan in the block at alignment_plan(). Budgets of 0 mean
+    // unlimited; tolerance 0 asks for the exact distance.
+    EMSCRIPTEN_KEEPALIVE
+    AlignmentPlan* plan_alignment(int seq1_len, int seq2_len, int feature_dim, int need_path,
+                                  double memory_budget, double latency_ms, double tolerance) {
+        lastAlignmentPlan() = planAlignment(seq1_len, seq2_len, feature_dim, need_path != 0,
+                                            memory_budget, latency_ms, tolerance);
+        return &lastAlignmentPlan();
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    AlignmentPlan* alignment_plan() {
+        return &lastAlignmentPlan();
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    double compute_adaptive_dtw(double* seq1, int seq1_len, int feature_dim1,
+                                double* seq2, int seq2_len, int feature_dim2,
+                                double memory_budget, double latency_ms, double tolerance) {
+        AlignmentPlan& plan = lastAlignmentPlan();
+        plan = planAlignment(seq1_len, seq2_len, feature_dim1, false, memory_budget, latency_ms, tolerance);
+        if (feature_dim1 != feature_dim2 || !plan.feasible) {
             return std::numeric_limits<double>::infinity();
         }
-        
-        std::vector<std::vector<double>> sequence1(seq1_len, std::vector<double>(feature_dim1));
-        std::vector<std::vector<double>> sequence2(seq2_len, std::vector<double>(feature_dim2));
-        
-        for (int i = 0; i < seq1_len; i++) {
-            for (int j = 0; j < feature_dim1; j++) {
-                sequence1[i][j] = seq1[i * feature_dim1 + j];
-            }
+        CancelScope cancel(moduleCancelControl());
+        DynamicTimeWarping dtw;
+        DTWOutcome outcome = runAlignmentPlan(dtw, FeatureView(seq1, seq1_len, feature_dim1),
+                                              FeatureView(seq2, seq2_len, feature_dim2), plan, nullptr);
+        return outcome.pathLength > 0 ? outcome.distance / outcome.pathLength : outcome.distance;
+    }
+    
+    // Reference store (see reference_store.h). JS copies the store file into
+    // a malloc()ed region that it keeps alive while the store is open; the
+    // store reads it in place. Returns the number of entries, or -1 for a
+    // malformed file.
+    EMSCRIPTEN_KEEPALIVE
+    int reference_store_open(const uint8_t* data, double size_bytes) {
+        if (!referenceStore().open(data, static_cast<size_t>(std::max(0.0, size_bytes)))) {
+            return -1;
         }
-        
-        for (int i = 0; i < seq2_len; i++) {
-            for (int j = 0; j < feature_dim2; j++) {
-                sequence2[i][j] = seq2[i * feature_dim2 + j];
-            }
+        return referenceStore().entryCount();
+    }
+    
+    // Entry index for (surah, ayah, reciter), or -1
+    EMSCRIPTEN_KEEPALIVE
+    int reference_find(int surah, int ayah, int reciter) {
+        return referenceStore().find(surah, ayah, reciter);
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    int reference_frames(int entry) {
+        return validReference(entry) ? static_cast<int>(referenceStore().entry(entry).frames) : 0;
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    int reference_feature_dim() {
+        return referenceStore().featureDim();
+    }
+    
+    // Feature options (denoise 2, loudness 4) the store was built with;
+    // queries extracted with the same ones compare like for like
+    EMSCRIPTEN_KEEPALIVE
+    int reference_front_end() {
+        return static_cast<int>(referenceStore().frontEnd());
+    }
+    
+    // Row stride (in floats) of reference_features() results
+    EMSCRIPTEN_KEEPALIVE
+    int reference_feature_stride() {
+        return static_cast<int>(paddedStride<float>(referenceStore().featureDim()));
+    }
+    
+    // Float32 rows of the entry: inside the store, or decoded into the arena
+    // (valid until scratch_reset()) for float16/int8 stores
+    EMSCRIPTEN_KEEPALIVE
+    const float* reference_features(int entry) {
+        if (!validReference(entry)) return nullptr;
+        return referenceStore().features(entry, analysisArena()).data();
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    int reference_word_count(int entry) {
+        return validReference(entry) ? static_cast<int>(referenceStore().entry(entry).words) : 0;
+    }
+    
+    // word_count + 1 frame indices, or null when the entry has none
+    EMSCRIPTEN_KEEPALIVE
+    const uint32_t* reference_word_boundaries(int entry) {
+        return validReference(entry) ? referenceStore().wordBoundaries(entry) : nullptr;
+    }
+    
+    // Normalised DTW between a query and a stored reference over the first
+    // feature_dim columns. Size the arena with reserve_dtw_workspace(query_len,
+    // reference_frames(entry), feature_dim) first.
+    EMSCRIPTEN_KEEPALIVE
+    double compute_reference_dtw(double* query, int query_len, int feature_dim, int entry) {
+        if (!validReference(entry) || feature_dim > referenceStore().featureDim()) {
+            return std::numeric_limits<double>::infinity();
         }
-        
-        DynamicTimeWarping dtw;
-        DTWResult result = dtw.compute(sequence1, sequence2);
-        return result.distance;
+        CancelScope cancel(moduleCancelControl());
+        return referenceDistance(referenceStore(), entry, FeatureView(query, query_len, feature_dim));
     }
     
+    // LB_Keogh bound on the unnormalised DTW distance against the entry's
+    // envelope; 0 when the store has no envelopes
     EMSCRIPTEN_KEEPALIVE
-    double compute_normalized_dtw(double* seq1, int seq1_len, int feature_dim1,
-                                 double* seq2, int seq2_len, int feature_dim2) {
+    double reference_lower_bound(double* query, int query_len, int feature_dim, int entry) {
+        if (!validReference(entry) || !referenceStore().hasEnvelope(entry) ||
+            feature_dim > referenceStore().featureDim()) {
+            return 0.0;
+        }
+        FeatureViewF upper = referenceStore().upperEnvelope(entry);
+        FeatureViewF lower = referenceStore().lowerEnvelope(entry);
+        return lbKeogh(FeatureView(query, query_len, feature_dim),
+                       FeatureViewF(upper.data(), upper.rows(), feature_dim, upper.stride()),
+                       FeatureViewF(lower.data(), lower.rows(), feature_dim, lower.stride()));
+    }
+    
+    // Time-sliced alignment for the main thread (DTWTask). Create a task,
+    // call dtw_task_step() with a budget in microseconds until it returns 1,
+    // yielding to the browser in between, then read the distance. The input
+    // sequences must stay allocated until the task is destroyed.
+    EMSCRIPTEN_KEEPALIVE
+    AlignmentTask* dtw_task_create(double* seq1, int seq1_len, int feature_dim1,
+                                   double* seq2, int seq2_len, int feature_dim2, int window_size) {
+        AlignmentTask* task = new AlignmentTask();
+        task->exact.reset(new DTWTask<double>(FeatureView(seq1, seq1_len, feature_dim1),
+                                              FeatureView(seq2, seq2_len, feature_dim2),
+                                              DistanceMetric::Euclidean, window_size, false));
+        return task;
+    }
+    
+    // Against a stored reference entry, as compute_reference_dtw; null for
+    // an unknown entry. The store must stay open until the task is destroyed.
+    EMSCRIPTEN_KEEPALIVE
+    AlignmentTask* dtw_task_create_reference(double* query, int query_len, int feature_dim, int entry) {
+        if (!validReference(entry) || feature_dim > referenceStore().featureDim()) {
+            return nullptr;
+        }
+        AlignmentTask* task = new AlignmentTask();
+        task->query.resize(query_len, feature_dim);
+        for (int i = 0; i < query_len; i++) {
+            std::copy(query + static_cast<size_t>(i) * feature_dim,
+                      query + static_cast<size_t>(i + 1) * feature_dim, task->query.row(i));
+        }
+        FeatureViewF full;
+        if (referenceStore().encoding() == ReferenceEncoding::Float32) {
+            full = referenceStore().features(entry, analysisArena());
+        } else {
+            task->decoded.resize(referenceStore().entry(entry).frames, referenceStore().featureDim());
+            referenceStore().decode(entry, task->decoded.mutableView());
+            full = task->decoded.view();
+        }
+        FeatureViewF reference(full.data(), full.rows(), feature_dim, full.stride());
+        task->reference.reset(new DTWTask<float>(task->query.view(), reference,
+                                                 DistanceMetric::Euclidean, -1, false));
+        return task;
+    }
+    
+    // Returns 1 once the alignment is complete
+    EMSCRIPTEN_KEEPALIVE
+    int dtw_task_step(AlignmentTask* task, double budget_us) {
+        return task && task->step(budget_us) ? 1 : 0;
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    double dtw_task_progress(AlignmentTask* task) {
+        return task ? task->progress() : 0.0;
+    }
+    
+    // Normalised distance once complete, as compute_normalized_dtw
+    EMSCRIPTEN_KEEPALIVE
+    double dtw_task_normalized_distance(AlignmentTask* task) {
+        if (!task) return std::numeric_limits<double>::infinity();
+        DTWOutcome outcome = task->outcome();
+        return outcome.pathLength > 0 ? outcome.distance / outcome.pathLength : outcome.distance;
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    void dtw_task_destroy(AlignmentTask* task) {
+        delete task;
+    }
+    
+    // Anytime analysis (progressive.h). Each progressive_advance() runs one
+    // stage and returns the stage it published to progressive_result(), or
+    // 0 once there is nothing left to do. The query is copied, so it can be
+    // released straight after creation.
+    EMSCRIPTEN_KEEPALIVE
+    ProgressiveAnalysis* progressive_create(double* query, int query_len, int feature_dim1,
+                                            double* reference, int reference_len, int feature_dim2) {
         if (feature_dim1 != feature_dim2) {
-            return std::numeric_limits<double>::infinity();
+            return nullptr;
+        }
+        return new ProgressiveAnalysis(FeatureView(query, query_len, feature_dim1),
+                                       FeatureView(reference, reference_len, feature_dim2));
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    ProgressiveAnalysis* progressive_create_reference(double* query, int query_len, int feature_dim, int entry) {
+        if (!validReference(entry) || feature_dim > referenceStore().featureDim()) {
+            return nullptr;
         }
+        return new ProgressiveAnalysis(FeatureView(query, query_len, feature_dim), referenceStore(), entry);
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    int progressive_advance(ProgressiveAnalysis* analysis) {
+        if (!analysis) return 0;
+        CancelScope cancel(moduleCancelControl());
+        return static_cast<int>(analysis->advance());
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    ProgressiveResult* progressive_result(ProgressiveAnalysis* analysis) {
+        return analysis ? &analysis->result() : nullptr;
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    void progressive_destroy(ProgressiveAnalysis* analysis) {
+        delete analysis;
+    }
+    
+    // Long recordings (segmenter.h). Splits the query into segments for
+    // ayahs first_ayah..last_ayah of `surah` in the open reference store
+    // (surah 0: at pauses only), scores them and keeps the per-segment
+    // results and the combined report until segmentation_destroy(). The
+    // query is not retained. Rows are feature_dim wide; the first dtw_dim
+    // columns are aligned and scored and energy_column holds the RMS energy
+    // pauses are found from. frame_rate is feature frames per second.
+    // Returns null when the columns do not fit the rows.
+    EMSCRIPTEN_KEEPALIVE
+    Segmentation* segment_recitation(double* query, int query_len, int feature_dim, int dtw_dim,
+                                     int energy_column, double frame_rate, int surah, int first_ayah,
+                                     int last_ayah, int reciter) {
+        if (frame_rate <= 0.0 || dtw_dim <= 0 || dtw_dim > feature_dim || energy_column < 0 ||
+            energy_column >= feature_dim) {
+            return nullptr;
+        }
+        SegmenterConfig config;
+        config.frameRate = frame_rate;
+        config.energyColumn = energy_column;
+        config.alignColumns = dtw_dim;
         
-        std::vector<std::vector<double>> sequence1(seq1_len, std::vector<double>(feature_dim1));
-        std::vector<std::vector<double>> sequence2(seq2_len, std::vector<double>(feature_dim2));
+        Segmentation* segmentation = new Segmentation();
+        CancelScope cancel(moduleCancelControl());
+        segmentation->report = segmentRecitation(FeatureView(query, query_len, feature_dim), &referenceStore(),
+                                                 surah, first_ayah, last_ayah, reciter, config,
+                                                 segmentation->segments);
+        return segmentation;
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    RecitationReport* segmentation_report(Segmentation* segmentation) {
+        return segmentation ? &segmentation->report : nullptr;
+    }
+    
+    // report.segments entries
+    EMSCRIPTEN_KEEPALIVE
+    RecitationSegment* segmentation_segments(Segmentation* segmentation) {
+        return segmentation ? segmentation->segments.data() : nullptr;
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    void segmentation_destroy(Segmentation* segmentation) {
+        delete segmentation;
+    }
+    
+    // Waqf verification (waqf.h). The query is aligned to a stored entry
+    // with word boundaries to place its words, then its rows are run through
+    // a WaqfDetector once. Rows are feature_dim wide; the first dtw_dim
+    // columns are aligned, and energy_column / pitch_column must lie within
+    // the row. marks holds one WaqfMark per word of the entry. Returns null
+    // when a column is out of range, the entry has no word boundaries or
+    // the counts differ.
+    EMSCRIPTEN_KEEPALIVE
+    WaqfCheck* detect_waqf(double* query, int query_len, int feature_dim, int dtw_dim, int energy_column,
+                           int pitch_column, double frame_rate, int entry,
+                           const int32_t* marks, int mark_count) {
+        if (!validReference(entry) || dtw_dim <= 0 || dtw_dim > feature_dim ||
+            dtw_dim > referenceStore().featureDim() || frame_rate <= 0.0) {
+            return nullptr;
+        }
+        if (energy_column < 0 || energy_column >= feature_dim || pitch_column < 0 ||
+            pitch_column >= feature_dim) {
+            return nullptr;
+        }
+        const uint32_t* boundaries = referenceStore().wordBoundaries(entry);
+        int words = static_cast<int>(referenceStore().entry(entry).words);
+        if (!boundaries || words == 0 || words != mark_count) {
+            return nullptr;
+        }
         
-        for (int i = 0; i < seq1_len; i++) {
-            for (int j = 0; j < feature_dim1; j++) {
-                sequence1[i][j] = seq1[i * feature_dim1 + j];
+        CancelScope cancel(moduleCancelControl());
+        FeatureView features(query, query_len, feature_dim);
+        std::vector<std::pair<int, int>> path;
+        {
+            ScratchArena& arena = analysisArena();
+            ArenaScope scope(arena);
+            FeatureViewF full = referenceStore().features(entry, arena);
+            FeatureViewF reference(full.data(), full.rows(), dtw_dim, full.stride());
+            MutableFeatureViewF queryF = arenaFeatures<float>(arena, query_len, dtw_dim);
+            for (int i = 0; i < query_len; i++) {
+                std::copy(features.row(i), features.row(i) + dtw_dim, queryF.row(i));
+            }
+            // Linear memory, so long verses fit
+            DynamicTimeWarping dtw;
+            DTWOutcome outcome = dtw.alignHirschberg(FeatureViewF(queryF), reference,
+                                                     DistanceMetric::Euclidean, &path);
+            if (std::isnan(outcome.distance) || path.empty()) {
+                return nullptr;
             }
         }
         
-        for (int i = 0; i < seq2_len; i++) {
-            for (int j = 0; j < feature_dim2; j++) {
-                sequence2[i][j] = seq2[i * feature_dim2 + j];
-            }
+        std::vector<int32_t> wordStarts(words + 1);
+        wordStartsFromPath(path, boundaries, words, query_len, wordStarts.data());
+        std::vector<WaqfMark> wordMarks(words);
+        for (int w = 0; w < words; w++) {
+            wordMarks[w] = static_cast<WaqfMark>(marks[w]);
         }
         
-        DynamicTimeWarping dtw;
-        return dtw.computeNormalizedDistance(sequence1, sequence2);
+        WaqfConfig config;
+        config.frameRate = frame_rate;
+        config.energyColumn = energy_column;
+        config.pitchColumn = pitch_column;
+        WaqfDetector detector(config, wordStarts.data(), wordMarks.data(), words);
+        for (int i = 0; i < query_len; i++) {
+            detector.push(features.row(i), feature_dim);
+        }
+        detector.finish();
+        
+        WaqfCheck* check = new WaqfCheck();
+        check->pauses = detector.pauses();
+        return check;
     }
-}
\ No newline at end of file
+    
+    EMSCRIPTEN_KEEPALIVE
+    int waqf_count(WaqfCheck* check) {
+        return check ? static_cast<int>(check->pauses.size()) : 0;
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    WaqfPause* waqf_pauses(WaqfCheck* check) {
+        return check ? check->pauses.data() : nullptr;
+    }
+    
+    EMSCRIPTEN_KEEPALIVE
+    void waqf_destroy(WaqfCheck* check) {
+        delete check;
+    }
+}
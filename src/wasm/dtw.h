@@ -0,0 +1,963 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <cstdint>
+#include "arena.h"
+#include "cancellation.h"
+#include "feature_matrix.h"
+#include "scheduler.h"
+#include "time_slice.h"
+#include "workspace.h"
+
+struct DTWResult {
+    double distance;
+    std::vector<std::pair<int, int>> path;
+};
+
+struct DTWOutcome {
+    double distance;
+    int pathLength;
+};
+
+// Where a pattern matched inside a longer series: series frames [start, end)
+struct DTWMatch {
+    double distance;
+    int pathLength;
+    int start;
+    int end;
+};
+
+#ifdef __EMSCRIPTEN__
+// `path` is an Int32Array of interleaved (query, reference) indices
+struct AlignmentView {
+    double distance;
+    int pathLength;
+    emscripten::val path;
+};
+#endif
+
+enum class DistanceMetric {
+    Euclidean,
+    Manhattan
+};
+
+// Per-row column ranges for a path-constrained alignment: row i covers
+// columns [start[i], end[i]] (1-based, row 0 is the origin cell) and its
+// cells begin at offset[i] in the step storage. Built by projectCorridor()
+// around a path found at a coarser resolution, so the search grows
+// linearly with the sequence lengths rather than with their product.
+struct DTWCorridor {
+    PoolVector<int32_t> start;
+    PoolVector<int32_t> end;
+    PoolVector<size_t> offset;
+    
+    int rows() const { return static_cast<int>(start.size()) - 1; }
+    size_t cells() const { return offset.empty() ? 0 : offset.back(); }
+};
+
+// Projects a path over sequences downsampled by `factor` back onto the full
+// n x m grid and widens it by `radius` cells on every side (as in FastDTW).
+// The result is connected, so the end cell stays reachable.
+inline void projectCorridor(const std::vector<std::pair<int, int>>& coarsePath, int factor,
+                            int n, int m, int radius, DTWCorridor& corridor) {
+    corridor.start.assign(n + 1, m + 1);
+    corridor.end.assign(n + 1, 0);
+    corridor.start[0] = 0;
+    
+    for (const std::pair<int, int>& cell : coarsePath) {
+        int rowFirst = std::max(0, cell.first * factor - radius);
+        int rowLast = std::min(n - 1, cell.first * factor + factor - 1 + radius);
+        int colFirst = std::max(0, cell.second * factor - radius) + 1;
+        int colLast = std::min(m - 1, cell.second * factor + factor - 1 + radius) + 1;
+        for (int r = rowFirst + 1; r <= rowLast + 1; r++) {
+            corridor.start[r] = std::min(corridor.start[r], colFirst);
+            corridor.end[r] = std::max(corridor.end[r], colLast);
+        }
+    }
+    
+    corridor.offset.resize(n + 2);
+    corridor.offset[0] = 0;
+    for (int i = 0; i <= n; i++) {
+        int width = std::max(0, corridor.end[i] - corridor.start[i] + 1);
+        corridor.offset[i + 1] = corridor.offset[i] + width;
+    }
+}
+
+// Averages each run of `factor` rows (the last run may be shorter)
+template <typename T>
+inline void downsampleFeatures(BasicFeatureView<T> input, int factor, BasicFeatureMatrix<T>& output) {
+    int rows = (input.rows() + factor - 1) / factor;
+    int cols = input.cols();
+    output.resize(rows, cols);
+    for (int r = 0; r < rows; r++) {
+        int first = r * factor;
+        int last = std::min(input.rows(), first + factor);
+        T* out = output.row(r);
+        std::fill(out, out + cols, T(0));
+        for (int i = first; i < last; i++) {
+            const T* in = input.row(i);
+            for (int c = 0; c < cols; c++) {
+                out[c] += in[c];
+            }
+        }
+        T scale = T(1) / static_cast<T>(last - first);
+        for (int c = 0; c < cols; c++) {
+            out[c] *= scale;
+        }
+    }
+}
+
+template <typename T>
+class DTWTask;
+
+class DynamicTimeWarping {
+private:
+    template <typename T>
+    friend class DTWTask;
+    
+    // Buffers behind the typed_memory_view APIs
+    FeatureMatrixF sequenceInputs[2];
+    std::vector<std::pair<int, int>> pathScratch;
+    PoolVector<int32_t> pathOutput;
+    
+    // Backtracking steps stored per cell
+    enum Step : uint8_t {
+        kDiagonal = 0,
+        kHorizontal = 1,
+        kVertical = 2,
+        kNone = 3
+    };
+    
+    template <typename T>
+    static double euclideanDistance(const T* a, const T* b, int dim) {
+        double sum = 0.0;
+        for (int i = 0; i < dim; i++) {
+            double diff = static_cast<double>(a[i]) - b[i];
+            sum += diff * diff;
+        }
+        return std::sqrt(sum);
+    }
+    
+    template <typename T>
+    static double manhattanDistance(const T* a, const T* b, int dim) {
+        double sum = 0.0;
+        for (int i = 0; i < dim; i++) {
+            sum += std::abs(static_cast<double>(a[i]) - b[i]);
+        }
+        return sum;
+    }
+    
+    template <typename T>
+    static double distance(const T* a, const T* b, int dim, DistanceMetric metric) {
+        return metric == DistanceMetric::Manhattan
+            ? manhattanDistance(a, b, dim)
+            : euclideanDistance(a, b, dim);
+    }
+    
+    // Columns [jStart, jEnd] of row i, inside the band when windowSize >= 0
+    static void rowBounds(int i, int m, int windowSize, int& jStart, int& jEnd) {
+        jStart = windowSize < 0 ? 1 : std::max(1, i - windowSize);
+        jEnd = windowSize < 0 ? m : std::min(m, i + windowSize);
+    }
+    
+    // One row of the two-row recurrence, tracking path lengths alongside
+    // the costs. Same tie-breaking as the backtracking of the stored variant.
+    template <typename T>
+    static void rollingRow(BasicFeatureView<T> seq1, BasicFeatureView<T> seq2, DistanceMetric metric,
+                           int windowSize, int i, const double* prevRow, double* row,
+                           const int* prevLength, int* rowLength) {
+        int m = seq2.rows();
+        int dim = seq1.cols();
+        int jStart, jEnd;
+        rowBounds(i, m, windowSize, jStart, jEnd);
+        const T* a = seq1.row(i - 1);
+        
+        std::fill(row, row + m + 1, std::numeric_limits<double>::infinity());
+        std::fill(rowLength, rowLength + m + 1, 0);
+        
+        for (int j = jStart; j <= jEnd; j++) {
+            const T* b = seq2.row(j - 1);
+            double d = distance(a, b, dim, metric);
+            
+            double match = prevRow[j - 1];
+            double insertion = row[j - 1];
+            double deletion = prevRow[j];
+            
+            double minCost = std::min({match, insertion, deletion});
+            row[j] = d + minCost;
+            if (minCost == match) {
+                rowLength[j] = prevLength[j - 1] + 1;
+            } else if (minCost == insertion) {
+                rowLength[j] = rowLength[j - 1] + 1;
+            } else {
+                rowLength[j] = prevLength[j] + 1;
+            }
+        }
+    }
+    
+    // Cost and backtracking steps for the full matrix (windowSize < 0) or
+    // for a Sakoe-Chiba band of 2w+1 cells per row, over caller storage of
+    // cellsFor() elements each
+    struct StepMatrix {
+        double* cost;
+        uint8_t* steps;
+        int windowSize;
+        int width;
+        
+        static int widthFor(int m, int windowSize) {
+            return windowSize >= 0 ? 2 * windowSize + 1 : m + 1;
+        }
+        
+        static size_t cellsFor(int n, int m, int windowSize) {
+            return static_cast<size_t>(n + 1) * widthFor(m, windowSize);
+        }
+        
+        // Row i stores columns [rowStart(i), rowStart(i) + width)
+        long cell(int i, int j) const {
+            int col = j - (windowSize >= 0 ? i - windowSize : 0);
+            return (col >= 0 && col < width) ? static_cast<long>(i) * width + col : -1;
+        }
+        
+        double costAt(int i, int j) const {
+            long index = cell(i, j);
+            return index < 0 ? std::numeric_limits<double>::infinity() : cost[index];
+        }
+        
+        void bounds(int i, int m, int& jStart, int& jEnd) const {
+            rowBounds(i, m, windowSize, jStart, jEnd);
+        }
+        
+        void clear(int n) {
+            size_t cells = static_cast<size_t>(n + 1) * width;
+            std::fill(cost, cost + cells, std::numeric_limits<double>::infinity());
+            std::fill(steps, steps + cells, static_cast<uint8_t>(kNone));
+            cost[cell(0, 0)] = 0.0;
+        }
+    };
+    
+    // The same over a DTWCorridor, storing only the corridor's cells
+    struct CorridorMatrix {
+        double* cost;
+        uint8_t* steps;
+        const DTWCorridor* corridor;
+        
+        long cell(int i, int j) const {
+            return (j >= corridor->start[i] && j <= corridor->end[i])
+                ? static_cast<long>(corridor->offset[i] + (j - corridor->start[i])) : -1;
+        }
+        
+        double costAt(int i, int j) const {
+            long index = cell(i, j);
+            return index < 0 ? std::numeric_limits<double>::infinity() : cost[index];
+        }
+        
+        void bounds(int i, int, int& jStart, int& jEnd) const {
+            jStart = corridor->start[i];
+            jEnd = corridor->end[i];
+        }
+        
+        void clear(int) {
+            std::fill(cost, cost + corridor->cells(), std::numeric_limits<double>::infinity());
+            std::fill(steps, steps + corridor->cells(), static_cast<uint8_t>(kNone));
+            cost[cell(0, 0)] = 0.0;
+        }
+    };
+    
+    template <typename T, typename Matrix>
+    static void storedRow(BasicFeatureView<T> seq1, BasicFeatureView<T> seq2, DistanceMetric metric,
+                          Matrix& matrix, int i) {
+        int dim = seq1.cols();
+        int jStart, jEnd;
+        matrix.bounds(i, seq2.rows(), jStart, jEnd);
+        const T* a = seq1.row(i - 1);
+        
+        for (int j = jStart; j <= jEnd; j++) {
+            const T* b = seq2.row(j - 1);
+            double d = distance(a, b, dim, metric);
+            
+            double match = matrix.costAt(i - 1, j - 1);
+            double insertion = matrix.costAt(i, j - 1);
+            double deletion = matrix.costAt(i - 1, j);
+            
+            double minCost = std::min({match, insertion, deletion});
+            long index = matrix.cell(i, j);
+            matrix.cost[index] = d + minCost;
+            
+            // Track path
+            if (minCost == match) {
+                matrix.steps[index] = kDiagonal;
+            } else if (minCost == insertion) {
+                matrix.steps[index] = kHorizontal;
+            } else {
+                matrix.steps[index] = kVertical;
+            }
+        }
+    }
+    
+    // Walks the steps back from (n, m); returns the path length
+    template <typename Matrix>
+    static int backtrack(const Matrix& matrix, int n, int m, std::vector<std::pair<int, int>>* path) {
+        if (path) {
+            path->clear();
+            path->reserve(n + m);
+        }
+        int pathLength = 0;
+        int i = n, j = m;
+        
+        while (i > 0 && j > 0) {
+            long index = matrix.cell(i, j);
+            uint8_t step = index < 0 ? static_cast<uint8_t>(kNone) : matrix.steps[index];
+            if (step == kNone) {
+                break; // end cell outside the band
+            }
+            if (path) {
+                path->push_back({i-1, j-1});
+            }
+            pathLength++;
+            
+            switch (step) {
+                case kDiagonal:
+                    i--; j--;
+                    break;
+                case kHorizontal:
+                    j--;
+                    break;
+                case kVertical:
+                    i--;
+                    break;
+            }
+        }
+        
+        if (path) {
+            std::reverse(path->begin(), path->end());
+        }
+        return pathLength;
+    }
+    
+    // Exact distance and path length with two rolling rows; the path itself
+    // is never materialised, so memory is O(m).
+    template <typename T>
+    DTWOutcome alignRolling(BasicFeatureView<T> seq1, BasicFeatureView<T> seq2,
+                            DistanceMetric metric, int windowSize) {
+        int n = seq1.rows();
+        int m = seq2.rows();
+        ScratchArena& arena = analysisArena();
+        ArenaScope scope(arena);
+        
+        size_t cols = m + 1;
+        double* cost = arena.allocateArray<double>(2 * cols);
+        int* length = arena.allocateArray<int>(2 * cols);
+        
+        double* prevRow = cost;
+        double* row = cost + cols;
+        int* prevLength = length;
+        int* rowLength = length + cols;
+        
+        std::fill(prevRow, prevRow + cols, std::numeric_limits<double>::infinity());
+        std::fill(prevLength, prevLength + cols, 0);
+        prevRow[0] = 0.0;
+        
+        CancelPoll cancel(kCancelPollInterval);
+        for (int i = 1; i <= n; i++) {
+            int jStart, jEnd;
+            rowBounds(i, m, windowSize, jStart, jEnd);
+            if (cancel.stop(std::max(0, jEnd - jStart + 1))) {
+                cancel.progress(static_cast<double>(i - 1) / n);
+                return {std::numeric_limits<double>::quiet_NaN(), 0};
+            }
+            
+            rollingRow(seq1, seq2, metric, windowSize, i, prevRow, row, prevLength, rowLength);
+            std::swap(prevRow, row);
+            std::swap(prevLength, rowLength);
+        }
+        
+        return {prevRow[m], prevLength[m]};
+    }
+    
+    // Stores cost and backtracking steps (see StepMatrix)
+    template <typename T>
+    DTWOutcome alignStored(BasicFeatureView<T> seq1, BasicFeatureView<T> seq2,
+                           DistanceMetric metric, int windowSize,
+                           std::vector<std::pair<int, int>>* path) {
+        int n = seq1.rows();
+        int m = seq2.rows();
+        ScratchArena& arena = analysisArena();
+        ArenaScope scope(arena);
+        
+        size_t cells = StepMatrix::cellsFor(n, m, windowSize);
+        StepMatrix matrix = {arena.allocateArray<double>(cells), arena.allocateArray<uint8_t>(cells),
+                             windowSize, StepMatrix::widthFor(m, windowSize)};
+        matrix.clear(n);
+        
+        // Fill cost matrix
+        CancelPoll cancel(kCancelPollInterval);
+        for (int i = 1; i <= n; i++) {
+            int jStart, jEnd;
+            rowBounds(i, m, windowSize, jStart, jEnd);
+            if (cancel.stop(std::max(0, jEnd - jStart + 1))) {
+                cancel.progress(static_cast<double>(i - 1) / n);
+                return {std::numeric_limits<double>::quiet_NaN(), 0};
+            }
+            storedRow(seq1, seq2, metric, matrix, i);
+        }
+        
+        // Backtrack to find optimal path
+        int pathLength = backtrack(matrix, n, m, path);
+        return {matrix.costAt(n, m), pathLength};
+    }
+    
+public:
+    // Core DTW over two feature sequences of equal width. windowSize < 0
+    // disables the Sakoe-Chiba band. Without a `path` output only two rows
+    // are kept; otherwise the full or banded step matrix is stored. All
+    // scratch lives in the analysis arena (see dtwScratchBytes). Under a
+    // CancelScope the row loop stops early when asked to; the distance is
+    // then NaN and the path empty.
+    template <typename T>
+    DTWOutcome align(BasicFeatureView<T> seq1, BasicFeatureView<T> seq2,
+                     DistanceMetric metric, int windowSize,
+                     std::vector<std::pair<int, int>>* path) {
+        if (path) path->clear();
+        if (seq1.empty() || seq2.empty() || seq1.cols() != seq2.cols()) {
+            return {std::numeric_limits<double>::infinity(), 0};
+        }
+        
+        if (!path) {
+            return alignRolling(seq1, seq2, metric, windowSize);
+        }
+        return alignStored(seq1, seq2, metric, windowSize, path);
+    }
+    
+    // Alignment restricted to a corridor over seq1.rows() rows (see
+    // projectCorridor), always with the path. Distance and path are exact
+    // whenever the optimal path lies inside the corridor.
+    template <typename T>
+    DTWOutcome alignCorridor(BasicFeatureView<T> seq1, BasicFeatureView<T> seq2,
+                             DistanceMetric metric, const DTWCorridor& corridor,
+                             std::vector<std::pair<int, int>>* path) {
+        if (path) path->clear();
+        int n = seq1.rows();
+        int m = seq2.rows();
+        if (seq1.empty() || seq2.empty() || seq1.cols() != seq2.cols() || corridor.rows() != n) {
+            return {std::numeric_limits<double>::infinity(), 0};
+        }
+        
+        ScratchArena& arena = analysisArena();
+        ArenaScope scope(arena);
+        size_t cells = corridor.cells();
+        CorridorMatrix matrix = {arena.allocateArray<double>(cells), arena.allocateArray<uint8_t>(cells),
+                                 &corridor};
+        matrix.clear(n);
+        
+        CancelPoll cancel(kCancelPollInterval);
+        for (int i = 1; i <= n; i++) {
+            if (cancel.stop(std::max(0, corridor.end[i] - corridor.start[i] + 1))) {
+                cancel.progress(static_cast<double>(i - 1) / n);
+                return {std::numeric_limits<double>::quiet_NaN(), 0};
+            }
+            storedRow(seq1, seq2, metric, matrix, i);
+        }
+        
+        int pathLength = backtrack(matrix, n, m, path);
+        return {matrix.costAt(n, m), pathLength};
+    }
+    
+    // FastDTW (Salvador & Chan): aligns both sequences at half resolution,
+    // recursively, then refines that path inside a corridor `radius` cells
+    // wide. Time and memory grow linearly with the lengths. The result is
+    // exact whenever the optimal path stays inside the corridors; a wider
+    // radius makes that likelier.
+    template <typename T>
+    DTWOutcome alignFast(BasicFeatureView<T> seq1, BasicFeatureView<T> seq2,
+                         DistanceMetric metric, int radius,
+                         std::vector<std::pair<int, int>>* path) {
+        if (path) path->clear();
+        if (seq1.empty() || seq2.empty() || seq1.cols() != seq2.cols()) {
+            return {std::numeric_limits<double>::infinity(), 0};
+        }
+        radius = std::max(0, radius);
+        int n = seq1.rows();
+        int m = seq2.rows();
+        if (n <= radius + 2 || m <= radius + 2) {
+            return align(seq1, seq2, metric, -1, path);
+        }
+        
+        BasicFeatureMatrix<T> coarse1;
+        BasicFeatureMatrix<T> coarse2;
+        downsampleFeatures(seq1, 2, coarse1);
+        downsampleFeatures(seq2, 2, coarse2);
+        std::vector<std::pair<int, int>> coarsePath;
+        DTWOutcome coarse = alignFast(coarse1.view(), coarse2.view(), metric, radius, &coarsePath);
+        if (std::isnan(coarse.distance)) {
+            return coarse;
+        }
+        
+        DTWCorridor corridor;
+        projectCorridor(coarsePath, 2, n, m, radius, corridor);
+        return alignCorridor(seq1, seq2, metric, corridor, path);
+    }
+    
+    // Exact distance and an optimal path in O(n + m) memory (Hirschberg's
+    // divide and conquer). Each split finds where the path crosses the
+    // middle row from a forward and a backward pass of rolling rows, then
+    // solves both halves; blocks below kHirschbergBaseCells use align().
+    // About twice the cell work of align(). The two passes of a split, and
+    // its two halves, run in parallel on the engine scheduler. Among
+    // equally good paths the one returned may differ from align()'s.
+    template <typename T>
+    DTWOutcome alignHirschberg(BasicFeatureView<T> seq1, BasicFeatureView<T> seq2,
+                               DistanceMetric metric, std::vector<std::pair<int, int>>* path) {
+        if (path) path->clear();
+        if (seq1.empty() || seq2.empty() || seq1.cols() != seq2.cols()) {
+            return {std::numeric_limits<double>::infinity(), 0};
+        }
+        
+        // Workers do not inherit the caller's CancelScope
+        CancelControl* cancel = currentCancelControl();
+        std::vector<std::pair<int, int>> cells;
+        cells.reserve(static_cast<size_t>(seq1.rows()) + seq2.rows());
+        if (!hirschbergSplit(seq1, seq2, metric, 0, seq1.rows() - 1, 0, seq2.rows() - 1, cancel, cells)) {
+            return {std::numeric_limits<double>::quiet_NaN(), 0};
+        }
+        
+        double total = 0.0;
+        for (const std::pair<int, int>& cell : cells) {
+            total += distance(seq1.row(cell.first), seq2.row(cell.second), seq1.cols(), metric);
+        }
+        int pathLength = static_cast<int>(cells.size());
+        if (path) path->swap(cells);
+        return {total, pathLength};
+    }
+    
+    // Best match of `pattern` anywhere inside `series` (subsequence DTW):
+    // the path covers every pattern frame but may start and end at any
+    // series frame. Ends are compared by cost per path step, so short and
+    // long spans compete fairly. Two rolling rows over the series; under a
+    // CancelScope a stopped search returns a NaN distance.
+    template <typename T>
+    DTWMatch alignSubsequence(BasicFeatureView<T> pattern, BasicFeatureView<T> series,
+                              DistanceMetric metric) {
+        DTWMatch match = {std::numeric_limits<double>::infinity(), 0, 0, 0};
+        if (pattern.empty() || series.empty() || pattern.cols() != series.cols()) {
+            return match;
+        }
+        int m = pattern.rows();
+        int w = series.rows();
+        int dim = pattern.cols();
+        ScratchArena& arena = analysisArena();
+        ArenaScope scope(arena);
+        
+        double* cost = arena.allocateArray<double>(2 * static_cast<size_t>(w));
+        int* length = arena.allocateArray<int>(2 * static_cast<size_t>(w));
+        int* origin = arena.allocateArray<int>(2 * static_cast<size_t>(w));
+        double* prevRow = cost;
+        double* row = cost + w;
+        int* prevLength = length;
+        int* rowLength = length + w;
+        int* prevOrigin = origin;
+        int* rowOrigin = origin + w;
+        
+        // The first pattern frame may start at any series frame
+        for (int j = 0; j < w; j++) {
+            prevRow[j] = distance(pattern.row(0), series.row(j), dim, metric);
+            prevLength[j] = 1;
+            prevOrigin[j] = j;
+        }
+        
+        CancelPoll cancel(kCancelPollInterval);
+        for (int i = 1; i < m; i++) {
+            if (cancel.stop(w)) {
+                cancel.progress(static_cast<double>(i) / m);
+                match.distance = std::numeric_limits<double>::quiet_NaN();
+                return match;
+            }
+            const T* p = pattern.row(i);
+            row[0] = prevRow[0] + distance(p, series.row(0), dim, metric);
+            rowLength[0] = prevLength[0] + 1;
+            rowOrigin[0] = prevOrigin[0];
+            for (int j = 1; j < w; j++) {
+                // Same tie-breaking as rollingRow
+                double best = prevRow[j - 1];
+                int from = 0;
+                if (row[j - 1] < best) {
+                    best = row[j - 1];
+                    from = 1;
+                }
+                if (prevRow[j] < best) {
+                    best = prevRow[j];
+                    from = 2;
+                }
+                row[j] = best + distance(p, series.row(j), dim, metric);
+                rowLength[j] = (from == 0 ? prevLength[j - 1] : from == 1 ? rowLength[j - 1] : prevLength[j]) + 1;
+                rowOrigin[j] = from == 0 ? prevOrigin[j - 1] : from == 1 ? rowOrigin[j - 1] : prevOrigin[j];
+            }
+            std::swap(prevRow, row);
+            std::swap(prevLength, rowLength);
+            std::swap(prevOrigin, rowOrigin);
+        }
+        
+        double bestPerStep = std::numeric_limits<double>::infinity();
+        for (int j = 0; j < w; j++) {
+            double perStep = prevRow[j] / prevLength[j];
+            if (perStep < bestPerStep) {
+                bestPerStep = perStep;
+                match = {prevRow[j], prevLength[j], prevOrigin[j], j + 1};
+            }
+        }
+        return match;
+    }
+    
+    template <typename T>
+    DTWResult computeView(BasicFeatureView<T> seq1, BasicFeatureView<T> seq2,
+                          DistanceMetric metric = DistanceMetric::Euclidean,
+                          int windowSize = -1) {
+        DTWResult result;
+        result.distance = align(seq1, seq2, metric, windowSize, &result.path).distance;
+        return result;
+    }
+    
+    // Runs whatever planDTWWorkspace settled on
+    template <typename T>
+    DTWOutcome alignPlanned(BasicFeatureView<T> seq1, BasicFeatureView<T> seq2,
+                            const WorkspacePlan& plan,
+                            std::vector<std::pair<int, int>>* path) {
+        int windowSize = plan.dtwAlgorithm == DTWAlgorithm::Full ? -1 : plan.bandWidth;
+        if (plan.dtwAlgorithm == DTWAlgorithm::DistanceOnly) {
+            path = nullptr;
+        }
+        return align(seq1, seq2, DistanceMetric::Euclidean, windowSize, path);
+    }
+    
+    DTWResult compute(const std::vector<std::vector<double>>& seq1, 
+                     const std::vector<std::vector<double>>& seq2,
+                     const std::string& distanceMetric = "euclidean") {
+        return computeNested(seq1, seq2,
+                             distanceMetric == "manhattan" ? DistanceMetric::Manhattan
+                                                           : DistanceMetric::Euclidean,
+                             -1);
+    }
+    
+    DTWResult computeConstrained(const std::vector<std::vector<double>>& seq1,
+                                const std::vector<std::vector<double>>& seq2,
+                                int windowSize) {
+        // Sakoe-Chiba band constraint
+        return computeNested(seq1, seq2, DistanceMetric::Euclidean, std::max(0, windowSize));
+    }
+    
+#ifdef __EMSCRIPTEN__
+    // Zero-copy embind surface. JS writes both sequences into the views from
+    // sequenceInput(0|1, rows, cols) and calls alignInputs(); the returned
+    // path view lives in this object. Views are invalidated by the next call
+    // that resizes them, by delete() and by WASM memory growth.
+    FeatureBuffer sequenceInput(int which, int rows, int cols) {
+        FeatureMatrixF& input = sequenceInputs[which == 0 ? 0 : 1];
+        input.resize(std::max(0, rows), std::max(0, cols));
+        size_t elements = static_cast<size_t>(input.rows()) * input.stride();
+        return {emscripten::val(emscripten::typed_memory_view(elements, input.data())),
+                input.rows(), input.cols(), static_cast<int>(input.stride())};
+    }
+    
+    // bandWidth < 0 for unconstrained alignment
+    AlignmentView alignInputs(int bandWidth) {
+        DTWOutcome outcome = align(sequenceInputs[0].view(), sequenceInputs[1].view(),
+                                   DistanceMetric::Euclidean, bandWidth, &pathScratch);
+        
+        pathOutput.resize(2 * pathScratch.size());
+        for (size_t k = 0; k < pathScratch.size(); k++) {
+            pathOutput[2 * k] = pathScratch[k].first;
+            pathOutput[2 * k + 1] = pathScratch[k].second;
+        }
+        
+        return {outcome.distance, outcome.pathLength,
+                emscripten::val(emscripten::typed_memory_view(pathOutput.size(), pathOutput.data()))};
+    }
+#endif
+    
+    double computeNormalizedDistance(const std::vector<std::vector<double>>& seq1,
+                                   const std::vector<std::vector<double>>& seq2) {
+        DTWResult result = compute(seq1, seq2);
+        int pathLength = result.path.size();
+        return pathLength > 0 ? result.distance / pathLength : result.distance;
+    }
+    
+    static WorkspacePlan planWorkspace(int n, int m, int dim, DTWAlgorithm algorithm,
+                                       int bandWidth, bool needPath, double budgetBytes) {
+        return planDTWWorkspace(n, m, dim, algorithm, bandWidth, needPath,
+                                static_cast<size_t>(std::max(0.0, budgetBytes)));
+    }
+    
+    // Reserves the plan's workspace once, then aligns without growing memory.
+    // Rejected plans return an infinite distance and no path.
+    DTWResult computePlanned(const std::vector<std::vector<double>>& seq1,
+                             const std::vector<std::vector<double>>& seq2,
+                             const WorkspacePlan& plan) {
+        DTWResult result = {std::numeric_limits<double>::infinity(), {}};
+        if (!reserveWorkspace(plan)) {
+            return result;
+        }
+        
+        ScratchArena& arena = analysisArena();
+        ArenaScope scope(arena);
+        FeatureView view1 = arenaFeaturesFrom<double>(arena, seq1);
+        FeatureView view2 = arenaFeaturesFrom<double>(arena, seq2);
+        result.distance = alignPlanned(view1, view2, plan, &result.path).distance;
+        return result;
+    }
+    
+private:
+    // Hirschberg blocks at or below this many cells are solved directly;
+    // splits at or above kHirschbergParallelCells run on the scheduler
+    static constexpr size_t kHirschbergBaseCells = 1 << 16;
+    static constexpr size_t kHirschbergParallelCells = 1 << 20;
+    
+    // Best cost from (r0, c0) to each column of row rLast, columns c0..c1
+    template <typename T>
+    static void forwardCosts(BasicFeatureView<T> seq1, BasicFeatureView<T> seq2, DistanceMetric metric,
+                             int r0, int rLast, int c0, int c1, CancelControl* cancel, double* out) {
+        int cols = c1 - c0 + 1;
+        int dim = seq1.cols();
+        // Slot j + 1 holds column c0 + j; slot 0 is the left edge
+        PoolVector<double> previous(cols + 1, std::numeric_limits<double>::infinity());
+        PoolVector<double> row(cols + 1, std::numeric_limits<double>::infinity());
+        size_t pending = 0;
+        
+        for (int i = r0; i <= rLast; i++) {
+            const T* a = seq1.row(i);
+            for (int j = 0; j < cols; j++) {
+                double best = (i == r0 && j == 0) ? 0.0 : std::min({previous[j], row[j], previous[j + 1]});
+                row[j + 1] = distance(a, seq2.row(c0 + j), dim, metric) + best;
+            }
+            std::swap(previous, row);
+            pending += cols;
+            if (pending >= kCancelPollInterval) {
+                pending = 0;
+                if (stopRequested(cancel)) return;
+            }
+        }
+        std::copy(previous.begin() + 1, previous.end(), out);
+    }
+    
+    // Best cost from each column of row rFirst to (r1, c1), columns c0..c1
+    template <typename T>
+    static void backwardCosts(BasicFeatureView<T> seq1, BasicFeatureView<T> seq2, DistanceMetric metric,
+                              int rFirst, int r1, int c0, int c1, CancelControl* cancel, double* out) {
+        int cols = c1 - c0 + 1;
+        int dim = seq1.cols();
+        // Slot j holds column c0 + j; slot cols is the right edge
+        PoolVector<double> next(cols + 1, std::numeric_limits<double>::infinity());
+        PoolVector<double> row(cols + 1, std::numeric_limits<double>::infinity());
+        size_t pending = 0;
+        
+        for (int i = r1; i >= rFirst; i--) {
+            const T* a = seq1.row(i);
+            for (int j = cols - 1; j >= 0; j--) {
+                double best = (i == r1 && j == cols - 1) ? 0.0 : std::min({next[j + 1], row[j + 1], next[j]});
+                row[j] = distance(a, seq2.row(c0 + j), dim, metric) + best;
+            }
+            std::swap(next, row);
+            pending += cols;
+            if (pending >= kCancelPollInterval) {
+                pending = 0;
+                if (stopRequested(cancel)) return;
+            }
+        }
+        std::copy(next.begin(), next.end() - 1, out);
+    }
+    
+    // Appends an optimal path from (r0, c0) to (r1, c1) to `out`; false when
+    // the run was stopped
+    template <typename T>
+    bool hirschbergSplit(BasicFeatureView<T> seq1, BasicFeatureView<T> seq2, DistanceMetric metric,
+                         int r0, int r1, int c0, int c1, CancelControl* cancel,
+                         std::vector<std::pair<int, int>>& out) {
+        if (stopRequested(cancel)) return false;
+        int rows = r1 - r0 + 1;
+        int cols = c1 - c0 + 1;
+        size_t cells = static_cast<size_t>(rows) * cols;
+        
+        if (cells <= kHirschbergBaseCells || rows == 1 || cols == 1) {
+            std::vector<std::pair<int, int>> local;
+            ScratchArena& arena = analysisArena();
+            ArenaScope scope(arena);
+            StepMatrix matrix = {arena.allocateArray<double>(cells + rows + cols + 1),
+                                 arena.allocateArray<uint8_t>(cells + rows + cols + 1),
+                                 -1, StepMatrix::widthFor(cols, -1)};
+            matrix.clear(rows);
+            BasicFeatureView<T> block1 = seq1.slice(r0, r1 + 1);
+            BasicFeatureView<T> block2 = seq2.slice(c0, c1 + 1);
+            for (int i = 1; i <= rows; i++) {
+                storedRow(block1, block2, metric, matrix, i);
+            }
+            backtrack(matrix, rows, cols, &local);
+            for (const std::pair<int, int>& cell : local) {
+                out.push_back({cell.first + r0, cell.second + c0});
+            }
+            return true;
+        }
+        
+        // The path leaves row `mid` from (mid, j) either down to (mid + 1, j)
+        // or diagonally to (mid + 1, j + 1)
+        int mid = r0 + (rows - 1) / 2;
+        PoolVector<double> forward(cols);
+        PoolVector<double> backward(cols);
+        auto pass = [&](int which) {
+            if (which == 0) {
+                forwardCosts(seq1, seq2, metric, r0, mid, c0, c1, cancel, forward.data());
+            } else {
+                backwardCosts(seq1, seq2, metric, mid + 1, r1, c0, c1, cancel, backward.data());
+            }
+        };
+        if (cells >= kHirschbergParallelCells) {
+            parallelFor(0, 2, 1, pass);
+        } else {
+            pass(0);
+            pass(1);
+        }
+        if (stopRequested(cancel)) return false;
+        
+        double best = std::numeric_limits<double>::infinity();
+        int leftEnd = 0;
+        int rightStart = 0;
+        for (int j = 0; j < cols; j++) {
+            if (forward[j] + backward[j] < best) {
+                best = forward[j] + backward[j];
+                leftEnd = j;
+                rightStart = j;
+            }
+            if (j + 1 < cols && forward[j] + backward[j + 1] < best) {
+                best = forward[j] + backward[j + 1];
+                leftEnd = j;
+                rightStart = j + 1;
+            }
+        }
+        
+        std::vector<std::pair<int, int>> right;
+        bool complete[2] = {true, true};
+        auto half = [&](int which) {
+            if (which == 0) {
+                complete[0] = hirschbergSplit(seq1, seq2, metric, r0, mid, c0, c0 + leftEnd, cancel, out);
+            } else {
+                complete[1] = hirschbergSplit(seq1, seq2, metric, mid + 1, r1, c0 + rightStart, c1, cancel, right);
+            }
+        };
+        if (cells >= kHirschbergParallelCells) {
+            parallelFor(0, 2, 1, half);
+        } else {
+            half(0);
+            half(1);
+        }
+        out.insert(out.end(), right.begin(), right.end());
+        return complete[0] && complete[1];
+    }
+    
+    DTWResult computeNested(const std::vector<std::vector<double>>& seq1,
+                            const std::vector<std::vector<double>>& seq2,
+                            DistanceMetric metric, int windowSize) {
+        ScratchArena& arena = analysisArena();
+        ArenaScope scope(arena);
+        FeatureView view1 = arenaFeaturesFrom<double>(arena, seq1);
+        FeatureView view2 = arenaFeaturesFrom<double>(arena, seq2);
+        return computeView(view1, view2, metric, windowSize);
+    }
+};
+
+// Resumable DynamicTimeWarping::align: step() computes cost rows until its
+// time budget is spent and keeps the rows (or the step matrix, when a path
+// is wanted) in the task between calls. Only the input sequences have to
+// stay where they are. Distance, path length and path are identical to
+// align() over the same inputs.
+template <typename T>
+class DTWTask {
+public:
+    DTWTask(BasicFeatureView<T> seq1, BasicFeatureView<T> seq2, DistanceMetric metric,
+            int windowSize, bool wantPath)
+        : seq1(seq1), seq2(seq2), metric(metric), windowSize(windowSize), wantPath(wantPath),
+          n(seq1.rows()), m(seq2.rows()) {
+        if (seq1.empty() || seq2.empty() || seq1.cols() != seq2.cols()) {
+            result = {std::numeric_limits<double>::infinity(), 0};
+            finished = true;
+            return;
+        }
+        
+        if (wantPath) {
+            size_t cells = Engine::StepMatrix::cellsFor(n, m, windowSize);
+            cost.resize(cells);
+            steps.resize(cells);
+            matrix = {cost.data(), steps.data(), windowSize, Engine::StepMatrix::widthFor(m, windowSize)};
+            matrix.clear(n);
+        } else {
+            size_t cols = static_cast<size_t>(m) + 1;
+            cost.assign(2 * cols, std::numeric_limits<double>::infinity());
+            lengths.assign(2 * cols, 0);
+            cost[0] = 0.0;
+        }
+    }
+    
+    // Runs rows until budgetUs has been spent; true once the alignment is done
+    bool step(double budgetUs) {
+        if (finished) return true;
+        
+        TimeSlice slice(budgetUs);
+        size_t cols = static_cast<size_t>(m) + 1;
+        while (row <= n) {
+            int jStart, jEnd;
+            Engine::rowBounds(row, m, windowSize, jStart, jEnd);
+            if (wantPath) {
+                Engine::storedRow(seq1, seq2, metric, matrix, row);
+            } else {
+                size_t previous = static_cast<size_t>((row - 1) & 1) * cols;
+                size_t current = static_cast<size_t>(row & 1) * cols;
+                Engine::rollingRow(seq1, seq2, metric, windowSize, row, cost.data() + previous,
+                                   cost.data() + current, lengths.data() + previous,
+                                   lengths.data() + current);
+            }
+            row++;
+            if (slice.exhausted(std::max(1, jEnd - jStart + 1)) && row <= n) {
+                return false;
+            }
+        }
+        
+        if (wantPath) {
+            int pathLength = Engine::backtrack(matrix, n, m, &pathPoints);
+            result = {matrix.costAt(n, m), pathLength};
+        } else {
+            size_t last = static_cast<size_t>(n & 1) * cols;
+            result = {cost[last + m], lengths[last + m]};
+        }
+        finished = true;
+        return true;
+    }
+    
+    bool done() const { return finished; }
+    double progress() const { return finished ? 1.0 : static_cast<double>(row - 1) / n; }
+    
+    // Valid once done()
+    DTWOutcome outcome() const { return result; }
+    const std::vector<std::pair<int, int>>& path() const { return pathPoints; }
+    
+private:
+    using Engine = DynamicTimeWarping;
+    
+    BasicFeatureView<T> seq1;
+    BasicFeatureView<T> seq2;
+    DistanceMetric metric;
+    int windowSize;
+    bool wantPath;
+    int n;
+    int m;
+    int row = 1;
+    bool finished = false;
+    
+    // Two rolling rows (distance only) or the stored step matrix
+    PoolVector<double> cost;
+    PoolVector<int32_t> lengths;
+    PoolVector<uint8_t> steps;
+    Engine::StepMatrix matrix = {};
+    
+    DTWOutcome result = {0.0, 0};
+    std::vector<std::pair<int, int>> pathPoints;
+};
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <unordered_map>
+#include "feature_matrix.h"
+
+// Feature cache keyed by audio content.
+//
+// Re-scoring the same recording (another reference, another reciter, a
+// retried analysis) used to rerun the whole front end. The cache keys the
+// extracted features by a 64-bit hash of the PCM samples and the pipeline
+// configuration, and keeps the most recently used matrices up to a byte
+// budget. Hashing runs at memory speed, so a miss costs a few milliseconds
+// on a minute of audio against hundreds for the extraction it can save.
+//
+// A hit requires the hash and the configuration fields to agree; the
+// samples themselves are not compared, so two recordings collide only with
+// probability about 2^-64.
+
+// Default budget: about 45 minutes of audio at 44.1 kHz and a 1024-sample hop
+// (144-byte padded rows of the 17 base features)
+const size_t kDefaultFeatureCacheBytes = 16u << 20;
+
+// XXH64 over `len` bytes
+inline uint64_t contentHash64(const void* data, size_t len, uint64_t seed = 0) {
+    const uint64_t prime1 = 11400714785074694791ULL;
+    const uint64_t prime2 = 14029467366897019727ULL;
+    const uint64_t prime3 = 1609587929392839161ULL;
+    const uint64_t prime4 = 9650029242287828579ULL;
+    const uint64_t prime5 = 2870177450012600261ULL;
+    auto rotl = [](uint64_t x, int r) { return (x << r) | (x >> (64 - r)); };
+    auto round = [&](uint64_t acc, uint64_t input) {
+        acc += input * prime2;
+        return rotl(acc, 31) * prime1;
+    };
+    auto merge = [&](uint64_t acc, uint64_t lane) {
+        acc ^= round(0, lane);
+        return acc * prime1 + prime4;
+    };
+    auto read64 = [](const uint8_t* p) {
+        uint64_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    };
+
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    const uint8_t* end = p + len;
+    uint64_t h;
+    if (len >= 32) {
+        uint64_t v1 = seed + prime1 + prime2;
+        uint64_t v2 = seed + prime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - prime1;
+        const uint8_t* limit = end - 32;
+        do {
+            v1 = round(v1, read64(p));
+            v2 = round(v2, read64(p + 8));
+            v3 = round(v3, read64(p + 16));
+            v4 = round(v4, read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = merge(h, v1);
+        h = merge(h, v2);
+        h = merge(h, v3);
+        h = merge(h, v4);
+    } else {
+        h = seed + prime5;
+    }
+    h += len;
+
+    while (p + 8 <= end) {
+        h ^= round(0, read64(p));
+        h = rotl(h, 27) * prime1 + prime4;
+        p += 8;
+    }
+    if (p + 4 <= end) {
+        uint32_t v;
+        std::memcpy(&v, p, sizeof(v));
+        h ^= static_cast<uint64_t>(v) * prime1;
+        h = rotl(h, 23) * prime2 + prime3;
+        p += 4;
+    }
+    while (p < end) {
+        h ^= static_cast<uint64_t>(*p) * prime5;
+        h = rotl(h, 11) * prime1;
+        p++;
+    }
+
+    h ^= h >> 33;
+    h *= prime2;
+    h ^= h >> 29;
+    h *= prime3;
+    h ^= h >> 32;
+    return h;
+}
+
+// What the features were computed from. `options` holds the switches that
+// change the output (kFeatureFormants and the like in audio_processor.h);
+// it takes part in the hash and the match.
+struct FeatureKey {
+    uint64_t hash;
+    int dataLen;
+    double sampleRate;
+    int frameSize;
+    int hopSize;
+    uint32_t options;
+
+    bool operator==(const FeatureKey& other) const {
+        return hash == other.hash && dataLen == other.dataLen && sampleRate == other.sampleRate &&
+               frameSize == other.frameSize && hopSize == other.hopSize && options == other.options;
+    }
+};
+
+inline FeatureKey featureKey(const double* audioData, int dataLen, double sampleRate,
+                             int frameSize, int hopSize, uint32_t options = 0) {
+    FeatureKey key = {0, dataLen, sampleRate, frameSize, hopSize, options};
+    double config[5] = {static_cast<double>(dataLen), sampleRate, static_cast<double>(frameSize),
+                        static_cast<double>(hopSize), static_cast<double>(options)};
+    uint64_t seed = contentHash64(config, sizeof(config));
+    key.hash = contentHash64(audioData, static_cast<size_t>(std::max(0, dataLen)) * sizeof(double), seed);
+    return key;
+}
+
+// Byte-bounded LRU of feature matrices. Not synchronised: one per module,
+// used from the thread that calls the C API.
+class FeatureCache {
+public:
+    explicit FeatureCache(size_t capacityBytes = kDefaultFeatureCacheBytes) : capacity(capacityBytes) {}
+
+    FeatureCache(const FeatureCache&) = delete;
+    FeatureCache& operator=(const FeatureCache&) = delete;
+
+    // Evicts down to the new budget; 0 disables the cache
+    void setCapacity(size_t bytes) {
+        capacity = bytes;
+        evict(0);
+    }
+
+    // The cached features for `key`, now the most recently used, or null.
+    // Valid until the next insert(), setCapacity() or clear().
+    const FeatureMatrix* find(const FeatureKey& key) {
+        auto it = index.find(key.hash);
+        if (it == index.end() || !(it->second->key == key)) {
+            misses++;
+            return nullptr;
+        }
+        entries.splice(entries.begin(), entries, it->second);
+        hits++;
+        return &it->second->features;
+    }
+
+    // Copies `features` in. Matrices larger than the whole budget are not
+    // kept; an entry with the same hash is replaced.
+    void insert(const FeatureKey& key, FeatureView features) {
+        erase(key.hash);
+        size_t bytes = static_cast<size_t>(features.rows()) * paddedStride<double>(features.cols()) * sizeof(double);
+        if (bytes > capacity) return;
+        evict(bytes);
+        entries.emplace_front();
+        Entry& entry = entries.front();
+        entry.key = key;
+        entry.features.assign(features);
+        index[key.hash] = entries.begin();
+        used += entry.features.byteSize();
+    }
+
+    void clear() {
+        entries.clear();
+        index.clear();
+        used = 0;
+    }
+
+    size_t bytes() const { return used; }
+    size_t size() const { return entries.size(); }
+    uint64_t hitCount() const { return hits; }
+    uint64_t missCount() const { return misses; }
+
+private:
+    struct Entry {
+        FeatureKey key;
+        FeatureMatrix features;
+    };
+
+    void erase(uint64_t hash) {
+        auto it = index.find(hash);
+        if (it == index.end()) return;
+        used -= it->second->features.byteSize();
+        entries.erase(it->second);
+        index.erase(it);
+    }
+
+    // Drops least recently used entries until `incoming` more bytes fit
+    void evict(size_t incoming) {
+        while (!entries.empty() && used + incoming > capacity) {
+            erase(entries.back().key.hash);
+        }
+    }
+
+    // Most recently used first
+    std::list<Entry> entries;
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+    size_t capacity;
+    size_t used = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+};
@@ -0,0 +1,268 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
+#include "arena.h"
+
+#ifdef __EMSCRIPTEN__
+#include <emscripten/val.h>
+#endif
+
+// Feature matrices shared by every engine module.
+//
+// Features are stored row-major, one frame per row. Rows start on a
+// kFeatureAlignment boundary (the stride is padded), so per-frame loops can
+// use 128-bit SIMD loads in both float and double. Views do not own their
+// data and can point at caller memory (e.g. a Float64Array in the WASM heap)
+// with any stride, including an unpadded one.
+
+constexpr size_t kFeatureAlignment = 16;
+
+template <typename T>
+inline size_t paddedStride(int cols) {
+    size_t perLine = kFeatureAlignment / sizeof(T);
+    return alignUp(static_cast<size_t>(cols), perLine == 0 ? 1 : perLine);
+}
+
+template <typename T>
+class BasicFeatureView {
+public:
+    BasicFeatureView() : ptr(nullptr), numRows(0), numCols(0), rowStride(0) {}
+
+    BasicFeatureView(const T* data, int rows, int cols)
+        : ptr(data), numRows(rows), numCols(cols), rowStride(cols) {}
+
+    BasicFeatureView(const T* data, int rows, int cols, size_t stride)
+        : ptr(data), numRows(rows), numCols(cols), rowStride(stride) {}
+
+    const T* row(int i) const { return ptr + static_cast<size_t>(i) * rowStride; }
+    const T& operator()(int i, int j) const { return row(i)[j]; }
+
+    int rows() const { return numRows; }
+    int cols() const { return numCols; }
+    size_t stride() const { return rowStride; }
+    const T* data() const { return ptr; }
+    bool empty() const { return numRows == 0 || numCols == 0; }
+    bool contiguous() const { return rowStride == static_cast<size_t>(numCols); }
+
+    // Rows [begin, end)
+    BasicFeatureView slice(int begin, int end) const {
+        return BasicFeatureView(row(begin), end - begin, numCols, rowStride);
+    }
+
+private:
+    const T* ptr;
+    int numRows;
+    int numCols;
+    size_t rowStride;
+};
+
+template <typename T>
+class BasicMutableFeatureView {
+public:
+    BasicMutableFeatureView() : ptr(nullptr), numRows(0), numCols(0), rowStride(0) {}
+
+    BasicMutableFeatureView(T* data, int rows, int cols)
+        : ptr(data), numRows(rows), numCols(cols), rowStride(cols) {}
+
+    BasicMutableFeatureView(T* data, int rows, int cols, size_t stride)
+        : ptr(data), numRows(rows), numCols(cols), rowStride(stride) {}
+
+    T* row(int i) const { return ptr + static_cast<size_t>(i) * rowStride; }
+    T& operator()(int i, int j) const { return row(i)[j]; }
+
+    int rows() const { return numRows; }
+    int cols() const { return numCols; }
+    size_t stride() const { return rowStride; }
+    T* data() const { return ptr; }
+
+    BasicMutableFeatureView slice(int begin, int end) const {
+        return BasicMutableFeatureView(row(begin), end - begin, numCols, rowStride);
+    }
+
+    operator BasicFeatureView<T>() const {
+        return BasicFeatureView<T>(ptr, numRows, numCols, rowStride);
+    }
+
+private:
+    T* ptr;
+    int numRows;
+    int numCols;
+    size_t rowStride;
+};
+
+// Owning matrix with aligned storage and padded stride. Padding is zeroed so
+// SIMD kernels may read whole lines.
+template <typename T>
+class BasicFeatureMatrix {
+public:
+    BasicFeatureMatrix() : storage(nullptr), ptr(nullptr), numRows(0), numCols(0), rowStride(0) {}
+
+    BasicFeatureMatrix(int rows, int cols) : BasicFeatureMatrix() {
+        resize(rows, cols);
+    }
+
+    ~BasicFeatureMatrix() {
+        std::free(storage);
+    }
+
+    BasicFeatureMatrix(const BasicFeatureMatrix& other) : BasicFeatureMatrix() {
+        assign(other.view());
+    }
+
+    BasicFeatureMatrix& operator=(const BasicFeatureMatrix& other) {
+        if (this != &other) {
+            assign(other.view());
+        }
+        return *this;
+    }
+
+    BasicFeatureMatrix(BasicFeatureMatrix&& other) noexcept
+        : storage(other.storage), ptr(other.ptr), numRows(other.numRows),
+          numCols(other.numCols), rowStride(other.rowStride) {
+        other.storage = nullptr;
+        other.ptr = nullptr;
+        other.numRows = other.numCols = 0;
+        other.rowStride = 0;
+    }
+
+    BasicFeatureMatrix& operator=(BasicFeatureMatrix&& other) noexcept {
+        if (this != &other) {
+            std::free(storage);
+            storage = other.storage;
+            ptr = other.ptr;
+            numRows = other.numRows;
+            numCols = other.numCols;
+            rowStride = other.rowStride;
+            other.storage = nullptr;
+            other.ptr = nullptr;
+            other.numRows = other.numCols = 0;
+            other.rowStride = 0;
+        }
+        return *this;
+    }
+
+    // Contents are zeroed; existing storage is reused when large enough
+    void resize(int rows, int cols) {
+        size_t stride = paddedStride<T>(cols);
+        size_t bytes = static_cast<size_t>(rows) * stride * sizeof(T);
+        if (bytes > capacityBytes()) {
+            std::free(storage);
+            storage = static_cast<uint8_t*>(std::malloc(bytes + kFeatureAlignment));
+            if (!storage) {
+                throw std::bad_alloc();
+            }
+            uintptr_t base = reinterpret_cast<uintptr_t>(storage);
+            ptr = reinterpret_cast<T*>(alignUp(base, kFeatureAlignment));
+            capacity = bytes;
+        }
+        numRows = rows;
+        numCols = cols;
+        rowStride = stride;
+        if (bytes > 0) {
+            std::memset(ptr, 0, bytes);
+        }
+    }
+
+    template <typename U>
+    void assign(BasicFeatureView<U> source) {
+        resize(source.rows(), source.cols());
+        for (int i = 0; i < source.rows(); i++) {
+            std::copy(source.row(i), source.row(i) + source.cols(), row(i));
+        }
+    }
+
+    T* row(int i) { return ptr + static_cast<size_t>(i) * rowStride; }
+    const T* row(int i) const { return ptr + static_cast<size_t>(i) * rowStride; }
+    T& operator()(int i, int j) { return row(i)[j]; }
+    const T& operator()(int i, int j) const { return row(i)[j]; }
+
+    int rows() const { return numRows; }
+    int cols() const { return numCols; }
+    size_t stride() const { return rowStride; }
+    T* data() { return ptr; }
+    const T* data() const { return ptr; }
+    bool empty() const { return numRows == 0 || numCols == 0; }
+    size_t byteSize() const { return static_cast<size_t>(numRows) * rowStride * sizeof(T); }
+
+    BasicFeatureView<T> view() const {
+        return BasicFeatureView<T>(ptr, numRows, numCols, rowStride);
+    }
+
+    BasicMutableFeatureView<T> mutableView() {
+        return BasicMutableFeatureView<T>(ptr, numRows, numCols, rowStride);
+    }
+
+    operator BasicFeatureView<T>() const { return view(); }
+
+private:
+    size_t capacityBytes() const { return storage ? capacity : 0; }
+
+    uint8_t* storage;
+    T* ptr;
+    int numRows;
+    int numCols;
+    size_t rowStride;
+    size_t capacity = 0;
+};
+
+#ifdef __EMSCRIPTEN__
+// Engine-owned feature storage handed to JS as a typed array view (float or
+// double, depending on the buffer).
+// `data` covers rows * stride elements; element (i, j) is data[i * stride + j].
+struct FeatureBuffer {
+    emscripten::val data;
+    int rows;
+    int cols;
+    int stride;
+};
+#endif
+
+using FeatureView = BasicFeatureView<double>;
+using FeatureViewF = BasicFeatureView<float>;
+using MutableFeatureView = BasicMutableFeatureView<double>;
+using MutableFeatureViewF = BasicMutableFeatureView<float>;
+using FeatureMatrix = BasicFeatureMatrix<double>;
+using FeatureMatrixF = BasicFeatureMatrix<float>;
+
+// Padded matrix in the analysis arena; lives until the enclosing scope rewinds
+template <typename T>
+inline BasicMutableFeatureView<T> arenaFeatures(ScratchArena& arena, int rows, int cols) {
+    size_t stride = paddedStride<T>(cols);
+    T* data = arena.allocateArray<T>(static_cast<size_t>(rows) * stride);
+    std::fill(data, data + static_cast<size_t>(rows) * stride, T(0));
+    return BasicMutableFeatureView<T>(data, rows, cols, stride);
+}
+
+// Embind boundary helpers for the legacy nested-vector APIs. Ragged input
+// yields an empty view.
+template <typename T>
+inline BasicFeatureView<T> arenaFeaturesFrom(ScratchArena& arena,
+                                             const std::vector<std::vector<double>>& nested) {
+    if (nested.empty()) {
+        return BasicFeatureView<T>();
+    }
+    int cols = nested[0].size();
+    BasicMutableFeatureView<T> out = arenaFeatures<T>(arena, nested.size(), cols);
+    for (size_t i = 0; i < nested.size(); i++) {
+        if (static_cast<int>(nested[i].size()) != cols) {
+            return BasicFeatureView<T>();
+        }
+        std::copy(nested[i].begin(), nested[i].end(), out.row(i));
+    }
+    return out;
+}
+
+template <typename T>
+inline std::vector<std::vector<double>> toNested(BasicFeatureView<T> view) {
+    std::vector<std::vector<double>> nested(view.rows());
+    for (int i = 0; i < view.rows(); i++) {
+        nested[i].assign(view.row(i), view.row(i) + view.cols());
+    }
+    return nested;
+}
@@ -0,0 +1,470 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include "arena.h"
+#include "cancellation.h"
+#include "feature_matrix.h"
+#include "time_slice.h"
+#include "workspace.h"
+
+struct ViterbiResult {
+    std::vector<int> path;
+    double probability;
+    std::vector<double> probabilities;
+};
+
+struct ForwardResult {
+    double probability;
+    std::vector<std::vector<double>> alpha;
+};
+
+#ifdef __EMSCRIPTEN__
+// Typed-array results over engine-owned buffers. `alpha` is a Float64Array
+// of rows x stride log probabilities (kept in double: long utterances reach
+// magnitudes where float32 would lose the differences between states).
+struct ForwardView {
+    double probability;
+    emscripten::val alpha;
+    int rows;
+    int stride;
+};
+
+struct ViterbiView {
+    double probability;
+    emscripten::val path;           // Int32Array
+    emscripten::val probabilities;  // Float64Array
+};
+#endif
+
+class HiddenMarkovModel {
+private:
+    friend class ViterbiTask;
+    
+    int numStates;
+    int numObservations;
+    // Model parameters are kept in log space, row-major, in pooled storage
+    PoolVector<double> logTransitions;
+    PoolVector<double> logEmissions;
+    PoolVector<double> logInitial;
+    
+    static constexpr double kNegInf = -std::numeric_limits<double>::infinity();
+    
+    // Buffers behind the typed_memory_view APIs
+    PoolVector<int32_t> observationBuffer;
+    FeatureMatrix alphaOutput;
+    PoolVector<int32_t> pathOutput;
+    PoolVector<double> probabilityOutput;
+    
+    double logSum(double logA, double logB) {
+        if (logA == kNegInf) return logB;
+        if (logB == kNegInf) return logA;
+        
+        if (logA > logB) {
+            return logA + std::log(1.0 + std::exp(logB - logA));
+        } else {
+            return logB + std::log(1.0 + std::exp(logA - logB));
+        }
+    }
+    
+    bool validSymbol(int symbol) const {
+        return symbol >= 0 && symbol < numObservations;
+    }
+    
+    double logTransition(int from, int to) const {
+        return logTransitions[static_cast<size_t>(from) * numStates + to];
+    }
+    
+    double logEmission(int state, int symbol) const {
+        return logEmissions[static_cast<size_t>(state) * numObservations + symbol];
+    }
+    
+    static void assignLog(PoolVector<double>& target, const std::vector<std::vector<double>>& source,
+                          int rows, int cols) {
+        for (int i = 0; i < rows && i < static_cast<int>(source.size()); i++) {
+            for (int j = 0; j < cols && j < static_cast<int>(source[i].size()); j++) {
+                target[static_cast<size_t>(i) * cols + j] = std::log(source[i][j]);
+            }
+        }
+    }
+    
+    // Viterbi building blocks shared by viterbiInto and ViterbiTask
+    void viterbiFirst(int symbol, double* delta, int* back) const {
+        for (int i = 0; i < numStates; i++) {
+            if (validSymbol(symbol)) {
+                delta[i] = logInitial[i] + logEmission(i, symbol);
+            } else {
+                delta[i] = kNegInf;
+            }
+            back[i] = 0;
+        }
+    }
+    
+    void viterbiStep(const double* prev, int symbol, double* current, int* back) const {
+        for (int j = 0; j < numStates; j++) {
+            double maxProb = kNegInf;
+            int maxState = 0;
+            
+            for (int i = 0; i < numStates; i++) {
+                double prob = prev[i] + logTransition(i, j);
+                if (prob > maxProb) {
+                    maxProb = prob;
+                    maxState = i;
+                }
+            }
+            
+            if (validSymbol(symbol)) {
+                current[j] = maxProb + logEmission(j, symbol);
+            } else {
+                current[j] = kNegInf;
+            }
+            back[j] = maxState;
+        }
+    }
+    
+    // Best final state, then the path back through psi; returns its log
+    // probability
+    double viterbiFinish(const double* last, const int* psi, int T, int* path) const {
+        double maxProb = kNegInf;
+        int maxState = 0;
+        
+        for (int i = 0; i < numStates; i++) {
+            if (last[i] > maxProb) {
+                maxProb = last[i];
+                maxState = i;
+            }
+        }
+        
+        path[T-1] = maxState;
+        for (int t = T-2; t >= 0; t--) {
+            path[t] = psi[static_cast<size_t>(t + 1) * numStates + path[t+1]];
+        }
+        return maxProb;
+    }
+    
+public:
+    HiddenMarkovModel(int states, int observations) 
+        : numStates(states), numObservations(observations) {
+        logTransitions.assign(static_cast<size_t>(states) * states, kNegInf);
+        logEmissions.assign(static_cast<size_t>(states) * observations, kNegInf);
+        logInitial.assign(states, kNegInf);
+    }
+    
+    void setTransitionMatrix(const std::vector<std::vector<double>>& transitions) {
+        assignLog(logTransitions, transitions, numStates, numStates);
+    }
+    
+    void setEmissionMatrix(const std::vector<std::vector<double>>& emissions) {
+        assignLog(logEmissions, emissions, numStates, numObservations);
+    }
+    
+    void setInitialProbabilities(const std::vector<double>& initial) {
+        for (int i = 0; i < numStates && i < static_cast<int>(initial.size()); i++) {
+            logInitial[i] = std::log(initial[i]);
+        }
+    }
+    
+    // Row-major probabilities straight from caller memory
+    void setModel(const double* transitions, const double* emissions, const double* initial) {
+        for (size_t i = 0; i < logTransitions.size(); i++) {
+            logTransitions[i] = std::log(transitions[i]);
+        }
+        for (size_t i = 0; i < logEmissions.size(); i++) {
+            logEmissions[i] = std::log(emissions[i]);
+        }
+        for (int i = 0; i < numStates; i++) {
+            logInitial[i] = std::log(initial[i]);
+        }
+    }
+    
+    // Viterbi over T observations. Writes the state path and, if requested,
+    // per-step path probabilities; returns the best log probability.
+    // psi lives in the analysis arena; delta is kept in full only when the
+    // per-step probabilities are wanted, otherwise as two rolling rows.
+    // Stopped under a CancelScope, it returns NaN without writing the path.
+    double viterbiInto(const int* observations, int T, int* path, double* probabilities) {
+        if (T == 0) {
+            return kNegInf;
+        }
+        
+        ScratchArena& arena = analysisArena();
+        ArenaScope scope(arena);
+        size_t cells = static_cast<size_t>(T) * numStates;
+        bool keepDelta = probabilities != nullptr;
+        double* delta = arena.allocateArray<double>(keepDelta ? cells : 2 * static_cast<size_t>(numStates));
+        int* psi = arena.allocateArray<int>(cells);
+        auto deltaAt = [&](int t) {
+            return delta + static_cast<size_t>(keepDelta ? t : (t & 1)) * numStates;
+        };
+        
+        // Initialization (t = 0)
+        viterbiFirst(observations[0], delta, psi);
+        
+        // Recursion
+        CancelPoll cancel(kCancelPollInterval);
+        for (int t = 1; t < T; t++) {
+            if (cancel.stop(static_cast<size_t>(numStates) * numStates)) {
+                cancel.progress(static_cast<double>(t) / T);
+                return std::numeric_limits<double>::quiet_NaN();
+            }
+            viterbiStep(deltaAt(t - 1), observations[t], deltaAt(t), psi + static_cast<size_t>(t) * numStates);
+        }
+        
+        // Termination and path backtracking
+        double maxProb = viterbiFinish(deltaAt(T - 1), psi, T, path);
+        
+        // Extract probabilities for each time step
+        if (keepDelta) {
+            for (int t = 0; t < T; t++) {
+                probabilities[t] = delta[static_cast<size_t>(t) * numStates + path[t]];
+            }
+        }
+        
+        return maxProb;
+    }
+    
+    ViterbiResult viterbi(const std::vector<int>& observations) {
+        int T = observations.size();
+        if (T == 0) {
+            return {{}, kNegInf, {}};
+        }
+        
+        std::vector<int> path(T);
+        std::vector<double> probabilities(T);
+        double maxProb = viterbiInto(observations.data(), T, path.data(), probabilities.data());
+        
+        return {path, maxProb, probabilities};
+    }
+    
+    // Maps one feature column to discrete symbols: round((x + offset) * scale),
+    // clamped to the model's alphabet.
+    void quantizeObservations(FeatureView features, int column, double offset, double scale,
+                              int* observations) const {
+        for (int t = 0; t < features.rows(); t++) {
+            long symbol = std::lround((features(t, column) + offset) * scale);
+            observations[t] = static_cast<int>(std::max(0L, std::min<long>(numObservations - 1, symbol)));
+        }
+    }
+    
+    // Forward recursion. `alpha` (T x numStates) receives every step when it
+    // is non-empty; otherwise only two rows are kept in the arena. Returns
+    // NaN when stopped under a CancelScope.
+    double forwardInto(const int* observations, int T, MutableFeatureView alpha = MutableFeatureView()) {
+        if (T == 0) {
+            return kNegInf;
+        }
+        
+        ScratchArena& arena = analysisArena();
+        ArenaScope scope(arena);
+        bool keepAlpha = alpha.rows() >= T;
+        double* rows = keepAlpha ? nullptr : arena.allocateArray<double>(2 * static_cast<size_t>(numStates));
+        auto rowAt = [&](int t) {
+            return keepAlpha ? alpha.row(t) : rows + static_cast<size_t>(t & 1) * numStates;
+        };
+        
+        // Initialization
+        double* first = rowAt(0);
+        for (int i = 0; i < numStates; i++) {
+            if (validSymbol(observations[0])) {
+                first[i] = logInitial[i] + logEmission(i, observations[0]);
+            } else {
+                first[i] = kNegInf;
+            }
+        }
+        
+        // Recursion
+        CancelPoll cancel(kCancelPollInterval);
+        for (int t = 1; t < T; t++) {
+            if (cancel.stop(static_cast<size_t>(numStates) * numStates)) {
+                cancel.progress(static_cast<double>(t) / T);
+                return std::numeric_limits<double>::quiet_NaN();
+            }
+            const double* prev = rowAt(t - 1);
+            double* current = rowAt(t);
+            
+            for (int j = 0; j < numStates; j++) {
+                current[j] = kNegInf;
+                
+                for (int i = 0; i < numStates; i++) {
+                    double prob = prev[i] + logTransition(i, j);
+                    current[j] = logSum(current[j], prob);
+                }
+                
+                if (validSymbol(observations[t])) {
+                    current[j] += logEmission(j, observations[t]);
+                } else {
+                    current[j] = kNegInf;
+                }
+            }
+        }
+        
+        // Termination
+        const double* last = rowAt(T - 1);
+        double totalProb = kNegInf;
+        for (int i = 0; i < numStates; i++) {
+            totalProb = logSum(totalProb, last[i]);
+        }
+        
+        return totalProb;
+    }
+    
+    ForwardResult forward(const std::vector<int>& observations) {
+        int T = observations.size();
+        if (T == 0) {
+            return {kNegInf, {}};
+        }
+        
+        ScratchArena& arena = analysisArena();
+        ArenaScope scope(arena);
+        MutableFeatureView alpha = arenaFeatures<double>(arena, T, numStates);
+        double totalProb = forwardInto(observations.data(), T, alpha);
+        
+        return {totalProb, toNested<double>(alpha)};
+    }
+    
+#ifdef __EMSCRIPTEN__
+    // Zero-copy embind surface. JS fills the Int32Array from
+    // observationInput(T), then calls forwardInput() or viterbiInput().
+    // Returned views live in this object and are invalidated by the next call
+    // that refills them, by delete() and by WASM memory growth.
+    emscripten::val observationInput(int T) {
+        observationBuffer.resize(std::max(0, T));
+        return emscripten::val(emscripten::typed_memory_view(observationBuffer.size(),
+                                                             observationBuffer.data()));
+    }
+    
+    ForwardView forwardInput() {
+        int T = observationBuffer.size();
+        alphaOutput.resize(T, numStates);
+        double probability = forwardInto(observationBuffer.data(), T, alphaOutput.mutableView());
+        
+        size_t elements = static_cast<size_t>(alphaOutput.rows()) * alphaOutput.stride();
+        return {probability, emscripten::val(emscripten::typed_memory_view(elements, alphaOutput.data())),
+                alphaOutput.rows(), static_cast<int>(alphaOutput.stride())};
+    }
+    
+    ViterbiView viterbiInput() {
+        int T = observationBuffer.size();
+        pathOutput.resize(T);
+        probabilityOutput.resize(T);
+        double probability = viterbiInto(observationBuffer.data(), T, pathOutput.data(),
+                                         probabilityOutput.data());
+        
+        return {probability,
+                emscripten::val(emscripten::typed_memory_view(pathOutput.size(), pathOutput.data())),
+                emscripten::val(emscripten::typed_memory_view(probabilityOutput.size(),
+                                                              probabilityOutput.data()))};
+    }
+#endif
+    
+    std::vector<std::vector<double>> backward(const std::vector<int>& observations) {
+        int T = observations.size();
+        std::vector<std::vector<double>> beta(T, std::vector<double>(numStates));
+        if (T == 0) {
+            return beta;
+        }
+        
+        // Initialization
+        for (int i = 0; i < numStates; i++) {
+            beta[T-1][i] = 0.0; // log(1) = 0
+        }
+        
+        // Recursion
+        for (int t = T-2; t >= 0; t--) {
+            int symbol = observations[t+1];
+            
+            for (int i = 0; i < numStates; i++) {
+                beta[t][i] = kNegInf;
+                if (!validSymbol(symbol)) continue;
+                
+                for (int j = 0; j < numStates; j++) {
+                    double prob = logTransition(i, j) + 
+                                 logEmission(j, symbol) + 
+                                 beta[t+1][j];
+                    beta[t][i] = logSum(beta[t][i], prob);
+                }
+            }
+        }
+        
+        return beta;
+    }
+    
+    double calculateLikelihood(const std::vector<int>& observations) {
+        return forwardInto(observations.data(), observations.size());
+    }
+};
+
+// Resumable HiddenMarkovModel::viterbiInto: step() advances a frame cursor
+// until its time budget is spent. delta (two rows, or every row when
+// per-step probabilities are wanted) and psi are owned by the task; the
+// model and the observations must outlive it. Results are identical to
+// viterbiInto().
+class ViterbiTask {
+public:
+    ViterbiTask(const HiddenMarkovModel& model, const int* observations, int T, bool wantProbabilities)
+        : model(model), observations(observations), T(std::max(0, T)), keepDelta(wantProbabilities) {
+        int states = model.numStates;
+        if (this->T == 0) {
+            probability = HiddenMarkovModel::kNegInf;
+            finished = true;
+            return;
+        }
+        delta.resize(static_cast<size_t>(keepDelta ? this->T : 2) * states);
+        psi.resize(static_cast<size_t>(this->T) * states);
+        pathOutput.resize(this->T);
+        model.viterbiFirst(observations[0], delta.data(), psi.data());
+    }
+    
+    // Runs frames until budgetUs has been spent; true once decoding is done
+    bool step(double budgetUs) {
+        if (finished) return true;
+        
+        TimeSlice slice(budgetUs);
+        size_t states = model.numStates;
+        while (t < T) {
+            model.viterbiStep(deltaAt(t - 1), observations[t], deltaAt(t), psi.data() + static_cast<size_t>(t) * states);
+            t++;
+            if (slice.exhausted(states * states) && t < T) {
+                return false;
+            }
+        }
+        
+        probability = model.viterbiFinish(deltaAt(T - 1), psi.data(), T, pathOutput.data());
+        if (keepDelta) {
+            probabilityOutput.resize(T);
+            for (int k = 0; k < T; k++) {
+                probabilityOutput[k] = delta[static_cast<size_t>(k) * states + pathOutput[k]];
+            }
+        }
+        finished = true;
+        return true;
+    }
+    
+    bool done() const { return finished; }
+    double progress() const { return finished ? 1.0 : static_cast<double>(t) / T; }
+    
+    // Valid once done(); probabilities() is empty unless requested
+    double logProbability() const { return probability; }
+    const int32_t* path() const { return pathOutput.data(); }
+    const double* probabilities() const { return probabilityOutput.data(); }
+    
+private:
+    double* deltaAt(int frame) {
+        return delta.data() + static_cast<size_t>(keepDelta ? frame : (frame & 1)) * model.numStates;
+    }
+    
+    const HiddenMarkovModel& model;
+    const int* observations;
+    int T;
+    bool keepDelta;
+    int t = 1;
+    bool finished = false;
+    double probability = 0.0;
+    
+    PoolVector<double> delta;
+    PoolVector<int32_t> psi;
+    PoolVector<int32_t> pathOutput;
+    PoolVector<double> probabilityOutput;
+};
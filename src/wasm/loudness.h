@@ -0,0 +1,218 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include "arena.h"
+#include "dsp_tables.h"
+
+// Loudness normalisation ahead of feature extraction.
+//
+// A phone held at arm's length and a headset mic differ by 20 dB or more,
+// which shifts MFCC[0], the energy column and every threshold built on them.
+// LoudnessNormalizer brings the input to kTargetLufs before framing:
+//     K-weighting   the ITU-R BS.1770 pre-filter (high shelf + RLB
+//                   high-pass, coefficients for any sample rate)
+//     short-term    mean square of the K-weighted signal over the last
+//                   kShortTermBlocks blocks of kLoudnessBlockSeconds, blocks
+//                   below kLoudnessGateLufs left out, so pauses are not
+//                   boosted; the gain holds through silence
+//     AGC           kTargetLufs minus the short-term loudness, within
+//                   kMaxAgcCutDb / kMaxAgcBoostDb
+//     limiter       the block gain is capped so the block's peak stays under
+//                   kLimiterCeiling
+// Output is delayed by one block (the look-ahead): block k goes out when
+// block k + 1 is complete, with the gain ramped across the block towards
+// min(gain[k], gain[k + 1]), so no block exceeds its own cap and the gain has
+// no steps. Sample i of the output is still sample i of the input, only
+// later; finish() flushes the tail. State is two blocks of audio plus
+// kShortTermBlocks block energies, whatever the length of the stream.
+//
+// Streaming and batch use the same pass (batch is process() over the whole
+// buffer, then finish()), so live and offline features stay row for row.
+
+const double kTargetLufs = -23.0;
+const double kLoudnessGateLufs = -50.0;
+const double kLoudnessBlockSeconds = 0.1;
+const int kShortTermBlocks = 30; // 3 s, the BS.1770 short-term window
+const double kMaxAgcBoostDb = 24.0;
+const double kMaxAgcCutDb = 12.0;
+const double kLimiterCeiling = 0.9;
+
+class LoudnessNormalizer {
+public:
+    // Shelf corner of the K-weighting pre-filter (stage 1 below)
+    static constexpr double kShelfHz = 1681.974450955533;
+
+    // False for unusable sample rates: the pre-filter's shelf has to sit
+    // below Nyquist, so rates under about 3.4 kHz are refused
+    bool configure(double sampleRate) {
+        if (!(sampleRate > 2.0 * kShelfHz)) return false;
+        blockSize = std::max(1, static_cast<int>(std::lround(kLoudnessBlockSeconds * sampleRate)));
+        held.assign(static_cast<size_t>(blockSize) * 2, 0.0);
+
+        // BS.1770 stage 1: high shelf, +4 dB above about 1.7 kHz
+        double k = std::tan(dsp::kPi * kShelfHz / sampleRate);
+        double q = 0.7071752369554196;
+        double vh = std::pow(10.0, 3.999843853973347 / 20.0);
+        double vb = std::pow(vh, 0.4996667741545416);
+        double a0 = 1.0 + k / q + k * k;
+        shelf = {(vh + vb * k / q + k * k) / a0, 2.0 * (k * k - vh) / a0, (vh - vb * k / q + k * k) / a0,
+                 2.0 * (k * k - 1.0) / a0, (1.0 - k / q + k * k) / a0};
+        // Stage 2: RLB high-pass at about 38 Hz
+        k = std::tan(dsp::kPi * 38.13547087602444 / sampleRate);
+        q = 0.5003270373238773;
+        a0 = 1.0 + k / q + k * k;
+        highPass = {1.0, -2.0, 1.0, 2.0 * (k * k - 1.0) / a0, (1.0 - k / q + k * k) / a0};
+        reset();
+        return true;
+    }
+
+    // Starts a new stream with the same configuration
+    void reset() {
+        shelf.clear();
+        highPass.clear();
+        filled = 0;
+        blocks = 0;
+        std::fill(energies, energies + kShortTermBlocks, -1.0);
+        agcDb = 0.0;
+        loudness = kLoudnessGateLufs;
+        blockEnergy = 0.0;
+        blockPeak = 0.0;
+        heldGain = 1.0;
+        rampFrom = -1.0;
+    }
+
+    bool configured() const { return blockSize > 0; }
+
+    // Output lags input by up to this many samples
+    int latency() const { return 2 * blockSize; }
+
+    // Short-term loudness of the gated blocks so far, and the AGC gain
+    double shortTermLufs() const { return loudness; }
+    double gainDb() const { return agcDb; }
+
+    // Feeds `count` samples; `emit(const double* span, int n)` receives the
+    // normalised samples that are ready, in order
+    template <typename T, typename Emit>
+    void process(const T* samples, int count, Emit&& emit) {
+        for (int i = 0; i < count; i++) {
+            double x = samples[i];
+            double weighted = highPass.step(shelf.step(x));
+            blockEnergy += weighted * weighted;
+            blockPeak = std::max(blockPeak, std::abs(x));
+            held[static_cast<size_t>(blocks % 2) * blockSize + filled] = x;
+            if (++filled == blockSize) {
+                closeBlock(emit);
+            }
+        }
+    }
+
+    // Ends the stream, flushing everything held back; the open block gets
+    // the gain it has so far. reset() before the next stream.
+    template <typename Emit>
+    void finish(Emit&& emit) {
+        double gain = filled > 0 ? blockGain() : heldGain;
+        if (blocks > 0) {
+            emitHeld(std::min(heldGain, gain), blockSize, emit);
+        }
+        if (filled > 0) {
+            double* block = held.data() + static_cast<size_t>(blocks % 2) * blockSize;
+            ramp(block, filled, rampFrom < 0.0 ? gain : rampFrom, gain);
+            emit(static_cast<const double*>(block), filled);
+        }
+        filled = 0;
+        blocks = 0;
+    }
+
+private:
+    struct Biquad {
+        double b0, b1, b2, a1, a2;
+        double z1 = 0.0;
+        double z2 = 0.0;
+
+        double step(double x) {
+            double y = b0 * x + z1;
+            z1 = b1 * x - a1 * y + z2;
+            z2 = b2 * x - a2 * y;
+            return y;
+        }
+
+        void clear() {
+            z1 = 0.0;
+            z2 = 0.0;
+        }
+    };
+
+    // Gain for the open block: the AGC, updated with the block when it is
+    // loud enough to count, capped by the limiter
+    double blockGain() {
+        int n = std::max(1, filled);
+        double meanSquare = blockEnergy / n;
+        double blockLufs = -0.691 + 10.0 * std::log10(std::max(meanSquare, 1e-20));
+        energies[blocks % kShortTermBlocks] = blockLufs >= kLoudnessGateLufs ? meanSquare : -1.0;
+
+        double sum = 0.0;
+        int counted = 0;
+        for (double energy : energies) {
+            if (energy >= 0.0) {
+                sum += energy;
+                counted++;
+            }
+        }
+        if (counted > 0) {
+            loudness = -0.691 + 10.0 * std::log10(std::max(sum / counted, 1e-20));
+            agcDb = std::max(-kMaxAgcCutDb, std::min(kMaxAgcBoostDb, kTargetLufs - loudness));
+        }
+        double gain = std::pow(10.0, agcDb / 20.0);
+        if (blockPeak * gain > kLimiterCeiling) {
+            gain = kLimiterCeiling / blockPeak;
+        }
+        return gain;
+    }
+
+    template <typename Emit>
+    void closeBlock(Emit& emit) {
+        double gain = blockGain();
+        // The previous block can go now that its successor's gain is known
+        if (blocks > 0) {
+            emitHeld(std::min(heldGain, gain), blockSize, emit);
+        }
+        heldGain = gain;
+        blockEnergy = 0.0;
+        blockPeak = 0.0;
+        filled = 0;
+        blocks++;
+    }
+
+    // Emits the held (previous) block, ramping the gain to `target`; the
+    // first block of a stream starts at its target
+    template <typename Emit>
+    void emitHeld(double target, int count, Emit& emit) {
+        double* block = held.data() + static_cast<size_t>((blocks + 1) % 2) * blockSize;
+        ramp(block, count, rampFrom < 0.0 ? target : rampFrom, target);
+        emit(static_cast<const double*>(block), count);
+        rampFrom = target;
+    }
+
+    static void ramp(double* block, int count, double from, double to) {
+        double step = (to - from) / count;
+        for (int i = 0; i < count; i++) {
+            block[i] *= from + step * (i + 1);
+        }
+    }
+
+    int blockSize = 0;
+    Biquad shelf = {};
+    Biquad highPass = {};
+    PoolVector<double> held;
+    int filled = 0;
+    int64_t blocks = 0;
+    double energies[kShortTermBlocks] = {};
+    double agcDb = 0.0;
+    double loudness = 0.0;
+    double blockEnergy = 0.0;
+    double blockPeak = 0.0;
+    double heldGain = 1.0;
+    double rampFrom = -1.0;
+};
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include "arena.h"
+#include "dsp_tables.h"
+
+// LPC formant estimation.
+//
+// Vowel quality (fatha / kasra / damma, and the lowered F2 of tafkhim) is
+// carried by the first formants, which the 26-band mel smoothing blurs.
+// formantCandidates() fits an all-pole model to one analysis frame:
+//     1. decimate by whole steps to about kFormantSampleRate (averaging
+//        each step), so the model order stays small at 44.1/48 kHz
+//     2. pre-emphasis and a Hamming window
+//     3. autocorrelation r[0..order], order = 2 + rate / 1000
+//     4. Levinson-Durbin recursion for the predictor
+//     5. peak picking on the model envelope over kFormantGridPoints
+//        frequencies up to kMaxFormantHz, refined by parabolic
+//        interpolation of the log envelope
+// Up to kMaxFormantCandidates peaks above kMinFormantHz are kept, lowest
+// first. FormantTracker then labels three of them F1-F3 per frame, taking
+// the ordered triple closest (in log frequency) to the previous frame's
+// formants, or to a neutral vowel when there are none; frames without
+// candidates read 0 and leave the track where it was.
+
+const double kFormantSampleRate = 11025.0;
+const double kMaxFormantHz = 5000.0;
+const double kMinFormantHz = 90.0;
+const double kFormantPreEmphasis = 0.97;
+const int kFormantGridPoints = 256;
+const int kMaxFormantCandidates = 5;
+const int kMaxLpcOrder = 24;
+const int kFormantColumns = 3;
+// Frames quieter than this mean square carry no usable envelope
+const double kMinFormantPower = 1e-10;
+// Neutral vowel formants the tracker starts from
+const double kNeutralFormants[kFormantColumns] = {500.0, 1500.0, 2500.0};
+
+struct FormantCandidates {
+    int count;
+    double hz[kMaxFormantCandidates];
+};
+
+namespace lpc_detail {
+
+// Predictor a[0..order] (a[0] = 1) from autocorrelation r[0..order];
+// returns the prediction error power, 0 when r is degenerate
+inline double levinsonDurbin(const double* r, int order, double* a) {
+    double previous[kMaxLpcOrder + 1];
+    std::fill(a, a + order + 1, 0.0);
+    a[0] = 1.0;
+    double error = r[0];
+    if (error <= 0.0) return 0.0;
+    for (int i = 1; i <= order; i++) {
+        double acc = r[i];
+        for (int j = 1; j < i; j++) {
+            acc += a[j] * r[i - j];
+        }
+        double k = -acc / error;
+        std::copy(a, a + i, previous);
+        for (int j = 1; j < i; j++) {
+            a[j] = previous[j] + k * previous[i - j];
+        }
+        a[i] = k;
+        error *= 1.0 - k * k;
+        if (error <= 0.0) return 0.0;
+    }
+    return error;
+}
+
+} // namespace lpc_detail
+
+inline FormantCandidates formantCandidates(const double* frame, int frameSize, double sampleRate) {
+    FormantCandidates result = {};
+    int step = std::max(1, static_cast<int>(sampleRate / kFormantSampleRate + 1e-9));
+    double rate = sampleRate / step;
+    int length = frameSize / step;
+    int order = std::min(kMaxLpcOrder, 2 + static_cast<int>(rate / 1000.0));
+    if (length <= order + 1) return result;
+
+    // Decimate, pre-emphasise and window in one pass
+    ScratchArena& arena = analysisArena();
+    ArenaScope scope(arena);
+    double* x = arena.allocateArray<double>(length);
+    double last = 0.0;
+    for (int i = 0; i < length; i++) {
+        double sum = 0.0;
+        for (int j = 0; j < step; j++) {
+            sum += frame[i * step + j];
+        }
+        double value = sum / step;
+        double window = 0.54 - 0.46 * std::cos(2.0 * dsp::kPi * i / (length - 1));
+        x[i] = (value - kFormantPreEmphasis * last) * window;
+        last = value;
+    }
+
+    double r[kMaxLpcOrder + 1];
+    for (int lag = 0; lag <= order; lag++) {
+        double sum = 0.0;
+        for (int i = lag; i < length; i++) {
+            sum += x[i] * x[i - lag];
+        }
+        r[lag] = sum;
+    }
+    if (r[0] / length < kMinFormantPower) return result;
+    // Slight white-noise floor keeps the recursion stable on pure tones
+    r[0] *= 1.0 + 1e-9;
+
+    double a[kMaxLpcOrder + 1];
+    if (lpc_detail::levinsonDurbin(r, order, a) <= 0.0) return result;
+
+    // Log envelope -log|A(e^jw)|^2 on the grid
+    double top = std::min(kMaxFormantHz, 0.5 * rate);
+    double envelope[kFormantGridPoints];
+    for (int g = 0; g < kFormantGridPoints; g++) {
+        double omega = 2.0 * dsp::kPi * (top * g / (kFormantGridPoints - 1)) / rate;
+        double re = 0.0;
+        double im = 0.0;
+        for (int k = 0; k <= order; k++) {
+            re += a[k] * std::cos(omega * k);
+            im -= a[k] * std::sin(omega * k);
+        }
+        envelope[g] = -std::log(std::max(re * re + im * im, 1e-30));
+    }
+
+    double binHz = top / (kFormantGridPoints - 1);
+    for (int g = 1; g + 1 < kFormantGridPoints && result.count < kMaxFormantCandidates; g++) {
+        if (envelope[g] <= envelope[g - 1] || envelope[g] < envelope[g + 1]) continue;
+        double curvature = envelope[g - 1] - 2.0 * envelope[g] + envelope[g + 1];
+        double offset = curvature < 0.0 ? 0.5 * (envelope[g - 1] - envelope[g + 1]) / curvature : 0.0;
+        double hz = (g + offset) * binHz;
+        if (hz >= kMinFormantHz) {
+            result.hz[result.count++] = hz;
+        }
+    }
+    return result;
+}
+
+class FormantTracker {
+public:
+    FormantTracker() { reset(); }
+
+    void reset() {
+        std::copy(kNeutralFormants, kNeutralFormants + kFormantColumns, previous);
+    }
+
+    // F1-F3 in Hz for the next frame, 0 where there is no formant
+    void track(const FormantCandidates& candidates, double* formants) {
+        std::fill(formants, formants + kFormantColumns, 0.0);
+        int n = candidates.count;
+        if (n == 0) return;
+
+        // Ordered choice of min(n, 3) candidates closest to the track
+        int slots = std::min(n, kFormantColumns);
+        int best[kFormantColumns] = {0, 1, 2};
+        double bestCost = -1.0;
+        int pick[kFormantColumns];
+        choose(candidates, 0, 0, slots, pick, best, bestCost);
+        for (int s = 0; s < slots; s++) {
+            formants[s] = candidates.hz[best[s]];
+            previous[s] = formants[s];
+        }
+    }
+
+private:
+    void choose(const FormantCandidates& candidates, int slot, int from, int slots, int* pick,
+                int* best, double& bestCost) const {
+        if (slot == slots) {
+            double cost = 0.0;
+            for (int s = 0; s < slots; s++) {
+                cost += std::abs(std::log(candidates.hz[pick[s]] / previous[s]));
+            }
+            if (bestCost < 0.0 || cost < bestCost) {
+                bestCost = cost;
+                std::copy(pick, pick + slots, best);
+            }
+            return;
+        }
+        for (int c = from; c <= candidates.count - (slots - slot); c++) {
+            pick[slot] = c;
+            choose(candidates, slot + 1, c + 1, slots, pick, best, bestCost);
+        }
+    }
+
+    double previous[kFormantColumns];
+};
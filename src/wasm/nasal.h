@@ -0,0 +1,269 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include "arena.h"
+#include "dsp_tables.h"
+
+// Nasal murmur (ghunnah) detection.
+//
+// During a nasal murmur the mouth is closed and the sound leaves through
+// the nose: energy gathers in a low nasal formant (about 200-450 Hz) and
+// the closed oral cavity, a side branch, puts an anti-resonance (a deep
+// spectral zero) somewhere in 600-2400 Hz, lower for meem than for noon.
+// NasalDetector measures both with a small Goertzel bank on each analysis
+// frame, so it needs no FFT of its own. The bank's 24 probes cost one
+// multiply-add each per frame sample; at a hop of half the frame every
+// sample is in two frames, so about 48 per sample plus the window, small
+// next to the MFCC and pitch work on the same frame. Per frame:
+//     murmur   nasal band against the anti-resonance region, dB
+//     notch    deepest anti-resonance sub-band against its neighbours, dB
+//     voiced   level at least kNasalVoicingDb over a running noise floor
+//     score    voiced * sigmoid(murmur) * sigmoid(notch)
+//
+// Both cues are needed: a close back vowel (/u/) also has its first formant
+// in the nasal band, but no zero in the region above it.
+//
+// Frames are scored in stream order. A run that reaches kNasalOnScore and
+// holds above kNasalOffScore becomes a NasalSegment when it lasts at least
+// minSegmentSeconds, so ghunnah length can be checked in counts.
+//
+// Layout of NasalSegment (little-endian, 24 bytes):
+//     0  int32   start       frames [start, end)
+//     4  int32   end
+//     8  float32 meanScore
+//    12  float32 peakScore
+//    16  float64 durationMs
+
+struct NasalSegment {
+    int32_t start;
+    int32_t end;
+    float meanScore;
+    float peakScore;
+    double durationMs;
+};
+
+static_assert(sizeof(NasalSegment) == 24, "nasal segment layout");
+
+struct NasalConfig {
+    double sampleRate;
+    int frameSize;
+    int hopSize;
+    double minSegmentSeconds = 0.05;
+};
+
+// Goertzel probes: the nasal band every kNasalProbeSpacingHz, the
+// anti-resonance region as kAntiSubBands sub-bands of kProbesPerSubBand
+// probes. Dense enough that harmonics of any voice fall near a probe.
+const double kNasalBandLowHz = 200.0;
+const double kNasalBandHighHz = 450.0;
+const double kNasalProbeSpacingHz = 50.0;
+const double kAntiBandLowHz = 600.0;
+const double kAntiBandHighHz = 2400.0;
+const int kAntiSubBands = 6;
+const int kProbesPerSubBand = 3;
+const int kMaxNasalProbes = 32;
+
+// Sigmoid centres and widths of the two cues, dB
+const double kMurmurCentreDb = 16.0;
+const double kMurmurWidthDb = 2.0;
+const double kNotchCentreDb = 10.0;
+const double kNotchWidthDb = 2.0;
+const double kNasalVoicingDb = 12.0;
+const double kNasalFloorRiseDbPerSecond = 1.0;
+
+const double kNasalOnScore = 0.6;
+const double kNasalOffScore = 0.4;
+
+class NasalDetector {
+public:
+    // Sizes every buffer: scores for maxFrames frames between clearScores()
+    // calls. False for unusable configurations.
+    bool configure(const NasalConfig& nasalConfig, int maxFrames) {
+        if (nasalConfig.sampleRate <= 0 || nasalConfig.frameSize < 2 || nasalConfig.hopSize <= 0 ||
+            maxFrames <= 0) {
+            return false;
+        }
+        config = nasalConfig;
+        int size = config.frameSize;
+        window.resize(size);
+        windowed.resize(size);
+        for (int i = 0; i < size; i++) {
+            window[i] = 0.5 * (1.0 - std::cos(2.0 * dsp::kPi * i / (size - 1)));
+        }
+
+        probes = 0;
+        nasalProbes = 0;
+        double nyquist = 0.5 * config.sampleRate;
+        for (double hz = kNasalBandLowHz; hz <= kNasalBandHighHz && hz < nyquist; hz += kNasalProbeSpacingHz) {
+            addProbe(hz);
+            nasalProbes++;
+        }
+        double subBand = (kAntiBandHighHz - kAntiBandLowHz) / kAntiSubBands;
+        for (int b = 0; b < kAntiSubBands; b++) {
+            for (int p = 0; p < kProbesPerSubBand; p++) {
+                addProbe(kAntiBandLowHz + subBand * (p + 0.5) / kProbesPerSubBand + subBand * b);
+            }
+        }
+
+        double frameRate = config.sampleRate / config.hopSize;
+        floorRise = kNasalFloorRiseDbPerSecond / frameRate;
+        minSegmentFrames = std::max(1, static_cast<int>(std::lround(config.minSegmentSeconds * frameRate)));
+        scoreBuffer.resize(maxFrames);
+        found.clear();
+        found.reserve(64);
+        reset();
+        return true;
+    }
+
+    // Starts a new stream with the same configuration
+    void reset() {
+        frame = 0;
+        pending = 0;
+        floorDb = 0.0;
+        runStart = -1;
+        found.clear();
+    }
+
+    bool configured() const { return !window.empty(); }
+
+    // Scores the next frameSize-sample frame of the stream
+    double push(const double* samples) {
+        int size = config.frameSize;
+        double power = 0.0;
+        for (int i = 0; i < size; i++) {
+            power += samples[i] * samples[i];
+            windowed[i] = samples[i] * window[i];
+        }
+        double level = 10.0 * std::log10(std::max(power / size, 1e-18));
+        if (frame == 0) floorDb = level;
+        bool voiced = level >= floorDb + kNasalVoicingDb;
+        floorDb = level < floorDb ? level : std::min(level, floorDb + floorRise);
+
+        double score = 0.0;
+        if (voiced && nasalProbes > 0 && probes > nasalProbes) {
+            double energy[kMaxNasalProbes];
+            for (int p = 0; p < probes; p++) {
+                energy[p] = goertzel(coefficient[p]);
+            }
+            double nasal = 0.0;
+            for (int p = 0; p < nasalProbes; p++) {
+                nasal += energy[p];
+            }
+            nasal /= nasalProbes;
+
+            // Anti-resonance sub-bands that fit below Nyquist
+            int subBands = (probes - nasalProbes) / kProbesPerSubBand;
+            double bands[kAntiSubBands];
+            double anti = 0.0;
+            for (int b = 0; b < subBands; b++) {
+                double band = 0.0;
+                for (int p = 0; p < kProbesPerSubBand; p++) {
+                    band += energy[nasalProbes + b * kProbesPerSubBand + p];
+                }
+                bands[b] = std::max(band / kProbesPerSubBand, 1e-30);
+                anti += bands[b];
+            }
+            anti /= std::max(1, subBands);
+
+            // Deepest sub-band against the geometric mean of its neighbours,
+            // so spectral tilt alone does not count as a zero
+            double notchDb = 0.0;
+            for (int b = 1; b + 1 < subBands; b++) {
+                double dip = 5.0 * std::log10(bands[b - 1] * bands[b + 1]) - 10.0 * std::log10(bands[b]);
+                notchDb = std::max(notchDb, dip);
+            }
+            double murmurDb = 10.0 * std::log10(std::max(nasal, 1e-30) / std::max(anti, 1e-30));
+            score = sigmoid((murmurDb - kMurmurCentreDb) / kMurmurWidthDb) *
+                    sigmoid((notchDb - kNotchCentreDb) / kNotchWidthDb);
+        }
+
+        track(score);
+        if (pending < static_cast<int>(scoreBuffer.size())) {
+            scoreBuffer[pending++] = static_cast<float>(score);
+        }
+        frame++;
+        return score;
+    }
+
+    // Ends the stream, closing a segment still open
+    void finish() {
+        if (runStart >= 0) closeRun(frame);
+    }
+
+    // Scores of the frames pushed since the last clearScores(); frames past
+    // the buffer are still tracked for segments but not stored
+    int scoreCount() const { return pending; }
+    const float* scores() const { return scoreBuffer.data(); }
+    void clearScores() { pending = 0; }
+
+    int segmentCount() const { return static_cast<int>(found.size()); }
+    const NasalSegment* segments() const { return found.data(); }
+    int64_t framesScored() const { return frame; }
+
+private:
+    static double sigmoid(double x) { return 1.0 / (1.0 + std::exp(-x)); }
+
+    void addProbe(double hz) {
+        if (probes >= kMaxNasalProbes || hz >= 0.5 * config.sampleRate) return;
+        coefficient[probes++] = 2.0 * std::cos(2.0 * dsp::kPi * hz / config.sampleRate);
+    }
+
+    // Power of the windowed frame at one probe frequency
+    double goertzel(double coeff) const {
+        double s1 = 0.0;
+        double s2 = 0.0;
+        for (double x : windowed) {
+            double s0 = x + coeff * s1 - s2;
+            s2 = s1;
+            s1 = s0;
+        }
+        return s1 * s1 + s2 * s2 - coeff * s1 * s2;
+    }
+
+    // Hysteresis over the frame scores
+    void track(double score) {
+        if (runStart < 0) {
+            if (score >= kNasalOnScore) {
+                runStart = frame;
+                runSum = 0.0;
+                runPeak = 0.0;
+            } else {
+                return;
+            }
+        } else if (score < kNasalOffScore) {
+            closeRun(frame);
+            return;
+        }
+        runSum += score;
+        runPeak = std::max(runPeak, score);
+    }
+
+    void closeRun(int64_t end) {
+        int64_t length = end - runStart;
+        if (length >= minSegmentFrames) {
+            found.push_back({static_cast<int32_t>(runStart), static_cast<int32_t>(end),
+                             static_cast<float>(runSum / length), static_cast<float>(runPeak),
+                             length * 1000.0 * config.hopSize / config.sampleRate});
+        }
+        runStart = -1;
+    }
+
+    NasalConfig config = {};
+    PoolVector<double> window;
+    PoolVector<double> windowed;
+    double coefficient[kMaxNasalProbes] = {};
+    int probes = 0;
+    int nasalProbes = 0;
+    double floorRise = 0.0;
+    int minSegmentFrames = 1;
+    PoolVector<float> scoreBuffer;
+    PoolVector<NasalSegment> found;
+    int64_t frame = 0;
+    int pending = 0;
+    double floorDb = 0.0;
+    int64_t runStart = -1;
+    double runSum = 0.0;
+    double runPeak = 0.0;
+};
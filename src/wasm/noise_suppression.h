@@ -0,0 +1,123 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include "arena.h"
+
+// Spectral noise suppression ahead of the mel stage.
+//
+// Fans and traffic put a steady floor under the whole spectrum. It lifts the
+// quiet mel bands of every frame, so two recitations of the same words made
+// in different rooms drift apart in DTW distance. NoiseSuppressor keeps a
+// noise power profile, one value per FFT bin, learned from frames an energy
+// VAD calls silent. AudioProcessor::logMelInto then scales each magnitude
+// bin of the spectrum it computes anyway by a Wiener-style gain:
+//     gain = max(kNoiseGainFloor, 1 - kNoiseOverSubtraction * noise / power)
+// the spectral subtraction of the noise power, floored so that residual
+// noise stays smooth instead of turning into musical tones.
+//
+// The VAD compares the frame level (from the spectrum) with a running floor
+// that follows drops at once and rises kNoiseFloorRiseDbPerSecond: frames
+// within kNoiseVadDb of it are noise. The profile is the mean of the first
+// noise frames, then an exponential average at kNoiseLearnRate so it follows
+// slow changes; a noise frame kNoiseVadDb quieter than the profile starts it
+// over (the stream opened on speech). The spectrum passes unchanged until
+// kMinNoiseFrames noise frames have been seen.
+//
+// Streams learn and apply frame by frame (process()). Batch analysis learns
+// from the quietest frames of the recording first (learn()) and freezes the
+// profile; process() then only reads, so a parallel frame loop may share it.
+
+const double kNoiseVadDb = 6.0;
+const double kNoiseFloorRiseDbPerSecond = 1.0;
+const double kNoiseLearnRate = 0.05;
+const double kNoiseOverSubtraction = 1.0;
+const double kNoiseGainFloor = 0.1;
+const int kMinNoiseFrames = 4;
+// Frames a batch profile is learned from, at most
+const int kMaxNoiseFrames = 32;
+
+class NoiseSuppressor {
+public:
+    // `spectrumBins` magnitudes per frame at `frameRate` frames per second.
+    // False for unusable configurations.
+    bool configure(int spectrumBins, double frameRate) {
+        if (spectrumBins <= 0 || frameRate <= 0) return false;
+        noise.assign(spectrumBins, 0.0);
+        floorRise = kNoiseFloorRiseDbPerSecond / frameRate;
+        reset();
+        return true;
+    }
+
+    // Forgets the profile and unfreezes it
+    void reset() {
+        std::fill(noise.begin(), noise.end(), 0.0);
+        learned = 0;
+        frames = 0;
+        floorDb = 0.0;
+        profileDb = 0.0;
+        frozen = false;
+    }
+
+    bool configured() const { return !noise.empty(); }
+    int bins() const { return static_cast<int>(noise.size()); }
+    bool ready() const { return learned >= kMinNoiseFrames; }
+    int framesLearned() const { return learned; }
+
+    // Stops learning; process() only applies the profile from now on
+    void freeze() { frozen = true; }
+
+    // Adds one noise frame to the profile
+    void learn(const double* magnitude) {
+        double level = levelOf(magnitude);
+        double rate = std::max(kNoiseLearnRate, 1.0 / (learned + 1));
+        for (size_t k = 0; k < noise.size(); k++) {
+            noise[k] += rate * (magnitude[k] * magnitude[k] - noise[k]);
+        }
+        profileDb += rate * (level - profileDb);
+        learned++;
+    }
+
+    // One frame in stream order: learn from it when it is silent, then
+    // suppress. `count` must be bins().
+    void process(double* magnitude, int count) {
+        if (count != bins()) return;
+        if (!frozen) {
+            double level = levelOf(magnitude);
+            if (frames == 0) floorDb = level;
+            bool silent = level < floorDb + kNoiseVadDb;
+            floorDb = level < floorDb ? level : std::min(level, floorDb + floorRise);
+            frames++;
+            if (silent) {
+                if (learned > 0 && level < profileDb - kNoiseVadDb) {
+                    learned = 0;
+                }
+                learn(magnitude);
+            }
+        }
+        if (!ready()) return;
+        for (int k = 0; k < count; k++) {
+            double power = magnitude[k] * magnitude[k];
+            double gain = power > 0.0 ? 1.0 - kNoiseOverSubtraction * noise[k] / power : 0.0;
+            magnitude[k] *= std::max(kNoiseGainFloor, gain);
+        }
+    }
+
+private:
+    double levelOf(const double* magnitude) const {
+        double power = 0.0;
+        for (size_t k = 0; k < noise.size(); k++) {
+            power += magnitude[k] * magnitude[k];
+        }
+        return 10.0 * std::log10(std::max(power / noise.size(), 1e-20));
+    }
+
+    PoolVector<double> noise;
+    double floorRise = 0.0;
+    int learned = 0;
+    int64_t frames = 0;
+    double floorDb = 0.0;
+    double profileDb = 0.0;
+    bool frozen = false;
+};
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include "arena.h"
+
+// Onsets and syllable nuclei from the frame pipeline.
+//
+// Both come from values the feature extraction computes anyway: the log
+// mel energies behind the MFCCs (AudioProcessor::logMelInto) and the RMS
+// energy column, one frame at a time in stream order.
+//
+//   Onsets: spectral flux, the mean rise of the log mel energies over the
+//   previous frame (bands that got quieter count zero). A frame is an onset
+//   when its flux is the largest within kOnsetMaxSeconds on either side and
+//   exceeds the mean flux over kOnsetPreAverageSeconds before and
+//   kOnsetPostAverageSeconds after it by kOnsetDelta. Onsets are at least
+//   kMinOnsetGapSeconds apart.
+//
+//   Nuclei: peaks of the energy contour, in dB, that rise kNucleusDipDb
+//   over the dip before them and fall as far after, and lie within
+//   kNucleusRangeDb of the running speech level: one per syllable vowel.
+//
+// Both wait for frames after the one they report, so landmarks lag the
+// stream by up to kOnsetPostAverageSeconds (onsets) or the next dip
+// (nuclei), and are listed in the order they are confirmed; finish()
+// settles the tail and sorts them by frame. They are cheap anchors for the
+// aligners: a word cannot start between two nuclei of the same syllable,
+// and syllable counts bound how far a DTW band has to stretch.
+//
+// Layout of SpeechLandmark (little-endian, 16 bytes):
+//     0  int32   frame
+//     4  int32   kind        LandmarkKind
+//     8  float32 strength    onset: flux over the threshold;
+//                            nucleus: rise over the dip before it, dB
+//    12  float32 levelDb     frame energy
+
+enum class LandmarkKind : int32_t {
+    Onset = 0,
+    Nucleus = 1
+};
+
+struct SpeechLandmark {
+    int32_t frame;
+    int32_t kind;
+    float strength;
+    float levelDb;
+};
+
+static_assert(sizeof(SpeechLandmark) == 16, "speech landmark layout");
+
+const double kOnsetMaxSeconds = 0.03;
+const double kOnsetPreAverageSeconds = 0.1;
+const double kOnsetPostAverageSeconds = 0.07;
+const double kOnsetDelta = 0.3;
+const double kMinOnsetGapSeconds = 0.05;
+const double kNucleusDipDb = 2.0;
+const double kNucleusRangeDb = 25.0;
+const double kNucleusDecayDbPerSecond = 2.0;
+// Flux history kept for the look-ahead window, in frames
+const int kOnsetHistory = 64;
+const int kLandmarkBands = 64;
+
+class OnsetDetector {
+public:
+    // `bands` log mel energies per frame at `frameRate` frames per second.
+    // False for unusable configurations.
+    bool configure(double frameRate, int bands) {
+        if (frameRate <= 0 || bands <= 0 || bands > kLandmarkBands) return false;
+        rate = frameRate;
+        bandCount = bands;
+        auto frames = [&](double seconds) { return std::max(1, static_cast<int>(std::lround(seconds * frameRate))); };
+        maxWindow = frames(kOnsetMaxSeconds);
+        preAverage = frames(kOnsetPreAverageSeconds);
+        postAverage = std::max(maxWindow, frames(kOnsetPostAverageSeconds));
+        // The whole window has to fit in the history ring
+        preAverage = std::min(preAverage, kOnsetHistory - postAverage - 1);
+        minGap = frames(kMinOnsetGapSeconds);
+        speechDecay = kNucleusDecayDbPerSecond / frameRate;
+        found.clear();
+        found.reserve(256);
+        reset();
+        return true;
+    }
+
+    // Starts a new stream with the same configuration
+    void reset() {
+        frame = 0;
+        lastOnset = -minGap - 1;
+        speech = 0.0;
+        dipBefore = 0.0;
+        peakFrame = -1;
+        found.clear();
+    }
+
+    bool configured() const { return rate > 0.0; }
+
+    // One frame: its log mel energies and RMS energy
+    void push(const double* logMel, double energy) {
+        double flux = 0.0;
+        if (frame > 0) {
+            for (int b = 0; b < bandCount; b++) {
+                flux += std::max(0.0, logMel[b] - previous[b]);
+            }
+            flux /= bandCount;
+        }
+        std::copy(logMel, logMel + bandCount, previous);
+        fluxes[frame % kOnsetHistory] = flux;
+        double level = 20.0 * std::log10(std::max(energy, 1e-9));
+        levels[frame % kOnsetHistory] = level;
+
+        // The frame whose look-ahead is now complete
+        if (frame >= postAverage) pickOnset(frame - postAverage, frame);
+        trackNucleus(frame, level);
+        frame++;
+    }
+
+    // Ends the stream: frames still waiting for look-ahead are judged on
+    // what there is
+    void finish() {
+        for (int64_t t = std::max<int64_t>(0, frame - postAverage); t < frame; t++) {
+            pickOnset(t, frame - 1);
+        }
+        std::sort(found.begin(), found.end(), [](const SpeechLandmark& a, const SpeechLandmark& b) {
+            return a.frame < b.frame;
+        });
+    }
+
+    int landmarkCount() const { return static_cast<int>(found.size()); }
+    const SpeechLandmark* landmarks() const { return found.data(); }
+    int64_t framesSeen() const { return frame; }
+
+private:
+    // Onset test for frame t with flux known up to frame `last`
+    void pickOnset(int64_t t, int64_t last) {
+        double flux = fluxes[t % kOnsetHistory];
+        if (t - lastOnset < minGap || flux <= 0.0) return;
+        for (int64_t k = std::max<int64_t>(0, t - maxWindow); k <= std::min(last, t + maxWindow); k++) {
+            if (fluxes[k % kOnsetHistory] > flux) return;
+        }
+        double sum = 0.0;
+        int count = 0;
+        for (int64_t k = std::max<int64_t>(0, t - preAverage); k <= std::min(last, t + postAverage); k++) {
+            sum += fluxes[k % kOnsetHistory];
+            count++;
+        }
+        double threshold = sum / count + kOnsetDelta;
+        if (flux < threshold) return;
+        found.push_back({static_cast<int32_t>(t), static_cast<int32_t>(LandmarkKind::Onset),
+                         static_cast<float>(flux - threshold), static_cast<float>(levels[t % kOnsetHistory])});
+        lastOnset = t;
+    }
+
+    // Peak picking on the energy contour: a peak is confirmed once the level
+    // has fallen kNucleusDipDb below it
+    void trackNucleus(int64_t t, double level) {
+        speech = t == 0 || level > speech ? level : std::max(level, speech - speechDecay);
+        if (t == 0) dipBefore = level;
+
+        if (peakFrame < 0) {
+            dipBefore = std::min(dipBefore, level);
+            if (level >= dipBefore + kNucleusDipDb) {
+                peakFrame = t;
+                peakLevel = level;
+            }
+            return;
+        }
+        if (level > peakLevel) {
+            peakFrame = t;
+            peakLevel = level;
+        } else if (level <= peakLevel - kNucleusDipDb) {
+            if (peakLevel >= speech - kNucleusRangeDb) {
+                found.push_back({static_cast<int32_t>(peakFrame), static_cast<int32_t>(LandmarkKind::Nucleus),
+                                 static_cast<float>(peakLevel - dipBefore), static_cast<float>(peakLevel)});
+            }
+            peakFrame = -1;
+            dipBefore = level;
+        }
+    }
+
+    double rate = 0.0;
+    int bandCount = 0;
+    int maxWindow = 1;
+    int preAverage = 1;
+    int postAverage = 1;
+    int minGap = 1;
+    double speechDecay = 0.0;
+
+    double previous[kLandmarkBands] = {};
+    double fluxes[kOnsetHistory] = {};
+    double levels[kOnsetHistory] = {};
+    int64_t frame = 0;
+    int64_t lastOnset = 0;
+    double speech = 0.0;
+    double dipBefore = 0.0;
+    int64_t peakFrame = -1;
+    double peakLevel = 0.0;
+    PoolVector<SpeechLandmark> found;
+};
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include "arena.h"
+
+// Multi-resolution min/max/RMS summary of a recording for waveform drawing.
+//
+// Level 0 has one bin per kPeakBaseBin samples and each level above halves
+// the resolution, so any zoom reads the level whose bins are just finer
+// than a pixel and touches at most two bins per pixel: repainting costs
+// O(pixels), not O(samples). A bin is three int16 values (min, max, RMS,
+// scaled by 32767), 6 bytes against 256 for the samples it covers, and the
+// whole pyramid is under 5% of the float32 audio.
+//
+// append() is incremental: samples go into the open bin of level 0 and a
+// finished bin is folded into the level above, so building while recording
+// costs a few operations per sample. The last bin of every level is kept up
+// to date with the samples it has seen so far, so a level always covers the
+// whole stream. RMS is combined from exact mean squares, not from the
+// rounded values of the finer level.
+//
+// Layout of a level for C API readers: bins(level) PeakBin records,
+// contiguous, at data(level); little-endian int16 min, max, rms.
+
+struct PeakBin {
+    int16_t min;
+    int16_t max;
+    int16_t rms;
+};
+
+static_assert(sizeof(PeakBin) == 6, "peak bin layout");
+
+// Samples per level-0 bin; a power of two
+const int kPeakBaseBin = 64;
+// Level 15 bins cover about 47 s at 44.1 kHz
+const int kMaxPeakLevels = 16;
+
+class PeakPyramid {
+public:
+    // Reserves every level for `expectedSamples`, so a recording up to that
+    // length never moves the data while it is being read
+    explicit PeakPyramid(int64_t expectedSamples = 0) { reserve(expectedSamples); }
+
+    void reserve(int64_t expectedSamples) {
+        int64_t bins = (std::max<int64_t>(0, expectedSamples) + kPeakBaseBin - 1) / kPeakBaseBin;
+        for (int level = 0; level < kMaxPeakLevels && bins > 0; level++) {
+            store[level].reserve(static_cast<size_t>(bins));
+            bins = (bins + 1) / 2;
+        }
+    }
+
+    void append(const float* samples, int count) {
+        for (int i = 0; i < count; i++) {
+            double value = samples[i];
+            Summary& open = pending[0];
+            open.min = open.count == 0 ? value : std::min(open.min, value);
+            open.max = open.count == 0 ? value : std::max(open.max, value);
+            open.sumSquares += value * value;
+            if (++open.count == kPeakBaseBin) {
+                closeBin(0);
+            }
+        }
+        total += std::max(0, count);
+        refreshOpenBins();
+    }
+
+    void clear() {
+        for (int level = 0; level < kMaxPeakLevels; level++) {
+            store[level].clear();
+            pending[level] = Summary();
+            closed[level] = 0;
+        }
+        total = 0;
+    }
+
+    // Levels holding more than one bin, plus the first that holds one
+    int levels() const {
+        int level = 0;
+        while (level + 1 < kMaxPeakLevels && store[level].size() > 1) {
+            level++;
+        }
+        return level + 1;
+    }
+
+    int bins(int level) const {
+        return level >= 0 && level < kMaxPeakLevels ? static_cast<int>(store[level].size()) : 0;
+    }
+
+    // Valid until the next append() past the reserved length, or clear()
+    const PeakBin* data(int level) const {
+        return level >= 0 && level < kMaxPeakLevels ? store[level].data() : nullptr;
+    }
+
+    static int64_t binSamples(int level) { return static_cast<int64_t>(kPeakBaseBin) << level; }
+
+    // The coarsest level with at least one bin per `samplesPerPixel`
+    int levelFor(double samplesPerPixel) const {
+        int level = 0;
+        while (level + 1 < levels() && binSamples(level + 1) <= samplesPerPixel) {
+            level++;
+        }
+        return level;
+    }
+
+    int64_t samples() const { return total; }
+
+private:
+    // Open bin being accumulated. sumSquares is over samples, so the RMS of
+    // a coarse bin is exact whatever its children were.
+    struct Summary {
+        double min = 0.0;
+        double max = 0.0;
+        double sumSquares = 0.0;
+        int64_t count = 0;
+
+        void merge(const Summary& other) {
+            if (other.count == 0) return;
+            min = count == 0 ? other.min : std::min(min, other.min);
+            max = count == 0 ? other.max : std::max(max, other.max);
+            sumSquares += other.sumSquares;
+            count += other.count;
+        }
+    };
+
+    static int16_t quantize(double value) {
+        return static_cast<int16_t>(std::lround(std::max(-1.0, std::min(1.0, value)) * 32767.0));
+    }
+
+    static PeakBin toBin(const Summary& summary) {
+        double rms = summary.count > 0 ? std::sqrt(summary.sumSquares / summary.count) : 0.0;
+        return {quantize(summary.min), quantize(summary.max), quantize(rms)};
+    }
+
+    // Seals the open bin of `level` and folds it into the level above;
+    // two sealed bins close a bin there
+    void closeBin(int level) {
+        while (true) {
+            Summary done = pending[level];
+            pending[level] = Summary();
+            setBin(level, closed[level]++, done);
+            if (level + 1 >= kMaxPeakLevels) return;
+            Summary& parent = pending[level + 1];
+            parent.merge(done);
+            if (parent.count < binSamples(level + 1)) return;
+            level++;
+        }
+    }
+
+    // Open bins at every level: the level's sealed children plus the open
+    // bin of the level below
+    void refreshOpenBins() {
+        Summary carry;
+        for (int level = 0; level < kMaxPeakLevels; level++) {
+            Summary open = pending[level];
+            if (level > 0) open.merge(carry);
+            if (open.count == 0) {
+                store[level].resize(static_cast<size_t>(closed[level]));
+            } else {
+                setBin(level, closed[level], open);
+            }
+            carry = open;
+        }
+    }
+
+    void setBin(int level, int64_t index, const Summary& summary) {
+        PoolVector<PeakBin>& target = store[level];
+        if (static_cast<int64_t>(target.size()) <= index) {
+            target.resize(static_cast<size_t>(index) + 1);
+        }
+        target[static_cast<size_t>(index)] = toBin(summary);
+    }
+
+    PoolVector<PeakBin> store[kMaxPeakLevels];
+    Summary pending[kMaxPeakLevels];
+    int64_t closed[kMaxPeakLevels] = {};
+    int64_t total = 0;
+};
@@ -0,0 +1,220 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+#include "arena.h"
+#include "cancellation.h"
+#include "dtw.h"
+#include "feature_matrix.h"
+#include "scheduler.h"
+#include "time_slice.h"
+#include "workspace.h"
+
+// Adaptive alignment planning.
+//
+// planAlignment() picks the DTW variant and its parameters from the input
+// sizes, the memory budget, the latency target and the accuracy the caller
+// accepts, and reports the choice, so a 2-second word and a 20-minute surah
+// behave predictably. Candidates are tried in order and the first that fits
+// both the memory budget and the latency target wins:
+//     exact:  DistanceOnly (no path wanted), else Full, then Hirschberg
+//     approximate (tolerance > 0):  Banded, then FastDTW at the largest
+//             radius that fits
+// When nothing meets the latency target, the fastest plan that fits in
+// memory is returned with withinLatency false. When nothing fits in memory,
+// the smallest plan is returned with feasible false.
+//
+// Times are estimates: cells visited times a per-cell cost measured once per
+// process (alignmentCellNs), scaled per variant from native and WASM runs.
+//
+// Layout of AlignmentPlan for C API readers (little-endian, 40 bytes):
+//     0  int32   algorithm        DTWAlgorithm
+//     4  int32   bandWidth        Banded: Sakoe-Chiba half width
+//     8  int32   radius           FastDTW: corridor radius in frames
+//    12  int32   threads          scheduler threads the alignment may use
+//    16  uint8   singlePrecision  features converted to float32 first
+//    17  uint8   exact            distance is the optimum
+//    18  uint8   feasible         fits the memory budget
+//    19  uint8   withinLatency    estimate meets the latency target
+//    24  float64 estimatedMs
+//    32  float64 workspaceBytes   inputs plus peak scratch
+
+struct AlignmentPlan {
+    DTWAlgorithm algorithm;
+    int32_t bandWidth;
+    int32_t radius;
+    int32_t threads;
+    bool singlePrecision;
+    bool exact;
+    bool feasible;
+    bool withinLatency;
+    double estimatedMs;
+    double workspaceBytes;
+};
+
+static_assert(sizeof(AlignmentPlan) == 40, "alignment plan layout");
+
+// Per-cell cost of each variant relative to the rolling-row recurrence
+const double kStoredCellCost = 1.7;
+const double kHirschbergCellCost = 2.4;
+
+// FastDTW radius range. Below kLooseTolerance the radius stays at least
+// kSafeFastRadius, which recovers the exact path on typical recitations.
+const int kMinFastRadius = 1;
+const int kSafeFastRadius = 8;
+const int kMaxFastRadius = 32;
+const double kLooseTolerance = 0.05;
+
+// Tolerance from which float32 rounding (about 1e-7 relative) is acceptable
+const double kSinglePrecisionTolerance = 1e-6;
+
+// Nanoseconds per rolling-row cell at `dim` features, measured on first use
+inline double alignmentCellNs(int dim) {
+    static const double nsPer16 = [] {
+        const int size = 96;
+        const int width = 16;
+        FeatureMatrixF a(size, width);
+        FeatureMatrixF b(size, width);
+        for (int i = 0; i < size; i++) {
+            for (int c = 0; c < width; c++) {
+                a.row(i)[c] = static_cast<float>((i * 7 + c * 3) % 11);
+                b.row(i)[c] = static_cast<float>((i * 5 + c * 2) % 13);
+            }
+        }
+        // Measured outside any CancelScope so an expired deadline cannot
+        // cut the run short
+        CancelControl* saved = currentCancelControl();
+        currentCancelControl() = nullptr;
+        DynamicTimeWarping dtw;
+        double best = std::numeric_limits<double>::infinity();
+        for (int run = 0; run < 3; run++) {
+            double start = engineMonotonicUs();
+            dtw.align(a.view(), b.view(), DistanceMetric::Euclidean, -1, nullptr);
+            best = std::min(best, engineMonotonicUs() - start);
+        }
+        currentCancelControl() = saved;
+        return std::max(1e-3, best * 1000.0 / (static_cast<double>(size) * size));
+    }();
+    // About two features' worth of fixed work per cell
+    return nsPer16 * (std::max(1, dim) + 2) / (16 + 2);
+}
+
+inline AlignmentPlan planAlignment(int n, int m, int dim, bool needPath,
+                                   double memoryBytes, double latencyMs, double tolerance) {
+    int threads = TaskScheduler::instance().concurrency();
+    size_t budget = static_cast<size_t>(std::max(0.0, memoryBytes));
+    bool approximate = tolerance > 0.0;
+    bool single = tolerance >= kSinglePrecisionTolerance;
+    double cellNs = alignmentCellNs(dim);
+    double cells = static_cast<double>(n) * m;
+    int longer = std::max(n, m);
+
+    // Double inputs as planDTWWorkspace counts them, plus float32 copies
+    size_t strideD = alignUp(static_cast<size_t>(dim), kArenaAlignment / sizeof(double));
+    size_t strideF = alignUp(static_cast<size_t>(dim), kArenaAlignment / sizeof(float));
+    size_t inputBytes = arenaBytes(static_cast<size_t>(n) * strideD, sizeof(double)) +
+                        arenaBytes(static_cast<size_t>(m) * strideD, sizeof(double));
+    if (single) {
+        inputBytes += arenaBytes(static_cast<size_t>(n) * strideF, sizeof(float)) +
+                      arenaBytes(static_cast<size_t>(m) * strideF, sizeof(float));
+    }
+
+    auto candidate = [&](DTWAlgorithm algorithm, int parameter, double work, bool exact) {
+        AlignmentPlan plan = {};
+        plan.algorithm = algorithm;
+        plan.bandWidth = algorithm == DTWAlgorithm::Banded ? parameter : -1;
+        plan.radius = algorithm == DTWAlgorithm::FastDTW ? parameter : 0;
+        plan.threads = algorithm == DTWAlgorithm::Hirschberg ? threads : 1;
+        plan.singlePrecision = single;
+        plan.exact = exact;
+        plan.estimatedMs = work * cellNs / 1e6;
+        size_t bytes = inputBytes + alignmentBytes(n, m, dim, algorithm, parameter, plan.threads);
+        plan.workspaceBytes = static_cast<double>(bytes);
+        plan.feasible = withinBudget(bytes, budget);
+        plan.withinLatency = latencyMs <= 0.0 || plan.estimatedMs <= latencyMs;
+        return plan;
+    };
+    auto fastWork = [&](int radius) {
+        return kStoredCellCost * 2.0 * (static_cast<double>(n) + m) * (2.0 * radius + 3.0);
+    };
+
+    std::vector<AlignmentPlan> candidates;
+    if (!needPath) {
+        candidates.push_back(candidate(DTWAlgorithm::DistanceOnly, -1, cells, true));
+    } else {
+        candidates.push_back(candidate(DTWAlgorithm::Full, -1, kStoredCellCost * cells, true));
+        // Both passes of a split run at once when there is a second thread
+        double split = threads > 1 ? 2.0 : 1.0;
+        candidates.push_back(candidate(DTWAlgorithm::Hirschberg, -1, kHirschbergCellCost * cells / split, true));
+    }
+    if (approximate) {
+        // Centred on i == j: the length difference plus an eighth for tempo
+        int band = std::abs(n - m) + (longer + 7) / 8;
+        if (band < longer) {
+            double banded = kStoredCellCost * (static_cast<double>(n) + 1) * (2.0 * band + 1);
+            candidates.push_back(candidate(DTWAlgorithm::Banded, band, banded, false));
+        }
+
+        int minRadius = tolerance >= kLooseTolerance ? kMinFastRadius : kSafeFastRadius;
+        int radius = kMaxFastRadius;
+        while (radius > minRadius) {
+            AlignmentPlan plan = candidate(DTWAlgorithm::FastDTW, radius, fastWork(radius), false);
+            if (plan.feasible && plan.withinLatency) break;
+            radius--;
+        }
+        candidates.push_back(candidate(DTWAlgorithm::FastDTW, radius, fastWork(radius), false));
+    }
+
+    for (const AlignmentPlan& plan : candidates) {
+        if (plan.feasible && plan.withinLatency) return plan;
+    }
+    const AlignmentPlan* fastest = nullptr;
+    const AlignmentPlan* smallest = &candidates.front();
+    for (const AlignmentPlan& plan : candidates) {
+        if (plan.feasible && (!fastest || plan.estimatedMs < fastest->estimatedMs)) fastest = &plan;
+        if (plan.workspaceBytes < smallest->workspaceBytes) smallest = &plan;
+    }
+    return fastest ? *fastest : *smallest;
+}
+
+template <typename T>
+DTWOutcome runAlignmentPlan(DynamicTimeWarping& dtw, BasicFeatureView<T> seq1, BasicFeatureView<T> seq2,
+                            const AlignmentPlan& plan, std::vector<std::pair<int, int>>* path) {
+    switch (plan.algorithm) {
+        case DTWAlgorithm::Full:
+            return dtw.align(seq1, seq2, DistanceMetric::Euclidean, -1, path);
+        case DTWAlgorithm::Banded:
+            return dtw.align(seq1, seq2, DistanceMetric::Euclidean, plan.bandWidth, path);
+        case DTWAlgorithm::DistanceOnly:
+            if (path) path->clear();
+            return dtw.align(seq1, seq2, DistanceMetric::Euclidean, -1, nullptr);
+        case DTWAlgorithm::FastDTW:
+            return dtw.alignFast(seq1, seq2, DistanceMetric::Euclidean, plan.radius, path);
+        case DTWAlgorithm::Hirschberg:
+            return dtw.alignHirschberg(seq1, seq2, DistanceMetric::Euclidean, path);
+    }
+    return {std::numeric_limits<double>::infinity(), 0};
+}
+
+// Runs a plan over double inputs, converting them to float32 in the arena
+// first when the plan says so
+inline DTWOutcome runAlignmentPlan(DynamicTimeWarping& dtw, FeatureView seq1, FeatureView seq2,
+                                   const AlignmentPlan& plan, std::vector<std::pair<int, int>>* path) {
+    if (!plan.singlePrecision) {
+        return runAlignmentPlan<double>(dtw, seq1, seq2, plan, path);
+    }
+    ScratchArena& arena = analysisArena();
+    ArenaScope scope(arena);
+    MutableFeatureViewF single1 = arenaFeatures<float>(arena, seq1.rows(), seq1.cols());
+    MutableFeatureViewF single2 = arenaFeatures<float>(arena, seq2.rows(), seq2.cols());
+    for (int i = 0; i < seq1.rows(); i++) {
+        std::copy(seq1.row(i), seq1.row(i) + seq1.cols(), single1.row(i));
+    }
+    for (int i = 0; i < seq2.rows(); i++) {
+        std::copy(seq2.row(i), seq2.row(i) + seq2.cols(), single2.row(i));
+    }
+    return runAlignmentPlan<float>(dtw, FeatureViewF(single1), FeatureViewF(single2), plan, path);
+}
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+#include "dtw.h"
+#include "feature_matrix.h"
+#include "reference_store.h"
+#include "scoring.h"
+
+// Anytime analysis of one recording against one reference, in three stages
+// that each publish a better result than the last:
+//     Coarse   banded DTW over both sequences averaged kCoarseFactor:1;
+//              a distance estimate in a few milliseconds
+//     Full     full-resolution DTW inside a corridor around the coarse path
+//     Phoneme  the scoring HMM over the query frames the full path aligned
+//              to the reference (leading and trailing silence dropped)
+// Every stage constrains its search with the previous stage's path.
+//
+// Results go to a ProgressiveResult block. The stage word is stored last
+// with release semantics, so a reader on another thread (or JS between
+// advance() calls) that sees stage >= s can read every field of stage s.
+//
+// Layout (little-endian, 40 bytes):
+//     0  int32   stage           last ProgressiveStage published
+//     4  int32   pathLength      full-resolution path length (Full)
+//     8  float64 coarseDistance  normalised DTW distance (Coarse)
+//    16  float64 distance        normalised DTW distance (Full)
+//    24  float64 likelihood      forward log likelihood (Phoneme)
+//    32  int32   alignedStart    query frames scored by the HMM (Phoneme)
+//    36  int32   alignedEnd      (exclusive)
+
+enum class ProgressiveStage : int32_t {
+    None = 0,
+    Coarse = 1,
+    Full = 2,
+    Phoneme = 3
+};
+
+struct ProgressiveResult {
+    std::atomic<int32_t> stage;
+    int32_t pathLength;
+    double coarseDistance;
+    double distance;
+    double likelihood;
+    int32_t alignedStart;
+    int32_t alignedEnd;
+};
+
+static_assert(sizeof(ProgressiveResult) == 40, "progressive result layout");
+
+// Frames averaged per coarse frame, and the full-resolution frames the
+// corridor extends either side of the projected coarse path
+const int kCoarseFactor = 4;
+const int kCorridorRadius = 2 * kCoarseFactor;
+
+class ProgressiveAnalysis {
+public:
+    // Against a caller reference of the query's width (copied)
+    ProgressiveAnalysis(FeatureView queryFeatures, FeatureView referenceFeatures) {
+        setQuery(queryFeatures);
+        ownedReference.resize(referenceFeatures.rows(), referenceFeatures.cols());
+        for (int i = 0; i < referenceFeatures.rows(); i++) {
+            std::copy(referenceFeatures.row(i), referenceFeatures.row(i) + referenceFeatures.cols(),
+                      ownedReference.row(i));
+        }
+        reference = ownedReference.view();
+    }
+
+    // Against the leading query.cols() columns of a stored reference entry.
+    // Float32 stores are read in place and must stay open; other encodings
+    // are decoded into the analysis.
+    ProgressiveAnalysis(FeatureView queryFeatures, const ReferenceStore& store, int entry) {
+        setQuery(queryFeatures);
+        FeatureViewF full;
+        if (store.encoding() == ReferenceEncoding::Float32) {
+            ScratchArena& arena = analysisArena();
+            full = store.features(entry, arena);
+        } else {
+            ownedReference.resize(store.entry(entry).frames, store.featureDim());
+            store.decode(entry, ownedReference.mutableView());
+            full = ownedReference.view();
+        }
+        reference = FeatureViewF(full.data(), full.rows(), std::min(full.cols(), query.cols()),
+                                 full.stride());
+    }
+
+    ProgressiveAnalysis(const ProgressiveAnalysis&) = delete;
+    ProgressiveAnalysis& operator=(const ProgressiveAnalysis&) = delete;
+
+    // Runs the next stage and publishes it. Returns the stage published, or
+    // None when every stage is done, the inputs cannot be aligned, or a
+    // CancelScope stopped the stage (the previous result then stands).
+    ProgressiveStage advance() {
+        if (failed) return ProgressiveStage::None;
+        switch (stage()) {
+        case ProgressiveStage::None: return coarseStage();
+        case ProgressiveStage::Coarse: return fullStage();
+        case ProgressiveStage::Full: return phonemeStage();
+        case ProgressiveStage::Phoneme: return ProgressiveStage::None;
+        }
+        return ProgressiveStage::None;
+    }
+
+    ProgressiveStage stage() const {
+        return static_cast<ProgressiveStage>(output.stage.load(std::memory_order_acquire));
+    }
+
+    ProgressiveResult& result() { return output; }
+
+private:
+    void setQuery(FeatureView queryFeatures) {
+        query.resize(queryFeatures.rows(), queryFeatures.cols());
+        queryF.resize(queryFeatures.rows(), queryFeatures.cols());
+        for (int i = 0; i < queryFeatures.rows(); i++) {
+            std::copy(queryFeatures.row(i), queryFeatures.row(i) + queryFeatures.cols(), query.row(i));
+            std::copy(queryFeatures.row(i), queryFeatures.row(i) + queryFeatures.cols(), queryF.row(i));
+        }
+    }
+
+    static double normalized(DTWOutcome outcome) {
+        return outcome.pathLength > 0 ? outcome.distance / outcome.pathLength : outcome.distance;
+    }
+
+    ProgressiveStage publish(ProgressiveStage stage) {
+        output.stage.store(static_cast<int32_t>(stage), std::memory_order_release);
+        return stage;
+    }
+
+    ProgressiveStage coarseStage() {
+        if (queryF.rows() == 0 || reference.empty() || reference.cols() != queryF.cols()) {
+            failed = true;
+            return ProgressiveStage::None;
+        }
+
+        FeatureMatrixF coarseQuery;
+        FeatureMatrixF coarseReference;
+        downsampleFeatures(queryF.view(), kCoarseFactor, coarseQuery);
+        downsampleFeatures(reference, kCoarseFactor, coarseReference);
+
+        // The band is centred on i == j, so it spans the length difference
+        // (which also keeps the end reachable) plus an eighth of the longer
+        // sequence for tempo changes within the recitation
+        int n = coarseQuery.rows();
+        int m = coarseReference.rows();
+        int band = std::abs(n - m) + (std::max(n, m) + 7) / 8;
+        DTWOutcome outcome = dtw.align(coarseQuery.view(), coarseReference.view(),
+                                       DistanceMetric::Euclidean, band, &path);
+        if (std::isnan(outcome.distance)) return ProgressiveStage::None;
+
+        output.coarseDistance = normalized(outcome);
+        return publish(ProgressiveStage::Coarse);
+    }
+
+    ProgressiveStage fullStage() {
+        DTWCorridor corridor;
+        projectCorridor(path, kCoarseFactor, queryF.rows(), reference.rows(), kCorridorRadius, corridor);
+        std::vector<std::pair<int, int>> fullPath;
+        DTWOutcome outcome = dtw.alignCorridor(queryF.view(), reference, DistanceMetric::Euclidean,
+                                               corridor, &fullPath);
+        if (std::isnan(outcome.distance)) return ProgressiveStage::None;
+
+        path.swap(fullPath);
+        output.distance = normalized(outcome);
+        output.pathLength = outcome.pathLength;
+        return publish(ProgressiveStage::Full);
+    }
+
+    ProgressiveStage phonemeStage() {
+        // From the last query frame matched to the reference's first frame
+        // to the first one matched to its last
+        int lastReference = reference.rows() - 1;
+        int start = 0;
+        int end = query.rows();
+        for (const std::pair<int, int>& cell : path) {
+            if (cell.second == 0) start = cell.first;
+            if (cell.second == lastReference) {
+                end = cell.first + 1;
+                break;
+            }
+        }
+        if (end <= start) {
+            start = 0;
+            end = query.rows();
+        }
+
+        double likelihood = phonemeLikelihood(query.view().slice(start, end));
+        if (std::isnan(likelihood)) return ProgressiveStage::None;
+
+        output.likelihood = likelihood;
+        output.alignedStart = start;
+        output.alignedEnd = end;
+        return publish(ProgressiveStage::Phoneme);
+    }
+
+    DynamicTimeWarping dtw;
+    FeatureMatrix query;
+    FeatureMatrixF queryF;
+    FeatureMatrixF ownedReference;
+    FeatureViewF reference;
+    // The latest stage's path, which constrains the next stage
+    std::vector<std::pair<int, int>> path;
+    bool failed = false;
+    ProgressiveResult output = {};
+};
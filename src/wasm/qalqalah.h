@@ -0,0 +1,215 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include "arena.h"
+#include "dsp_tables.h"
+
+// Qalqalah (release burst) detection.
+//
+// Qalqalah letters (qaf, ta, ba, jeem, dal) with sukoon are released with
+// an audible echo: the stop closure is a short near-silence and the release
+// a sudden broadband burst. The main frames (2048 samples, 1024 hop) smear
+// both over tens of milliseconds, so QalqalahDetector reads the samples
+// itself, in one pass, on sub-frames of kBurstSubFrameSeconds:
+//     envelope  sub-frame level in dB
+//     flux      rise of three band levels (low / mid / high, split by
+//               one-pole filters at kBurstLowSplitHz and kBurstHighSplitHz)
+//               summed over the bands that got louder: a spectral flux
+//               that needs no FFT
+// A sub-frame is a burst candidate when its flux clears an adaptive
+// threshold (running mean plus kBurstFluxDeviations deviations, at least
+// kMinBurstFluxDb) and its level is kClosureDepthDb over the quietest
+// sub-frame of the preceding kClosureSeconds, with at least
+// kMinClosureSeconds of that quiet right before it: a release comes
+// straight out of the closure, a gradual attack does not. The candidate
+// with the highest flux within kBurstPeakSeconds is reported; another
+// burst cannot start within kBurstRefractorySeconds.
+//
+// Layout of QalqalahBurst (little-endian, 16 bytes):
+//     0  int32   sample      first sample of the burst's sub-frame
+//     4  float32 strength    0..1, from the rise over the closure
+//     8  float32 riseDb      level over the closure
+//    12  float32 closureMs   quiet stretch before the burst
+
+struct QalqalahBurst {
+    int32_t sample;
+    float strength;
+    float riseDb;
+    float closureMs;
+};
+
+static_assert(sizeof(QalqalahBurst) == 16, "qalqalah burst layout");
+
+const double kBurstSubFrameSeconds = 0.004;
+const double kBurstLowSplitHz = 500.0;
+const double kBurstHighSplitHz = 2500.0;
+const double kClosureSeconds = 0.06;
+const double kClosureDepthDb = 15.0;
+const double kMinClosureSeconds = 0.01;
+const double kMinBurstFluxDb = 9.0;
+const double kBurstFluxDeviations = 3.0;
+const double kBurstPeakSeconds = 0.012;
+const double kBurstRefractorySeconds = 0.08;
+// Flux statistics follow about this much audio
+const double kBurstStatsSeconds = 0.5;
+// Rise over the closure at which strength reaches 1 - 1/e
+const double kBurstStrengthDb = 15.0;
+const int kMaxClosureSubFrames = 64;
+
+class QalqalahDetector {
+public:
+    // False for unusable sample rates
+    bool configure(double sampleRate) {
+        if (sampleRate <= 0) return false;
+        rate = sampleRate;
+        subFrame = std::max(8, static_cast<int>(std::lround(kBurstSubFrameSeconds * sampleRate)));
+        double subFrameSeconds = static_cast<double>(subFrame) / sampleRate;
+        closureSubFrames = std::min(kMaxClosureSubFrames,
+                                    std::max(2, static_cast<int>(std::lround(kClosureSeconds / subFrameSeconds))));
+        minClosureSubFrames = std::max(1, static_cast<int>(std::lround(kMinClosureSeconds / subFrameSeconds)));
+        peakSubFrames = std::max(1, static_cast<int>(std::lround(kBurstPeakSeconds / subFrameSeconds)));
+        refractorySubFrames = static_cast<int>(std::lround(kBurstRefractorySeconds / subFrameSeconds));
+        statsRate = std::min(1.0, subFrameSeconds / kBurstStatsSeconds);
+        lowCoeff = 1.0 - std::exp(-2.0 * dsp::kPi * kBurstLowSplitHz / sampleRate);
+        highCoeff = 1.0 - std::exp(-2.0 * dsp::kPi * kBurstHighSplitHz / sampleRate);
+        found.clear();
+        found.reserve(64);
+        reset();
+        return true;
+    }
+
+    // Starts a new stream with the same configuration
+    void reset() {
+        lowState = 0.0;
+        highState = 0.0;
+        std::fill(bandEnergy, bandEnergy + 3, 0.0);
+        std::fill(previousBandDb, previousBandDb + 3, 0.0);
+        filled = 0;
+        subFrames = 0;
+        fluxMean = 0.0;
+        fluxDeviation = 0.0;
+        lastBurst = -refractorySubFrames - 1;
+        candidate = -1;
+        found.clear();
+    }
+
+    bool configured() const { return rate > 0.0; }
+
+    template <typename T>
+    void push(const T* samples, int count) {
+        for (int i = 0; i < count; i++) {
+            double x = samples[i];
+            lowState += lowCoeff * (x - lowState);
+            highState += highCoeff * (x - highState);
+            double low = lowState;
+            double mid = highState - lowState;
+            double high = x - highState;
+            bandEnergy[0] += low * low;
+            bandEnergy[1] += mid * mid;
+            bandEnergy[2] += high * high;
+            if (++filled == subFrame) {
+                closeSubFrame();
+            }
+        }
+    }
+
+    // Ends the stream, reporting a burst still inside its peak window
+    void finish() {
+        if (candidate >= 0) emitCandidate();
+    }
+
+    int burstCount() const { return static_cast<int>(found.size()); }
+    const QalqalahBurst* bursts() const { return found.data(); }
+    int subFrameSamples() const { return subFrame; }
+
+private:
+    void closeSubFrame() {
+        double bandDb[3];
+        double total = 0.0;
+        double flux = 0.0;
+        for (int b = 0; b < 3; b++) {
+            total += bandEnergy[b];
+            bandDb[b] = 10.0 * std::log10(std::max(bandEnergy[b] / subFrame, 1e-12));
+            if (subFrames > 0) flux += std::max(0.0, bandDb[b] - previousBandDb[b]);
+            previousBandDb[b] = bandDb[b];
+            bandEnergy[b] = 0.0;
+        }
+        double level = 10.0 * std::log10(std::max(total / subFrame, 1e-12));
+        filled = 0;
+
+        // Quietest level of the closure window before this sub-frame
+        int history = static_cast<int>(std::min<int64_t>(subFrames, closureSubFrames));
+        double closure = level;
+        for (int k = 1; k <= history; k++) {
+            closure = std::min(closure, levels[(subFrames - k) % kMaxClosureSubFrames]);
+        }
+
+        double threshold = std::max(kMinBurstFluxDb, fluxMean + kBurstFluxDeviations * fluxDeviation);
+        bool onset = history == closureSubFrames && flux >= threshold && level - closure >= kClosureDepthDb &&
+                     subFrames - lastBurst > refractorySubFrames;
+        int quiet = onset ? quietRun(level - kClosureDepthDb, history) : 0;
+        if (quiet >= minClosureSubFrames && (candidate < 0 || flux > candidateFlux)) {
+            if (candidate < 0) candidateOpened = subFrames;
+            candidate = subFrames;
+            candidateFlux = flux;
+            candidateRise = level - closure;
+            candidateClosure = quiet;
+        }
+        if (candidate >= 0 && subFrames - candidateOpened + 1 >= peakSubFrames) {
+            emitCandidate();
+        }
+
+        fluxMean += statsRate * (flux - fluxMean);
+        fluxDeviation += statsRate * (std::abs(flux - fluxMean) - fluxDeviation);
+        levels[subFrames % kMaxClosureSubFrames] = level;
+        subFrames++;
+    }
+
+    // Sub-frames just before this one that stay below `ceiling`
+    int quietRun(double ceiling, int history) const {
+        int run = 0;
+        while (run < history && levels[(subFrames - run - 1) % kMaxClosureSubFrames] < ceiling) {
+            run++;
+        }
+        return run;
+    }
+
+    void emitCandidate() {
+        double strength = 1.0 - std::exp(-(candidateRise - kClosureDepthDb) / kBurstStrengthDb);
+        found.push_back({static_cast<int32_t>(candidate * subFrame), static_cast<float>(std::max(0.0, strength)),
+                         static_cast<float>(candidateRise),
+                         static_cast<float>(candidateClosure * 1000.0 * subFrame / rate)});
+        lastBurst = candidate;
+        candidate = -1;
+    }
+
+    double rate = 0.0;
+    int subFrame = 0;
+    int closureSubFrames = 0;
+    int minClosureSubFrames = 1;
+    int peakSubFrames = 1;
+    int refractorySubFrames = 0;
+    double statsRate = 0.0;
+    double lowCoeff = 0.0;
+    double highCoeff = 0.0;
+
+    double lowState = 0.0;
+    double highState = 0.0;
+    double bandEnergy[3] = {};
+    double previousBandDb[3] = {};
+    double levels[kMaxClosureSubFrames] = {};
+    int filled = 0;
+    int64_t subFrames = 0;
+    double fluxMean = 0.0;
+    double fluxDeviation = 0.0;
+    int64_t lastBurst = 0;
+
+    int64_t candidate = -1;
+    int64_t candidateOpened = 0;
+    double candidateFlux = 0.0;
+    double candidateRise = 0.0;
+    int candidateClosure = 0;
+    PoolVector<QalqalahBurst> found;
+};
@@ -0,0 +1,682 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <vector>
+#include "arena.h"
+#include "feature_matrix.h"
+
+#ifndef __EMSCRIPTEN__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Reference feature store.
+//
+// One binary file holds the reference features for every verse and reciter.
+// It is opened in place: from a region of the WASM heap the file was copied
+// into, or from an mmap natively. Nothing is parsed into separate
+// structures, so lookups are O(1) and float32 stores are handed out as
+// FeatureViews over the file bytes.
+//
+// Layout (little-endian, every section and block 16-byte aligned):
+//   ReferenceStoreHeader
+//   surah table    uint32[surahCount + 1]  first global verse of each surah
+//   slot table     uint32[verseCount * reciterCount]  entry index or kNoEntry
+//   entry table    ReferenceEntry[entryCount]
+//   blocks         per entry: features (frames x stride, in the store's
+//                  encoding), int8 scale/bias (2 x featureDim float32),
+//                  word boundaries (words + 1 uint32 frame indices),
+//                  LB_Keogh envelopes (upper then lower, frames x
+//                  paddedStride<float> float32)
+
+enum class ReferenceEncoding : uint32_t {
+    Float32 = 0,
+    Float16 = 1,
+    Int8 = 2  // per-column affine: value = q * scale[c] + bias[c]
+};
+
+constexpr char kReferenceStoreMagic[8] = {'Q', 'R', 'E', 'F', 'S', 'T', 'O', 'R'};
+// Version 2 records the front end in what was a reserved word; version 1
+// stores (word 0) open as built without one
+constexpr uint32_t kReferenceStoreVersion = 2;
+constexpr uint32_t kNoEntry = 0xFFFFFFFFu;
+
+struct ReferenceStoreHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerBytes;
+    uint32_t encoding;        // ReferenceEncoding
+    uint32_t featureDim;
+    uint32_t stride;          // elements per stored feature row
+    uint32_t sampleRate;      // feature pipeline the store was built with
+    uint32_t frameSize;
+    uint32_t hopSize;
+    uint32_t surahCount;
+    uint32_t verseCount;
+    uint32_t reciterCount;
+    uint32_t entryCount;
+    uint32_t envelopeRadius;  // Sakoe-Chiba radius of the envelopes, 0 = none
+    uint32_t frontEnd;        // feature option bits applied when building (audio_processor.h)
+    uint64_t surahTableOffset;
+    uint64_t slotTableOffset;
+    uint64_t entryTableOffset;
+    uint64_t totalBytes;
+};
+
+struct ReferenceEntry {
+    uint32_t verse;           // global verse index
+    uint32_t reciter;
+    uint32_t frames;
+    uint32_t words;           // 0 when no boundaries are stored
+    uint64_t featureOffset;
+    uint64_t quantOffset;     // Int8 only
+    uint64_t wordOffset;      // 0 when absent
+    uint64_t envelopeOffset;  // 0 when absent
+};
+
+static_assert(sizeof(ReferenceStoreHeader) == 96, "store header layout");
+static_assert(sizeof(ReferenceEntry) == 48, "store entry layout");
+
+// IEEE 754 binary16 conversion (round to nearest even)
+inline uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    uint32_t exponent = (bits >> 23) & 0xFFu;
+    uint32_t mantissa = bits & 0x7FFFFFu;
+
+    if (exponent == 0xFF) {
+        return static_cast<uint16_t>(sign | 0x7C00u | (mantissa ? 0x200u : 0));
+    }
+    int e = static_cast<int>(exponent) - 127 + 15;
+    if (e >= 31) {
+        return static_cast<uint16_t>(sign | 0x7C00u);
+    }
+    if (e <= 0) {
+        if (e < -10) return static_cast<uint16_t>(sign);
+        mantissa |= 0x800000u;
+        int shift = 14 - e;
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t midpoint = 1u << (shift - 1);
+        if (rest > midpoint || (rest == midpoint && (half & 1))) half++;
+        return static_cast<uint16_t>(sign | half);
+    }
+    uint32_t half = sign | (static_cast<uint32_t>(e) << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1FFFu;
+    if (rest > 0x1000u || (rest == 0x1000u && (half & 1))) half++;
+    return static_cast<uint16_t>(half);
+}
+
+inline float halfToFloat(uint16_t half) {
+    uint32_t sign = static_cast<uint32_t>(half & 0x8000u) << 16;
+    uint32_t exponent = (half >> 10) & 0x1Fu;
+    uint32_t mantissa = half & 0x3FFu;
+    uint32_t bits;
+
+    if (exponent == 0) {
+        if (mantissa == 0) {
+            bits = sign;
+        } else {
+            int e = -1;
+            do { e++; mantissa <<= 1; } while (!(mantissa & 0x400u));
+            bits = sign | (static_cast<uint32_t>(127 - 15 - e) << 23) | ((mantissa & 0x3FFu) << 13);
+        }
+    } else if (exponent == 0x1F) {
+        bits = sign | 0x7F800000u | (mantissa << 13);
+    } else {
+        bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+    }
+
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// LB_Keogh envelope: upper/lower running max/min over +-radius frames
+template <typename T>
+inline void buildEnvelope(BasicFeatureView<T> features, int radius,
+                          MutableFeatureViewF upper, MutableFeatureViewF lower) {
+    int n = features.rows();
+    for (int i = 0; i < n; i++) {
+        int begin = std::max(0, i - radius);
+        int end = std::min(n - 1, i + radius);
+        for (int c = 0; c < features.cols(); c++) {
+            float hi = static_cast<float>(features(begin, c));
+            float lo = hi;
+            for (int j = begin + 1; j <= end; j++) {
+                float v = static_cast<float>(features(j, c));
+                hi = std::max(hi, v);
+                lo = std::min(lo, v);
+            }
+            upper(i, c) = hi;
+            lower(i, c) = lo;
+        }
+    }
+}
+
+// LB_Keogh lower bound of the (unnormalised, Euclidean) DTW distance under
+// the band the envelope was built with; cheap enough to prune reciters or
+// verses before a full alignment. Query frame i is compared with the
+// envelope at the proportional reference frame, so lengths may differ.
+template <typename T>
+inline double lbKeogh(BasicFeatureView<T> query, FeatureViewF upper, FeatureViewF lower) {
+    if (query.empty() || upper.empty() || query.cols() > upper.cols()) {
+        return 0.0;
+    }
+    int n = query.rows();
+    int m = upper.rows();
+    double bound = 0.0;
+    for (int i = 0; i < n; i++) {
+        int r = static_cast<int>(static_cast<int64_t>(i) * m / n);
+        const float* hi = upper.row(r);
+        const float* lo = lower.row(r);
+        const T* q = query.row(i);
+        double frame = 0.0;
+        for (int c = 0; c < query.cols(); c++) {
+            double v = q[c];
+            double d = v > hi[c] ? v - hi[c] : (v < lo[c] ? lo[c] - v : 0.0);
+            frame += d * d;
+        }
+        bound += std::sqrt(frame);
+    }
+    return bound;
+}
+
+inline size_t encodedStride(ReferenceEncoding encoding, int featureDim) {
+    switch (encoding) {
+        case ReferenceEncoding::Float16: return paddedStride<uint16_t>(featureDim);
+        case ReferenceEncoding::Int8: return paddedStride<int8_t>(featureDim);
+        default: return paddedStride<float>(featureDim);
+    }
+}
+
+inline size_t encodedElementBytes(ReferenceEncoding encoding) {
+    switch (encoding) {
+        case ReferenceEncoding::Float16: return sizeof(uint16_t);
+        case ReferenceEncoding::Int8: return sizeof(int8_t);
+        default: return sizeof(float);
+    }
+}
+
+class ReferenceStore {
+public:
+    // Validates the header, tables and every entry's blocks against `size`.
+    // `data` must be 16-byte aligned and outlive the store.
+    bool open(const void* data, size_t size) {
+        close();
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        if (!bytes || size < sizeof(ReferenceStoreHeader) ||
+            reinterpret_cast<uintptr_t>(bytes) % kFeatureAlignment != 0) {
+            return false;
+        }
+
+        const ReferenceStoreHeader* h = reinterpret_cast<const ReferenceStoreHeader*>(bytes);
+        if (std::memcmp(h->magic, kReferenceStoreMagic, sizeof(h->magic)) != 0 ||
+            h->version < 1 || h->version > kReferenceStoreVersion ||
+            h->headerBytes != sizeof(ReferenceStoreHeader) ||
+            h->encoding > static_cast<uint32_t>(ReferenceEncoding::Int8) ||
+            h->featureDim == 0 || h->totalBytes > size ||
+            h->stride != encodedStride(static_cast<ReferenceEncoding>(h->encoding), h->featureDim)) {
+            return false;
+        }
+
+        uint64_t slots = static_cast<uint64_t>(h->verseCount) * h->reciterCount;
+        if (!within(h->surahTableOffset, (h->surahCount + 1ull) * sizeof(uint32_t), h->totalBytes) ||
+            !within(h->slotTableOffset, slots * sizeof(uint32_t), h->totalBytes) ||
+            !within(h->entryTableOffset, static_cast<uint64_t>(h->entryCount) * sizeof(ReferenceEntry),
+                    h->totalBytes) ||
+            h->surahTableOffset % 4 || h->slotTableOffset % 4 || h->entryTableOffset % 8) {
+            return false;
+        }
+
+        const uint32_t* surahs = reinterpret_cast<const uint32_t*>(bytes + h->surahTableOffset);
+        const uint32_t* slotTable = reinterpret_cast<const uint32_t*>(bytes + h->slotTableOffset);
+        const ReferenceEntry* entryTable =
+            reinterpret_cast<const ReferenceEntry*>(bytes + h->entryTableOffset);
+
+        for (uint32_t s = 0; s < h->surahCount; s++) {
+            if (surahs[s] > surahs[s + 1]) return false;
+        }
+        if (surahs[h->surahCount] != h->verseCount) return false;
+        for (uint64_t s = 0; s < slots; s++) {
+            if (slotTable[s] != kNoEntry && slotTable[s] >= h->entryCount) return false;
+        }
+
+        ReferenceEncoding encoding = static_cast<ReferenceEncoding>(h->encoding);
+        uint64_t rowBytes = h->stride * encodedElementBytes(encoding);
+        uint64_t envelopeRow = paddedStride<float>(h->featureDim) * sizeof(float);
+        for (uint32_t e = 0; e < h->entryCount; e++) {
+            const ReferenceEntry& entry = entryTable[e];
+            if (entry.verse >= h->verseCount || entry.reciter >= h->reciterCount ||
+                !alignedWithin(entry.featureOffset, entry.frames * rowBytes, h->totalBytes)) {
+                return false;
+            }
+            if (encoding == ReferenceEncoding::Int8 &&
+                !alignedWithin(entry.quantOffset, 2ull * h->featureDim * sizeof(float), h->totalBytes)) {
+                return false;
+            }
+            if (entry.wordOffset &&
+                !alignedWithin(entry.wordOffset, (entry.words + 1ull) * sizeof(uint32_t), h->totalBytes)) {
+                return false;
+            }
+            if (entry.envelopeOffset &&
+                !alignedWithin(entry.envelopeOffset, 2ull * entry.frames * envelopeRow, h->totalBytes)) {
+                return false;
+            }
+        }
+
+        base = bytes;
+        storeHeader = h;
+        surahTable = surahs;
+        verseSlots = slotTable;
+        entries = entryTable;
+        return true;
+    }
+
+    void close() {
+        base = nullptr;
+        storeHeader = nullptr;
+        surahTable = nullptr;
+        verseSlots = nullptr;
+        entries = nullptr;
+    }
+
+    bool isOpen() const { return storeHeader != nullptr; }
+    const ReferenceStoreHeader& header() const { return *storeHeader; }
+    int entryCount() const { return isOpen() ? static_cast<int>(storeHeader->entryCount) : 0; }
+    int featureDim() const { return isOpen() ? static_cast<int>(storeHeader->featureDim) : 0; }
+    ReferenceEncoding encoding() const { return static_cast<ReferenceEncoding>(storeHeader->encoding); }
+    // Front-end options (kFeatureDenoise, kFeatureLoudness) queries must be
+    // extracted with to match the stored features
+    uint32_t frontEnd() const { return isOpen() ? storeHeader->frontEnd : 0; }
+
+    // Global verse index for a 1-based (surah, ayah), or -1
+    int verseIndex(int surah, int ayah) const {
+        if (!isOpen() || surah < 1 || surah > static_cast<int>(storeHeader->surahCount) || ayah < 1) {
+            return -1;
+        }
+        uint32_t first = surahTable[surah - 1];
+        uint32_t verse = first + static_cast<uint32_t>(ayah - 1);
+        return verse < surahTable[surah] ? static_cast<int>(verse) : -1;
+    }
+
+    // Entry index, or -1 when this reciter has no recording of the verse
+    int find(int surah, int ayah, int reciter) const {
+        int verse = verseIndex(surah, ayah);
+        if (verse < 0 || reciter < 0 || reciter >= static_cast<int>(storeHeader->reciterCount)) {
+            return -1;
+        }
+        uint32_t slot = verseSlots[static_cast<size_t>(verse) * storeHeader->reciterCount + reciter];
+        return slot == kNoEntry ? -1 : static_cast<int>(slot);
+    }
+
+    const ReferenceEntry& entry(int index) const { return entries[index]; }
+
+    // Float32 stores: a view over the file bytes. Other encodings are
+    // decoded into `arena` (valid until it rewinds).
+    FeatureViewF features(int index, ScratchArena& arena) const {
+        const ReferenceEntry& e = entries[index];
+        if (encoding() == ReferenceEncoding::Float32) {
+            return FeatureViewF(reinterpret_cast<const float*>(base + e.featureOffset),
+                                e.frames, storeHeader->featureDim, storeHeader->stride);
+        }
+        MutableFeatureViewF out = arenaFeatures<float>(arena, e.frames, storeHeader->featureDim);
+        decode(index, out);
+        return out;
+    }
+
+    void decode(int index, MutableFeatureViewF out) const {
+        const ReferenceEntry& e = entries[index];
+        int rows = std::min(static_cast<int>(e.frames), out.rows());
+        int cols = std::min(static_cast<int>(storeHeader->featureDim), out.cols());
+        size_t stride = storeHeader->stride;
+
+        switch (encoding()) {
+            case ReferenceEncoding::Float32: {
+                const float* src = reinterpret_cast<const float*>(base + e.featureOffset);
+                for (int i = 0; i < rows; i++) {
+                    std::copy(src + i * stride, src + i * stride + cols, out.row(i));
+                }
+                break;
+            }
+            case ReferenceEncoding::Float16: {
+                const uint16_t* src = reinterpret_cast<const uint16_t*>(base + e.featureOffset);
+                for (int i = 0; i < rows; i++) {
+                    for (int c = 0; c < cols; c++) {
+                        out(i, c) = halfToFloat(src[i * stride + c]);
+                    }
+                }
+                break;
+            }
+            case ReferenceEncoding::Int8: {
+                const int8_t* src = reinterpret_cast<const int8_t*>(base + e.featureOffset);
+                const float* scale = reinterpret_cast<const float*>(base + e.quantOffset);
+                const float* bias = scale + storeHeader->featureDim;
+                for (int i = 0; i < rows; i++) {
+                    for (int c = 0; c < cols; c++) {
+                        out(i, c) = src[i * stride + c] * scale[c] + bias[c];
+                    }
+                }
+                break;
+            }
+        }
+    }
+
+    // words + 1 frame indices (start of each word, then the end), or nullptr
+    const uint32_t* wordBoundaries(int index) const {
+        const ReferenceEntry& e = entries[index];
+        return e.wordOffset ? reinterpret_cast<const uint32_t*>(base + e.wordOffset) : nullptr;
+    }
+
+    bool hasEnvelope(int index) const { return entries[index].envelopeOffset != 0; }
+
+    FeatureViewF upperEnvelope(int index) const { return envelope(index, 0); }
+    FeatureViewF lowerEnvelope(int index) const { return envelope(index, 1); }
+
+private:
+    static bool within(uint64_t offset, uint64_t bytes, uint64_t total) {
+        return offset <= total && bytes <= total - offset;
+    }
+
+    static bool alignedWithin(uint64_t offset, uint64_t bytes, uint64_t total) {
+        return offset % kFeatureAlignment == 0 && within(offset, bytes, total);
+    }
+
+    FeatureViewF envelope(int index, int which) const {
+        const ReferenceEntry& e = entries[index];
+        if (!e.envelopeOffset) {
+            return FeatureViewF();
+        }
+        size_t stride = paddedStride<float>(storeHeader->featureDim);
+        const float* data = reinterpret_cast<const float*>(base + e.envelopeOffset) +
+                            static_cast<size_t>(which) * e.frames * stride;
+        return FeatureViewF(data, e.frames, storeHeader->featureDim, stride);
+    }
+
+    const uint8_t* base = nullptr;
+    const ReferenceStoreHeader* storeHeader = nullptr;
+    const uint32_t* surahTable = nullptr;
+    const uint32_t* verseSlots = nullptr;
+    const ReferenceEntry* entries = nullptr;
+};
+
+// Builds a store image. Entries are encoded as they are added; serialize()
+// lays out the tables and blocks.
+class ReferenceStoreWriter {
+public:
+    struct Config {
+        ReferenceEncoding encoding;
+        int featureDim;
+        int sampleRate;
+        int frameSize;
+        int hopSize;
+        int reciterCount;
+        int envelopeRadius;  // 0 = no envelopes
+        uint32_t frontEnd;   // feature option bits the features were extracted with
+    };
+
+    ReferenceStoreWriter(const Config& config, const std::vector<uint32_t>& surahVerseCounts)
+        : config(config), surahStarts(surahVerseCounts.size() + 1, 0) {
+        for (size_t s = 0; s < surahVerseCounts.size(); s++) {
+            surahStarts[s + 1] = surahStarts[s] + surahVerseCounts[s];
+        }
+        slots.assign(static_cast<size_t>(surahStarts.back()) * config.reciterCount, kNoEntry);
+    }
+
+    // Replaces any earlier entry for the same verse and reciter. Returns false
+    // for an unknown verse/reciter or a feature width mismatch.
+    template <typename T>
+    bool add(int surah, int ayah, int reciter, BasicFeatureView<T> features,
+             const std::vector<uint32_t>& wordBoundaries = {}) {
+        if (surah < 1 || surah >= static_cast<int>(surahStarts.size()) || ayah < 1 ||
+            reciter < 0 || reciter >= config.reciterCount || features.cols() != config.featureDim) {
+            return false;
+        }
+        uint32_t verse = surahStarts[surah - 1] + static_cast<uint32_t>(ayah - 1);
+        if (verse >= surahStarts[surah]) {
+            return false;
+        }
+
+        Pending pending;
+        pending.verse = verse;
+        pending.reciter = reciter;
+        pending.frames = features.rows();
+        pending.words = wordBoundaries;
+        encode(features, pending);
+
+        if (config.envelopeRadius > 0) {
+            FeatureMatrixF upper(features.rows(), config.featureDim);
+            FeatureMatrixF lower(features.rows(), config.featureDim);
+            buildEnvelope(features, config.envelopeRadius, upper.mutableView(), lower.mutableView());
+            const uint8_t* u = reinterpret_cast<const uint8_t*>(upper.data());
+            const uint8_t* l = reinterpret_cast<const uint8_t*>(lower.data());
+            pending.envelope.assign(u, u + upper.byteSize());
+            pending.envelope.insert(pending.envelope.end(), l, l + lower.byteSize());
+        }
+
+        size_t slot = static_cast<size_t>(verse) * config.reciterCount + reciter;
+        if (slots[slot] != kNoEntry) {
+            staged[slots[slot]] = std::move(pending);
+        } else {
+            slots[slot] = static_cast<uint32_t>(staged.size());
+            staged.push_back(std::move(pending));
+        }
+        return true;
+    }
+
+    size_t entryCount() const { return staged.size(); }
+
+    std::vector<uint8_t> serialize() const {
+        uint32_t surahCount = static_cast<uint32_t>(surahStarts.size() - 1);
+        size_t offset = alignUp(sizeof(ReferenceStoreHeader), kFeatureAlignment);
+        size_t surahOffset = offset;
+        offset = alignUp(offset + surahStarts.size() * sizeof(uint32_t), kFeatureAlignment);
+        size_t slotOffset = offset;
+        offset = alignUp(offset + slots.size() * sizeof(uint32_t), kFeatureAlignment);
+        size_t entryOffset = offset;
+        offset = alignUp(offset + staged.size() * sizeof(ReferenceEntry), kFeatureAlignment);
+
+        std::vector<ReferenceEntry> table(staged.size());
+        for (size_t e = 0; e < staged.size(); e++) {
+            const Pending& p = staged[e];
+            ReferenceEntry& entry = table[e];
+            entry.verse = p.verse;
+            entry.reciter = p.reciter;
+            entry.frames = p.frames;
+            entry.words = p.words.empty() ? 0 : static_cast<uint32_t>(p.words.size() - 1);
+            entry.featureOffset = place(offset, p.features.size());
+            entry.quantOffset = p.quant.empty() ? 0 : place(offset, p.quant.size() * sizeof(float));
+            entry.wordOffset = p.words.empty() ? 0 : place(offset, p.words.size() * sizeof(uint32_t));
+            entry.envelopeOffset = p.envelope.empty() ? 0 : place(offset, p.envelope.size());
+        }
+
+        std::vector<uint8_t> image(offset, 0);
+        ReferenceStoreHeader header = {};
+        std::memcpy(header.magic, kReferenceStoreMagic, sizeof(header.magic));
+        header.version = kReferenceStoreVersion;
+        header.headerBytes = sizeof(ReferenceStoreHeader);
+        header.encoding = static_cast<uint32_t>(config.encoding);
+        header.featureDim = config.featureDim;
+        header.stride = static_cast<uint32_t>(encodedStride(config.encoding, config.featureDim));
+        header.sampleRate = config.sampleRate;
+        header.frameSize = config.frameSize;
+        header.hopSize = config.hopSize;
+        header.surahCount = surahCount;
+        header.verseCount = surahStarts.back();
+        header.reciterCount = config.reciterCount;
+        header.entryCount = static_cast<uint32_t>(staged.size());
+        header.envelopeRadius = config.envelopeRadius;
+        header.frontEnd = config.frontEnd;
+        header.surahTableOffset = surahOffset;
+        header.slotTableOffset = slotOffset;
+        header.entryTableOffset = entryOffset;
+        header.totalBytes = offset;
+
+        std::memcpy(image.data(), &header, sizeof(header));
+        std::memcpy(image.data() + surahOffset, surahStarts.data(), surahStarts.size() * sizeof(uint32_t));
+        std::memcpy(image.data() + slotOffset, slots.data(), slots.size() * sizeof(uint32_t));
+        if (!table.empty()) {
+            std::memcpy(image.data() + entryOffset, table.data(), table.size() * sizeof(ReferenceEntry));
+        }
+        for (size_t e = 0; e < staged.size(); e++) {
+            const Pending& p = staged[e];
+            const ReferenceEntry& entry = table[e];
+            std::memcpy(image.data() + entry.featureOffset, p.features.data(), p.features.size());
+            if (entry.quantOffset) {
+                std::memcpy(image.data() + entry.quantOffset, p.quant.data(), p.quant.size() * sizeof(float));
+            }
+            if (entry.wordOffset) {
+                std::memcpy(image.data() + entry.wordOffset, p.words.data(), p.words.size() * sizeof(uint32_t));
+            }
+            if (entry.envelopeOffset) {
+                std::memcpy(image.data() + entry.envelopeOffset, p.envelope.data(), p.envelope.size());
+            }
+        }
+        return image;
+    }
+
+#ifndef __EMSCRIPTEN__
+    bool writeFile(const char* path) const {
+        std::vector<uint8_t> image = serialize();
+        FILE* file = std::fopen(path, "wb");
+        if (!file) {
+            return false;
+        }
+        bool ok = std::fwrite(image.data(), 1, image.size(), file) == image.size();
+        return std::fclose(file) == 0 && ok;
+    }
+#endif
+
+private:
+    struct Pending {
+        uint32_t verse = 0;
+        uint32_t reciter = 0;
+        uint32_t frames = 0;
+        std::vector<uint8_t> features;
+        std::vector<float> quant;
+        std::vector<uint32_t> words;
+        std::vector<uint8_t> envelope;
+    };
+
+    static size_t place(size_t& offset, size_t bytes) {
+        size_t at = offset;
+        offset = alignUp(offset + bytes, kFeatureAlignment);
+        return at;
+    }
+
+    template <typename T>
+    void encode(BasicFeatureView<T> features, Pending& pending) const {
+        int rows = features.rows();
+        int dim = config.featureDim;
+        size_t stride = encodedStride(config.encoding, dim);
+        pending.features.assign(rows * stride * encodedElementBytes(config.encoding), 0);
+
+        switch (config.encoding) {
+            case ReferenceEncoding::Float32: {
+                float* out = reinterpret_cast<float*>(pending.features.data());
+                for (int i = 0; i < rows; i++) {
+                    for (int c = 0; c < dim; c++) {
+                        out[i * stride + c] = static_cast<float>(features(i, c));
+                    }
+                }
+                break;
+            }
+            case ReferenceEncoding::Float16: {
+                uint16_t* out = reinterpret_cast<uint16_t*>(pending.features.data());
+                for (int i = 0; i < rows; i++) {
+                    for (int c = 0; c < dim; c++) {
+                        out[i * stride + c] = floatToHalf(static_cast<float>(features(i, c)));
+                    }
+                }
+                break;
+            }
+            case ReferenceEncoding::Int8: {
+                // Symmetric around the column midpoint, full [-127, 127] range
+                pending.quant.assign(2 * dim, 0.0f);
+                float* scale = pending.quant.data();
+                float* bias = scale + dim;
+                for (int c = 0; c < dim; c++) {
+                    double lo = std::numeric_limits<double>::infinity();
+                    double hi = -lo;
+                    for (int i = 0; i < rows; i++) {
+                        lo = std::min(lo, static_cast<double>(features(i, c)));
+                        hi = std::max(hi, static_cast<double>(features(i, c)));
+                    }
+                    if (rows == 0) lo = hi = 0.0;
+                    bias[c] = static_cast<float>((hi + lo) / 2.0);
+                    scale[c] = hi > lo ? static_cast<float>((hi - lo) / 254.0) : 1.0f;
+                }
+                int8_t* out = reinterpret_cast<int8_t*>(pending.features.data());
+                for (int i = 0; i < rows; i++) {
+                    for (int c = 0; c < dim; c++) {
+                        double q = std::round((features(i, c) - bias[c]) / scale[c]);
+                        out[i * stride + c] = static_cast<int8_t>(std::max(-127.0, std::min(127.0, q)));
+                    }
+                }
+                break;
+            }
+        }
+    }
+
+    Config config;
+    std::vector<uint32_t> surahStarts;
+    std::vector<uint32_t> slots;
+    std::vector<Pending> staged;
+};
+
+#ifndef __EMSCRIPTEN__
+// Read-only mapping of a store file for native tools
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const char* path) {
+        close();
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+            ::close(fd);
+            return false;
+        }
+        void* mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) {
+            return false;
+        }
+        mapping = mapped;
+        length = static_cast<size_t>(info.st_size);
+        return true;
+    }
+
+    void close() {
+        if (mapping) {
+            munmap(mapping, length);
+            mapping = nullptr;
+            length = 0;
+        }
+    }
+
+    const void* data() const { return mapping; }
+    size_t size() const { return length; }
+
+private:
+    void* mapping = nullptr;
+    size_t length = 0;
+};
+#endif
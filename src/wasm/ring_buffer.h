@@ -0,0 +1,164 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+// Lock-free single-producer/single-consumer ring of float32 samples laid out
+// in caller-provided memory, so the same bytes can be shared between the
+// AudioWorklet (producer) and the analysis worker (consumer) through a
+// SharedArrayBuffer or a shared WebAssembly.Memory.
+//
+// Layout (little-endian, all offsets in bytes from the start of the region):
+//     0  uint32 writeIndex   producer-owned, free-running sample count
+//     4  uint32 overruns     samples the producer dropped because it was full
+//    64  uint32 readIndex    consumer-owned, free-running sample count
+//    68  uint32 capacity     samples, a power of two, fixed at init
+//   128  float32 samples[capacity]
+// The two indices sit on separate 64-byte lines so each side only writes its
+// own. readable = writeIndex - readIndex (mod 2^32). The producer publishes
+// samples with a release store of writeIndex after copying them; the
+// consumer frees space with a release store of readIndex after reading.
+// JS sides use Atomics.load/store on a Uint32Array over the header
+// (writeIndex = [0], overruns = [1], readIndex = [16], capacity = [17]).
+//
+// The producer never blocks: when the ring is full the excess is counted in
+// `overruns` and dropped, since an audio callback cannot wait.
+
+constexpr size_t kRingHeaderBytes = 128;
+constexpr uint32_t kRingMaxCapacity = 1u << 28;
+
+struct RingControl {
+    std::atomic<uint32_t> writeIndex;
+    std::atomic<uint32_t> overruns;
+    uint32_t producerPadding[14];
+    std::atomic<uint32_t> readIndex;
+    uint32_t capacity;
+    uint32_t consumerPadding[14];
+};
+
+static_assert(sizeof(RingControl) == kRingHeaderBytes, "ring header layout");
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "ring indices must be plain 32-bit words");
+
+class SampleRing {
+public:
+    SampleRing() = default;
+
+    // Bytes needed for a ring of `capacity` samples (rounded up to a power of two)
+    static size_t bytesFor(int capacity) {
+        return kRingHeaderBytes + static_cast<size_t>(roundCapacity(capacity)) * sizeof(float);
+    }
+
+    // Formats `memory` (16-byte aligned, bytesFor(capacity) long) as an empty ring
+    static SampleRing create(void* memory, int capacity) {
+        uint32_t rounded = roundCapacity(capacity);
+        if (!memory || rounded == 0 || reinterpret_cast<uintptr_t>(memory) % 16 != 0) {
+            return SampleRing();
+        }
+        std::memset(memory, 0, kRingHeaderBytes);
+        RingControl* control = new (memory) RingControl();
+        control->writeIndex.store(0, std::memory_order_relaxed);
+        control->overruns.store(0, std::memory_order_relaxed);
+        control->readIndex.store(0, std::memory_order_relaxed);
+        control->capacity = rounded;
+        return attach(memory);
+    }
+
+    // Wraps a ring formatted by create() (possibly from another thread or JS)
+    static SampleRing attach(void* memory) {
+        SampleRing ring;
+        RingControl* control = static_cast<RingControl*>(memory);
+        if (!control || control->capacity == 0 || (control->capacity & (control->capacity - 1)) != 0 ||
+            control->capacity > kRingMaxCapacity) {
+            return ring;
+        }
+        ring.control = control;
+        ring.samples = reinterpret_cast<float*>(static_cast<uint8_t*>(memory) + kRingHeaderBytes);
+        ring.mask = control->capacity - 1;
+        return ring;
+    }
+
+    bool valid() const { return control != nullptr; }
+    int capacity() const { return control ? static_cast<int>(control->capacity) : 0; }
+
+    int readable() const {
+        if (!control) return 0;
+        uint32_t write = control->writeIndex.load(std::memory_order_acquire);
+        uint32_t read = control->readIndex.load(std::memory_order_relaxed);
+        return static_cast<int>(write - read);
+    }
+
+    int writable() const {
+        if (!control) return 0;
+        uint32_t write = control->writeIndex.load(std::memory_order_relaxed);
+        uint32_t read = control->readIndex.load(std::memory_order_acquire);
+        return static_cast<int>(control->capacity - (write - read));
+    }
+
+    uint32_t overruns() const {
+        return control ? control->overruns.load(std::memory_order_relaxed) : 0;
+    }
+
+    // Producer: copies what fits, drops and counts the rest. Returns the
+    // samples written.
+    int write(const float* input, int count) {
+        if (!control || count <= 0) return 0;
+        uint32_t write = control->writeIndex.load(std::memory_order_relaxed);
+        int written = std::min(count, writable());
+        uint32_t start = write & mask;
+        int first = std::min(written, static_cast<int>(control->capacity - start));
+        std::memcpy(samples + start, input, static_cast<size_t>(first) * sizeof(float));
+        std::memcpy(samples, input + first, static_cast<size_t>(written - first) * sizeof(float));
+        control->writeIndex.store(write + written, std::memory_order_release);
+        if (written < count) {
+            control->overruns.fetch_add(count - written, std::memory_order_relaxed);
+        }
+        return written;
+    }
+
+    // Consumer, zero-copy: hands fn(const float* span, int count) up to
+    // maxSamples readable samples in at most two contiguous spans straight
+    // from ring memory, then releases them. Returns the samples consumed.
+    template <typename Fn>
+    int consume(int maxSamples, Fn&& fn) {
+        if (!control) return 0;
+        uint32_t read = control->readIndex.load(std::memory_order_relaxed);
+        int count = std::min(maxSamples, readable());
+        if (count <= 0) return 0;
+        uint32_t start = read & mask;
+        int first = std::min(count, static_cast<int>(control->capacity - start));
+        fn(static_cast<const float*>(samples + start), first);
+        if (count > first) {
+            fn(static_cast<const float*>(samples), count - first);
+        }
+        control->readIndex.store(read + count, std::memory_order_release);
+        return count;
+    }
+
+    // Consumer: copies up to `count` samples out
+    int read(float* output, int count) {
+        return consume(count, [&](const float* span, int n) {
+            std::memcpy(output, span, static_cast<size_t>(n) * sizeof(float));
+            output += n;
+        });
+    }
+
+private:
+    static uint32_t roundCapacity(int capacity) {
+        if (capacity <= 0 || static_cast<uint32_t>(capacity) > kRingMaxCapacity) {
+            return 0;
+        }
+        uint32_t rounded = 1;
+        while (rounded < static_cast<uint32_t>(capacity)) {
+            rounded <<= 1;
+        }
+        return rounded;
+    }
+
+    RingControl* control = nullptr;
+    float* samples = nullptr;
+    uint32_t mask = 0;
+};
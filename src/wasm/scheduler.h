@@ -0,0 +1,394 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Engine-wide work-stealing scheduler.
+//
+// One fixed set of workers serves every parallel loop in the engine (frame
+// extraction, batch alignment, corpus building), so nested or concurrent
+// loops share cores instead of each spawning threads. Each worker owns a
+// deque: it pushes and pops its own tasks at the back (LIFO, cache-warm) and
+// steals from the front of other deques (FIFO, the largest pieces of a
+// split range) when it runs dry. Threads that are not workers submit through
+// a shared injection deque.
+//
+// A thread waiting on a TaskGroup runs queued tasks instead of blocking, so
+// nested parallelFor calls from inside a task cannot deadlock.
+//
+// The worker count is fixed at first use: configure() or ENGINE_THREADS,
+// otherwise hardware_concurrency() - 1 (the calling thread participates).
+// Single-threaded WASM builds have no workers and run every task inline on
+// the caller; the pthreads build and native builds use real workers.
+//
+// parallelReduce is deterministic: the range is cut into fixed chunks of
+// `grain` regardless of thread count or timing, and the per-chunk partial
+// results are combined in chunk order.
+
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#define ENGINE_HAS_THREADS 0
+#else
+#define ENGINE_HAS_THREADS 1
+#endif
+
+class TaskGroup;
+
+class TaskScheduler {
+public:
+    // Engine-wide instance; created with the configured worker count
+    static TaskScheduler& instance() {
+        static TaskScheduler scheduler(resolveWorkerCount());
+        return scheduler;
+    }
+
+    // Sets the worker count used when instance() is first created. Returns
+    // false once the scheduler exists.
+    static bool configure(int workers) {
+        if (created().load()) {
+            return false;
+        }
+        requestedWorkers() = std::max(0, workers);
+        return true;
+    }
+
+    explicit TaskScheduler(int workers) : queues(workers + 1), queued(0), stopping(false) {
+        created().store(true);
+        for (int i = 0; i < workers; i++) {
+            threads.emplace_back([this, i] { workerLoop(i); });
+        }
+    }
+
+    ~TaskScheduler() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    int workerCount() const { return static_cast<int>(threads.size()); }
+
+    // Threads that can run tasks at once (workers plus the caller)
+    int concurrency() const { return workerCount() + 1; }
+
+    // Runs fn() once on every worker, e.g. to size their thread_local arenas
+    // ahead of a parallel loop, and returns when all have. Each task holds
+    // its worker until every one has started, so no worker takes two; the
+    // caller only waits. No-op without workers.
+    template <typename Fn>
+    void forEachWorker(const Fn& fn);
+
+private:
+    friend class TaskGroup;
+
+    struct Task {
+        std::function<void()> body;
+        TaskGroup* group;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    static std::atomic<bool>& created() {
+        static std::atomic<bool> flag(false);
+        return flag;
+    }
+
+    static int& requestedWorkers() {
+        static int workers = -1;
+        return workers;
+    }
+
+    static int resolveWorkerCount() {
+#if ENGINE_HAS_THREADS
+        if (requestedWorkers() >= 0) {
+            return requestedWorkers();
+        }
+        if (const char* env = std::getenv("ENGINE_THREADS")) {
+            return std::max(0, std::atoi(env) - 1);
+        }
+        int hardware = static_cast<int>(std::thread::hardware_concurrency());
+        return std::max(0, hardware - 1);
+#else
+        return 0;
+#endif
+    }
+
+    // Index of this thread's deque: its own for workers, the injection
+    // deque for everyone else
+    int queueIndex() const {
+        return currentScheduler() == this ? currentWorker() : workerCount();
+    }
+
+    static const TaskScheduler*& currentScheduler() {
+        thread_local const TaskScheduler* scheduler = nullptr;
+        return scheduler;
+    }
+
+    static int& currentWorker() {
+        thread_local int worker = -1;
+        return worker;
+    }
+
+    void push(Task task) {
+        Queue& queue = queues[queueIndex()];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back(std::move(task));
+        }
+        queued.fetch_add(1);
+        {
+            // Pairs with the predicate check in workerLoop so a wake-up
+            // cannot slip in between a worker's check and its wait
+            std::lock_guard<std::mutex> lock(sleepMutex);
+        }
+        wake.notify_one();
+    }
+
+    // Own deque from the back, then steal from the front of the others
+    bool tryRun() {
+        int self = queueIndex();
+        Task task;
+        if (!popBack(queues[self], task)) {
+            int count = static_cast<int>(queues.size());
+            bool found = false;
+            for (int k = 1; k < count && !found; k++) {
+                found = popFront(queues[(self + k) % count], task);
+            }
+            if (!found) {
+                return false;
+            }
+        }
+        queued.fetch_sub(1);
+        execute(task);
+        return true;
+    }
+
+    static bool popBack(Queue& queue, Task& task) {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) return false;
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+        return true;
+    }
+
+    static bool popFront(Queue& queue, Task& task) {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) return false;
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        return true;
+    }
+
+    inline void execute(Task& task);
+
+    void workerLoop(int index) {
+        currentScheduler() = this;
+        currentWorker() = index;
+        while (true) {
+            if (tryRun()) {
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wake.wait(lock, [this] { return stopping || queued.load() > 0; });
+            if (stopping) {
+                return;
+            }
+        }
+    }
+
+    std::vector<Queue> queues;
+    std::vector<std::thread> threads;
+    std::atomic<int> queued;
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    bool stopping;
+};
+
+// A set of tasks to wait for. The first exception thrown by a task is
+// rethrown from wait(); remaining tasks still run.
+class TaskGroup {
+public:
+    explicit TaskGroup(TaskScheduler& scheduler = TaskScheduler::instance())
+        : scheduler(scheduler), pending(0) {}
+
+    ~TaskGroup() {
+        waitQuietly();
+    }
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    template <typename Fn>
+    void run(Fn&& fn) {
+        if (scheduler.workerCount() == 0) {
+            TaskScheduler::Task task = {std::forward<Fn>(fn), this};
+            pending.fetch_add(1);
+            scheduler.execute(task);
+            return;
+        }
+        pending.fetch_add(1);
+        scheduler.push({std::forward<Fn>(fn), this});
+    }
+
+    void wait() {
+        waitQuietly();
+        std::exception_ptr error;
+        {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            std::swap(error, firstError);
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    friend class TaskScheduler;
+
+    void waitQuietly() {
+        while (pending.load() > 0) {
+            if (!scheduler.tryRun()) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    void finished(std::exception_ptr error) {
+        if (error) {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!firstError) firstError = error;
+        }
+        pending.fetch_sub(1);
+    }
+
+    TaskScheduler& scheduler;
+    std::atomic<int> pending;
+    std::mutex errorMutex;
+    std::exception_ptr firstError;
+};
+
+inline void TaskScheduler::execute(Task& task) {
+    std::exception_ptr error;
+    try {
+        task.body();
+    } catch (...) {
+        error = std::current_exception();
+    }
+    task.group->finished(error);
+}
+
+template <typename Fn>
+void TaskScheduler::forEachWorker(const Fn& fn) {
+    // Called from a worker: it runs fn itself and the others get a task each
+    bool onWorker = currentScheduler() == this;
+    if (onWorker) fn();
+    int others = workerCount() - (onWorker ? 1 : 0);
+    if (others <= 0) return;
+    std::atomic<int> started(0);
+    std::atomic<int> done(0);
+    TaskGroup group(*this);
+    for (int i = 0; i < others; i++) {
+        group.run([this, &fn, &started, &done, others] {
+            started.fetch_add(1);
+            while (started.load() < others) {
+                std::this_thread::yield();
+            }
+            // A thread outside the pool waiting on its own group may pick
+            // one up; that worker is then left as it was
+            if (currentScheduler() == this) fn();
+            done.fetch_add(1);
+        });
+    }
+    while (done.load() < others) {
+        std::this_thread::yield();
+    }
+}
+
+namespace scheduler_detail {
+
+// Runs chunks [first, last) of fn, splitting off the upper half as a
+// stealable task until one chunk is left
+template <typename ChunkFn>
+void splitChunks(TaskGroup& group, int first, int last, const ChunkFn& fn) {
+    while (last - first > 1) {
+        int mid = first + (last - first) / 2;
+        group.run([&group, mid, last, &fn] { splitChunks(group, mid, last, fn); });
+        last = mid;
+    }
+    if (first < last) {
+        fn(first);
+    }
+}
+
+} // namespace scheduler_detail
+
+// fn(i) for every i in [begin, end), in chunks of `grain` indices
+template <typename Fn>
+void parallelFor(int begin, int end, int grain, const Fn& fn) {
+    if (end <= begin) {
+        return;
+    }
+    grain = std::max(1, grain);
+    int chunks = (end - begin + grain - 1) / grain;
+    auto runChunk = [&](int chunk) {
+        int lo = begin + chunk * grain;
+        int hi = std::min(end, lo + grain);
+        for (int i = lo; i < hi; i++) {
+            fn(i);
+        }
+    };
+
+    TaskScheduler& scheduler = TaskScheduler::instance();
+    if (chunks == 1 || scheduler.workerCount() == 0) {
+        for (int chunk = 0; chunk < chunks; chunk++) {
+            runChunk(chunk);
+        }
+        return;
+    }
+    TaskGroup group(scheduler);
+    scheduler_detail::splitChunks(group, 0, chunks, runChunk);
+    group.wait();
+}
+
+// Deterministic reduction: map(lo, hi, partial) folds indices [lo, hi) of
+// one chunk into `partial` (starting from `identity`), and the chunk results
+// are combined left to right with combine(accumulated, partial).
+template <typename T, typename MapFn, typename CombineFn>
+T parallelReduce(int begin, int end, int grain, const T& identity,
+                 const MapFn& map, const CombineFn& combine) {
+    if (end <= begin) {
+        return identity;
+    }
+    grain = std::max(1, grain);
+    int chunks = (end - begin + grain - 1) / grain;
+    std::vector<T> partials(chunks, identity);
+    parallelFor(0, chunks, 1, [&](int chunk) {
+        int lo = begin + chunk * grain;
+        int hi = std::min(end, lo + grain);
+        map(lo, hi, partials[chunk]);
+    });
+
+    T result = identity;
+    for (int chunk = 0; chunk < chunks; chunk++) {
+        result = combine(result, partials[chunk]);
+    }
+    return result;
+}
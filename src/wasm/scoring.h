@@ -0,0 +1,79 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "arena.h"
+#include "dtw.h"
+#include "feature_matrix.h"
+#include "hmm.h"
+#include "reference_store.h"
+
+// Recitation scoring on top of the engine. The alignment, the energy HMM and
+// the score formulas mirror WasmAnalysisService (performWasmReferenceDTW,
+// performWasmHMM, generateComprehensiveAnalysis) so a grade computed by the
+// native tools matches the one the browser shows for the same audio.
+
+const int kScoringStates = 4;
+const int kScoringSymbols = 256;
+
+struct RecitationScore {
+    int timingAccuracy;
+    int phonemeAccuracy;
+    int overallScore;
+};
+
+// Normalised DTW between the query and the same leading columns of a stored
+// reference entry. The query is copied to float32 to match the store.
+inline double referenceDistance(const ReferenceStore& store, int entry, FeatureView query) {
+    ScratchArena& arena = analysisArena();
+    ArenaScope scope(arena);
+    FeatureViewF full = store.features(entry, arena);
+    FeatureViewF reference(full.data(), full.rows(), query.cols(), full.stride());
+
+    MutableFeatureViewF queryView = arenaFeatures<float>(arena, query.rows(), query.cols());
+    for (int i = 0; i < query.rows(); i++) {
+        std::copy(query.row(i), query.row(i) + query.cols(), queryView.row(i));
+    }
+
+    DynamicTimeWarping dtw;
+    DTWOutcome outcome = dtw.align(FeatureViewF(queryView), reference,
+                                   DistanceMetric::Euclidean, -1, nullptr);
+    return outcome.pathLength > 0 ? outcome.distance / outcome.pathLength : outcome.distance;
+}
+
+// Forward log likelihood of the first MFCC under the browser's four-state
+// model: symbols round((c0 + 30) * 4), uniform transitions and initial
+// probabilities, Gaussian-shaped emissions centred on (state + 1) * 64.
+inline double phonemeLikelihood(FeatureView features) {
+    static const std::vector<double> emissions = [] {
+        std::vector<double> table(kScoringStates * kScoringSymbols);
+        for (int i = 0; i < kScoringStates; i++) {
+            for (int j = 0; j < kScoringSymbols; j++) {
+                double mean = (i + 1) * 64.0;
+                table[i * kScoringSymbols + j] = std::exp(-0.5 * (j - mean) * (j - mean) / 400.0);
+            }
+        }
+        return table;
+    }();
+    std::vector<double> transitions(kScoringStates * kScoringStates, 1.0 / kScoringStates);
+    std::vector<double> initial(kScoringStates, 1.0 / kScoringStates);
+
+    HiddenMarkovModel hmm(kScoringStates, kScoringSymbols);
+    hmm.setModel(transitions.data(), emissions.data(), initial.data());
+
+    ScratchArena& arena = analysisArena();
+    ArenaScope scope(arena);
+    int* observations = arena.allocateArray<int>(features.rows());
+    hmm.quantizeObservations(features, 0, 30.0, 4.0, observations);
+    return hmm.forwardInto(observations, features.rows());
+}
+
+inline RecitationScore recitationScore(double distance, double likelihood) {
+    RecitationScore score;
+    score.timingAccuracy = static_cast<int>(std::round(std::max(0.0, 100.0 - distance * 20.0)));
+    double normalizedLikelihood = std::max(0.0, likelihood + 1000.0) / 10.0;
+    score.phonemeAccuracy = std::min(100, static_cast<int>(std::round(normalizedLikelihood)));
+    score.overallScore = static_cast<int>(std::round((score.timingAccuracy + score.phonemeAccuracy) / 2.0));
+    return score;
+}
@@ -0,0 +1,335 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "cancellation.h"
+#include "dtw.h"
+#include "feature_matrix.h"
+#include "reference_store.h"
+#include "scheduler.h"
+#include "scoring.h"
+
+// Long-recording segmentation.
+//
+// A full-surah recording aligned as one sequence makes DTW quadratic in the
+// whole recitation and runs on one core. segmentRecitation() splits the
+// query features into ayah-sized segments and scores each one on its own,
+// in parallel, then folds the per-segment scores into one report:
+//
+//   1. Pauses: frames whose energy falls well below the recording's speech
+//      level for at least minPauseSeconds (detectPauses).
+//   2. Boundaries. With reference entries for the ayahs, each ayah is found
+//      in turn by subsequence DTW in a window after the previous one, and
+//      its end is moved onto a nearby pause. Ayahs the store lacks, and
+//      recordings without a store, fall back to the pauses alone: voiced
+//      spans merged up to minSegmentSeconds.
+//   3. Scoring: referenceDistance and phonemeLikelihood per segment, spread
+//      over the engine scheduler.
+// Segment boundaries are query frames, so the search is linear in the
+// recording length for a fixed ayah length.
+//
+// Layout of RecitationSegment (little-endian, 48 bytes):
+//     0  int32   start             query frames [start, end)
+//     4  int32   end
+//     8  int32   ayah              1-based within the surah, 0 = unlabelled
+//    12  int32   entry             reference entry scored against, -1 = none
+//    16  float64 distance          normalised DTW distance (NaN unaligned)
+//    24  float64 likelihood        forward log likelihood
+//    32  int32   timingAccuracy    -1 when unaligned
+//    36  int32   phonemeAccuracy
+//    40  int32   overallScore
+//    44  int32   flags             kSegmentAligned | kSegmentScored
+//
+// Layout of RecitationReport (little-endian, 48 bytes):
+//     0  int32   segments
+//     4  int32   ayahsExpected     lastAyah - firstAyah + 1, 0 without a surah
+//     8  int32   ayahsAligned      segments matched to a reference entry
+//    12  int32   frames            query frames inside segments
+//    16  int32   timingAccuracy    frame-weighted over aligned segments
+//    20  int32   phonemeAccuracy   frame-weighted over scored segments
+//    24  int32   overallScore
+//    28  int32   status            RunStatus of the whole run
+//    32  float64 distance          frame-weighted over aligned segments
+//    40  float64 likelihood        sum over scored segments
+
+const int32_t kSegmentAligned = 1;
+const int32_t kSegmentScored = 2;
+
+struct RecitationSegment {
+    int32_t start;
+    int32_t end;
+    int32_t ayah;
+    int32_t entry;
+    double distance;
+    double likelihood;
+    int32_t timingAccuracy;
+    int32_t phonemeAccuracy;
+    int32_t overallScore;
+    int32_t flags;
+};
+
+struct RecitationReport {
+    int32_t segments;
+    int32_t ayahsExpected;
+    int32_t ayahsAligned;
+    int32_t frames;
+    int32_t timingAccuracy;
+    int32_t phonemeAccuracy;
+    int32_t overallScore;
+    int32_t status;
+    double distance;
+    double likelihood;
+};
+
+static_assert(sizeof(RecitationSegment) == 48, "recitation segment layout");
+static_assert(sizeof(RecitationReport) == 48, "recitation report layout");
+
+struct SegmenterConfig {
+    double frameRate;              // feature frames per second
+    int energyColumn;              // RMS energy column of the query features
+    int alignColumns = 0;          // leading columns aligned and scored, 0 = all
+    double minPauseSeconds = 0.25;
+    double minSegmentSeconds = 1.0;
+};
+
+// Quiet frames [start, end)
+struct FramePause {
+    int start;
+    int end;
+};
+
+// Pause threshold: this fraction of the way from the quiet floor (10th
+// percentile of frame level) to the speech level (90th), in dB, but never
+// more than kMaxPauseDepthDb below speech, so digitally silent padding
+// cannot pull the threshold under the room noise. Recordings with less
+// than kMinSpeechRangeDb between floor and speech have no pauses.
+const double kPauseLevelFraction = 0.25;
+const double kMaxPauseDepthDb = 30.0;
+const double kMinSpeechRangeDb = 6.0;
+
+// An ayah is searched for within this many times its reference length
+// after the previous one, plus kMaxLeadSeconds of silence before it
+const double kMaxTempoRatio = 2.0;
+const double kMaxLeadSeconds = 3.0;
+
+inline std::vector<FramePause> detectPauses(FeatureView features, int energyColumn, double frameRate,
+                                            double minPauseSeconds) {
+    std::vector<FramePause> pauses;
+    int n = features.rows();
+    if (n == 0 || energyColumn < 0 || energyColumn >= features.cols()) return pauses;
+
+    std::vector<double> level(n);
+    for (int i = 0; i < n; i++) {
+        level[i] = 20.0 * std::log10(std::max(features(i, energyColumn), 1e-9));
+    }
+    std::vector<double> sorted(level);
+    std::nth_element(sorted.begin(), sorted.begin() + n / 10, sorted.end());
+    double floor = sorted[n / 10];
+    std::nth_element(sorted.begin(), sorted.begin() + (n * 9) / 10, sorted.end());
+    double speech = sorted[(n * 9) / 10];
+    if (speech - floor < kMinSpeechRangeDb) return pauses;
+
+    double threshold = std::max(floor + kPauseLevelFraction * (speech - floor), speech - kMaxPauseDepthDb);
+    int minFrames = std::max(1, static_cast<int>(std::lround(minPauseSeconds * frameRate)));
+    int start = -1;
+    for (int i = 0; i <= n; i++) {
+        bool quiet = i < n && level[i] < threshold;
+        if (quiet && start < 0) {
+            start = i;
+        } else if (!quiet && start >= 0) {
+            if (i - start >= minFrames) pauses.push_back({start, i});
+            start = -1;
+        }
+    }
+    return pauses;
+}
+
+namespace segmenter_detail {
+
+// Voiced spans of [begin, end) between pauses, each at least minFrames
+// long (short spans join the next one, a short tail joins the previous)
+inline void spansBetweenPauses(const std::vector<FramePause>& pauses, int begin, int end, int minFrames,
+                               std::vector<RecitationSegment>& segments) {
+    size_t first = segments.size();
+    int spanStart = begin;
+    int open = -1;
+    int openEnd = -1;
+    auto close = [&](int spanEnd) {
+        if (spanEnd <= spanStart) return;
+        if (open < 0) open = spanStart;
+        openEnd = spanEnd;
+        if (spanEnd - open >= minFrames) {
+            segments.push_back({open, spanEnd, 0, -1, 0.0, 0.0, -1, 0, 0, 0});
+            open = -1;
+        }
+    };
+    for (const FramePause& pause : pauses) {
+        if (pause.end <= begin || pause.start >= end) continue;
+        close(std::max(begin, pause.start));
+        spanStart = std::min(end, pause.end);
+    }
+    close(end);
+    if (open >= 0) {
+        if (segments.size() > first) {
+            segments.back().end = openEnd;
+        } else {
+            segments.push_back({open, openEnd, 0, -1, 0.0, 0.0, -1, 0, 0, 0});
+        }
+    }
+}
+
+// The pause nearest `frame` that starts or ends within `tolerance` of it
+inline const FramePause* pauseNear(const std::vector<FramePause>& pauses, int frame, int tolerance) {
+    const FramePause* best = nullptr;
+    int bestGap = tolerance + 1;
+    for (const FramePause& pause : pauses) {
+        int gap = frame < pause.start ? pause.start - frame : (frame > pause.end ? frame - pause.end : 0);
+        if (gap < bestGap) {
+            best = &pause;
+            bestGap = gap;
+        }
+    }
+    return best;
+}
+
+} // namespace segmenter_detail
+
+// Splits `query` into segments for ayahs firstAyah..lastAyah of `surah`
+// (reference entries of `reciter` in `store`, which may be null or closed)
+// and scores them. Under a CancelScope a stop during the boundary search
+// keeps the segments found so far; a stop during scoring leaves the
+// remaining segments unscored. Either way the report's status says so.
+inline RecitationReport segmentRecitation(FeatureView query, const ReferenceStore* store, int surah,
+                                          int firstAyah, int lastAyah, int reciter,
+                                          const SegmenterConfig& config,
+                                          std::vector<RecitationSegment>& segments) {
+    using namespace segmenter_detail;
+    segments.clear();
+    RecitationReport report = {};
+    int n = query.rows();
+    bool labelled = surah > 0 && firstAyah > 0 && lastAyah >= firstAyah;
+    report.ayahsExpected = labelled ? lastAyah - firstAyah + 1 : 0;
+    if (n == 0) return report;
+
+    CancelControl* control = currentCancelControl();
+    std::vector<FramePause> pauses = detectPauses(query, config.energyColumn, config.frameRate,
+                                                  config.minPauseSeconds);
+    // Pauses come from the whole rows; the rest looks at the aligned columns
+    if (config.alignColumns > 0 && config.alignColumns < query.cols()) {
+        query = FeatureView(query.data(), n, config.alignColumns, query.stride());
+    }
+    int minPause = std::max(1, static_cast<int>(std::lround(config.minPauseSeconds * config.frameRate)));
+    int minSegment = std::max(1, static_cast<int>(std::lround(config.minSegmentSeconds * config.frameRate)));
+    bool aligned = labelled && store && store->isOpen() && query.cols() <= store->featureDim();
+
+    if (!aligned) {
+        spansBetweenPauses(pauses, 0, n, minSegment, segments);
+    } else {
+        FeatureMatrixF queryF;
+        queryF.assign(query);
+        int lead = static_cast<int>(std::lround(kMaxLeadSeconds * config.frameRate));
+        int cursor = 0;
+        for (int ayah = firstAyah; ayah <= lastAyah && cursor < n; ayah++) {
+            int entry = store->find(surah, ayah, reciter);
+            if (entry < 0) {
+                // Without a reference the ayah runs to the next pause
+                std::vector<RecitationSegment> span;
+                spansBetweenPauses(pauses, cursor, n, minSegment, span);
+                RecitationSegment segment = span.empty()
+                    ? RecitationSegment{cursor, n, 0, -1, 0.0, 0.0, -1, 0, 0, 0}
+                    : span.front();
+                segment.ayah = ayah;
+                segments.push_back(segment);
+                const FramePause* pause = pauseNear(pauses, segment.end, 0);
+                cursor = pause ? pause->end : segment.end;
+                continue;
+            }
+
+            ScratchArena& arena = analysisArena();
+            ArenaScope scope(arena);
+            FeatureViewF full = store->features(entry, arena);
+            FeatureViewF reference(full.data(), full.rows(), query.cols(), full.stride());
+            int m = reference.rows();
+            int window = static_cast<int>(std::min<int64_t>(n - cursor,
+                static_cast<int64_t>(kMaxTempoRatio * m) + lead));
+            DynamicTimeWarping dtw;
+            DTWMatch match = dtw.alignSubsequence(reference, queryF.view().slice(cursor, cursor + window),
+                                                  DistanceMetric::Euclidean);
+            if (std::isnan(match.distance)) break;
+
+            int start = cursor + match.start;
+            int end = cursor + match.end;
+            int next = end;
+            const FramePause* pause = pauseNear(pauses, end, std::max(minPause, m / 8));
+            if (pause && pause->start > start) {
+                end = pause->start;
+                next = pause->end;
+            }
+            const FramePause* leading = pauseNear(pauses, start, 0);
+            if (leading && leading->end < end) start = std::max(start, leading->end);
+
+            segments.push_back({start, end, ayah, entry, 0.0, 0.0, -1, 0, 0, kSegmentAligned});
+            cursor = next;
+        }
+    }
+
+    // Segments are independent; workers do not inherit the CancelScope, so
+    // each checks the caller's control before starting
+    parallelFor(0, static_cast<int>(segments.size()), 1, [&](int s) {
+        if (stopRequested(control)) return;
+        RecitationSegment& segment = segments[s];
+        FeatureView slice = query.slice(segment.start, segment.end);
+        segment.distance = segment.flags & kSegmentAligned
+            ? referenceDistance(*store, segment.entry, slice)
+            : std::numeric_limits<double>::quiet_NaN();
+        segment.likelihood = phonemeLikelihood(slice);
+        RecitationScore score = recitationScore(segment.flags & kSegmentAligned ? segment.distance : 0.0,
+                                                segment.likelihood);
+        segment.phonemeAccuracy = score.phonemeAccuracy;
+        if (segment.flags & kSegmentAligned) {
+            segment.timingAccuracy = score.timingAccuracy;
+            segment.overallScore = score.overallScore;
+        } else {
+            segment.overallScore = score.phonemeAccuracy;
+        }
+        segment.flags |= kSegmentScored;
+    });
+
+    double alignedFrames = 0.0;
+    double scoredFrames = 0.0;
+    double timing = 0.0;
+    double phoneme = 0.0;
+    for (const RecitationSegment& segment : segments) {
+        int frames = segment.end - segment.start;
+        report.frames += frames;
+        if (segment.flags & kSegmentAligned) report.ayahsAligned++;
+        if (!(segment.flags & kSegmentScored)) continue;
+        scoredFrames += frames;
+        phoneme += static_cast<double>(frames) * segment.phonemeAccuracy;
+        report.likelihood += segment.likelihood;
+        if (segment.flags & kSegmentAligned) {
+            alignedFrames += frames;
+            timing += static_cast<double>(frames) * segment.timingAccuracy;
+            report.distance += static_cast<double>(frames) * segment.distance;
+        }
+    }
+    report.segments = static_cast<int32_t>(segments.size());
+    report.phonemeAccuracy = scoredFrames > 0 ? static_cast<int32_t>(std::lround(phoneme / scoredFrames)) : 0;
+    if (alignedFrames > 0) {
+        report.timingAccuracy = static_cast<int32_t>(std::lround(timing / alignedFrames));
+        report.distance /= alignedFrames;
+        report.overallScore = static_cast<int32_t>(std::lround((report.timingAccuracy + report.phonemeAccuracy) / 2.0));
+    } else {
+        report.timingAccuracy = -1;
+        report.distance = std::numeric_limits<double>::quiet_NaN();
+        report.overallScore = report.phonemeAccuracy;
+    }
+
+    if (control) {
+        report.status = control->status.load(std::memory_order_relaxed);
+    }
+    return report;
+}
@@ -0,0 +1,236 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include "arena.h"
+#include "audio_processor.h"
+#include "feature_matrix.h"
+#include "loudness.h"
+#include "nasal.h"
+#include "noise_suppression.h"
+#include "onset.h"
+#include "peak_pyramid.h"
+#include "qalqalah.h"
+#include "ring_buffer.h"
+
+// Incremental AudioProcessor::processAudioFramesInto for live input.
+//
+// Samples arrive in chunks of any size, pushed directly or drained from a
+// SampleRing. A feature row is produced as soon as its frame is complete.
+// Frame f covers stream samples [f * hop, f * hop + frameSize), as in
+// offline analysis, so live and offline features agree row for row.
+//
+// configure() sizes the frame buffers and warms the analysis arena, so
+// framing and feature extraction in push() and drain() do not allocate.
+// What can still grow: the detectors' result lists (nasal segments,
+// qalqalah bursts, landmarks), which are reserved for a typical recording
+// and grow past that, and an attached PeakPyramid once the stream outruns
+// the length it was reserved for. Rows collect in a fixed-capacity block
+// until the caller takes them with clearFrames(). Frames that arrive while
+// the block is full are dropped and counted. An attached PeakPyramid gets
+// every sample as well, so the waveform is summarised during capture. With
+// nasality enabled each frame is also scored by a NasalDetector; its scores
+// line up with the feature rows and are cleared with them. With qalqalah
+// enabled the samples also go through a QalqalahDetector, which reports
+// release bursts at its own, finer resolution. With landmarks enabled the
+// log mel energies of each frame feed an OnsetDetector. With noise
+// suppression enabled a NoiseSuppressor learns the room noise from the
+// silent frames and masks it out of the spectrum before the mel stage.
+// That changes the MFCCs and the landmarks' log mel energies; the other
+// detectors still see the raw samples. With loudness normalisation enabled
+// the samples go through a LoudnessNormalizer before framing; frames keep
+// their positions but complete up to LoudnessNormalizer::latency() samples
+// later, and finish() flushes the held samples when the stream ends. The
+// peak pyramid and qalqalah detector still get the raw samples.
+class StreamingFeatureExtractor {
+public:
+    // False for unusable configurations (hop larger than the frame, no room)
+    bool configure(double sampleRate, int frameSize, int hopSize, int maxFrames) {
+        if (sampleRate <= 0 || frameSize < 2 || hopSize <= 0 || hopSize > frameSize || maxFrames <= 0) {
+            return false;
+        }
+        rate = sampleRate;
+        size = frameSize;
+        hop = hopSize;
+        history.assign(frameSize, 0.0);
+        output.resize(maxFrames, kFeaturesPerFrame);
+
+        // Plan the tables and grow the arena to its per-frame peak once
+        processor.prepare(frameSize, sampleRate);
+        {
+            ArenaScope scope(analysisArena());
+            double features[kFeaturesPerFrame];
+            processor.extractFrameInto(history.data(), frameSize, sampleRate, features);
+        }
+        reset();
+        return true;
+    }
+
+    // Starts a new stream with the same configuration
+    void reset() {
+        filled = 0;
+        pending = 0;
+        produced = 0;
+        dropped = 0;
+        if (nasal.configured()) nasal.reset();
+        if (bursts.configured()) bursts.reset();
+        if (onsets.configured()) onsets.reset();
+        if (denoiser.configured()) denoiser.reset();
+        if (normalizer.configured()) normalizer.reset();
+    }
+
+    bool configured() const { return size > 0; }
+
+    // Not owned; null detaches
+    void attachPeaks(PeakPyramid* pyramid) { peaks = pyramid; }
+
+    // Scores every frame from now on for nasal murmur; allocates once
+    bool enableNasality() {
+        return configured() && (nasal.configured() || nasal.configure({rate, size, hop}, output.rows()));
+    }
+
+    const NasalDetector& nasality() const { return nasal; }
+
+    // Looks for qalqalah bursts from now on; allocates once
+    bool enableQalqalah() {
+        return configured() && (bursts.configured() || bursts.configure(rate));
+    }
+
+    const QalqalahDetector& qalqalah() const { return bursts; }
+
+    // Onsets and syllable nuclei from now on; allocates once
+    bool enableLandmarks() {
+        return configured() && (onsets.configured() || onsets.configure(rate / hop, kMelFilters));
+    }
+
+    const OnsetDetector& landmarks() const { return onsets; }
+
+    // Suppresses noise from now on; allocates once
+    bool enableNoiseSuppression() {
+        if (!configured() || (!denoiser.configured() && !denoiser.configure(size / 2, rate / hop))) {
+            return false;
+        }
+        processor.setNoiseSuppressor(&denoiser);
+        return true;
+    }
+
+    const NoiseSuppressor& noiseSuppressor() const { return denoiser; }
+
+    // Normalises loudness from now on; allocates once. Best enabled before
+    // the first push, so every frame sees the same front end.
+    bool enableLoudness() {
+        return configured() && (normalizer.configured() || normalizer.configure(rate));
+    }
+
+    const LoudnessNormalizer& loudness() const { return normalizer; }
+
+    // Appends samples; returns the number of frames completed
+    int push(const float* samples, int count) {
+        if (!configured()) return 0;
+        if (peaks) peaks->append(samples, count);
+        if (bursts.configured()) bursts.push(samples, count);
+        if (normalizer.configured()) {
+            int frames = 0;
+            normalizer.process(samples, count, [&](const double* span, int n) {
+                frames += frameSamples(span, n);
+            });
+            return frames;
+        }
+        return frameSamples(samples, count);
+    }
+
+    // Ends the stream: frames the samples the loudness look-ahead still
+    // holds, so the stream ends on the same rows as offline analysis.
+    // Returns the number of frames completed; reset() before the next stream.
+    int finish() {
+        if (!configured() || !normalizer.configured()) return 0;
+        int frames = 0;
+        normalizer.finish([&](const double* span, int n) {
+            frames += frameSamples(span, n);
+        });
+        return frames;
+    }
+
+    // Consumes everything readable in `ring`, reading it in place
+    int drain(SampleRing& ring) {
+        int frames = 0;
+        ring.consume(ring.readable(), [&](const float* span, int count) {
+            frames += push(span, count);
+        });
+        return frames;
+    }
+
+    // Rows produced since the last clearFrames()
+    int frameCount() const { return pending; }
+    FeatureViewF frames() const { return output.view().slice(0, pending); }
+    const float* data() const { return output.data(); }
+    int stride() const { return static_cast<int>(output.stride()); }
+    void clearFrames() {
+        pending = 0;
+        nasal.clearScores();
+    }
+
+    // Frames completed over the whole stream, including dropped ones
+    int64_t framesProduced() const { return produced; }
+    int64_t framesDropped() const { return dropped; }
+
+private:
+    // Adds samples to the frame history, emitting each frame completed
+    template <typename T>
+    int frameSamples(const T* samples, int count) {
+        int frames = 0;
+        while (count > 0) {
+            int take = std::min(count, size - filled);
+            double* tail = history.data() + filled;
+            for (int i = 0; i < take; i++) {
+                tail[i] = samples[i];
+            }
+            filled += take;
+            samples += take;
+            count -= take;
+
+            if (filled == size) {
+                emitFrame();
+                frames++;
+                std::memmove(history.data(), history.data() + hop, sizeof(double) * (size - hop));
+                filled = size - hop;
+            }
+        }
+        return frames;
+    }
+
+    void emitFrame() {
+        produced++;
+        if (nasal.configured()) nasal.push(history.data());
+        bool keep = pending < output.rows();
+        if (!keep) dropped++;
+        // Landmarks need every frame, kept or not
+        if (!keep && !onsets.configured()) return;
+        ArenaScope scope(analysisArena());
+        double features[kFeaturesPerFrame];
+        double logMel[kMelFilters];
+        processor.extractFrameInto(history.data(), size, rate, features, onsets.configured() ? logMel : nullptr);
+        if (onsets.configured()) onsets.push(logMel, features[kMFCCCoefficients]);
+        if (!keep) return;
+        std::copy(features, features + kFeaturesPerFrame, output.row(pending));
+        pending++;
+    }
+
+    AudioProcessor processor;
+    PoolVector<double> history;
+    FeatureMatrixF output;
+    PeakPyramid* peaks = nullptr;
+    NasalDetector nasal;
+    QalqalahDetector bursts;
+    OnsetDetector onsets;
+    NoiseSuppressor denoiser;
+    LoudnessNormalizer normalizer;
+    double rate = 0.0;
+    int size = 0;
+    int hop = 0;
+    int filled = 0;
+    int pending = 0;
+    int64_t produced = 0;
+    int64_t dropped = 0;
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+#ifdef __EMSCRIPTEN__
+#include <emscripten/emscripten.h>
+#endif
+
+// Budgeted execution for the resumable engine tasks (DTWTask, ViterbiTask,
+// FeatureTask). A task's step(budgetUs) does whole units of work (a DTW row,
+// a Viterbi frame, a feature frame) until the budget is spent and then
+// returns, so a caller on the main thread can render between steps. Task
+// state lives in the task, not in the analysis arena, so other engine calls
+// (and scratch_reset()) may run between steps.
+
+// Work between clock reads. Cheap units (a 4-state Viterbi frame) are
+// batched so the clock costs well under 1% of the step; expensive ones (a
+// feature frame) read it after every unit.
+constexpr size_t kSliceCheckInterval = 1 << 12;
+
+inline double engineMonotonicUs() {
+#ifdef __EMSCRIPTEN__
+    return emscripten_get_now() * 1000.0;
+#else
+    return std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+class TimeSlice {
+public:
+    explicit TimeSlice(double budgetUs) : deadline(engineMonotonicUs() + budgetUs) {}
+
+    // Accounts for `work` units just done; true once the budget is spent.
+    // A step always completes at least one unit, so a task progresses even
+    // with a zero budget.
+    bool exhausted(size_t work) {
+        pending += work;
+        if (pending < kSliceCheckInterval) return false;
+        pending = 0;
+        return engineMonotonicUs() >= deadline;
+    }
+
+private:
+    double deadline;
+    size_t pending = 0;
+};
@@ -0,0 +1,601 @@
+// Native analysis daemon for server-side scoring.
+//
+// Grades recitations with the same engine and score formulas as the browser
+// (see scoring.h) against a reference store built by corpus_builder. Jobs
+// arrive over stdin/stdout or a Unix socket, wait in a bounded queue, and run
+// on the engine scheduler with at most --jobs analyses in flight.
+//
+// Every message is a frame: a little-endian uint32 payload length, then the
+// payload.
+//   request:  one header line of space separated key=value pairs and '\n',
+//             followed by mono little-endian PCM
+//               id=TEXT          echoed in the response (optional)
+//               surah=N ayah=N   verse to score against
+//               reciter=N        reference reciter (default --reciter)
+//               rate=HZ          sample rate of the PCM
+//               format=s16|f32   sample format (default s16)
+//   response: one JSON object,
+//     {"id":"7","status":"ok","distance":..,"likelihood":..,
+//      "timing_accuracy":..,"phoneme_accuracy":..,"overall_score":..,
+//      "frames":..,"reference_frames":..,
+//      "ms":{"queue":..,"decode":..,"features":..,"align":..,"hmm":..,"total":..}}
+//     or {"id":"7","status":"error","error":"..."} with the same "ms" block.
+// Responses on a connection arrive in completion order; match them by id.
+//
+// Backpressure: once --queue jobs are waiting, readers stop reading until a
+// slot frees up, so clients see their writes block instead of the daemon
+// buffering without bound.
+//
+// Build with build_native.sh.
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "../audio_processor.h"
+#include "../reference_store.h"
+#include "../scheduler.h"
+#include "../scoring.h"
+#include "audio_file.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    std::string store;
+    std::string socketPath;
+    int threads = 0;
+    int jobs = 0;
+    int queue = 256;
+    int reciter = 0;
+    double memoryBudget = 256.0 * 1024 * 1024;
+    double maxFrameBytes = 64.0 * 1024 * 1024;
+};
+
+static void usage() {
+    std::fprintf(stderr,
+        "usage: analysis_daemon --store FILE [options]\n"
+        "  --socket PATH      listen on a Unix socket instead of stdin/stdout\n"
+        "  --threads N        engine worker threads (hardware concurrency)\n"
+        "  --jobs N           analyses in flight at once (worker threads)\n"
+        "  --queue N          accepted jobs waiting to run before readers block (256)\n"
+        "  --reciter N        reference reciter when a request names none (0)\n"
+        "  --memory-mb N      per-job workspace ceiling (256)\n"
+        "  --max-frame-mb N   largest accepted request frame (64)\n");
+}
+
+static bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h" || i + 1 >= argc) {
+            return false;
+        }
+        const char* value = argv[++i];
+
+        if (arg == "--store") {
+            options.store = value;
+        } else if (arg == "--socket") {
+            options.socketPath = value;
+        } else if (arg == "--threads") {
+            options.threads = std::atoi(value);
+        } else if (arg == "--jobs") {
+            options.jobs = std::atoi(value);
+        } else if (arg == "--queue") {
+            options.queue = std::atoi(value);
+        } else if (arg == "--reciter") {
+            options.reciter = std::atoi(value);
+        } else if (arg == "--memory-mb") {
+            options.memoryBudget = std::atof(value) * 1024 * 1024;
+        } else if (arg == "--max-frame-mb") {
+            options.maxFrameBytes = std::atof(value) * 1024 * 1024;
+        } else {
+            return false;
+        }
+    }
+    return !options.store.empty() && options.queue > 0 && options.maxFrameBytes > 0;
+}
+
+// One client: a socket, or stdin/stdout. Shared by its reader and by the
+// jobs it submitted, so it closes once the last response is written.
+class Connection {
+public:
+    Connection(int input, int output, bool owned) : input(input), output(output), owned(owned) {}
+
+    ~Connection() {
+        if (owned) {
+            ::close(input);
+            if (output != input) ::close(output);
+        }
+    }
+
+    Connection(const Connection&) = delete;
+    Connection& operator=(const Connection&) = delete;
+
+    // False at end of input; `error` is set when the stream is unusable
+    bool readFrame(std::string& payload, size_t maxBytes, std::string& error) {
+        uint8_t prefix[4];
+        if (!readExact(prefix, sizeof(prefix))) {
+            return false;
+        }
+        size_t length = audio_file::readLE(prefix, 4);
+        if (length > maxBytes) {
+            error = "frame of " + std::to_string(length) + " bytes exceeds --max-frame-mb";
+            return false;
+        }
+        payload.resize(length);
+        if (length > 0 && !readExact(&payload[0], length)) {
+            error = "truncated frame";
+            return false;
+        }
+        return true;
+    }
+
+    void writeFrame(const std::string& payload) {
+        uint8_t prefix[4];
+        uint32_t length = static_cast<uint32_t>(payload.size());
+        for (int i = 0; i < 4; i++) {
+            prefix[i] = static_cast<uint8_t>(length >> (8 * i));
+        }
+        std::lock_guard<std::mutex> lock(writeMutex);
+        if (broken) return;
+        broken = !writeAll(prefix, sizeof(prefix)) || !writeAll(payload.data(), payload.size());
+    }
+
+private:
+    bool readExact(void* data, size_t bytes) {
+        char* p = static_cast<char*>(data);
+        while (bytes > 0) {
+            ssize_t got = ::read(input, p, bytes);
+            if (got < 0 && errno == EINTR) continue;
+            if (got <= 0) return false;
+            p += got;
+            bytes -= got;
+        }
+        return true;
+    }
+
+    bool writeAll(const void* data, size_t bytes) {
+        const char* p = static_cast<const char*>(data);
+        while (bytes > 0) {
+            ssize_t put = ::write(output, p, bytes);
+            if (put < 0 && errno == EINTR) continue;
+            if (put <= 0) return false;
+            p += put;
+            bytes -= put;
+        }
+        return true;
+    }
+
+    int input;
+    int output;
+    bool owned;
+    std::mutex writeMutex;
+    bool broken = false;
+};
+
+struct Job {
+    std::shared_ptr<Connection> connection;
+    std::string id;
+    int surah = 0;
+    int ayah = 0;
+    int reciter = 0;
+    double sampleRate = 0.0;
+    bool float32 = false;
+    std::string payload;
+    size_t pcmOffset = 0;
+    Clock::time_point received;
+};
+
+static bool parseRequest(Job& job, std::string& error) {
+    size_t newline = job.payload.find('\n');
+    if (newline == std::string::npos) {
+        error = "missing header line";
+        return false;
+    }
+    std::istringstream fields(job.payload.substr(0, newline));
+    std::string field;
+    while (fields >> field) {
+        size_t equals = field.find('=');
+        std::string key = field.substr(0, equals);
+        std::string value = equals == std::string::npos ? "" : field.substr(equals + 1);
+        if (key == "id") {
+            job.id = value;
+        } else if (key == "surah") {
+            job.surah = std::atoi(value.c_str());
+        } else if (key == "ayah") {
+            job.ayah = std::atoi(value.c_str());
+        } else if (key == "reciter") {
+            job.reciter = std::atoi(value.c_str());
+        } else if (key == "rate") {
+            job.sampleRate = std::atof(value.c_str());
+        } else if (key == "format") {
+            if (value != "s16" && value != "f32") {
+                error = "unknown format " + value;
+                return false;
+            }
+            job.float32 = value == "f32";
+        } else {
+            error = "unknown field " + key;
+            return false;
+        }
+    }
+    if (job.sampleRate <= 0) {
+        error = "missing rate";
+        return false;
+    }
+    job.pcmOffset = newline + 1;
+    return true;
+}
+
+// Bounded FIFO between the readers and the dispatcher. push() blocks while
+// full, which is what pushes back on clients.
+class JobQueue {
+public:
+    explicit JobQueue(size_t capacity) : capacity(capacity) {}
+
+    void push(std::shared_ptr<Job> job) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this] { return jobs.size() < capacity || closed; });
+        if (closed) return;
+        jobs.push_back(std::move(job));
+        notEmpty.notify_one();
+    }
+
+    // False once closed and drained
+    bool pop(std::shared_ptr<Job>& job) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this] { return !jobs.empty() || closed; });
+        if (jobs.empty()) return false;
+        job = std::move(jobs.front());
+        jobs.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+
+private:
+    size_t capacity;
+    std::deque<std::shared_ptr<Job>> jobs;
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    bool closed = false;
+};
+
+static double millisecondsBetween(Clock::time_point from, Clock::time_point to) {
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+static std::string jsonString(const std::string& text) {
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+static std::string jsonNumber(double value, const char* format = "%.9g") {
+    if (!std::isfinite(value)) {
+        return "null";
+    }
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), format, value);
+    return buffer;
+}
+
+// Phase timings of one job, in milliseconds
+struct JobTiming {
+    double queue = 0.0;
+    double decode = 0.0;
+    double features = 0.0;
+    double align = 0.0;
+    double hmm = 0.0;
+    double total = 0.0;
+
+    std::string json() const {
+        return "{\"queue\":" + jsonNumber(queue, "%.3f") + ",\"decode\":" + jsonNumber(decode, "%.3f") +
+               ",\"features\":" + jsonNumber(features, "%.3f") + ",\"align\":" + jsonNumber(align, "%.3f") +
+               ",\"hmm\":" + jsonNumber(hmm, "%.3f") + ",\"total\":" + jsonNumber(total, "%.3f") + "}";
+    }
+};
+
+class Analyzer {
+public:
+    Analyzer(const ReferenceStore& store, const Options& options)
+        : store(store), budget(static_cast<size_t>(options.memoryBudget)),
+          defaultReciter(options.reciter) {}
+
+    // Runs one job and writes its response
+    void run(Job& job) {
+        JobTiming timing;
+        Clock::time_point started = Clock::now();
+        timing.queue = millisecondsBetween(job.received, started);
+
+        std::string result;
+        std::string error;
+        {
+            ArenaScope scope(analysisArena());
+            if (!analyze(job, timing, result, error)) {
+                result.clear();
+            }
+        }
+        timing.total = millisecondsBetween(job.received, Clock::now());
+
+        std::string response = "{\"id\":" + jsonString(job.id);
+        if (error.empty()) {
+            response += ",\"status\":\"ok\"" + result;
+            completed++;
+        } else {
+            response += ",\"status\":\"error\",\"error\":" + jsonString(error);
+            failed++;
+        }
+        response += ",\"ms\":" + timing.json() + "}";
+        job.connection->writeFrame(response);
+        job.payload.clear();
+    }
+
+    std::shared_ptr<Job> makeJob(std::shared_ptr<Connection> connection, std::string payload) {
+        std::shared_ptr<Job> job = std::make_shared<Job>();
+        job->connection = std::move(connection);
+        job->payload = std::move(payload);
+        job->reciter = defaultReciter;
+        job->received = Clock::now();
+        return job;
+    }
+
+    int completedCount() const { return completed; }
+    int failedCount() const { return failed; }
+
+private:
+    bool analyze(Job& job, JobTiming& timing, std::string& result, std::string& error) {
+        if (!parseRequest(job, error)) {
+            return false;
+        }
+        int entry = store.find(job.surah, job.ayah, job.reciter);
+        if (entry < 0) {
+            error = "no reference for " + std::to_string(job.surah) + ":" + std::to_string(job.ayah) +
+                    " reciter " + std::to_string(job.reciter);
+            return false;
+        }
+        const ReferenceStoreHeader& header = store.header();
+        double sampleRate = header.sampleRate;
+        int frameSize = header.frameSize;
+        int hopSize = header.hopSize;
+        // The front end the store was built with, so both sides match
+        uint32_t frontEnd = store.frontEnd() & (kFeatureDenoise | kFeatureLoudness);
+
+        // Decode to the store's pipeline rate
+        Clock::time_point phase = Clock::now();
+        AudioClip clip;
+        clip.sampleRate = job.sampleRate;
+        int bytesPerSample = job.float32 ? 4 : 2;
+        size_t samples = (job.payload.size() - job.pcmOffset) / bytesPerSample;
+        const uint8_t* pcm = reinterpret_cast<const uint8_t*>(job.payload.data()) + job.pcmOffset;
+        clip.samples.resize(samples);
+        for (size_t i = 0; i < samples; i++) {
+            clip.samples[i] = audio_file::decodeSample(pcm + i * bytesPerSample, 8 * bytesPerSample,
+                                                       job.float32);
+        }
+        resample(clip, sampleRate);
+        timing.decode = millisecondsBetween(phase, Clock::now());
+
+        int dataLen = static_cast<int>(clip.samples.size());
+        int numFrames = dataLen >= frameSize ? (dataLen - frameSize) / hopSize + 1 : 0;
+        if (numFrames == 0) {
+            error = "shorter than one frame";
+            return false;
+        }
+        int referenceFrames = static_cast<int>(store.entry(entry).frames);
+        WorkspacePlan audioPlan = planFeatureWorkspace(dataLen, numFrames, frameSize, frontEnd, budget);
+        WorkspacePlan dtwPlan = planDTWWorkspace(numFrames, referenceFrames, kMFCCCoefficients,
+                                                 DTWAlgorithm::Full, -1, false, budget);
+        WorkspacePlan hmmPlan = planHMMWorkspace(numFrames, kScoringStates, kScoringSymbols, false, budget);
+        if (!audioPlan.feasible || !dtwPlan.feasible || !hmmPlan.feasible) {
+            error = "recording exceeds --memory-mb";
+            return false;
+        }
+
+        // Features, as the browser computes them
+        phase = Clock::now();
+        reserveWorkspace(audioPlan);
+        AudioProcessor processor;
+        FeatureMatrix features = processor.extractFeatures<double>(clip.samples.data(), dataLen, sampleRate,
+                                                                   frameSize, hopSize, frontEnd);
+        FeatureView all = features.view();
+        FeatureView mfcc(all.data(), all.rows(), kMFCCCoefficients, all.stride());
+        timing.features = millisecondsBetween(phase, Clock::now());
+
+        phase = Clock::now();
+        reserveWorkspace(dtwPlan);
+        double distance = referenceDistance(store, entry, mfcc);
+        timing.align = millisecondsBetween(phase, Clock::now());
+
+        phase = Clock::now();
+        reserveWorkspace(hmmPlan);
+        double likelihood = phonemeLikelihood(mfcc);
+        timing.hmm = millisecondsBetween(phase, Clock::now());
+
+        RecitationScore score = recitationScore(distance, likelihood);
+        result = ",\"distance\":" + jsonNumber(distance) + ",\"likelihood\":" + jsonNumber(likelihood) +
+                 ",\"timing_accuracy\":" + std::to_string(score.timingAccuracy) +
+                 ",\"phoneme_accuracy\":" + std::to_string(score.phonemeAccuracy) +
+                 ",\"overall_score\":" + std::to_string(score.overallScore) +
+                 ",\"frames\":" + std::to_string(mfcc.rows()) +
+                 ",\"reference_frames\":" + std::to_string(referenceFrames);
+        return true;
+    }
+
+    const ReferenceStore& store;
+    size_t budget;
+    int defaultReciter;
+    std::atomic<int> completed{0};
+    std::atomic<int> failed{0};
+};
+
+// Feeds queued jobs to the engine scheduler, keeping at most `limit` in
+// flight. Returns once the queue is closed and every job has answered.
+static void dispatch(JobQueue& queue, Analyzer& analyzer, int limit) {
+    std::mutex mutex;
+    std::condition_variable slotFree;
+    int inFlight = 0;
+
+    TaskGroup group;
+    std::shared_ptr<Job> job;
+    while (queue.pop(job)) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            slotFree.wait(lock, [&] { return inFlight < limit; });
+            inFlight++;
+        }
+        group.run([&, job] {
+            analyzer.run(*job);
+            std::lock_guard<std::mutex> lock(mutex);
+            inFlight--;
+            slotFree.notify_one();
+        });
+        job.reset();
+    }
+    group.wait();
+}
+
+// Reads frames from one client until it hangs up
+static void serveConnection(std::shared_ptr<Connection> connection, JobQueue& queue, Analyzer& analyzer,
+                            size_t maxFrameBytes) {
+    std::string payload;
+    std::string error;
+    while (connection->readFrame(payload, maxFrameBytes, error)) {
+        queue.push(analyzer.makeJob(connection, std::move(payload)));
+        payload.clear();
+    }
+    if (!error.empty()) {
+        connection->writeFrame("{\"id\":\"\",\"status\":\"error\",\"error\":" + jsonString(error) + "}");
+        std::fprintf(stderr, "closing connection: %s\n", error.c_str());
+    }
+}
+
+static const char* gSocketPath = nullptr;
+
+static void removeSocketAndExit(int) {
+    if (gSocketPath) ::unlink(gSocketPath);
+    _exit(0);
+}
+
+static int listenOn(const std::string& path) {
+    sockaddr_un address = {};
+    if (path.size() >= sizeof(address.sun_path)) {
+        std::fprintf(stderr, "socket path too long: %s\n", path.c_str());
+        return -1;
+    }
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        std::perror("socket");
+        return -1;
+    }
+    address.sun_family = AF_UNIX;
+    std::copy(path.begin(), path.end(), address.sun_path);
+    ::unlink(path.c_str());
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(fd, 128) != 0) {
+        std::perror(path.c_str());
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        usage();
+        return 2;
+    }
+    std::signal(SIGPIPE, SIG_IGN);
+
+    // The dispatcher only waits, so every core goes to the engine workers
+    TaskScheduler::configure(options.threads > 0 ? options.threads
+                                                 : std::max(1u, std::thread::hardware_concurrency()));
+    int jobs = options.jobs > 0 ? options.jobs : TaskScheduler::instance().workerCount();
+
+    MappedFile file;
+    ReferenceStore store;
+    if (!file.open(options.store.c_str()) || !store.open(file.data(), file.size())) {
+        std::fprintf(stderr, "cannot open reference store %s\n", options.store.c_str());
+        return 1;
+    }
+    if (store.featureDim() < kMFCCCoefficients) {
+        std::fprintf(stderr, "reference store has %d feature columns, need %d\n", store.featureDim(),
+                     kMFCCCoefficients);
+        return 1;
+    }
+
+    Analyzer analyzer(store, options);
+    JobQueue queue(options.queue);
+    size_t maxFrameBytes = static_cast<size_t>(options.maxFrameBytes);
+    std::fprintf(stderr, "%d entries, %d jobs in flight on %d workers, queue %d\n", store.entryCount(), jobs,
+                 TaskScheduler::instance().workerCount(), options.queue);
+
+    if (options.socketPath.empty()) {
+        auto started = Clock::now();
+        std::thread dispatcher([&] { dispatch(queue, analyzer, jobs); });
+        serveConnection(std::make_shared<Connection>(STDIN_FILENO, STDOUT_FILENO, false), queue, analyzer,
+                        maxFrameBytes);
+        queue.close();
+        dispatcher.join();
+        std::fprintf(stderr, "%d jobs (%d failed) in %.1fs\n", analyzer.completedCount() + analyzer.failedCount(),
+                     analyzer.failedCount(), millisecondsBetween(started, Clock::now()) / 1000.0);
+        return 0;
+    }
+
+    int listener = listenOn(options.socketPath);
+    if (listener < 0) {
+        return 1;
+    }
+    gSocketPath = options.socketPath.c_str();
+    std::signal(SIGINT, removeSocketAndExit);
+    std::signal(SIGTERM, removeSocketAndExit);
+
+    std::thread dispatcher([&] { dispatch(queue, analyzer, jobs); });
+    while (true) {
+        int client = ::accept(listener, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR) continue;
+            std::perror("accept");
+            break;
+        }
+        std::thread(serveConnection, std::make_shared<Connection>(client, client, true), std::ref(queue),
+                    std::ref(analyzer), maxFrameBytes).detach();
+    }
+    queue.close();
+    dispatcher.join();
+    ::unlink(gSocketPath);
+    return 1;
+}
@@ -0,0 +1,210 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Audio input for the native tools: RIFF/WAVE (PCM 8/16/24/32-bit, float
+// 32/64-bit, WAVE_FORMAT_EXTENSIBLE) and headerless little-endian 16-bit PCM.
+// Channels are mixed down to mono and samples scaled to [-1, 1], matching
+// what AudioBuffer.getChannelData() hands the browser pipeline.
+
+struct AudioClip {
+    std::vector<double> samples;
+    double sampleRate = 0.0;
+};
+
+namespace audio_file {
+
+inline uint32_t readLE(const uint8_t* p, int bytes) {
+    uint32_t value = 0;
+    for (int i = 0; i < bytes; i++) {
+        value |= static_cast<uint32_t>(p[i]) << (8 * i);
+    }
+    return value;
+}
+
+inline bool readAll(const std::string& path, std::vector<uint8_t>& bytes) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    uint8_t buffer[1 << 16];
+    size_t got;
+    bytes.clear();
+    while ((got = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        bytes.insert(bytes.end(), buffer, buffer + got);
+    }
+    bool ok = !std::ferror(file);
+    std::fclose(file);
+    return ok;
+}
+
+inline double decodeSample(const uint8_t* p, int bits, bool isFloat) {
+    if (isFloat) {
+        if (bits == 32) {
+            float value;
+            std::memcpy(&value, p, sizeof(value));
+            return value;
+        }
+        double value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+    switch (bits) {
+        case 8:
+            return (p[0] - 128) / 128.0;
+        case 16:
+            return static_cast<int16_t>(readLE(p, 2)) / 32768.0;
+        case 24: {
+            int32_t value = static_cast<int32_t>(readLE(p, 3) << 8) >> 8;
+            return value / 8388608.0;
+        }
+        default:
+            return static_cast<int32_t>(readLE(p, 4)) / 2147483648.0;
+    }
+}
+
+} // namespace audio_file
+
+// Returns false with `error` set for unreadable or unsupported files
+inline bool readWav(const std::string& path, AudioClip& clip, std::string& error) {
+    std::vector<uint8_t> bytes;
+    if (!audio_file::readAll(path, bytes)) {
+        error = "cannot read file";
+        return false;
+    }
+    if (bytes.size() < 12 || std::memcmp(bytes.data(), "RIFF", 4) != 0 ||
+        std::memcmp(bytes.data() + 8, "WAVE", 4) != 0) {
+        error = "not a RIFF/WAVE file";
+        return false;
+    }
+
+    int format = 0, channels = 0, bits = 0;
+    uint32_t rate = 0;
+    const uint8_t* data = nullptr;
+    size_t dataBytes = 0;
+
+    size_t pos = 12;
+    while (pos + 8 <= bytes.size()) {
+        const uint8_t* chunk = bytes.data() + pos;
+        size_t size = audio_file::readLE(chunk + 4, 4);
+        size_t available = std::min(size, bytes.size() - pos - 8);
+        if (std::memcmp(chunk, "fmt ", 4) == 0 && available >= 16) {
+            format = audio_file::readLE(chunk + 8, 2);
+            channels = audio_file::readLE(chunk + 10, 2);
+            rate = audio_file::readLE(chunk + 12, 4);
+            bits = audio_file::readLE(chunk + 22, 2);
+            if (format == 0xFFFE && available >= 26) {
+                format = audio_file::readLE(chunk + 32, 2); // SubFormat GUID prefix
+            }
+        } else if (std::memcmp(chunk, "data", 4) == 0) {
+            data = chunk + 8;
+            dataBytes = available;
+        }
+        pos += 8 + size + (size & 1);
+    }
+
+    bool isFloat = format == 3;
+    if (!data || channels <= 0 || rate == 0 || (format != 1 && !isFloat) ||
+        (isFloat && bits != 32 && bits != 64) ||
+        (!isFloat && bits != 8 && bits != 16 && bits != 24 && bits != 32)) {
+        error = "unsupported WAVE encoding";
+        return false;
+    }
+
+    int frameBytes = channels * bits / 8;
+    size_t frames = dataBytes / frameBytes;
+    clip.sampleRate = rate;
+    clip.samples.resize(frames);
+    for (size_t i = 0; i < frames; i++) {
+        const uint8_t* frame = data + i * frameBytes;
+        double sum = 0.0;
+        for (int c = 0; c < channels; c++) {
+            sum += audio_file::decodeSample(frame + c * bits / 8, bits, isFloat);
+        }
+        clip.samples[i] = sum / channels;
+    }
+    return true;
+}
+
+inline bool readPcm16(const std::string& path, double sampleRate, AudioClip& clip, std::string& error) {
+    std::vector<uint8_t> bytes;
+    if (!audio_file::readAll(path, bytes)) {
+        error = "cannot read file";
+        return false;
+    }
+    clip.sampleRate = sampleRate;
+    clip.samples.resize(bytes.size() / 2);
+    for (size_t i = 0; i < clip.samples.size(); i++) {
+        clip.samples[i] = audio_file::decodeSample(bytes.data() + 2 * i, 16, false);
+    }
+    return true;
+}
+
+// .wav by header; anything else is read as raw 16-bit PCM at `pcmRate`
+inline bool readAudioFile(const std::string& path, double pcmRate, AudioClip& clip, std::string& error) {
+    std::string lower = path;
+    std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+    if (lower.size() >= 4 && lower.compare(lower.size() - 4, 4, ".wav") == 0) {
+        return readWav(path, clip, error);
+    }
+    return readPcm16(path, pcmRate, clip, error);
+}
+
+// Band-limited resampling with a Blackman-windowed sinc (32 zero crossings
+// each side, cut off at the lower Nyquist frequency). The kernel is
+// tabulated at 512 points per zero crossing and linearly interpolated.
+inline void resample(AudioClip& clip, double targetRate) {
+    if (clip.sampleRate == targetRate || clip.samples.empty() || targetRate <= 0) {
+        return;
+    }
+    const double pi = 3.14159265358979323846;
+    const int kHalfTaps = 32;
+    const int kResolution = 512;
+
+    static const std::vector<double> kernel = [&] {
+        std::vector<double> table(kHalfTaps * kResolution + 2, 0.0);
+        for (int i = 0; i <= kHalfTaps * kResolution; i++) {
+            double x = static_cast<double>(i) / kResolution;
+            double sinc = i == 0 ? 1.0 : std::sin(pi * x) / (pi * x);
+            double t = x / kHalfTaps;
+            table[i] = sinc * (0.42 + 0.5 * std::cos(pi * t) + 0.08 * std::cos(2.0 * pi * t));
+        }
+        return table;
+    }();
+
+    double ratio = targetRate / clip.sampleRate;
+    double cutoff = std::min(1.0, ratio); // relative to the input Nyquist
+    double support = kHalfTaps / cutoff;  // input samples each side
+
+    size_t outLength = static_cast<size_t>(std::floor(clip.samples.size() * ratio));
+    std::vector<double> out(outLength);
+    const std::vector<double>& in = clip.samples;
+    long inLength = static_cast<long>(in.size());
+
+    for (size_t n = 0; n < outLength; n++) {
+        double center = n / ratio;
+        long first = std::max(0L, static_cast<long>(std::ceil(center - support)));
+        long last = std::min(inLength - 1, static_cast<long>(std::floor(center + support)));
+        double sum = 0.0;
+        double weightSum = 0.0;
+        for (long k = first; k <= last; k++) {
+            double position = std::fabs(k - center) * cutoff * kResolution;
+            int index = static_cast<int>(position);
+            if (index >= kHalfTaps * kResolution) continue;
+            double fraction = position - index;
+            double weight = kernel[index] + (kernel[index + 1] - kernel[index]) * fraction;
+            sum += in[k] * weight;
+            weightSum += weight;
+        }
+        out[n] = weightSum != 0.0 ? sum / weightSum : 0.0;
+    }
+
+    clip.samples.swap(out);
+    clip.sampleRate = targetRate;
+}
@@ -0,0 +1,299 @@
+// Offline reference corpus builder.
+//
+// Reads a manifest of reference recitations, extracts features with the
+// same AudioProcessor pipeline the WASM module runs, builds a DBA template
+// per verse from all reciters, and writes a reference store (see
+// reference_store.h) for WasmAnalysisService to load.
+//
+// Manifest: one recording per line, whitespace separated, '#' comments:
+//   surah ayah reciter path [word-start seconds, comma separated, then end]
+// Relative paths are resolved against the manifest's directory. Files other
+// than .wav are read as raw 16-bit mono PCM at --sample-rate.
+//
+// Build with build_native.sh.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../audio_processor.h"
+#include "../dba.h"
+#include "../reference_store.h"
+#include "../scheduler.h"
+#include "audio_file.h"
+
+// Verses per surah (Hafs numbering, 6236 in total)
+static const std::vector<uint32_t> kSurahVerseCounts = {
+    7, 286, 200, 176, 120, 165, 206, 75, 129, 109, 123, 111, 43, 52, 99, 128, 111, 110, 98, 135,
+    112, 78, 118, 64, 77, 227, 93, 88, 69, 60, 34, 30, 73, 54, 45, 83, 182, 88, 75, 85,
+    54, 53, 89, 59, 37, 35, 38, 29, 18, 45, 60, 49, 62, 55, 78, 96, 29, 22, 24, 13,
+    14, 11, 11, 18, 12, 12, 30, 52, 52, 44, 28, 28, 20, 56, 40, 31, 50, 40, 46, 42,
+    29, 19, 36, 25, 22, 17, 19, 26, 30, 20, 15, 21, 11, 8, 8, 19, 5, 8, 8, 11,
+    11, 8, 3, 9, 5, 4, 7, 3, 6, 3, 5, 4, 5, 6
+};
+
+struct Options {
+    std::string manifest;
+    std::string output;
+    ReferenceEncoding encoding = ReferenceEncoding::Float16;
+    double sampleRate = 48000.0;
+    int frameSize = 2048;
+    int threads = 0;
+    int envelopeRadius = 8;
+    int dbaIterations = 10;
+    int alignDims = kMFCCCoefficients;
+    bool templates = true;
+    uint32_t frontEnd = 0; // kFeatureDenoise / kFeatureLoudness, as the browser is configured
+    double memoryBudget = 256.0 * 1024 * 1024;
+};
+
+struct Recording {
+    int surah = 0;
+    int ayah = 0;
+    int reciter = 0;
+    std::string path;
+    std::vector<double> wordSeconds;
+
+    FeatureMatrix features;
+    std::string error;
+};
+
+static void usage() {
+    std::fprintf(stderr,
+        "usage: corpus_builder --manifest FILE --out FILE [options]\n"
+        "  --encoding f32|f16|i8     feature encoding (default f16)\n"
+        "  --sample-rate HZ          pipeline sample rate, inputs are resampled (48000)\n"
+        "  --frame-size N            frame size, hop is N/2 as in the browser (2048)\n"
+        "  --threads N               threads including the caller (ENGINE_THREADS or\n"
+        "                            hardware concurrency)\n"
+        "  --envelope-radius N       LB_Keogh envelope radius in frames, 0 = none (8)\n"
+        "  --dba-iterations N        DBA refinement passes (10)\n"
+        "  --align-dims N            leading feature columns used for alignment (13)\n"
+        "  --no-templates            skip the per-verse DBA templates\n"
+        "  --denoise                 suppress the learned background noise before the\n"
+        "                            mel stage, as with noiseSuppression in the browser\n"
+        "  --loudness                normalise loudness before framing, as with\n"
+        "                            loudnessNormalization in the browser\n"
+        "  --memory-mb N             per-thread DTW workspace ceiling (256)\n");
+}
+
+static bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto next = [&]() -> const char* { return i + 1 < argc ? argv[++i] : nullptr; };
+        const char* value = nullptr;
+
+        if (arg == "--no-templates") {
+            options.templates = false;
+            continue;
+        }
+        if (arg == "--denoise" || arg == "--loudness") {
+            options.frontEnd |= arg == "--denoise" ? kFeatureDenoise : kFeatureLoudness;
+            continue;
+        }
+        if (arg == "--help" || arg == "-h" || !(value = next())) {
+            return false;
+        }
+
+        if (arg == "--manifest") {
+            options.manifest = value;
+        } else if (arg == "--out") {
+            options.output = value;
+        } else if (arg == "--encoding") {
+            std::string encoding = value;
+            if (encoding == "f32") options.encoding = ReferenceEncoding::Float32;
+            else if (encoding == "f16") options.encoding = ReferenceEncoding::Float16;
+            else if (encoding == "i8") options.encoding = ReferenceEncoding::Int8;
+            else return false;
+        } else if (arg == "--sample-rate") {
+            options.sampleRate = std::atof(value);
+        } else if (arg == "--frame-size") {
+            options.frameSize = std::atoi(value);
+        } else if (arg == "--threads") {
+            options.threads = std::atoi(value);
+        } else if (arg == "--envelope-radius") {
+            options.envelopeRadius = std::atoi(value);
+        } else if (arg == "--dba-iterations") {
+            options.dbaIterations = std::atoi(value);
+        } else if (arg == "--align-dims") {
+            options.alignDims = std::atoi(value);
+        } else if (arg == "--memory-mb") {
+            options.memoryBudget = std::atof(value) * 1024 * 1024;
+        } else {
+            return false;
+        }
+    }
+    return !options.manifest.empty() && !options.output.empty() &&
+           options.sampleRate > 0 && options.frameSize >= 2;
+}
+
+static bool readManifest(const std::string& path, std::vector<Recording>& recordings) {
+    std::ifstream in(path);
+    if (!in) {
+        return false;
+    }
+    std::string directory;
+    size_t slash = path.find_last_of('/');
+    if (slash != std::string::npos) {
+        directory = path.substr(0, slash + 1);
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(in, line)) {
+        lineNumber++;
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        Recording recording;
+        if (!(fields >> recording.surah)) {
+            continue; // blank or comment
+        }
+        std::string words;
+        if (!(fields >> recording.ayah >> recording.reciter >> recording.path)) {
+            std::fprintf(stderr, "%s:%d: expected surah ayah reciter path\n", path.c_str(), lineNumber);
+            return false;
+        }
+        if (fields >> words) {
+            std::istringstream list(words);
+            std::string seconds;
+            while (std::getline(list, seconds, ',')) {
+                recording.wordSeconds.push_back(std::atof(seconds.c_str()));
+            }
+        }
+        if (!recording.path.empty() && recording.path[0] != '/') {
+            recording.path = directory + recording.path;
+        }
+        recordings.push_back(std::move(recording));
+    }
+    return true;
+}
+
+static std::vector<uint32_t> wordFrames(const std::vector<double>& seconds, double sampleRate,
+                                        int hopSize, int frames) {
+    std::vector<uint32_t> boundaries;
+    for (double s : seconds) {
+        int frame = static_cast<int>(s * sampleRate / hopSize);
+        boundaries.push_back(static_cast<uint32_t>(std::max(0, std::min(frames, frame))));
+    }
+    return boundaries;
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        usage();
+        return 2;
+    }
+    if (options.threads > 0) {
+        TaskScheduler::configure(options.threads - 1);
+    }
+    int threads = TaskScheduler::instance().concurrency();
+    int hopSize = options.frameSize / 2;
+    auto started = std::chrono::steady_clock::now();
+
+    std::vector<Recording> recordings;
+    if (!readManifest(options.manifest, recordings)) {
+        std::fprintf(stderr, "cannot read manifest %s\n", options.manifest.c_str());
+        return 1;
+    }
+
+    // 1. Features, one file per task. A thread waiting on a nested frame
+    // loop may pick up another file, so processors and arena use are scoped
+    // to the task rather than the thread.
+    std::atomic<int> done(0);
+    parallelFor(0, recordings.size(), 1, [&](int i) {
+        AudioProcessor processor;
+        ArenaScope scope(analysisArena());
+        Recording& recording = recordings[i];
+        AudioClip clip;
+        if (!readAudioFile(recording.path, options.sampleRate, clip, recording.error)) {
+            return;
+        }
+        resample(clip, options.sampleRate);
+        recording.features = processor.extractFeatures<double>(clip.samples.data(), clip.samples.size(),
+                                                               options.sampleRate, options.frameSize,
+                                                               hopSize, options.frontEnd);
+        if (recording.features.empty()) {
+            recording.error = "shorter than one frame";
+        }
+        int finished = ++done;
+        if (finished % 100 == 0) {
+            std::fprintf(stderr, "  %d/%zu files\n", finished, recordings.size());
+        }
+    });
+
+    int maxReciter = -1;
+    std::map<std::pair<int, int>, std::vector<int>> verses;
+    int failed = 0;
+    for (size_t i = 0; i < recordings.size(); i++) {
+        Recording& recording = recordings[i];
+        if (recording.error.empty() &&
+            (recording.surah < 1 || recording.surah > static_cast<int>(kSurahVerseCounts.size()) ||
+             recording.ayah < 1 || recording.ayah > static_cast<int>(kSurahVerseCounts[recording.surah - 1]) ||
+             recording.reciter < 0)) {
+            recording.error = "no such verse or reciter";
+        }
+        if (!recording.error.empty()) {
+            std::fprintf(stderr, "skipping %s: %s\n", recording.path.c_str(), recording.error.c_str());
+            failed++;
+            continue;
+        }
+        maxReciter = std::max(maxReciter, recording.reciter);
+        verses[{recording.surah, recording.ayah}].push_back(i);
+    }
+
+    // 2. DBA template per verse, stored as an extra reciter after the real ones
+    int templateReciter = options.templates ? maxReciter + 1 : -1;
+    std::vector<std::pair<std::pair<int, int>, std::vector<int>>> groups(verses.begin(), verses.end());
+    std::vector<FeatureMatrix> templates(options.templates ? groups.size() : 0);
+    if (options.templates) {
+        DBAOptions dba = {options.alignDims, options.dbaIterations, 1e-4,
+                          static_cast<size_t>(options.memoryBudget)};
+        parallelFor(0, groups.size(), 1, [&](int g) {
+            ArenaScope scope(analysisArena());
+            std::vector<FeatureView> sequences;
+            for (int i : groups[g].second) {
+                sequences.push_back(recordings[i].features.view());
+            }
+            templates[g] = dbaAverage(sequences, dba);
+        });
+    }
+
+    // 3. Store
+    ReferenceStoreWriter::Config config = {options.encoding, kFeaturesPerFrame,
+                                           static_cast<int>(options.sampleRate), options.frameSize,
+                                           hopSize, maxReciter + 1 + (options.templates ? 1 : 0),
+                                           options.envelopeRadius, options.frontEnd};
+    ReferenceStoreWriter writer(config, kSurahVerseCounts);
+    for (const Recording& recording : recordings) {
+        if (!recording.error.empty()) continue;
+        std::vector<uint32_t> words = wordFrames(recording.wordSeconds, options.sampleRate, hopSize,
+                                                 recording.features.rows());
+        writer.add(recording.surah, recording.ayah, recording.reciter, recording.features.view(), words);
+    }
+    for (size_t g = 0; g < templates.size(); g++) {
+        if (!templates[g].empty()) {
+            writer.add(groups[g].first.first, groups[g].first.second, templateReciter,
+                       templates[g].view());
+        }
+    }
+
+    if (!writer.writeFile(options.output.c_str())) {
+        std::fprintf(stderr, "cannot write %s\n", options.output.c_str());
+        return 1;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    std::fprintf(stderr, "%zu entries (%zu verses, %d failed) -> %s in %.1fs on %d threads\n",
+                 writer.entryCount(), groups.size(), failed, options.output.c_str(), seconds, threads);
+    if (options.templates) {
+        std::fprintf(stderr, "DBA templates are reciter %d\n", templateReciter);
+    }
+    return failed > 0 ? 3 : 0;
+}
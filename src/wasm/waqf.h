@@ -0,0 +1,253 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Waqf (pause) verification.
+//
+// WaqfDetector consumes feature rows one at a time, in the order the
+// streaming extractor produces them, and finds pauses from the RMS energy
+// and pitch columns. The moment a pause closes it is placed on the word
+// boundary it falls on, using the word alignment (query frame where each
+// word starts), and checked against the stop mark after that word, so the
+// verdicts are ready when the last row has been pushed; nothing rescans the
+// audio or the features.
+//
+// Voice activity: a frame is quiet when its level is well below a running
+// speech level (see kWaqfLevelFraction), tracked with a fast-attack peak
+// follower and a slow-rising noise floor so it works on a live stream. A
+// quiet frame whose pitch stays within kHeldPitchTolerance of the last
+// voiced frame is a held, softly trailing sound (madd, ghunnah), not a
+// pause.
+//
+// Layout of WaqfPause (little-endian, 32 bytes):
+//     0  int32   start       query frames [start, end); equal for
+//     4  int32   end         MissedRequired, at the boundary's frame
+//     8  int32   word        word the pause follows (InsideWord: the word
+//                            it interrupts)
+//    12  int32   mark        WaqfMark after that word
+//    16  int32   verdict     WaqfVerdict
+//    20  int32   reserved
+//    24  float64 durationMs
+
+// Stop marks of the mushaf, one per word: the mark written after it
+enum class WaqfMark : int32_t {
+    None = 0,               // no mark: stopping mid-phrase is not intended
+    Permitted = 1,          // jeem (U+06DA)
+    StopPreferred = 2,      // qala (U+06D7)
+    ContinuePreferred = 3,  // sala (U+06D6)
+    Required = 4,           // meem (U+06D8)
+    Forbidden = 5,          // la (U+06D9)
+    Paired = 6,             // mu'anaqah (U+06DB): stop at one of the pair
+    VerseEnd = 7
+};
+
+enum class WaqfVerdict : int32_t {
+    Correct = 0,
+    Discouraged = 1,     // stopped where continuing is preferred
+    Unmarked = 2,        // stopped at a word boundary without a mark
+    Forbidden = 3,       // stopped at a la mark
+    InsideWord = 4,      // stopped in the middle of a word
+    MissedRequired = 5,  // continued through a meem mark
+    PairedTwice = 6      // stopped at both marks of a mu'anaqah pair
+};
+
+struct WaqfPause {
+    int32_t start;
+    int32_t end;
+    int32_t word;
+    int32_t mark;
+    int32_t verdict;
+    int32_t reserved;
+    double durationMs;
+};
+
+static_assert(sizeof(WaqfPause) == 32, "waqf pause layout");
+
+struct WaqfConfig {
+    double frameRate;               // feature frames per second
+    int energyColumn;               // RMS energy
+    int pitchColumn;                // pitch in Hz, -1 when unavailable
+    double minPauseSeconds = 0.3;   // shorter silences are articulation
+    double boundaryToleranceSeconds = 0.15;
+};
+
+// A frame is quiet below this fraction of the way from the noise floor to
+// the speech level (in dB), or kWaqfMaxDepthDb under speech, whichever is
+// higher. Nothing is quiet until the two are kWaqfMinRangeDb apart.
+const double kWaqfLevelFraction = 0.25;
+const double kWaqfMaxDepthDb = 30.0;
+const double kWaqfMinRangeDb = 6.0;
+// Level follower rates in dB per second
+const double kSpeechDecayDbPerSecond = 2.0;
+const double kFloorRiseDbPerSecond = 1.0;
+const double kHeldPitchTolerance = 0.1;
+
+class WaqfDetector {
+public:
+    // wordStarts: words + 1 query frames, the start of each word and then
+    // the end of the last; marks: one per word. Both are copied.
+    WaqfDetector(const WaqfConfig& config, const int32_t* wordStarts, const WaqfMark* marks, int words)
+        : config(config), starts(wordStarts, wordStarts + (words > 0 ? words + 1 : 0)),
+          marks(marks, marks + std::max(0, words)), stopped(std::max(0, words), false) {
+        minPauseFrames = std::max(1, static_cast<int>(std::lround(config.minPauseSeconds * config.frameRate)));
+        tolerance = static_cast<int>(std::lround(config.boundaryToleranceSeconds * config.frameRate));
+        speechDecay = kSpeechDecayDbPerSecond / config.frameRate;
+        floorRise = kFloorRiseDbPerSecond / config.frameRate;
+    }
+
+    // One feature row of `cols` values
+    void push(const double* row, int cols) {
+        double energy = config.energyColumn >= 0 && config.energyColumn < cols ? row[config.energyColumn] : 0.0;
+        double pitch = config.pitchColumn >= 0 && config.pitchColumn < cols ? row[config.pitchColumn] : 0.0;
+        double level = 20.0 * std::log10(std::max(energy, 1e-9));
+        if (frame == 0) {
+            speech = noiseFloor = level;
+        }
+
+        // Judged against the levels before this frame, so a quiet stretch
+        // cannot qualify itself by dragging the floor down
+        bool quiet = speech - noiseFloor >= kWaqfMinRangeDb &&
+                     level < std::max(noiseFloor + kWaqfLevelFraction * (speech - noiseFloor),
+                                      speech - kWaqfMaxDepthDb);
+        track(level);
+        if (quiet && heldPitch > 0.0 && pitch > 0.0 &&
+            std::abs(pitch - heldPitch) <= kHeldPitchTolerance * heldPitch) {
+            quiet = false;
+        }
+        if (!quiet) {
+            heldPitch = pitch;
+        }
+
+        if (quiet && quietStart < 0) {
+            quietStart = frame;
+        } else if (!quiet && quietStart >= 0) {
+            closePause(quietStart, frame);
+            quietStart = -1;
+        }
+        frame++;
+    }
+
+    // Ends the stream: a trailing silence is the verse end, not a pause.
+    // Reports the required stops that were recited through.
+    void finish() {
+        quietStart = -1;
+        int words = static_cast<int>(marks.size());
+        for (int w = 0; w + 1 < words; w++) {
+            if (marks[w] == WaqfMark::Required && !stopped[w]) {
+                int at = starts[w + 1];
+                results.push_back({at, at, w, static_cast<int32_t>(WaqfMark::Required),
+                                   static_cast<int32_t>(WaqfVerdict::MissedRequired), 0, 0.0});
+            }
+        }
+    }
+
+    const std::vector<WaqfPause>& pauses() const { return results; }
+
+private:
+    void track(double level) {
+        speech = level > speech ? level : std::max(level, speech - speechDecay);
+        noiseFloor = level < noiseFloor ? level : std::min(level, noiseFloor + floorRise);
+    }
+
+    void closePause(int start, int end) {
+        int words = static_cast<int>(marks.size());
+        // Silence before the first word or after the last is not a waqf
+        if (end - start < minPauseFrames || words == 0 ||
+            end <= starts.front() || start >= starts.back()) {
+            return;
+        }
+
+        // The inner boundary (start of word b) nearest the pause, if close
+        int boundary = -1;
+        int bestGap = tolerance + 1;
+        for (int b = 1; b < words; b++) {
+            int at = starts[b];
+            int gap = at < start ? start - at : (at > end ? at - end : 0);
+            if (gap < bestGap) {
+                bestGap = gap;
+                boundary = b;
+            }
+        }
+
+        WaqfPause pause = {start, end, 0, 0, 0, 0, (end - start) * 1000.0 / config.frameRate};
+        if (boundary < 0) {
+            int middle = (start + end) / 2;
+            int word = static_cast<int>(std::upper_bound(starts.begin(), starts.end() - 1, middle) - starts.begin()) - 1;
+            pause.word = std::max(0, word);
+            pause.mark = static_cast<int32_t>(WaqfMark::None);
+            pause.verdict = static_cast<int32_t>(WaqfVerdict::InsideWord);
+        } else {
+            int word = boundary - 1;
+            WaqfMark mark = marks[word];
+            pause.word = word;
+            pause.mark = static_cast<int32_t>(mark);
+            pause.verdict = static_cast<int32_t>(verdictFor(word, mark));
+            stopped[word] = true;
+        }
+        results.push_back(pause);
+    }
+
+    WaqfVerdict verdictFor(int word, WaqfMark mark) const {
+        switch (mark) {
+            case WaqfMark::Permitted:
+            case WaqfMark::StopPreferred:
+            case WaqfMark::Required:
+            case WaqfMark::VerseEnd:
+                return WaqfVerdict::Correct;
+            case WaqfMark::ContinuePreferred:
+                return WaqfVerdict::Discouraged;
+            case WaqfMark::Forbidden:
+                return WaqfVerdict::Forbidden;
+            case WaqfMark::Paired:
+                // The earlier mark of the pair is the previous Paired word
+                for (int w = word - 1; w >= 0; w--) {
+                    if (marks[w] == WaqfMark::Paired) {
+                        return stopped[w] ? WaqfVerdict::PairedTwice : WaqfVerdict::Correct;
+                    }
+                }
+                return WaqfVerdict::Correct;
+            case WaqfMark::None:
+                break;
+        }
+        return WaqfVerdict::Unmarked;
+    }
+
+    WaqfConfig config;
+    std::vector<int32_t> starts;
+    std::vector<WaqfMark> marks;
+    std::vector<bool> stopped;
+    std::vector<WaqfPause> results;
+    int minPauseFrames;
+    int tolerance;
+    double speechDecay;
+    double floorRise;
+    double speech = 0.0;
+    double noiseFloor = 0.0;
+    double heldPitch = 0.0;
+    int quietStart = -1;
+    int frame = 0;
+};
+
+// Query frame where each word starts, from an alignment path (query,
+// reference) and the reference's words + 1 word boundary frames: a word
+// starts at the first query frame aligned to its first reference frame or
+// later; the last entry is the query frame after the last word.
+inline void wordStartsFromPath(const std::vector<std::pair<int, int>>& path, const uint32_t* referenceBoundaries,
+                               int words, int queryLength, int32_t* wordStarts) {
+    size_t cell = 0;
+    for (int w = 0; w < words; w++) {
+        while (cell < path.size() && path[cell].second < static_cast<int>(referenceBoundaries[w])) {
+            cell++;
+        }
+        wordStarts[w] = cell < path.size() ? path[cell].first : queryLength;
+    }
+    int end = 0;
+    for (const std::pair<int, int>& step : path) {
+        if (step.second < static_cast<int>(referenceBoundaries[words])) end = step.first + 1;
+    }
+    wordStarts[words] = words > 0 ? std::max(end, wordStarts[words - 1]) : 0;
+}
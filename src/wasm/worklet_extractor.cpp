@@ -0,0 +1,75 @@
+#include <emscripten/emscripten.h>
+#include "worklet_extractor.h"
+
+// Standalone build of WorkletFeatureExtractor for the AudioWorklet global
+// scope, which has no fetch, no importScripts and a hard real-time deadline.
+// The page compiles the .wasm and hands the WebAssembly.Module to the
+// processor, which instantiates it synchronously. There is no embind and no
+// JS runtime, and memory never grows, so the views the worklet takes over
+// the input block and the feature rows stay valid for its lifetime.
+
+static WorkletFeatureExtractor& extractor() {
+    static WorkletFeatureExtractor instance;
+    return instance;
+}
+
+// Filled by the worklet before each worklet_process() call
+alignas(16) static float quantumInput[kRenderQuantum];
+
+extern "C" {
+    // Returns 1 when the configuration is usable; every allocation the
+    // extractor will ever make happens here
+    EMSCRIPTEN_KEEPALIVE
+    int worklet_configure(double sample_rate, int frame_size, int hop_size, int max_frames) {
+        return extractor().configure(sample_rate, frame_size, hop_size, max_frames) ? 1 : 0;
+    }
+
+    // kRenderQuantum floats the worklet copies each quantum into
+    EMSCRIPTEN_KEEPALIVE
+    float* worklet_input() {
+        return quantumInput;
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    int worklet_quantum() {
+        return kRenderQuantum;
+    }
+
+    // Consumes `count` samples from worklet_input() and returns the number of
+    // rows ready: kFeaturesPerFrame float32 columns, worklet_feature_stride()
+    // apart, from worklet_features(), valid until worklet_clear()
+    EMSCRIPTEN_KEEPALIVE
+    int worklet_process(int count) {
+        return extractor().process(quantumInput, std::max(0, std::min(count, kRenderQuantum)));
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    const float* worklet_features() {
+        return extractor().data();
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    int worklet_feature_stride() {
+        return extractor().stride();
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    void worklet_clear() {
+        extractor().clearFrames();
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    void worklet_reset() {
+        extractor().reset();
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    double worklet_dropped() {
+        return static_cast<double>(extractor().framesDropped());
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    double worklet_late() {
+        return static_cast<double>(extractor().framesLate());
+    }
+}
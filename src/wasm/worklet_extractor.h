@@ -0,0 +1,165 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include "arena.h"
+#include "audio_processor.h"
+#include "feature_matrix.h"
+
+// Samples per AudioWorkletProcessor.process() call
+const int kRenderQuantum = 128;
+
+// Feature extraction on the audio rendering thread, one render quantum at a
+// time. The rows are the same as AudioProcessor::extractFrameInto and
+// StreamingFeatureExtractor produce for the same samples.
+//
+// A whole frame costs far more than one quantum can afford, mostly in the
+// pitch search. So when a frame completes it is snapshotted, and its work
+// is spread over the quanta until the next frame is due. The first step
+// does the spectral columns (two FFTs). Each later step covers an equal
+// slice of the pitch lags. If the next frame arrives before the current one
+// is finished (hop shorter than the planned steps), the remainder runs at
+// once and the frame is counted as late.
+//
+// configure() sizes every buffer and warms the analysis arena. process()
+// does not allocate after that. Rows collect in a fixed-capacity block until
+// the caller takes them with clearFrames(); frames that arrive while it is
+// full are dropped and counted.
+class WorkletFeatureExtractor {
+public:
+    // False for unusable configurations (hop larger than the frame, no room)
+    bool configure(double sampleRate, int frameSize, int hopSize, int maxFrames) {
+        if (sampleRate <= 0 || frameSize < 2 || hopSize <= 0 || hopSize > frameSize || maxFrames <= 0) {
+            return false;
+        }
+        rate = sampleRate;
+        size = frameSize;
+        hop = hopSize;
+        history.assign(frameSize, 0.0);
+        frame.assign(frameSize, 0.0);
+        output.resize(maxFrames, kFeaturesPerFrame);
+
+        // One spectral step, then the pitch lags over the remaining quanta
+        AudioProcessor::PitchSearch search = AudioProcessor::beginPitchSearch(frameSize, sampleRate);
+        int lags = std::max(1, search.lastLag - search.nextLag + 1);
+        int pitchSteps = std::max(1, hopSize / kRenderQuantum - 1);
+        lagsPerStep = (lags + pitchSteps - 1) / pitchSteps;
+
+        // Plan the tables and grow the arena to its per-frame peak once
+        processor.prepare(frameSize, sampleRate);
+        {
+            ArenaScope scope(analysisArena());
+            processor.extractFrameInto(frame.data(), frameSize, sampleRate, row);
+        }
+        reset();
+        return true;
+    }
+
+    // Starts a new stream with the same configuration
+    void reset() {
+        filled = 0;
+        pending = 0;
+        stage = Stage::Idle;
+        produced = 0;
+        dropped = 0;
+        late = 0;
+    }
+
+    bool configured() const { return size > 0; }
+
+    // Feeds one quantum (at most kRenderQuantum samples) and advances the
+    // frame in flight by one step. Returns the rows ready to be taken.
+    int process(const float* samples, int count) {
+        if (!configured()) return 0;
+        while (count > 0) {
+            int take = std::min(count, size - filled);
+            double* tail = history.data() + filled;
+            for (int i = 0; i < take; i++) {
+                tail[i] = samples[i];
+            }
+            filled += take;
+            samples += take;
+            count -= take;
+
+            if (filled == size) {
+                beginFrame();
+                std::memmove(history.data(), history.data() + hop, sizeof(double) * (size - hop));
+                filled = size - hop;
+            }
+        }
+        step();
+        return pending;
+    }
+
+    // Rows completed since the last clearFrames()
+    int frameCount() const { return pending; }
+    FeatureViewF frames() const { return output.view().slice(0, pending); }
+    const float* data() const { return output.data(); }
+    int stride() const { return static_cast<int>(output.stride()); }
+    void clearFrames() { pending = 0; }
+
+    // Frames completed over the whole stream, including dropped ones
+    int64_t framesProduced() const { return produced; }
+    int64_t framesDropped() const { return dropped; }
+    // Frames that had to be finished in a single quantum
+    int64_t framesLate() const { return late; }
+
+private:
+    enum class Stage { Idle, Spectral, Pitch };
+
+    void beginFrame() {
+        if (stage != Stage::Idle) {
+            late++;
+            while (stage != Stage::Idle) {
+                step();
+            }
+        }
+        produced++;
+        if (pending >= output.rows()) {
+            dropped++;
+            return;
+        }
+        std::copy(history.begin(), history.end(), frame.begin());
+        stage = Stage::Spectral;
+    }
+
+    void step() {
+        switch (stage) {
+        case Stage::Idle:
+            return;
+        case Stage::Spectral: {
+            ArenaScope scope(analysisArena());
+            processor.extractSpectralInto(frame.data(), size, rate, row);
+            search = AudioProcessor::beginPitchSearch(size, rate);
+            stage = Stage::Pitch;
+            return;
+        }
+        case Stage::Pitch:
+            if (AudioProcessor::continuePitchSearch(frame.data(), size, search, lagsPerStep)) {
+                row[kMFCCCoefficients + 3] = AudioProcessor::pitchFrom(search, rate);
+                std::copy(row, row + kFeaturesPerFrame, output.row(pending));
+                pending++;
+                stage = Stage::Idle;
+            }
+            return;
+        }
+    }
+
+    AudioProcessor processor;
+    PoolVector<double> history;
+    PoolVector<double> frame;
+    FeatureMatrixF output;
+    double row[kFeaturesPerFrame] = {};
+    AudioProcessor::PitchSearch search = {};
+    Stage stage = Stage::Idle;
+    double rate = 0.0;
+    int size = 0;
+    int hop = 0;
+    int lagsPerStep = 1;
+    int filled = 0;
+    int pending = 0;
+    int64_t produced = 0;
+    int64_t dropped = 0;
+    int64_t late = 0;
+};
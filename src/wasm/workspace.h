@@ -0,0 +1,233 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include "arena.h"
+#include "scheduler.h"
+
+// Workspace planning.
+//
+// Given input lengths and the algorithm a caller wants, compute exactly how
+// many arena bytes one analysis call will touch (inputs, scratch and arena
+// results) so the arena can be grown once up front. With
+// ALLOW_MEMORY_GROWTH a mid-analysis memory.grow copies the heap and
+// detaches every HEAP* view JS holds; reserving first avoids both.
+//
+// The byte counts mirror the allocation order in the modules: every arena
+// allocation is rounded up to kArenaAlignment, so the sum below is exact.
+
+enum class DTWAlgorithm {
+    Full = 0,         // (n+1) x (m+1) cost and step matrices, exact path
+    Banded = 1,       // Sakoe-Chiba band storage, (n+1) x (2w+1)
+    DistanceOnly = 2, // two rolling rows, exact distance and path length, no path
+    FastDTW = 3,      // multi-resolution corridor of radius r, approximate path
+    Hirschberg = 4    // divide and conquer over rolling rows, exact path
+};
+
+struct WorkspacePlan {
+    bool feasible;
+    bool downgraded;
+    DTWAlgorithm dtwAlgorithm;
+    int bandWidth;
+    size_t inputBytes;
+    size_t scratchBytes;
+    size_t workerBytes; // each scheduler worker's own arena, for parallel loops
+
+    // The calling thread's share; workerBytes come on top, once per worker
+    size_t totalBytes() const { return inputBytes + scratchBytes; }
+};
+
+inline size_t arenaBytes(size_t count, size_t elementSize) {
+    size_t bytes = count * elementSize;
+    return alignUp(bytes == 0 ? 1 : bytes, kArenaAlignment);
+}
+
+// Scratch used by DynamicTimeWarping::align for one call
+inline size_t dtwScratchBytes(int n, int m, DTWAlgorithm algorithm, int bandWidth) {
+    size_t rows = static_cast<size_t>(n) + 1;
+    size_t cols = static_cast<size_t>(m) + 1;
+
+    switch (algorithm) {
+        case DTWAlgorithm::Full:
+            return arenaBytes(rows * cols, sizeof(double)) + arenaBytes(rows * cols, sizeof(uint8_t));
+        case DTWAlgorithm::Banded: {
+            size_t width = 2 * static_cast<size_t>(bandWidth) + 1;
+            return arenaBytes(rows * width, sizeof(double)) + arenaBytes(rows * width, sizeof(uint8_t));
+        }
+        case DTWAlgorithm::DistanceOnly:
+            return arenaBytes(2 * cols, sizeof(double)) + arenaBytes(2 * cols, sizeof(int));
+        case DTWAlgorithm::FastDTW:
+        case DTWAlgorithm::Hirschberg:
+            // Mostly pooled rather than arena memory; see alignmentBytes()
+            return 0;
+    }
+    return 0;
+}
+
+// Peak engine memory of an alignment beyond its inputs, for any algorithm:
+// the arena scratch above, plus for FastDTW its full-resolution corridor
+// (about (n + m) * (2r + 3) cells; coarser levels are released before it is
+// built), the downsampled copies and the paths, and for Hirschberg one direct block and two rolling
+// row pairs per thread plus the path. `parameter` is the band width or the
+// FastDTW radius.
+inline size_t alignmentBytes(int n, int m, int dim, DTWAlgorithm algorithm, int parameter, int threads) {
+    size_t length = static_cast<size_t>(n) + m;
+    size_t pathBytes = length * 2 * sizeof(int);
+    switch (algorithm) {
+        case DTWAlgorithm::FastDTW: {
+            size_t cells = length * (2 * static_cast<size_t>(std::max(0, parameter)) + 3);
+            size_t corridor = 2 * (static_cast<size_t>(n) + 1) * (2 * sizeof(int32_t) + sizeof(size_t));
+            return arenaBytes(cells, sizeof(double)) + arenaBytes(cells, sizeof(uint8_t)) + corridor +
+                   length * dim * sizeof(double) + 2 * pathBytes;
+        }
+        case DTWAlgorithm::Hirschberg: {
+            size_t block = (static_cast<size_t>(1) << 16) + length + 1;
+            size_t rows = 4 * (static_cast<size_t>(m) + 1) * sizeof(double);
+            return static_cast<size_t>(std::max(1, threads)) *
+                       (arenaBytes(block, sizeof(double)) + arenaBytes(block, sizeof(uint8_t)) + rows) +
+                   pathBytes;
+        }
+        case DTWAlgorithm::DistanceOnly:
+            return dtwScratchBytes(n, m, algorithm, parameter);
+        default:
+            return dtwScratchBytes(n, m, algorithm, parameter) + pathBytes;
+    }
+}
+
+inline bool withinBudget(size_t bytes, size_t budget) {
+    return budget == 0 || bytes <= budget;
+}
+
+// Plans a DTW call over n x dim and m x dim inputs placed in the arena
+// (with the padded FeatureMatrix stride, an upper bound for dense input).
+// A budget of 0 means unlimited. When the requested algorithm does not fit:
+//  - callers that do not need the path get the rolling-row variant, which is
+//    exact for distance and normalised distance;
+//  - callers that need the path get the widest Sakoe-Chiba band that fits
+//    (never narrower than |n - m|, or the end cell would be unreachable);
+//  - otherwise the plan is rejected.
+inline WorkspacePlan planDTWWorkspace(int n, int m, int dim, DTWAlgorithm requested,
+                                      int bandWidth, bool needPath, size_t budget) {
+    WorkspacePlan plan = {false, false, requested, bandWidth, 0, 0, 0};
+    size_t stride = alignUp(static_cast<size_t>(dim), kArenaAlignment / sizeof(double));
+    plan.inputBytes = arenaBytes(static_cast<size_t>(n) * stride, sizeof(double)) +
+                      arenaBytes(static_cast<size_t>(m) * stride, sizeof(double));
+
+    int minBand = std::abs(n - m);
+    if (requested == DTWAlgorithm::Banded) {
+        plan.bandWidth = std::max(bandWidth, minBand);
+    } else if (requested == DTWAlgorithm::Full) {
+        plan.bandWidth = -1;
+    }
+    if (!needPath) {
+        // The path is never materialised, so the rolling rows give the same answer
+        plan.dtwAlgorithm = DTWAlgorithm::DistanceOnly;
+    }
+
+    plan.scratchBytes = dtwScratchBytes(n, m, plan.dtwAlgorithm, plan.bandWidth);
+    if (withinBudget(plan.totalBytes(), budget)) {
+        plan.feasible = true;
+        return plan;
+    }
+
+    plan.downgraded = true;
+
+    if (!needPath || budget <= plan.inputBytes) {
+        return plan;
+    }
+
+    // Widest band that fits: (n+1) * (2w+1) * (8 + 1) bytes plus alignment
+    size_t rows = static_cast<size_t>(n) + 1;
+    size_t perCell = sizeof(double) + sizeof(uint8_t);
+    size_t available = budget - plan.inputBytes;
+    size_t maxWidth = available / (rows * perCell);
+    int band = maxWidth >= 1 ? static_cast<int>((maxWidth - 1) / 2) : -1;
+    if (plan.dtwAlgorithm == DTWAlgorithm::Banded) {
+        band = std::min(band, plan.bandWidth);
+    }
+    band = std::min(band, std::max(n, m));
+
+    while (band >= minBand &&
+           !withinBudget(plan.inputBytes + dtwScratchBytes(n, m, DTWAlgorithm::Banded, band), budget)) {
+        band--;
+    }
+
+    if (band < minBand) {
+        return plan;
+    }
+
+    plan.dtwAlgorithm = DTWAlgorithm::Banded;
+    plan.bandWidth = band;
+    plan.scratchBytes = dtwScratchBytes(n, m, DTWAlgorithm::Banded, band);
+    plan.feasible = true;
+    return plan;
+}
+
+// Scratch peak of one frame's spectrum: windowed frame + magnitude
+// spectrum + FFT real/imaginary buffers. Whichever thread runs the frame
+// allocates it from its own arena.
+inline size_t frameScratchBytes(int frameSize) {
+    return arenaBytes(frameSize, sizeof(double)) + arenaBytes(frameSize / 2, sizeof(double)) +
+           2 * arenaBytes(frameSize, sizeof(double));
+}
+
+// Feature extraction: audio input, flat result and the per-frame scratch
+// peak, which every worker of the frame loop needs as well. The optional
+// stages add to it; see planFeatureWorkspace().
+inline WorkspacePlan planAudioWorkspace(int dataLen, int numFrames, int featuresPerFrame,
+                                        int frameSize, size_t budget) {
+    WorkspacePlan plan = {false, false, DTWAlgorithm::Full, -1, 0, 0, 0};
+    plan.inputBytes = arenaBytes(dataLen, sizeof(double));
+
+    size_t mfccScratch = frameScratchBytes(frameSize);
+    plan.scratchBytes = arenaBytes(static_cast<size_t>(numFrames) * featuresPerFrame, sizeof(double)) +
+                        mfccScratch;
+    plan.workerBytes = mfccScratch;
+
+    plan.feasible = withinBudget(plan.totalBytes(), budget);
+    return plan;
+}
+
+// HMM: observations and row-major model inputs, then either the Viterbi
+// psi table with two delta rows plus the returned path, or the two forward
+// rows.
+inline WorkspacePlan planHMMWorkspace(int T, int numStates, int numSymbols, bool viterbi,
+                                      size_t budget) {
+    WorkspacePlan plan = {false, false, DTWAlgorithm::Full, -1, 0, 0, 0};
+    size_t states = static_cast<size_t>(numStates);
+    plan.inputBytes = arenaBytes(T, sizeof(int)) +
+                      arenaBytes(states * states, sizeof(double)) +
+                      arenaBytes(states * numSymbols, sizeof(double)) +
+                      arenaBytes(states, sizeof(double));
+
+    if (viterbi) {
+        plan.scratchBytes = arenaBytes(T, sizeof(int)) +
+                            arenaBytes(2 * states, sizeof(double)) +
+                            arenaBytes(static_cast<size_t>(T) * states, sizeof(int));
+    } else {
+        plan.scratchBytes = arenaBytes(2 * states, sizeof(double));
+    }
+
+    plan.feasible = withinBudget(plan.totalBytes(), budget);
+    return plan;
+}
+
+// Reserves a worker's share on every scheduler worker. Arenas are
+// thread_local, so reserving the caller's alone leaves the workers to grow
+// theirs on the first parallel loop.
+inline void reserveWorkerArenas(size_t bytes) {
+    if (bytes > 0) {
+        TaskScheduler::instance().forEachWorker([bytes] { analysisArena().reserve(bytes); });
+    }
+}
+
+// Grows the arena once for a feasible plan, and each worker's for its share
+inline bool reserveWorkspace(const WorkspacePlan& plan) {
+    if (!plan.feasible) {
+        return false;
+    }
+    analysisArena().reserve(plan.totalBytes());
+    reserveWorkerArenas(plan.workerBytes);
+    return true;
+}